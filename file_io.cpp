@@ -88,8 +88,21 @@ void annotationFileLoad(const QString & filename, const bool mergeSkeleton, cons
                 throw std::runtime_error("couldn’t store custom settings.ini from annotation file to a temporary file");
             }
         });
-        getSpecificFile("mergelist.txt", [](auto & file){
-            Segmentation::singleton().mergelistLoad(file);
+        boost::optional<quint32> mergelistTextChecksum;
+        if (archive.setCurrentFile("mergelist.txt")) {
+            QuaZipFileInfo64 info;
+            if (archive.getCurrentFileInfo(&info)) {
+                mergelistTextChecksum = info.crc;
+            }
+        }
+        bool binaryMergelistLoaded{false};
+        getSpecificFile("mergelist.bin", [&binaryMergelistLoaded, mergelistTextChecksum](auto & file){
+            binaryMergelistLoaded = Segmentation::singleton().mergelistLoadBinary(file, mergelistTextChecksum);
+        });
+        getSpecificFile("mergelist.txt", [binaryMergelistLoaded](auto & file){
+            if (!binaryMergelistLoaded) {
+                Segmentation::singleton().mergelistLoad(file);
+            }
         });
         getSpecificFile("microworker.txt", [](auto & file){
             Segmentation::singleton().jobLoad(file);
@@ -167,12 +180,21 @@ void annotationFileSave(const QString & filename) {
             throw std::runtime_error((filename + ": saving skeleton failed").toStdString());
         }
         if (Segmentation::singleton().hasObjects()) {
+            const auto text = Segmentation::singleton().mergelistText();
             QuaZipFile file_write(&archive_write);
             if (zipCreateFile(file_write, "mergelist.txt", 1)) {
-                Segmentation::singleton().mergelistSave(file_write);
+                file_write.write(text);
             } else {
                 throw std::runtime_error((filename + ": saving mergelist failed").toStdString());
             }
+            // loads faster, only used if mergelist.txt still has this checksum, older versions only know the text
+            const auto textChecksum = static_cast<quint32>(crc32(crc32(0, nullptr, 0), reinterpret_cast<const Bytef *>(text.constData()), static_cast<uInt>(text.size())));
+            QuaZipFile binaryFile(&archive_write);
+            if (zipCreateFile(binaryFile, "mergelist.bin", 1)) {
+                binaryFile.write(Segmentation::singleton().mergelistBinary(textChecksum));
+            } else {
+                throw std::runtime_error((filename + ": saving binary mergelist failed").toStdString());
+            }
         }
         if (Segmentation::singleton().job.id != 0) {
             QuaZipFile file_write(&archive_write);
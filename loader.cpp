@@ -24,6 +24,7 @@
 
 #include "network.h"
 #include "segmentation/segmentation.h"
+#include "segmentation/statistics.h"
 #include "session.h"
 #include "skeleton/skeletonizer.h"
 #include "stateInfo.h"
@@ -43,6 +44,8 @@
 #include <QNetworkReply>
 #include <QtConcurrent>
 
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <fstream>
 #include <stdexcept>
@@ -81,11 +84,35 @@ void Loader::Controller::unloadCurrentMagnification() {
 }
 
 void Loader::Controller::markOcCubeAsModified(const CoordOfCube &cubeCoord, const int magnification) {
-    emit markOcCubeAsModifiedSignal(cubeCoord, magnification);
+    if (worker->modifiedCubeInbox.push(cubeCoord, static_cast<std::size_t>(std::log2(magnification)))) {
+        QTimer::singleShot(0, worker.get(), &Loader::Worker::modifiedCubesPending);
+    }
+    SegmentationStatistics::singleton().cubeChanged(cubeCoord, magnification);
     state->viewer->window->notifyUnsavedChanges();
     state->viewer->reslice_notify_all(worker.get()->snappyLayerId, cubeCoord.cube2Global(Dataset::current().cubeEdgeLength, magnification));
 }
 
+void Loader::Controller::markOcCubesAsModified(const Loader::Worker::CacheQueue & cubeCoords, const int magnification) {
+    if (cubeCoords.empty()) {
+        return;
+    }
+    bool wasEmpty{false};
+    for (const auto & cubeCoord : cubeCoords) {
+        wasEmpty |= worker->modifiedCubeInbox.push(cubeCoord, static_cast<std::size_t>(std::log2(magnification)));
+        SegmentationStatistics::singleton().cubeChanged(cubeCoord, magnification);
+    }
+    if (wasEmpty) {
+        QTimer::singleShot(0, worker.get(), &Loader::Worker::modifiedCubesPending);
+    }
+    state->viewer->window->notifyUnsavedChanges();
+    std::vector<Coordinate> globalCoords;
+    globalCoords.reserve(cubeCoords.size());
+    for (const auto & cubeCoord : cubeCoords) {
+        globalCoords.emplace_back(cubeCoord.cube2Global(Dataset::current().cubeEdgeLength, magnification));
+    }
+    state->viewer->reslice_notify_all(worker.get()->snappyLayerId, globalCoords);
+}
+
 decltype(Loader::Worker::snappyCache) Loader::Controller::getAllModifiedCubes() {
     if (worker != nullptr) {
         QMutexLocker locker(&worker->snappyMutex);
@@ -98,6 +125,22 @@ decltype(Loader::Worker::snappyCache) Loader::Controller::getAllModifiedCubes()
     }
 }
 
+Loader::Worker::SnappyCache Loader::Controller::getModifiedCubes(const std::size_t magIndex, const std::vector<CoordOfCube> & cubeCoords) {
+    Loader::Worker::SnappyCache cubes;
+    if (worker != nullptr) {
+        QMutexLocker locker(&worker->snappyMutex);
+        if (magIndex < worker->snappyCache.size()) {
+            for (const auto & cubeCoord : cubeCoords) {
+                const auto it = worker->snappyCache[magIndex].find(cubeCoord);
+                if (it != std::end(worker->snappyCache[magIndex])) {
+                    cubes.emplace(*it);
+                }
+            }
+        }
+    }
+    return cubes;
+}
+
 bool Loader::Controller::isFinished() {
     return worker != nullptr ? worker->isFinished.load() : true;//no loader == done?
 }
@@ -203,6 +246,11 @@ Loader::Worker::Worker(const decltype(datasets) & layers)
     , slotChunk(static_cast<std::size_t>(layers.size())), freeSlots(static_cast<std::size_t>(layers.size()))
     , datasets{layers}, snappyLayerId{Segmentation::singleton().layerId}
     , OcModifiedCacheQueue(static_cast<std::size_t>(std::log2(layers.front().highestAvailableMag)+1))
+    , propagationQueue(static_cast<std::size_t>(std::log2(layers.front().highestAvailableMag)+1))
+    , restoredCubes(static_cast<std::size_t>(std::log2(layers.front().highestAvailableMag)+1))
+    , restoredQueue(static_cast<std::size_t>(std::log2(layers.front().highestAvailableMag)+1))
+    , pendingBlocks(static_cast<std::size_t>(std::log2(layers.front().highestAvailableMag)+1))
+    , droppedPendingCubes(static_cast<std::size_t>(std::log2(layers.front().highestAvailableMag)+1))
     , snappyCache(static_cast<std::size_t>(std::log2(layers.front().highestAvailableMag)+1))
 {
     qnam.setRedirectPolicy(QNetworkRequest::NoLessSafeRedirectPolicy);// default is manual redirect
@@ -262,6 +310,10 @@ void unloadCubes(CubeHash & loadedCubes, Slots & freeSlots, Keep keep, UnloadHoo
 }
 
 void Loader::Worker::unloadCurrentMagnification() {
+    {// propagate now, edits in the next mag are newer and must not be overwritten by these
+        QMutexLocker locker(&snappyMutex);
+        compressModifiedCubes();
+    }
     for (std::size_t layerId{0}; layerId < datasets.size(); ++layerId) {
         abortDownloadsFinishDecompression(layerId, [](const Coordinate &){return false;});
         QMutexLocker locker(&state->protectCube2Pointer);
@@ -284,8 +336,11 @@ void Loader::Worker::unloadCurrentMagnification() {
     }
 }
 
-void Loader::Worker::markOcCubeAsModified(const CoordOfCube &cubeCoord, const int magnification) {
-    OcModifiedCacheQueue[static_cast<std::size_t>(std::log2(magnification))].emplace(cubeCoord);
+void Loader::Worker::takeModifiedCubes() {
+    modifiedCubeInbox.take([this](const CoordOfCube & cubeCoord, const std::size_t magIndex){
+        OcModifiedCacheQueue[magIndex].emplace(cubeCoord);
+        propagationQueue[magIndex].emplace(cubeCoord);
+    });
 }
 
 void Loader::Worker::snappyCacheSupplySnappy(const CoordOfCube cubeCoord, const int magnification, const std::string cube) {
@@ -296,6 +351,12 @@ void Loader::Worker::snappyCacheSupplySnappy(const CoordOfCube cubeCoord, const
         return;
     }
     snappyCache[cubeMagnification].emplace(std::piecewise_construct, std::forward_as_tuple(cubeCoord), std::forward_as_tuple(cube));
+    //the backup already contains everything propagated into it, pending blocks of unsaved coarser cubes are recreated from it
+    erasePendingBlocks(cubeMagnification, cubeCoord);
+    droppedPendingCubes[cubeMagnification].erase(cubeCoord);
+    restoredCubes[cubeMagnification].emplace(cubeCoord);
+    restoredQueue[cubeMagnification].emplace(cubeCoord);
+    modifiedCubesPending();
 
     if (cubeMagnification == loaderMagnification) {//unload if currently loaded
         const auto globalCoord = cubeCoord.cube2Global(datasets.front().cubeEdgeLength, magnification);
@@ -328,6 +389,7 @@ void Loader::Worker::snappyCacheClear() {
     if (snappyLayerId >= state->cube2Pointer.size()) {
         return;
     }
+    takeModifiedCubes();
     //unload all modified cubes
     for (std::size_t mag = 0; mag < OcModifiedCacheQueue.size(); ++mag) {
         unloadCubes(state->cube2Pointer[snappyLayerId][mag], freeSlots[snappyLayerId], [this, mag](const CoordOfCube & cubeCoord){
@@ -337,28 +399,365 @@ void Loader::Worker::snappyCacheClear() {
         });
         OcModifiedCacheQueue[mag].clear();
         snappyCache[mag].clear();
+        propagationQueue[mag].clear();
+        restoredCubes[mag].clear();
+        restoredQueue[mag].clear();
+        pendingBlocks[mag].clear();
+        droppedPendingCubes[mag].clear();
     }
+    pendingBytes = 0;
     state->viewer->loader_notify();//a bit of a detour…
 }
 
-void Loader::Worker::flushIntoSnappyCache() {
+void Loader::Worker::modifiedCubesPending() {
+    takeModifiedCubes();
+    if (!backupPendingSince.isValid()) {
+        backupPendingSince.start();
+    }
+    QTimer::singleShot(backupDelayMs, this, [this, generation = ++backupGeneration](){
+        // painting paused or went on for long, a backup in between invalidated the timer
+        if (generation == backupGeneration || (backupPendingSince.isValid() && backupPendingSince.hasExpired(backupMaxDelayMs))) {
+            backupModifiedCubes();
+        }
+    });
+}
+
+void Loader::Worker::backupModifiedCubes() {
     QMutexLocker locker(&snappyMutex);
+    compressModifiedCubes();
+}
+
+void Loader::Worker::compressModifiedCubes() {// call with snappyMutex locked
+    takeModifiedCubes();
+    backupPendingSince.invalidate();
+    struct Backup {
+        std::size_t mag;
+        CoordOfCube cubeCoord;
+        const void * cube;
+        std::string * snappy;// references into the cache stay valid while inserting
+    };
+    std::vector<Backup> backups;
     for (std::size_t mag = 0; mag < OcModifiedCacheQueue.size(); ++mag) {
         for (const auto & cubeCoord : OcModifiedCacheQueue[mag]) {
-            state->protectCube2Pointer.lock();
-            auto cube = cubeQuery(state->cube2Pointer, snappyLayerId, mag, {cubeCoord.x, cubeCoord.y, cubeCoord.z});
-            state->protectCube2Pointer.unlock();
-            if (cube != nullptr) {
-                snappyCacheBackupRaw(cubeCoord, cube);
-            }
+            backups.push_back({mag, {cubeCoord.x, cubeCoord.y, cubeCoord.z}, nullptr, nullptr});
         }
         //clear work queue
         OcModifiedCacheQueue[mag].clear();
     }
+    //writers hold protectCube2Pointer while they change a cube, so compressing under it yields consistent snapshots,
+    //batches of thread count size let painting continue in between
+    const auto batchSize = static_cast<std::size_t>(std::max(1, QThreadPool::globalInstance()->maxThreadCount()));
+    for (auto batchBegin = std::begin(backups); batchBegin != std::end(backups);) {
+        const auto batchEnd = std::next(batchBegin, std::min<std::size_t>(batchSize, std::distance(batchBegin, std::end(backups))));
+        QMutexLocker locker(&state->protectCube2Pointer);
+        for (auto it = batchBegin; it != batchEnd; ++it) {
+            it->cube = cubeQuery(state->cube2Pointer, snappyLayerId, it->mag, it->cubeCoord);
+            if (it->cube != nullptr) {
+                it->snappy = &snappyCache[it->mag][it->cubeCoord];
+            }
+        }
+        QtConcurrent::blockingMap(batchBegin, batchEnd, [](Backup & backup){
+            if (backup.cube != nullptr) {
+                snappy::Compress(reinterpret_cast<const char *>(backup.cube), OBJID_BYTES * state->cubeBytes, backup.snappy);
+            }
+        });
+        batchBegin = batchEnd;
+    }
+    propagateEdits();
+}
 
+void Loader::Worker::flushIntoSnappyCache() {
+    QMutexLocker locker(&snappyMutex);
+    compressModifiedCubes();// usually little is left since backupModifiedCubes ran in the background
     snappyFlushCondition.wakeAll();
 }
 
+namespace {
+struct EditBlock {// changed region of a cube with its new ids
+    CoordOfCube cubeCoord;
+    CoordInCube offset;
+    int edge;
+    std::vector<std::uint64_t> ids;
+    bool restored{false};// stems from a cube supplied from an annotation
+};
+
+// mode pooling of 2×2×2 voxels, ties are resolved in favour of the first id
+EditBlock parentBlock(const CoordOfCube & cubeCoord, const CoordInCube & offset, const int edge, const std::uint64_t * ids, const int cubeEdgeLen) {
+    const auto half = edge / 2;
+    EditBlock parent{{cubeCoord.x / 2, cubeCoord.y / 2, cubeCoord.z / 2}
+        , {(cubeCoord.x % 2) * cubeEdgeLen / 2 + offset.x / 2, (cubeCoord.y % 2) * cubeEdgeLen / 2 + offset.y / 2, (cubeCoord.z % 2) * cubeEdgeLen / 2 + offset.z / 2}
+        , half, std::vector<std::uint64_t>(static_cast<std::size_t>(half) * half * half)};
+    const auto at = [ids, edge](const int x, const int y, const int z){
+        return ids[(static_cast<std::size_t>(z) * edge + y) * edge + x];
+    };
+    auto * out = parent.ids.data();
+    for (int z = 0; z < half; ++z)
+    for (int y = 0; y < half; ++y)
+    for (int x = 0; x < half; ++x) {
+        const std::array<std::uint64_t, 8> pool{{at(2*x, 2*y, 2*z), at(2*x+1, 2*y, 2*z), at(2*x, 2*y+1, 2*z), at(2*x+1, 2*y+1, 2*z)
+                                                , at(2*x, 2*y, 2*z+1), at(2*x+1, 2*y, 2*z+1), at(2*x, 2*y+1, 2*z+1), at(2*x+1, 2*y+1, 2*z+1)}};
+        auto mode = pool[0];
+        std::ptrdiff_t modeCount = 0;
+        for (auto it = std::begin(pool); it != std::end(pool) && std::distance(it, std::end(pool)) > modeCount; ++it) {
+            const auto count = std::count(it, std::end(pool), *it);
+            if (count > modeCount) {
+                mode = *it;
+                modeCount = count;
+            }
+        }
+        *out++ = mode;
+    }
+    return parent;
+}
+
+EditBlock uncompressedBlock(const CoordOfCube & cubeCoord, const CoordInCube & offset, const int edge, const std::string & snappy) {
+    EditBlock block{cubeCoord, offset, edge, std::vector<std::uint64_t>(static_cast<std::size_t>(edge) * edge * edge)};
+    if (!snappy::RawUncompress(snappy.data(), snappy.size(), reinterpret_cast<char *>(block.ids.data()))) {
+        block.edge = 0;// nothing to copy
+    }
+    return block;
+}
+
+void copyBlock(const EditBlock & block, std::uint64_t * cube, const int cubeEdgeLen) {
+    for (int z = 0; z < block.edge; ++z)
+    for (int y = 0; y < block.edge; ++y) {
+        const auto * row = block.ids.data() + (static_cast<std::size_t>(z) * block.edge + y) * block.edge;
+        std::copy_n(row, block.edge, cube + (static_cast<std::size_t>(block.offset.z + z) * cubeEdgeLen + block.offset.y + y) * cubeEdgeLen + block.offset.x);
+    }
+}
+
+// downsamples the 8 finer cubes of a cube whose pending blocks were dropped,
+// finer cubes which lost theirs as well are recreated first
+template<typename SnappyCache, typename PendingBlocks, typename DroppedCubes>
+std::vector<EditBlock> recreatedBlocks(const std::size_t mag, const CoordOfCube & cubeCoord, const SnappyCache & snappyCache
+                                       , const PendingBlocks & pendingBlocks, const DroppedCubes & droppedPendingCubes, const int cubeEdgeLen) {
+    std::vector<EditBlock> blocks;
+    if (mag == 0) {
+        return blocks;
+    }
+    const auto childMag = mag - 1;
+    for (int z = 0; z < 2; ++z)
+    for (int y = 0; y < 2; ++y)
+    for (int x = 0; x < 2; ++x) {
+        const CoordOfCube child{2 * cubeCoord.x + x, 2 * cubeCoord.y + y, 2 * cubeCoord.z + z};
+        std::vector<EditBlock> childBlocks;
+        const auto snappyIt = snappyCache[childMag].find(child);
+        if (snappyIt != std::end(snappyCache[childMag])) {// contains everything
+            childBlocks.emplace_back(uncompressedBlock(child, {0, 0, 0}, cubeEdgeLen, snappyIt->second));
+        } else if (droppedPendingCubes[childMag].find(child) != std::end(droppedPendingCubes[childMag])) {
+            childBlocks = recreatedBlocks(childMag, child, snappyCache, pendingBlocks, droppedPendingCubes, cubeEdgeLen);
+        } else {
+            const auto pendingIt = pendingBlocks[childMag].find(child);
+            if (pendingIt != std::end(pendingBlocks[childMag])) {
+                for (const auto & pending : pendingIt->second) {
+                    childBlocks.emplace_back(uncompressedBlock(child, pending.offset, pending.edge, pending.snappy));
+                }
+            }
+        }
+        for (const auto & block : childBlocks) {
+            if (block.edge > 1) {
+                blocks.emplace_back(parentBlock(child, block.offset, block.edge, block.ids.data(), cubeEdgeLen));
+            }
+        }
+    }
+    return blocks;
+}
+}
+
+void Loader::Worker::propagateEdits() {// call with snappyMutex locked, after compressModifiedCubes
+    if (snappyLayerId >= datasets.size()) {
+        return;
+    }
+    const auto cubeEdgeLen = datasets[snappyLayerId].cubeEdgeLength;
+    const auto cubeVoxels = static_cast<std::size_t>(cubeEdgeLen) * cubeEdgeLen * cubeEdgeLen;
+    std::vector<EditBlock> blocks;// changes of the current mag which were propagated from the one below
+    for (std::size_t mag = 0; mag + 1 < propagationQueue.size(); ++mag) {
+        //downsample edited cubes of this mag and the blocks which arrived here into the next coarser mag
+        struct Job {
+            const std::string * snappy;// edited cube
+            const EditBlock * block;// or propagated block
+            CoordOfCube cubeCoord;
+            bool restored;
+            EditBlock parent;
+        };
+        // in edit order: snapshots of the edited cubes first, the blocks were written into them afterwards
+        std::vector<Job> jobs;
+        for (const auto & cubeCoord : propagationQueue[mag]) {
+            const auto snappyIt = snappyCache[mag].find(cubeCoord);
+            if (snappyIt != std::end(snappyCache[mag])) {
+                jobs.push_back({&snappyIt->second, nullptr, cubeCoord, false, {}});
+            }
+        }
+        for (const auto & cubeCoord : restoredQueue[mag]) {
+            const auto snappyIt = snappyCache[mag].find(cubeCoord);
+            if (propagationQueue[mag].find(cubeCoord) == std::end(propagationQueue[mag]) && snappyIt != std::end(snappyCache[mag])) {
+                jobs.push_back({&snappyIt->second, nullptr, cubeCoord, true, {}});
+            }
+        }
+        propagationQueue[mag].clear();
+        restoredQueue[mag].clear();
+        for (const auto & block : blocks) {
+            if (block.edge > 1) {
+                jobs.push_back({nullptr, &block, block.cubeCoord, block.restored, {}});
+            }
+        }
+        if (jobs.empty()) {
+            blocks.clear();
+            continue;
+        }
+        QtConcurrent::blockingMap(jobs, [cubeEdgeLen, cubeVoxels](Job & job){
+            if (job.block != nullptr) {
+                job.parent = parentBlock(job.cubeCoord, job.block->offset, job.block->edge, job.block->ids.data(), cubeEdgeLen);
+            } else {
+                std::vector<std::uint64_t> ids(cubeVoxels);
+                if (snappy::RawUncompress(job.snappy->data(), job.snappy->size(), reinterpret_cast<char *>(ids.data()))) {
+                    job.parent = parentBlock(job.cubeCoord, {0, 0, 0}, cubeEdgeLen, ids.data(), cubeEdgeLen);
+                }
+            }
+            job.parent.restored = job.restored;
+        });
+        const auto parentMag = mag + 1;
+        std::vector<EditBlock> parents;
+        for (auto & job : jobs) {
+            const bool restoredTarget = restoredCubes[parentMag].find(job.parent.cubeCoord) != std::end(restoredCubes[parentMag]);
+            if (job.parent.edge > 0 && !(job.parent.restored && restoredTarget)) {// restored coarser cubes already contain the restored edits
+                parents.emplace_back(std::move(job.parent));
+            }
+        }
+        //apply to the next mag in job order: into the loaded cube, else into its backup, else keep it until the cube is loaded
+        std::unordered_map<CoordOfCube, std::vector<const EditBlock *>> blocksOfCube;
+        for (const auto & block : parents) {
+            blocksOfCube[block.cubeCoord].emplace_back(&block);
+        }
+        struct Recompression {
+            std::string * snappy;
+            const std::vector<const EditBlock *> * blocks;
+        };
+        std::vector<Recompression> recompressions;
+        std::vector<CoordOfCube> changedCubes;
+        for (const auto & pair : blocksOfCube) {
+            const auto & cubeCoord = pair.first;
+            bool applied{false};
+            if (parentMag == loaderMagnification) {
+                QMutexLocker locker(&state->protectCube2Pointer);// writers hold it while they change a cube
+                if (auto * cube = cubeQuery(state->cube2Pointer, snappyLayerId, parentMag, cubeCoord)) {
+                    for (const auto * block : pair.second) {
+                        copyBlock(*block, reinterpret_cast<std::uint64_t *>(cube), cubeEdgeLen);
+                    }
+                    applied = true;
+                }
+            }
+            if (applied) {
+                OcModifiedCacheQueue[parentMag].emplace(cubeCoord);
+                state->viewer->reslice_notify_all(snappyLayerId, cubeCoord.cube2Global(cubeEdgeLen, 1 << parentMag));
+                changedCubes.emplace_back(cubeCoord);
+            } else if (snappyCache[parentMag].find(cubeCoord) != std::end(snappyCache[parentMag])) {
+                recompressions.push_back({&snappyCache[parentMag][cubeCoord], &pair.second});
+                changedCubes.emplace_back(cubeCoord);
+            } else if (droppedPendingCubes[parentMag].find(cubeCoord) == std::end(droppedPendingCubes[parentMag])) {// dropped cubes are recreated anyway
+                auto & pending = pendingBlocks[parentMag][cubeCoord];
+                for (const auto * block : pair.second) {
+                    //older blocks inside the new one are obsolete
+                    const auto obsolete = std::stable_partition(std::begin(pending), std::end(pending), [block](const PendingBlock & old){
+                        return !(old.offset.x >= block->offset.x && old.offset.y >= block->offset.y && old.offset.z >= block->offset.z
+                                && old.offset.x + old.edge <= block->offset.x + block->edge && old.offset.y + old.edge <= block->offset.y + block->edge
+                                && old.offset.z + old.edge <= block->offset.z + block->edge);
+                    });
+                    for (auto it = obsolete; it != std::end(pending); ++it) {
+                        pendingBytes -= it->snappy.size();
+                    }
+                    pending.erase(obsolete, std::end(pending));
+                    pending.push_back({block->offset, block->edge, {}});
+                    snappy::Compress(reinterpret_cast<const char *>(block->ids.data()), block->ids.size() * sizeof(std::uint64_t), &pending.back().snappy);
+                    pendingBytes += pending.back().snappy.size();
+                }
+            }
+        }
+        QtConcurrent::blockingMap(recompressions, [cubeEdgeLen, cubeVoxels](Recompression & recompression){
+            std::vector<std::uint64_t> ids(cubeVoxels);
+            if (snappy::RawUncompress(recompression.snappy->data(), recompression.snappy->size(), reinterpret_cast<char *>(ids.data()))) {
+                for (const auto * block : *recompression.blocks) {
+                    copyBlock(*block, ids.data(), cubeEdgeLen);
+                }
+                snappy::Compress(reinterpret_cast<const char *>(ids.data()), ids.size() * sizeof(std::uint64_t), recompression.snappy);
+            }
+        });
+        notifyPropagated(parentMag, std::move(changedCubes));
+        blocks = std::move(parents);
+    }
+    dropPendingBlocksOverBudget();
+}
+
+void Loader::Worker::applyPendingBlocks(const std::size_t layerId, const Coordinate & globalCoord) {
+    if (layerId != snappyLayerId || loaderMagnification >= pendingBlocks.size()) {
+        return;
+    }
+    const auto cubeEdgeLen = datasets[layerId].cubeEdgeLength;
+    const auto cubeCoord = globalCoord.cube(cubeEdgeLen, datasets[layerId].magnification);
+    const auto pendingIt = pendingBlocks[loaderMagnification].find(cubeCoord);
+    const bool dropped = droppedPendingCubes[loaderMagnification].find(cubeCoord) != std::end(droppedPendingCubes[loaderMagnification]);
+    if (pendingIt == std::end(pendingBlocks[loaderMagnification]) && !dropped) {
+        return;
+    }
+    std::vector<EditBlock> blocks;
+    if (dropped) {
+        blocks = recreatedBlocks(loaderMagnification, cubeCoord, snappyCache, pendingBlocks, droppedPendingCubes, cubeEdgeLen);
+    }
+    if (pendingIt != std::end(pendingBlocks[loaderMagnification])) {
+        for (const auto & pending : pendingIt->second) {
+            blocks.emplace_back(uncompressedBlock(cubeCoord, pending.offset, pending.edge, pending.snappy));
+        }
+    }
+    {
+        QMutexLocker locker(&state->protectCube2Pointer);// writers hold it while they change a cube
+        auto * cube = cubeQuery(state->cube2Pointer, layerId, loaderMagnification, cubeCoord);
+        if (cube == nullptr) {
+            return;
+        }
+        for (const auto & block : blocks) {
+            copyBlock(block, reinterpret_cast<std::uint64_t *>(cube), cubeEdgeLen);
+        }
+    }
+    OcModifiedCacheQueue[loaderMagnification].emplace(cubeCoord);// keep it in the snappy cache from now on
+    state->viewer->reslice_notify_all(layerId, globalCoord);
+    notifyPropagated(loaderMagnification, {cubeCoord});
+    erasePendingBlocks(loaderMagnification, cubeCoord);
+    droppedPendingCubes[loaderMagnification].erase(cubeCoord);
+}
+
+void Loader::Worker::erasePendingBlocks(const std::size_t mag, const CoordOfCube & cubeCoord) {
+    const auto pendingIt = pendingBlocks[mag].find(cubeCoord);
+    if (pendingIt != std::end(pendingBlocks[mag])) {
+        for (const auto & pending : pendingIt->second) {
+            pendingBytes -= pending.snappy.size();
+        }
+        pendingBlocks[mag].erase(pendingIt);
+    }
+}
+
+void Loader::Worker::dropPendingBlocksOverBudget() {
+    //coarsest first, their finer cubes are most likely still at hand to recreate them from
+    for (auto mag = pendingBlocks.size(); mag-- > 1 && pendingBytes > pendingBlocksBudget;) {
+        while (!pendingBlocks[mag].empty() && pendingBytes > pendingBlocksBudget) {
+            const auto cubeCoord = std::begin(pendingBlocks[mag])->first;
+            erasePendingBlocks(mag, cubeCoord);
+            droppedPendingCubes[mag].emplace(cubeCoord);
+        }
+    }
+}
+
+void Loader::Worker::notifyPropagated(const std::size_t mag, std::vector<CoordOfCube> cubeCoords) {
+    if (cubeCoords.empty()) {
+        return;
+    }
+    //statistics live in the gui thread
+    QMetaObject::invokeMethod(QCoreApplication::instance(), [mag, cubeCoords = std::move(cubeCoords)](){
+        for (const auto & cubeCoord : cubeCoords) {
+            SegmentationStatistics::singleton().cubeChanged(cubeCoord, 1 << mag);
+        }
+    }, Qt::QueuedConnection);
+}
+
 void Loader::Worker::moveToThread(QThread *targetThread) {
     qnam.moveToThread(targetThread);
     QObject::moveToThread(targetThread);
@@ -467,6 +866,8 @@ std::pair<bool, void*> decompressCube(void * currentSlot, QIODevice & reply, con
 }
 
 void Loader::Worker::cleanup(const Coordinate center) {
+    takeModifiedCubes();
+    QMutexLocker snappyLocker(&snappyMutex);// backups are read from other threads
     for (std::size_t layerId{0}; layerId < datasets.size(); ++layerId) {
         abortDownloadsFinishDecompression(layerId, currentlyVisibleWrap(center, datasets[layerId]));
         if (loaderMagnification >= state->cube2Pointer[layerId].size()) {
@@ -579,6 +980,7 @@ void Loader::Worker::downloadAndLoadCubes(const unsigned int loadingNr, const Co
                     cubeHash[globalCoord.cube(dataset.cubeEdgeLength, dataset.magnification)] = currentSlot;
                     state->protectCube2Pointer.unlock();
                     state->viewer->reslice_notify_all(layerId, globalCoord);
+                    applyPendingBlocks(layerId, globalCoord);
                 } else {
                     qCritical() << layerId << globalCoord << "no slots for snappy extract" << cubeHash.size() << freeSlots.size();
                 }
@@ -634,6 +1036,8 @@ void Loader::Worker::downloadAndLoadCubes(const unsigned int loadingNr, const Co
                             if (!result.first) {//decompression unsuccessful
                                 qCritical() << layerId << globalCoord << static_cast<int>(dataset.type) << "decompression failed → no fill";
                                 freeSlots.emplace_back(result.second);
+                            } else {
+                                applyPendingBlocks(layerId, globalCoord);
                             }
                         } else {
                             qCritical() << layerId << globalCoord << static_cast<int>(dataset.type) << "future canceled";
@@ -655,6 +1059,7 @@ void Loader::Worker::downloadAndLoadCubes(const unsigned int loadingNr, const Co
                         cubeHash[globalCoord.cube(dataset.cubeEdgeLength, dataset.magnification)] = currentSlot;
                         state->protectCube2Pointer.unlock();
                         state->viewer->reslice_notify_all(layerId, globalCoord);
+                        applyPendingBlocks(layerId, globalCoord);
                     } else {
                         if (reply->error() != QNetworkReply::OperationCanceledError) {
                             qCritical() << layerId << globalCoord << static_cast<int>(dataset.type) << reply->request().url() << reply->errorString() << reply->readAll();
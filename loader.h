@@ -29,6 +29,7 @@
 #include "usermove.h"
 
 #include <QCoreApplication>
+#include <QElapsedTimer>
 #include <QFutureWatcher>
 #include <QMutex>
 #include <QNetworkReply>
@@ -45,6 +46,7 @@
 #include <atomic>
 #include <list>
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -67,6 +69,43 @@ class Worker;
 namespace Loader {
 class Worker;
 
+/**
+ * Cubes marked as modified by the gui thread, a lock-free stack which the loader takes as a whole.
+ * Marking never waits for the loader, the order is irrelevant as the cubes end up in a set anyway.
+ */
+class ModifiedCubeInbox {
+    struct Node {
+        CoordOfCube cubeCoord;
+        std::size_t magIndex;
+        Node * next;
+    };
+    std::atomic<Node *> head{nullptr};
+
+public:
+    ~ModifiedCubeInbox() {
+        take([](const CoordOfCube &, std::size_t){});
+    }
+    //returns whether the inbox was empty before, i.e. the loader has to be told to take it
+    bool push(const CoordOfCube & cubeCoord, const std::size_t magIndex) {
+        auto * node = new Node{cubeCoord, magIndex, nullptr};
+        auto * expected = head.load(std::memory_order_relaxed);
+        do {
+            node->next = expected;
+        } while (!head.compare_exchange_weak(expected, node, std::memory_order_release, std::memory_order_relaxed));
+        return expected == nullptr;//node may already be taken
+    }
+    template<typename Func>
+    void take(Func func) {
+        auto * node = head.exchange(nullptr, std::memory_order_acquire);
+        while (node != nullptr) {
+            func(node->cubeCoord, node->magIndex);
+            auto * next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+};
+
 class Worker : public QObject {
     Q_OBJECT
     friend class Loader::Controller;
@@ -93,7 +132,17 @@ private:
     std::vector<CoordOfCube> DcoiFromPos(const CoordOfCube & currentOrigin, const UserMoveType userMoveType, const floatCoordinate & direction);
     uint loadCubes();
     void snappyCacheBackupRaw(const CoordOfCube &, const void * cube);
+    void compressModifiedCubes();
+    void propagateEdits();
+    void applyPendingBlocks(const std::size_t layerId, const Coordinate & globalCoord);
+    void erasePendingBlocks(const std::size_t mag, const CoordOfCube & cubeCoord);
+    void dropPendingBlocksOverBudget();
+    void notifyPropagated(const std::size_t mag, std::vector<CoordOfCube> cubeCoords);
     void snappyCacheClear();
+    static constexpr int backupDelayMs{500};// modified cubes are compressed after painting paused that long
+    static constexpr int backupMaxDelayMs{5000};// or at the latest when they wait that long
+    std::size_t backupGeneration{0};// restarts the idle debounce of backupModifiedCubes
+    QElapsedTimer backupPendingSince;
 
     void abortDownloadsFinishDecompression();
     template<typename Func>
@@ -104,6 +153,19 @@ public://matsch
     using CacheQueue = std::unordered_set<CoordOfCube>;
     std::size_t snappyLayerId{1};
     std::vector<CacheQueue> OcModifiedCacheQueue;
+    std::vector<CacheQueue> propagationQueue;// edited cubes per mag which still have to be downsampled into the coarser mags
+    std::vector<CacheQueue> restoredCubes;// supplied from an annotation, they already contain everything propagated into them
+    std::vector<CacheQueue> restoredQueue;// restored cubes which still have to be downsampled into coarser cubes that weren’t restored
+    struct PendingBlock {// downsampled edit for a coarser cube that isn’t loaded or backed up
+        CoordInCube offset;
+        int edge;
+        std::string snappy;
+    };
+    std::vector<std::unordered_map<CoordOfCube, std::vector<PendingBlock>>> pendingBlocks;// applied when the cube is loaded
+    std::size_t pendingBytes{0};
+    static constexpr std::size_t pendingBlocksBudget{256 * 1024 * 1024};// compressed bytes, the coarsest pending cubes are dropped above it
+    std::vector<CacheQueue> droppedPendingCubes;// recreated from their finer cubes when loaded, like pending blocks after loading an annotation
+    ModifiedCubeInbox modifiedCubeInbox;// has to be taken into OcModifiedCacheQueue before it’s used
     using SnappyCache = std::unordered_map<CoordOfCube, std::string>;
     std::vector<SnappyCache> snappyCache;
     QMutex snappyMutex;
@@ -112,7 +174,9 @@ public://matsch
     void moveToThread(QThread * targetThread);//reimplement to move qnam
 
     void unloadCurrentMagnification();
-    void markOcCubeAsModified(const CoordOfCube &cubeCoord, const int magnification);
+    void takeModifiedCubes();
+    void modifiedCubesPending();
+    void backupModifiedCubes();
     void snappyCacheSupplySnappy(const CoordOfCube, const int magnification, const std::string cube);
     void flushIntoSnappyCache();
     void broadcastProgress(bool startup = false);
@@ -158,8 +222,8 @@ public:
         QObject::connect(worker.get(), &Loader::Worker::progress, this, &Loader::Controller::refCountChange);
         QObject::connect(this, &Loader::Controller::loadSignal, worker.get(), &Loader::Worker::downloadAndLoadCubes);
         QObject::connect(this, &Loader::Controller::unloadCurrentMagnificationSignal, worker.get(), &Loader::Worker::unloadCurrentMagnification, Qt::BlockingQueuedConnection);
-        QObject::connect(this, &Loader::Controller::markOcCubeAsModifiedSignal, worker.get(), &Loader::Worker::markOcCubeAsModified, Qt::BlockingQueuedConnection);
-        QObject::connect(this, &Loader::Controller::snappyCacheSupplySnappySignal, worker.get(), &Loader::Worker::snappyCacheSupplySnappy, Qt::BlockingQueuedConnection);
+        //queued in order before later requests, e.g. getAllModifiedCubes
+        QObject::connect(this, &Loader::Controller::snappyCacheSupplySnappySignal, worker.get(), &Loader::Worker::snappyCacheSupplySnappy, Qt::QueuedConnection);
         workerThread.start();
     }
     void startLoading(const Coordinate & center, const UserMoveType userMoveType, const floatCoordinate &direction);
@@ -168,7 +232,9 @@ public:
         emit snappyCacheSupplySnappySignal(std::forward<Args>(args)...);
     }
     void markOcCubeAsModified(const CoordOfCube &cubeCoord, const int magnification);
+    void markOcCubesAsModified(const Loader::Worker::CacheQueue & cubeCoords, const int magnification);//notifies viewports and unsaved changes once for all
     decltype(Loader::Worker::snappyCache) getAllModifiedCubes();
+    Loader::Worker::SnappyCache getModifiedCubes(const std::size_t magIndex, const std::vector<CoordOfCube> & cubeCoords);//backups of unloaded cubes, without flushing
 public slots:
     bool isFinished();
 signals:
@@ -176,7 +242,6 @@ signals:
     void refCountChange(bool isIncrement, int refCount);
     void unloadCurrentMagnificationSignal();
     void loadSignal(const unsigned int loadingNr, const Coordinate center, const UserMoveType userMoveType, const floatCoordinate & direction, const Dataset::list_t & changedDatasets);
-    void markOcCubeAsModifiedSignal(const CoordOfCube &cubeCoord, const int magnification);
     void snappyCacheSupplySnappySignal(const CoordOfCube, const int magnification, const std::string cube);
 };
 }//namespace Loader
@@ -0,0 +1,9 @@
+#version 130
+
+flat in uvec2 id;
+
+out uvec2 fragId;
+
+void main() {
+    fragId = id;
+}
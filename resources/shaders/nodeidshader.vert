@@ -0,0 +1,15 @@
+#version 130
+
+in vec4 idHigh;// upper 32 bits of the picking name, the lower ones arrive as primary color
+
+flat out uvec2 id;
+
+uint unpack(vec4 bytes) {
+    uvec4 b = uvec4(bytes * 255.0 + 0.5);
+    return b.r | (b.g << 8u) | (b.b << 16u) | (b.a << 24u);
+}
+
+void main() {
+    gl_Position = ftransform();
+    id = uvec2(unpack(gl_Color), unpack(idHigh));
+}
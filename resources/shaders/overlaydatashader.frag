@@ -2,14 +2,23 @@
 
 uniform float textureOpacity;
 uniform sampler3D indexTexture;
-uniform sampler1D textureLUT;
-uniform float lutSize;//float(textureSize1D(textureLUT, 0));
-uniform float factor;//expand float to uint8 range
+uniform sampler2D paletteTexture;//index → packed global slot
+uniform sampler2D colorTexture;//global slot → color
+uniform vec3 indexFactor;//expand normalized index texel to palette index
+uniform vec2 paletteSize;
+uniform vec2 colorTableSize;
 varying vec3 texCoordFrag;//in
 
+const vec3 slotFactor = vec3(255.0, 255.0 * 256.0, 255.0 * 65536.0);
+
+vec4 lookup(sampler2D table, vec2 size, float index) {
+    float row = floor(index / size.x);
+    return texture2D(table, vec2((index - row * size.x + 0.5) / size.x, (row + 0.5) / size.y));
+}
+
 void main() {
-    float index = texture3D(indexTexture, texCoordFrag).r;
-    index *= factor;
-    gl_FragColor = texture1D(textureLUT, (index + 0.5) / lutSize);
-    gl_FragColor.a = textureOpacity;
+    float index = floor(dot(texture3D(indexTexture, texCoordFrag).rgb, indexFactor) + 0.5);
+    float slot = floor(dot(lookup(paletteTexture, paletteSize, index).rgb, slotFactor) + 0.5);
+    gl_FragColor = lookup(colorTexture, colorTableSize, slot);
+    gl_FragColor.a = textureOpacity;//background and hidden subobjects are drawn as well
 }
@@ -0,0 +1,93 @@
+#version 130
+
+uniform usampler3D indexAtlas;//palette indices of the uploaded cubes
+uniform usampler3D pageTable;//per cube of the supercube: atlas cube (xyz) and palette offset (w), x = ~0u if not uploaded
+uniform usampler2D paletteTexture;//palette index → global slot
+uniform sampler3D occupancyTexture;//mip pyramid over the bricks, 0 if nothing selected inside
+uniform sampler2D colorTexture;//global slot → color, alpha 1 for selected subobjects
+uniform int cubeEdge;
+uniform int volumeEdge;//voxels per axis of the supercube
+uniform int brickSize;
+uniform int occupancyLevels;
+uniform int paletteWidth;
+uniform int colorWidth;
+uniform mat4 slabToTexture;//(s, t, depth) → volume texture coordinates, depth 1 is closest
+uniform float steps;//samples along the whole depth
+uniform float opacity;
+in vec2 slabCoord;
+out vec4 fragColor;
+
+bool slotAt(ivec3 voxel, out uint slot) {
+    if (any(lessThan(voxel, ivec3(0))) || any(greaterThanEqual(voxel, ivec3(volumeEdge)))) {
+        return false;
+    }
+    uvec4 page = texelFetch(pageTable, voxel / cubeEdge, 0);
+    if (page.x == 0xFFFFFFFFu) {
+        return false;
+    }
+    uint index = page.w + texelFetch(indexAtlas, ivec3(page.xyz) * cubeEdge + voxel % cubeEdge, 0).r;
+    slot = texelFetch(paletteTexture, ivec2(int(index) % paletteWidth, int(index) / paletteWidth), 0).r;
+    return true;
+}
+
+vec4 colorOf(uint slot) {
+    return texelFetch(colorTexture, ivec2(int(slot) % colorWidth, int(slot) / colorWidth), 0);
+}
+
+float selected(ivec3 voxel) {
+    uint slot;
+    return slotAt(voxel, slot) && colorOf(slot).a > 254.5 / 255.0 ? 1.0 : 0.0;
+}
+
+void main() {
+    vec3 front = (slabToTexture * vec4(slabCoord, 1.0, 1.0)).xyz;
+    vec3 dir = (slabToTexture * vec4(slabCoord, 0.0, 1.0)).xyz - front;
+    dir = mix(dir, vec3(1e-7), vec3(lessThan(abs(dir), vec3(1e-7))));
+    vec3 invDir = 1.0 / dir;
+    // clip the ray [0, 1] against the unit cube
+    vec3 t0 = -front * invDir;
+    vec3 t1 = (vec3(1.0) - front) * invDir;
+    vec3 tmin = min(t0, t1);
+    vec3 tmax = max(t0, t1);
+    float enter = max(max(tmin.x, tmin.y), max(tmin.z, 0.0));
+    float leave = min(min(tmax.x, tmax.y), min(tmax.z, 1.0));
+
+    float du = 1.0 / steps;
+    float u = ceil(enter / du) * du;// stay on the sample grid of the old slab renderer
+    vec4 result = vec4(0.0);
+    for (int i = 0; i < 65536; ++i) {
+        if (u > leave || result.a > 0.99) {// early ray termination
+            break;
+        }
+        vec3 pos = front + u * dir;
+        ivec3 voxel = ivec3(floor(pos * float(volumeEdge)));
+        ivec3 brick = voxel / brickSize;
+        // climb the pyramid while the cell is empty, then skip to the exit of the largest empty cell
+        int level = 0;
+        while (level < occupancyLevels && texelFetch(occupancyTexture, brick >> level, level).r == 0.0) {
+            ++level;
+        }
+        if (level > 0) {
+            float cell = float(brickSize << (level - 1));
+            vec3 bound = (floor(vec3(voxel) / cell) + step(0.0, dir)) * cell / float(volumeEdge);
+            vec3 cellExit = (bound - front) * invDir;
+            u = max(u + du, ceil(min(min(cellExit.x, cellExit.y), cellExit.z) / du) * du);
+            continue;
+        }
+        uint slot;
+        if (slotAt(voxel, slot)) {
+            vec4 color = colorOf(slot);
+            if (color.a > 254.5 / 255.0) {
+                // darken by occupied neighbours and by depth
+                float neighbours = selected(voxel - ivec3(1, 0, 0)) + selected(voxel + ivec3(1, 0, 0))
+                        + selected(voxel - ivec3(0, 1, 0)) + selected(voxel + ivec3(0, 1, 0))
+                        + selected(voxel - ivec3(0, 0, 1)) + selected(voxel + ivec3(0, 0, 1));
+                vec3 shaded = color.rgb * pow(0.95, neighbours) * (1.0 - u);
+                result.rgb += (1.0 - result.a) * opacity * shaded;
+                result.a += (1.0 - result.a) * opacity;
+            }
+        }
+        u += du;
+    }
+    fragColor = result;
+}
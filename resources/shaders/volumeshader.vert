@@ -0,0 +1,9 @@
+#version 130
+
+in vec2 vertex;
+out vec2 slabCoord;
+
+void main() {
+    gl_Position = vec4(vertex, 0.0, 1.0);
+    slabCoord = vec2(vertex.x + 1.0, 1.0 - vertex.y) * 0.5;
+}
@@ -24,6 +24,8 @@
 
 #include "segmentation/cubeloader.h"
 #include "segmentation/segmentation.h"
+#include "segmentation/segmentationsplit.h"
+#include "segmentation/statistics.h"
 
 auto & objectFromId(const quint64 objId) {
     const auto it = Segmentation::singleton().objectIdToIndex.find(objId);
@@ -116,6 +118,14 @@ void SegmentationProxy::unmerge_selected_objects(const Coordinate & position) {
     Segmentation::singleton().unmergeSelectedObjects(position);
 }
 
+void SegmentationProxy::split_connected_component(const QList<int> & seed) {
+    connectedComponent(Coordinate(seed));
+}
+
+void SegmentationProxy::split_by_vertical_plane(const QList<int> & seed) {
+    verticalSplittingPlane(Coordinate(seed));
+}
+
 void SegmentationProxy::remove_object(const quint64 objId) {
     Segmentation::singleton().removeObject(objectFromId(objId));
 }
@@ -143,3 +153,28 @@ void SegmentationProxy::jump_to_object(const quint64 objId) {
 QList<int> SegmentationProxy::object_location(const quint64 objId) {
     return objectFromId(objId).location.list();
 }
+
+void SegmentationProxy::update_statistics() {
+    SegmentationStatistics::singleton().refresh();
+}
+
+namespace {
+QVariantMap statisticsMap(const SegmentationStatistics::Statistics & statistics) {
+    if (statistics.voxels == 0) {
+        return {{"voxels", 0}};
+    }
+    const auto centroid = statistics.centroid();
+    return {{"voxels", static_cast<quint64>(statistics.voxels)}
+        , {"min", QVariantList{statistics.min.x, statistics.min.y, statistics.min.z}}
+        , {"max", QVariantList{statistics.max.x, statistics.max.y, statistics.max.z}}
+        , {"centroid", QVariantList{centroid.x, centroid.y, centroid.z}}};
+}
+}
+
+QVariantMap SegmentationProxy::object_statistics(const quint64 objId) {
+    return statisticsMap(SegmentationStatistics::singleton().objectStatistics(objId));
+}
+
+QVariantMap SegmentationProxy::subobject_statistics(const quint64 subObjId) {
+    return statisticsMap(SegmentationStatistics::singleton().subobjectStatistics(subObjId));
+}
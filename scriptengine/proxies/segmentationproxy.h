@@ -27,6 +27,7 @@
 
 #include <QList>
 #include <QObject>
+#include <QVariantMap>
 
 class SegmentationProxy : public QObject {
     Q_OBJECT
@@ -51,6 +52,8 @@ public slots:
     void create_object(const quint64 objId, const quint64 initialSubobjectId, const QList<int> & location = {0, 0, 0}, const bool todo = false, const bool immutable = false);
     void merge_selected_objects();
     void unmerge_selected_objects(const Coordinate & position);
+    void split_connected_component(const QList<int> & seed);
+    void split_by_vertical_plane(const QList<int> & seed);
     void remove_object(const quint64 objId);
     void select_object(const quint64 objId);
     quint64 subobject_at_location(const QList<int> &position);
@@ -58,6 +61,10 @@ public slots:
     void unselect_object(const quint64 objId);
     void jump_to_object(const quint64 objId);
     QList<int> object_location(const quint64 objId);
+
+    void update_statistics();
+    QVariantMap object_statistics(const quint64 objId);
+    QVariantMap subobject_statistics(const quint64 subObjId);
 };
 
 #endif // SEGMENTATIONPROXY_H
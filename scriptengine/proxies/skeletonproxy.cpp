@@ -142,6 +142,21 @@ nodeListElement *SkeletonProxy::find_nearby_node_from_tree(quint64 tree_id, int
     return Skeletonizer::singleton().findNearbyNode(tree, coord);
 }
 
+QList<nodeListElement *> SkeletonProxy::find_nearest_nodes(int x, int y, int z, int count) {
+    const auto nodes = Skeletonizer::singleton().findNearestNodes(Coordinate(x, y, z), std::max(0, count));
+    return QVector<nodeListElement *>::fromStdVector(nodes).toList();
+}
+
+QList<nodeListElement *> SkeletonProxy::find_nodes_in_radius(int x, int y, int z, float radius) {
+    const auto nodes = Skeletonizer::singleton().findNodesInRadius(Coordinate(x, y, z), radius);
+    return QVector<nodeListElement *>::fromStdVector(nodes).toList();
+}
+
+QList<nodeListElement *> SkeletonProxy::find_nodes_in_box(const QList<int> & min, const QList<int> & max) {
+    const auto nodes = Skeletonizer::singleton().findNodesInBox(min, max);
+    return QVector<nodeListElement *>::fromStdVector(nodes).toList();
+}
+
 nodeListElement *SkeletonProxy::node_with_prev_id(quint64 node_id, bool same_tree) {
     nodeListElement *node = Skeletonizer::findNodeByNodeID(node_id);
     return Skeletonizer::singleton().getNodeWithPrevID(node, same_tree);
@@ -285,6 +300,49 @@ nodeListElement * SkeletonProxy::add_node(quint64 node_id, const QList<int> & co
     return &addNode(boost::make_optional(static_cast<decltype(nodeListElement::nodeID)>(node_id)), coordinate, parent_tree, properties);
 }
 
+QList<quint64> SkeletonProxy::add_nodes(quint64 tree_id, const QVariantList & coordinates, const QVariantList & segments, const QVariantList & properties, const QVariantList & radii, const QVariantList & node_ids) {
+    Skeletonizer::NodeBatch batch;
+    batch.positions.reserve(coordinates.size());
+    for (const auto & coordinate : coordinates) {
+        const auto list = coordinate.toList();
+        if (list.size() != 3) {
+            throw std::runtime_error(QObject::tr("add_nodes: coordinates must be [x, y, z] lists").toStdString());
+        }
+        batch.positions.emplace_back(list[0].toInt(), list[1].toInt(), list[2].toInt());
+    }
+    batch.segments.reserve(segments.size());
+    for (const auto & segment : segments) {
+        const auto pair = segment.toList();
+        if (pair.size() != 2) {
+            throw std::runtime_error(QObject::tr("add_nodes: segments must be [source_index, target_index] lists").toStdString());
+        }
+        batch.segments.emplace_back(pair[0].toULongLong(), pair[1].toULongLong());
+    }
+    batch.properties.reserve(properties.size());
+    for (const auto & property : properties) {
+        const auto map = property.toMap();// python dicts arrive as QVariantMap
+        QVariantHash hash;
+        for (auto it = std::cbegin(map); it != std::cend(map); ++it) {
+            hash.insert(it.key(), it.value());
+        }
+        batch.properties.emplace_back(hash);
+    }
+    batch.radii.reserve(radii.size());
+    for (const auto & radius : radii) {
+        batch.radii.emplace_back(radius.toFloat());
+    }
+    batch.nodeIDs.reserve(node_ids.size());
+    for (const auto & nodeID : node_ids) {
+        batch.nodeIDs.emplace_back(nodeID.toULongLong());
+    }
+    QList<quint64> ids;
+    ids.reserve(coordinates.size());
+    for (const auto * node : Skeletonizer::singleton().addNodes(tree_id, batch)) {
+        ids.append(node->nodeID);
+    }
+    return ids;
+}
+
 QList<treeListElement*> SkeletonProxy::trees() {
     QList<treeListElement*> trees;
     for (auto & tree : state->skeletonState->trees) {
@@ -399,6 +457,9 @@ QString SkeletonProxy::help() {
                    "\n export_converter(path) : creates a python class in the path which can be used to convert between the NewSkeleton class and KNOSSOS." \
                    "\n set_branch_node(node_id) : sets the node with node_id to branch_node" \
                    "\n add_segment(source_id, target_id) : adds a segment for the nodes. Both nodes must be added before" \
+                   "\n add_nodes(tree_id, coordinates, segments, properties, radii, node_ids) : adds many nodes to a tree at once and returns their ids." \
+                   "\n\t coordinates is a list of [x, y, z], segments a list of [source_index, target_index] into coordinates." \
+                   "\n\t properties, radii and node_ids are optional lists with one entry per node. Views are refreshed once at the end." \
                    "\n delete_active_node() : deletes the active node or informs about that no active node could be deleted" \
                    "\n delete_segment(source_id, target_id) : deletes a segment with source" \
                    "\n add_comment(node_id) : adds a comment for the node. Must be added before" \
@@ -70,6 +70,9 @@ public slots:
     QList<nodeListElement *> find_nodes_in_tree(treeListElement & tree, const QString & comment);
     void move_node_to_tree(quint64 node_id, quint64 tree_id);
     nodeListElement *find_nearby_node_from_tree(quint64 tree_id, int x, int y, int z);
+    QList<nodeListElement *> find_nearest_nodes(int x, int y, int z, int count = 1);
+    QList<nodeListElement *> find_nodes_in_radius(int x, int y, int z, float radius);
+    QList<nodeListElement *> find_nodes_in_box(const QList<int> & min, const QList<int> & max);
     nodeListElement *node_with_prev_id(quint64 node_id, bool same_tree);
     nodeListElement *node_with_next_id(quint64 node_id, bool same_tree);
     bool set_radius(const quint64 node_id, const float radius);
@@ -80,6 +83,7 @@ public slots:
     nodeListElement *active_node();
     nodeListElement * add_node(const QList<int> & coordinate, const treeListElement & parent_tree, const QVariantHash & properties = {});
     nodeListElement * add_node(quint64 node_id, const QList<int> & coordinate, const treeListElement & parent_tree, const QVariantHash & properties = {});
+    QList<quint64> add_nodes(quint64 tree_id, const QVariantList & coordinates, const QVariantList & segments = {}, const QVariantList & properties = {}, const QVariantList & radii = {}, const QVariantList & node_ids = {});
     bool set_branch_node(quint64 node_id);
     bool add_segment(quint64 source_id, quint64 target_id);
     bool delete_segment(quint64 source_id, quint64 target_id);
@@ -0,0 +1,67 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+
+#include "brushstroke.h"
+
+#include "cubeloader.h"
+#include "dataset.h"
+#include "loader.h"
+
+namespace {
+bool sameBrush(const brush_t & lhs, const brush_t & rhs) {
+    return lhs.radius == rhs.radius && lhs.inverse == rhs.inverse && lhs.mode == rhs.mode && lhs.view == rhs.view && lhs.shape == rhs.shape
+            && lhs.v1 == rhs.v1 && lhs.v2 == rhs.v2 && lhs.n == rhs.n;
+}
+}
+
+BrushStroke & BrushStroke::singleton() {
+    static BrushStroke brushStroke;
+    return brushStroke;
+}
+
+void BrushStroke::moveTo(const Coordinate & pos, const std::uint64_t newValue, const brush_t & newBrush) {
+    if (!pending.empty() && (newValue != value || !sameBrush(newBrush, brush))) {
+        flush();
+    }
+    value = newValue;
+    brush = newBrush;
+    if (lastPos && brush.mode == brush_t::mode_t::two_dim && floatCoordinate(pos - lastPos.get()).dot(brush.n) != 0) {
+        lastPos = boost::none;// don’t connect positions on different slices of a 2d brush
+    }
+    pending.emplace_back(lastPos.get_value_or(pos), pos);
+    lastPos = pos;
+}
+
+void BrushStroke::flush() {
+    if (pending.empty()) {
+        return;
+    }
+    const auto cubes = writeStroke(pending, value, brush);
+    pending.clear();
+    Loader::Controller::singleton().markOcCubesAsModified(cubes, Dataset::current().magnification);
+}
+
+void BrushStroke::end() {
+    flush();
+    lastPos = boost::none;
+}
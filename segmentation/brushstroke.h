@@ -0,0 +1,53 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+
+#ifndef BRUSHSTROKE_H
+#define BRUSHSTROKE_H
+
+#include "coordinate.h"
+#include "segmentationsplit.h"
+
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Paints the volume swept by the brush between successive positions of a stroke, so fast strokes leave no gaps.
+ * Positions are only queued, all segments of a frame are rasterised together in flush
+ * and their cubes are announced to the loader and viewports in one batch.
+ */
+class BrushStroke {
+    boost::optional<Coordinate> lastPos;
+    std::vector<std::pair<Coordinate, Coordinate>> pending;
+    std::uint64_t value{0};
+    brush_t brush;
+
+public:
+    static BrushStroke & singleton();
+    void moveTo(const Coordinate & pos, const std::uint64_t value, const brush_t & brush);
+    void flush();// called once per frame by the viewer
+    void end();
+};
+
+#endif//BRUSHSTROKE_H
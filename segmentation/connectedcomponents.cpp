@@ -0,0 +1,315 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+
+#include "connectedcomponents.h"
+
+#include "dataset.h"
+#include "loader.h"
+#include "segmentation.h"
+#include "session.h"
+#include "stateInfo.h"
+#include "undojournal.h"
+
+#include <QMutexLocker>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+
+namespace {
+// calls func(i, j) for all runs i of [lhs, lhsEnd) and j of [rhs, rhsEnd) sharing an x, both ranges sorted by x
+template<typename Run, typename Func>
+void forEachOverlap(std::uint32_t lhs, const std::uint32_t lhsEnd, const std::vector<Run> & lhsRuns, std::uint32_t rhs, const std::uint32_t rhsEnd, const std::vector<Run> & rhsRuns, Func func) {
+    while (lhs < lhsEnd && rhs < rhsEnd) {
+        if (lhsRuns[lhs].last >= rhsRuns[rhs].first && rhsRuns[rhs].last >= lhsRuns[lhs].first) {
+            func(lhs, rhs);
+        }
+        if (lhsRuns[lhs].last < rhsRuns[rhs].last) {
+            ++lhs;
+        } else {
+            ++rhs;
+        }
+    }
+}
+
+// membership with a cache for the last id, neighbouring voxels mostly share their id
+class MemberTest {
+    const std::unordered_set<std::uint64_t> & members;
+    std::uint64_t lastId{0};
+    bool lastResult{false};
+    bool valid{false};
+
+public:
+    MemberTest(const std::unordered_set<std::uint64_t> & members) : members(members) {}
+
+    bool operator()(const std::uint64_t id) {
+        if (!valid || id != lastId) {
+            lastId = id;
+            lastResult = members.find(id) != std::end(members);
+            valid = true;
+        }
+        return lastResult;
+    }
+};
+}
+
+ConnectedComponents::ConnectedComponents(const std::unordered_set<std::uint64_t> & members, const Coordinate & globalSeed)
+    : cubeEdgeLen{Dataset::current().cubeEdgeLength}, mag{Dataset::current().magnification}
+    , layerId{Segmentation::singleton().layerId}, magIndex{Dataset::current().magIndex}
+    , seed{globalSeed.x / mag, globalSeed.y / mag, globalSeed.z / mag}, cubeLock{&state->protectCube2Pointer} {
+    if (!Segmentation::singleton().enabled || layerId >= state->cube2Pointer.size() || magIndex >= state->cube2Pointer[layerId].size()) {
+        return;
+    }
+    const auto & loaded = state->cube2Pointer[layerId][magIndex];
+    const auto & areaMin = Session::singleton().movementAreaMin;
+    const auto & areaMax = Session::singleton().movementAreaMax;
+    const Coordinate voxelMin{areaMin.x / mag, areaMin.y / mag, areaMin.z / mag};
+    const Coordinate voxelMax{areaMax.x / mag, areaMax.y / mag, areaMax.z / mag};
+    const auto enqueue = [this, &loaded](const CoordOfCube & cubeCoord){
+        if (cubeIndex.find(cubeCoord) == std::end(cubeIndex)) {
+            const auto it = loaded.find(cubeCoord);
+            if (it != std::end(loaded)) {
+                cubeIndex.emplace(cubeCoord, cubes.size());
+                cubes.push_back(Cube{cubeCoord, reinterpret_cast<std::uint64_t *>(it->second), {}, {}, 0, {}});
+            }
+        }
+    };
+    enqueue({seed.x / cubeEdgeLen, seed.y / cubeEdgeLen, seed.z / cubeEdgeLen});
+    const std::array<CoordOfCube, 6> faceOffsets{{{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}}};
+    for (std::size_t waveBegin = 0; waveBegin < cubes.size();) {
+        const auto waveEnd = cubes.size();
+        QtConcurrent::blockingMap(std::next(std::begin(cubes), waveBegin), std::end(cubes), [this, &members, &voxelMin, &voxelMax](Cube & cube){
+            labelCube(cube, members, voxelMin, voxelMax);
+        });
+        for (auto i = waveBegin; i < waveEnd; ++i) {
+            const auto faces = touchedFaces(cubes[i]);
+            const auto cubeCoord = cubes[i].coord;
+            for (std::size_t face = 0; face < faces.size(); ++face) {
+                if (faces[face]) {
+                    enqueue(cubeCoord + faceOffsets[face]);
+                }
+            }
+        }
+        waveBegin = waveEnd;
+    }
+    std::size_t runCount{0};
+    for (auto & cube : cubes) {
+        cube.offset = static_cast<std::uint32_t>(runCount);
+        runCount += cube.runs.size();
+    }
+    parent.resize(runCount);
+    for (const auto & cube : cubes) {
+        for (std::size_t i = 0; i < cube.runs.size(); ++i) {
+            parent[cube.offset + i] = cube.offset + cube.runs[i].parent;
+        }
+    }
+    joinFaces();
+}
+
+std::uint32_t ConnectedComponents::find(std::uint32_t run) {
+    while (parent[run] != run) {
+        run = parent[run] = parent[parent[run]];// path halving
+    }
+    return run;
+}
+
+void ConnectedComponents::unite(const std::uint32_t lhs, const std::uint32_t rhs) {
+    const auto lhsRoot = find(lhs);
+    const auto rhsRoot = find(rhs);
+    if (lhsRoot != rhsRoot) {
+        parent[std::max(lhsRoot, rhsRoot)] = std::min(lhsRoot, rhsRoot);
+    }
+}
+
+void ConnectedComponents::labelCube(Cube & cube, const std::unordered_set<std::uint64_t> & members, const Coordinate & areaMin, const Coordinate & areaMax) const {
+    const auto edge = cubeEdgeLen;
+    const Coordinate origin{cube.coord.x * edge, cube.coord.y * edge, cube.coord.z * edge};
+    const Coordinate localMin{std::max(0, areaMin.x - origin.x), std::max(0, areaMin.y - origin.y), std::max(0, areaMin.z - origin.z)};
+    const Coordinate localMax{std::min(edge - 1, areaMax.x - origin.x), std::min(edge - 1, areaMax.y - origin.y), std::min(edge - 1, areaMax.z - origin.z)};
+    auto & runs = cube.runs;
+    cube.rowStart.assign(static_cast<std::size_t>(edge) * edge + 1, 0);
+    const auto findLocal = [&runs](std::uint32_t run){
+        while (runs[run].parent != run) {
+            run = runs[run].parent = runs[runs[run].parent].parent;
+        }
+        return run;
+    };
+    const auto uniteLocal = [&runs, &findLocal](const std::uint32_t lhs, const std::uint32_t rhs){
+        const auto lhsRoot = findLocal(lhs);
+        const auto rhsRoot = findLocal(rhs);
+        if (lhsRoot != rhsRoot) {
+            runs[std::max(lhsRoot, rhsRoot)].parent = std::min(lhsRoot, rhsRoot);
+        }
+    };
+    MemberTest member(members);
+    for (int z = 0; z < edge; ++z)
+    for (int y = 0; y < edge; ++y) {
+        const auto row = static_cast<std::size_t>(y) + static_cast<std::size_t>(z) * edge;
+        const auto rowBegin = static_cast<std::uint32_t>(runs.size());
+        cube.rowStart[row] = rowBegin;
+        if (y < localMin.y || y > localMax.y || z < localMin.z || z > localMax.z) {
+            continue;
+        }
+        const auto * voxels = cube.voxels + row * edge;
+        for (int x = localMin.x; x <= localMax.x; ++x) {
+            if (member(voxels[x])) {
+                const auto first = x;
+                while (x + 1 <= localMax.x && member(voxels[x + 1])) {
+                    ++x;
+                }
+                runs.push_back(Run{first, x, static_cast<std::uint32_t>(runs.size())});
+            }
+        }
+        const auto rowEnd = static_cast<std::uint32_t>(runs.size());
+        if (y > 0) {
+            forEachOverlap(cube.rowStart[row - 1], rowBegin, runs, rowBegin, rowEnd, runs, uniteLocal);
+        }
+        if (z > 0) {
+            forEachOverlap(cube.rowStart[row - edge], cube.rowStart[row - edge + 1], runs, rowBegin, rowEnd, runs, uniteLocal);
+        }
+    }
+    cube.rowStart.back() = static_cast<std::uint32_t>(runs.size());
+    for (std::uint32_t run = 0; run < runs.size(); ++run) {
+        runs[run].parent = runs[runs[run].parent].parent;// roots have the smallest index, so earlier runs are flat already
+    }
+}
+
+std::array<bool, 6> ConnectedComponents::touchedFaces(const Cube & cube) const {
+    const auto edge = static_cast<std::uint32_t>(cubeEdgeLen);
+    const auto rowEmpty = [&cube](const std::uint32_t row){
+        return cube.rowStart[row] == cube.rowStart[row + 1];
+    };
+    std::array<bool, 6> faces{};
+    for (std::uint32_t row = 0; row < edge * edge; ++row) {
+        if (!rowEmpty(row)) {
+            faces[0] = faces[0] || cube.runs[cube.rowStart[row]].first == 0;
+            faces[1] = faces[1] || cube.runs[cube.rowStart[row + 1] - 1].last == cubeEdgeLen - 1;
+        }
+    }
+    for (std::uint32_t i = 0; i < edge; ++i) {
+        faces[2] = faces[2] || !rowEmpty(i * edge);
+        faces[3] = faces[3] || !rowEmpty(edge - 1 + i * edge);
+        faces[4] = faces[4] || !rowEmpty(i);
+        faces[5] = faces[5] || !rowEmpty(i + (edge - 1) * edge);
+    }
+    return faces;
+}
+
+void ConnectedComponents::joinFaces() {
+    const auto edge = static_cast<std::uint32_t>(cubeEdgeLen);
+    for (const auto & cube : cubes) {
+        const auto neighbour = [this, &cube](const CoordOfCube & offset) -> const Cube * {
+            const auto it = cubeIndex.find(cube.coord - offset);
+            return it != std::end(cubeIndex) ? &cubes[it->second] : nullptr;
+        };
+        const auto uniteAcross = [this, &cube](const Cube & other){
+            return [this, &cube, &other](const std::uint32_t run, const std::uint32_t otherRun){
+                unite(cube.offset + run, other.offset + otherRun);
+            };
+        };
+        if (const auto * other = neighbour({1, 0, 0})) {
+            for (std::uint32_t row = 0; row < edge * edge; ++row) {// first run of the row against the last run of the neighbour’s row
+                if (cube.rowStart[row] != cube.rowStart[row + 1] && other->rowStart[row] != other->rowStart[row + 1]
+                        && cube.runs[cube.rowStart[row]].first == 0 && other->runs[other->rowStart[row + 1] - 1].last == cubeEdgeLen - 1) {
+                    unite(cube.offset + cube.rowStart[row], other->offset + other->rowStart[row + 1] - 1);
+                }
+            }
+        }
+        if (const auto * other = neighbour({0, 1, 0})) {
+            for (std::uint32_t z = 0; z < edge; ++z) {
+                const auto row = z * edge;
+                const auto otherRow = edge - 1 + z * edge;
+                forEachOverlap(cube.rowStart[row], cube.rowStart[row + 1], cube.runs, other->rowStart[otherRow], other->rowStart[otherRow + 1], other->runs, uniteAcross(*other));
+            }
+        }
+        if (const auto * other = neighbour({0, 0, 1})) {
+            for (std::uint32_t y = 0; y < edge; ++y) {
+                const auto otherRow = y + (edge - 1) * edge;
+                forEachOverlap(cube.rowStart[y], cube.rowStart[y + 1], cube.runs, other->rowStart[otherRow], other->rowStart[otherRow + 1], other->runs, uniteAcross(*other));
+            }
+        }
+    }
+}
+
+std::unordered_set<std::uint64_t> ConnectedComponents::splitOff(const std::uint64_t from, const std::uint64_t to) {
+    const auto cubeIt = cubeIndex.find({seed.x / cubeEdgeLen, seed.y / cubeEdgeLen, seed.z / cubeEdgeLen});
+    if (cubeIt == std::end(cubeIndex)) {
+        return {};
+    }
+    const auto & seedCube = cubes[cubeIt->second];
+    const auto row = static_cast<std::size_t>(seed.y % cubeEdgeLen) + static_cast<std::size_t>(seed.z % cubeEdgeLen) * cubeEdgeLen;
+    const auto x = seed.x % cubeEdgeLen;
+    const auto runBegin = std::begin(seedCube.runs) + seedCube.rowStart[row];
+    const auto runEnd = std::begin(seedCube.runs) + seedCube.rowStart[row + 1];
+    const auto seedRun = std::find_if(runBegin, runEnd, [x](const Run & run){ return run.first <= x && x <= run.last; });
+    if (seedRun == runEnd) {
+        return {};
+    }
+    const auto component = find(seedCube.offset + static_cast<std::uint32_t>(seedRun - std::begin(seedCube.runs)));
+    for (std::uint32_t run = 0; run < parent.size(); ++run) {// flat, so the parallel passes only read
+        parent[run] = find(run);
+    }
+    const auto forEachComponentVoxel = [this, component](Cube & cube, auto && func){
+        for (std::size_t i = 0; i < cube.runs.size(); ++i) {
+            if (parent[cube.offset + i] == component) {
+                const auto row = static_cast<std::size_t>(std::upper_bound(std::begin(cube.rowStart), std::end(cube.rowStart), i) - std::begin(cube.rowStart) - 1);
+                auto * voxels = cube.voxels + row * cubeEdgeLen;
+                for (int x = cube.runs[i].first; x <= cube.runs[i].last; ++x) {
+                    func(voxels[x]);
+                }
+            }
+        }
+    };
+    QtConcurrent::blockingMap(cubes, [&forEachComponentVoxel](Cube & cube){
+        std::uint64_t last{0};
+        bool any{false};
+        forEachComponentVoxel(cube, [&cube, &last, &any](const std::uint64_t value){
+            if (!any || value != last) {
+                cube.found.emplace(value);
+                last = value;
+                any = true;
+            }
+        });
+    });
+    std::unordered_set<std::uint64_t> visited;
+    std::vector<std::reference_wrapper<Cube>> changed;
+    for (auto & cube : cubes) {
+        visited.insert(std::begin(cube.found), std::end(cube.found));
+        if (cube.found.count(from) != 0) {
+            UndoJournal::singleton().cubeWillChange(layerId, magIndex, cube.coord, cube.voxels);
+            changed.emplace_back(cube);
+        }
+    }
+    visited.erase(from);
+    QtConcurrent::blockingMap(changed, [&forEachComponentVoxel, from, to](Cube & cube){
+        forEachComponentVoxel(cube, [from, to](std::uint64_t & value){
+            if (value == from) {
+                value = to;
+            }
+        });
+    });
+    cubeLock.unlock();// writing is done, let the loader continue before the cubes are announced
+    for (const Cube & cube : changed) {
+        Loader::Controller::singleton().markOcCubeAsModified(cube.coord, mag);
+    }
+    return visited;
+}
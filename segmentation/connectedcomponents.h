@@ -0,0 +1,92 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+
+#ifndef CONNECTEDCOMPONENTS_H
+#define CONNECTEDCOMPONENTS_H
+
+#include "coordinate.h"
+
+#include <QMutexLocker>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Two pass connected component labelling (6-connectivity) of the voxels of the loaded segmentation cubes
+ * of the current mag whose subobject id is in members.
+ *
+ * Only cubes reachable from the seed cube are labelled: starting with the seed cube, each wave labels
+ * the loaded neighbours of the previous wave which share a face with member voxels on it.
+ * The cubes of a wave are labelled on their own in parallel: member voxels are collected as runs along x
+ * and runs overlapping in the previous row or slice are joined with a union-find.
+ * Afterwards the runs touching cube faces are joined with their neighbours.
+ * Voxels outside the movement area are no members.
+ * The cubes stay locked (protectCube2Pointer) from construction until splitOff is done writing,
+ * so the loader can’t reuse their slots meanwhile.
+ */
+class ConnectedComponents {
+    struct Run {
+        int first;// x in cube, inclusive
+        int last;
+        std::uint32_t parent;// within the cube
+    };
+    struct Cube {
+        CoordOfCube coord;
+        std::uint64_t * voxels;
+        std::vector<Run> runs;// ordered by row
+        std::vector<std::uint32_t> rowStart;// first run of each row (y + z * cubeEdgeLen), one past the end at the back
+        std::uint32_t offset;// global index of the first run
+        std::unordered_set<std::uint64_t> found;// subobject ids of the split component
+    };
+    const int cubeEdgeLen;
+    const int mag;
+    const std::size_t layerId;
+    const std::size_t magIndex;
+    const Coordinate seed;// in voxels of the current mag
+    QMutexLocker cubeLock;
+    std::vector<Cube> cubes;
+    std::unordered_map<CoordOfCube, std::size_t> cubeIndex;
+    std::vector<std::uint32_t> parent;
+
+    std::uint32_t find(std::uint32_t run);
+    void unite(const std::uint32_t lhs, const std::uint32_t rhs);
+    void labelCube(Cube & cube, const std::unordered_set<std::uint64_t> & members, const Coordinate & areaMin, const Coordinate & areaMax) const;
+    std::array<bool, 6> touchedFaces(const Cube & cube) const;// -x, +x, -y, +y, -z, +z
+    void joinFaces();
+
+public:
+    ConnectedComponents(const std::unordered_set<std::uint64_t> & members, const Coordinate & globalSeed);
+
+    /**
+     * Replaces from by to in the component containing the seed voxel, only once.
+     * Changed cubes are journaled and marked as modified.
+     * Returns the other subobject ids encountered in the component.
+     */
+    std::unordered_set<std::uint64_t> splitOff(const std::uint64_t from, const std::uint64_t to);
+};
+
+#endif // CONNECTEDCOMPONENTS_H
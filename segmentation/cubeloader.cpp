@@ -27,22 +27,34 @@
 #include "segmentation.h"
 #include "segmentationsplit.h"
 #include "stateInfo.h"
+#include "undojournal.h"
 
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <array>
 #include <boost/multi_array.hpp>
+#include <cmath>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+// call with protectCube2Pointer locked and keep it until done accessing the cube,
+// the loader backs up modified cubes while holding it
 std::pair<bool, void *> getRawCube(const Coordinate & pos) {
     if (!Segmentation::singleton().enabled) {
         return {false, nullptr};
     }
     const auto posDc = pos.cube(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
-
-    state->protectCube2Pointer.lock();
     auto * rawcube = cubeQuery(state->cube2Pointer, Segmentation::singleton().layerId, Dataset::current().magIndex, posDc);
-    state->protectCube2Pointer.unlock();
-
     return std::make_pair(rawcube != nullptr, rawcube);
 }
 
+void journalCube(const Coordinate & pos, const void * const rawcube) {// call before the first write of an edit into this cube
+    const auto cubeCoord = pos.cube(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
+    UndoJournal::singleton().cubeWillChange(Segmentation::singleton().layerId, Dataset::current().magIndex, cubeCoord, rawcube);
+}
+
 boost::multi_array_ref<uint64_t, 3> getCubeRef(void * const rawcube) {
     const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
     const auto dims = boost::extents[cubeEdgeLen][cubeEdgeLen][cubeEdgeLen];
@@ -50,6 +62,7 @@ boost::multi_array_ref<uint64_t, 3> getCubeRef(void * const rawcube) {
 }
 
 uint64_t readVoxel(const Coordinate & pos) {
+    QMutexLocker locker(&state->protectCube2Pointer);
     auto cubeIt = getRawCube(pos);
     if (Session::singleton().outsideMovementArea(pos) || !cubeIt.first) {
         return Segmentation::singleton().getBackgroundId();
@@ -59,12 +72,16 @@ uint64_t readVoxel(const Coordinate & pos) {
 }
 
 bool writeVoxel(const Coordinate & pos, const uint64_t value, bool isMarkChanged) {
-    auto cubeIt = getRawCube(pos);
-    if (Session::singleton().outsideMovementArea(pos) || !cubeIt.first) {
-        return false;
+    {
+        QMutexLocker locker(&state->protectCube2Pointer);
+        auto cubeIt = getRawCube(pos);
+        if (Session::singleton().outsideMovementArea(pos) || !cubeIt.first) {
+            return false;
+        }
+        journalCube(pos, cubeIt.second);
+        const auto inCube = pos.insideCube(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
+        getCubeRef(cubeIt.second)[inCube.z][inCube.y][inCube.x] = value;
     }
-    const auto inCube = pos.insideCube(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
-    getCubeRef(cubeIt.second)[inCube.z][inCube.y][inCube.x] = value;
     if (isMarkChanged) {
         Loader::Controller::singleton().markOcCubeAsModified(pos.cube(Dataset::current().cubeEdgeLength, Dataset::current().magnification), Dataset::current().magnification);
     }
@@ -106,6 +123,20 @@ void coordCubesMarkChanged(const CubeCoordSet & cubeChangeSet) {
     }
 }
 
+bool fillWholeCube(const CoordOfCube & cubeCoord, const uint64_t value) {
+    const auto globalCoord = cubeCoord.cube2Global(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
+    QMutexLocker locker(&state->protectCube2Pointer);
+    auto rawcube = getRawCube(globalCoord);
+    if (rawcube.first) {
+        journalCube(globalCoord, rawcube.second);
+        auto cubeRef = getCubeRef(rawcube.second);
+        std::fill(cubeRef.data(), cubeRef.data() + cubeRef.num_elements(), value);
+    } else {
+        qCritical() << cubeCoord.x << cubeCoord.y << cubeCoord.z << "cube missing for (complete) writeVoxels";
+    }
+    return rawcube.first;
+}
+
 auto wholeCubes = [](const Coordinate & globalFirst, const Coordinate & globalLast, const uint64_t value, CubeCoordSet & cubeChangeSet) {
     const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
     const auto wholeCubeBegin = (globalFirst + cubeEdgeLen - 1).cube(cubeEdgeLen, Dataset::current().magnification);
@@ -116,14 +147,8 @@ auto wholeCubes = [](const Coordinate & globalFirst, const Coordinate & globalLa
     for (int y = wholeCubeBegin.y; y < wholeCubeEnd.y; ++y)
     for (int x = wholeCubeBegin.x; x < wholeCubeEnd.x; ++x) {
         const auto cubeCoord = CoordOfCube(x, y, z);
-        const auto globalCoord = cubeCoord.cube2Global(cubeEdgeLen, Dataset::current().magnification);
-        auto rawcube = getRawCube(globalCoord);
-        if (rawcube.first) {
-            auto cubeRef = getCubeRef(rawcube.second);
-            std::fill(cubeRef.data(), cubeRef.data() + cubeRef.num_elements(), value);
+        if (fillWholeCube(cubeCoord, value)) {
             cubeChangeSet.emplace(cubeCoord);
-        } else {
-            qCritical() << x << y << z << "cube missing for (complete) writeVoxels";
         }
     }
     //returns the skip function for the region traversal
@@ -134,11 +159,14 @@ auto wholeCubes = [](const Coordinate & globalFirst, const Coordinate & globalLa
     };
 };
 
-template<typename Func, typename Skip>
-CubeCoordSet processRegion(const Coordinate & globalFirst, const Coordinate &  globalLast, Func func, Skip skip) {
-    const auto & cubeEdgeLen = Dataset::current().cubeEdgeLength;
-    const auto cubeBegin = globalFirst.cube(cubeEdgeLen, Dataset::current().magnification);
-    const auto cubeEnd = globalLast.cube(cubeEdgeLen, Dataset::current().magnification) + 1;
+// calls func(voxels, count, globalPos) for each row of the region inside a loaded cube,
+// the count voxels are consecutive in x and globalPos is the global coordinate of the first one
+template<typename RowFunc, typename Skip>
+CubeCoordSet processRegionRows(const Coordinate & globalFirst, const Coordinate &  globalLast, const bool isWrite, RowFunc func, Skip skip) {
+    const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
+    const auto mag = Dataset::current().magnification;
+    const auto cubeBegin = globalFirst.cube(cubeEdgeLen, mag);
+    const auto cubeEnd = globalLast.cube(cubeEdgeLen, mag) + 1;
     CubeCoordSet cubeCoords;
 
     //traverse all remaining cubes
@@ -147,19 +175,23 @@ CubeCoordSet processRegion(const Coordinate & globalFirst, const Coordinate &  g
     for (int x = cubeBegin.x; x < cubeEnd.x; ++x) {
         skip(x, y, z);//skip cubes which got processed before
         const auto cubeCoord = CoordOfCube(x, y, z);
-        const auto globalCubeBegin = cubeCoord.cube2Global(cubeEdgeLen, Dataset::current().magnification);
+        const auto globalCubeBegin = cubeCoord.cube2Global(cubeEdgeLen, mag);
+        QMutexLocker locker(&state->protectCube2Pointer);// per cube, so the loader can interleave
         auto rawcube = getRawCube(globalCubeBegin);
         if (rawcube.first) {
-            auto cubeRef = getCubeRef(rawcube.second);
-            const auto globalCubeEnd = globalCubeBegin + cubeEdgeLen * Dataset::current().magnification - 1;
-            const auto localStart = globalFirst.capped(globalCubeBegin, globalCubeEnd).insideCube(cubeEdgeLen, Dataset::current().magnification);
-            const auto localEnd = globalLast.capped(globalCubeBegin, globalCubeEnd).insideCube(cubeEdgeLen, Dataset::current().magnification);
+            if (isWrite) {
+                journalCube(globalCubeBegin, rawcube.second);
+            }
+            auto * voxels = reinterpret_cast<uint64_t *>(rawcube.second);
+            const auto globalCubeEnd = globalCubeBegin + cubeEdgeLen * mag - 1;
+            const auto localStart = globalFirst.capped(globalCubeBegin, globalCubeEnd).insideCube(cubeEdgeLen, mag);
+            const auto localEnd = globalLast.capped(globalCubeBegin, globalCubeEnd).insideCube(cubeEdgeLen, mag);
+            const auto count = localEnd.x - localStart.x + 1;
 
             for (int z = localStart.z; z <= localEnd.z; ++z)
-            for (int y = localStart.y; y <= localEnd.y; ++y)
-            for (int x = localStart.x; x <= localEnd.x; ++x) {
-                const Coordinate globalCoord{globalCubeBegin.x + x * Dataset::current().magnification, globalCubeBegin.y + y * Dataset::current().magnification, globalCubeBegin.z + z * Dataset::current().magnification};
-                func(cubeRef[z][y][x], globalCoord);
+            for (int y = localStart.y; y <= localEnd.y; ++y) {
+                const Coordinate globalRow{globalCubeBegin.x + localStart.x * mag, globalCubeBegin.y + y * mag, globalCubeBegin.z + z * mag};
+                func(voxels + (static_cast<std::size_t>(z) * cubeEdgeLen + y) * cubeEdgeLen + localStart.x, count, globalRow);
             }
             cubeCoords.emplace(cubeCoord);
         } else {
@@ -169,15 +201,226 @@ CubeCoordSet processRegion(const Coordinate & globalFirst, const Coordinate &  g
     return cubeCoords;
 }
 
-template<typename Func>//wrapper without Skip
-CubeCoordSet processRegion(const Coordinate & globalFirst, const Coordinate &  globalLast, Func func) {
-    return processRegion(globalFirst, globalLast, func, [](int &, int, int){});
+template<typename RowFunc>//wrapper without Skip
+CubeCoordSet processRegionRows(const Coordinate & globalFirst, const Coordinate &  globalLast, const bool isWrite, RowFunc func) {
+    return processRegionRows(globalFirst, globalLast, isWrite, func, [](int &, int, int){});
+}
+
+template<typename Func>//per voxel
+CubeCoordSet processRegion(const Coordinate & globalFirst, const Coordinate &  globalLast, const bool isWrite, Func func) {
+    const auto mag = Dataset::current().magnification;
+    return processRegionRows(globalFirst, globalLast, isWrite, [&func, mag](uint64_t * voxels, const int count, Coordinate globalPos){
+        for (int i = 0; i < count; ++i, globalPos.x += mag) {
+            func(voxels[i], globalPos);
+        }
+    });
 }
 
+// isSubObjectIdSelected, memoised for the duration of a stroke
+class SelectedSubobjects {
+    std::unordered_map<uint64_t, bool> known;
+    uint64_t lastId{0};
+    bool lastResult{false};
+    bool valid{false};
+
+public:
+    bool operator()(const uint64_t subobjectId) {
+        if (!valid || subobjectId != lastId) {
+            auto it = known.find(subobjectId);
+            if (it == std::end(known)) {
+                it = known.emplace(subobjectId, Segmentation::singleton().isSubObjectIdSelected(subobjectId)).first;
+            }
+            lastId = subobjectId;
+            lastResult = it->second;
+            valid = true;
+        }
+        return lastResult;
+    }
+};
+
+/**
+ * x span of the brush swept from one position to another for every row of the swept region, computed once per segment.
+ * Round brushes sweep a capsule, whose ends are checked with the same distance test as isInsideSphere,
+ * so a segment without length contains exactly the voxels of a single round brush.
+ * Angular brushes sweep their box, for a single position that is the whole region.
+ */
+class StrokeStencil {
+    std::pair<Coordinate, Coordinate> region;
+    Coordinate first;
+    int rows;
+    std::vector<std::pair<int, int>> spans;// inclusive global x, empty if first > second
+
+    void roundSpans(const Coordinate & from, const Coordinate & to, const double radius) {
+        const auto scale = Dataset::current().scale;
+        const std::array<double, 3> d{(to.x - from.x) * static_cast<double>(scale.x), (to.y - from.y) * static_cast<double>(scale.y), (to.z - from.z) * static_cast<double>(scale.z)};
+        const auto dd = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        for (int z = first.z; z <= region.second.z; ++z)
+        for (int y = first.y; y <= region.second.y; ++y) {
+            const auto py = static_cast<double>(y - from.y) * scale.y;
+            const auto pz = static_cast<double>(z - from.z) * scale.z;
+            // squared distance to the segment, convex along the row
+            const auto sqDistance = [&](const int x){
+                const auto px = static_cast<double>(x - from.x) * scale.x;
+                const auto t = dd > 0 ? std::max(0.0, std::min(1.0, (px * d[0] + py * d[1] + pz * d[2]) / dd)) : 0.0;
+                const auto qx = px - t * d[0];
+                const auto qy = py - t * d[1];
+                const auto qz = pz - t * d[2];
+                return qx*qx + qy*qy + qz*qz;
+            };
+            const auto inside = [&](const int x){
+                return sqDistance(x) < radius * radius;
+            };
+            int lo = region.first.x;
+            int hi = region.second.x;
+            while (hi - lo > 2) {// ternary search for the closest voxel of the row
+                const auto m1 = lo + (hi - lo) / 3;
+                const auto m2 = hi - (hi - lo) / 3;
+                const auto d1 = sqDistance(m1);
+                const auto d2 = sqDistance(m2);
+                if (d1 < d2) {
+                    hi = m2 - 1;
+                } else if (d1 > d2) {
+                    lo = m1 + 1;
+                } else {
+                    lo = m1;
+                    hi = m2;
+                }
+            }
+            int closest = lo;
+            for (int x = lo + 1; x <= hi; ++x) {
+                if (sqDistance(x) < sqDistance(closest)) {
+                    closest = x;
+                }
+            }
+            if (!inside(closest)) {
+                spans.emplace_back(0, -1);
+                continue;
+            }
+            // the inside is an interval around the closest voxel
+            int outside = region.first.x - 1;
+            int in = closest;
+            while (in - outside > 1) {
+                const auto mid = outside + (in - outside) / 2;
+                (inside(mid) ? in : outside) = mid;
+            }
+            const auto left = in;
+            in = closest;
+            outside = region.second.x + 1;
+            while (outside - in > 1) {
+                const auto mid = in + (outside - in) / 2;
+                (inside(mid) ? in : outside) = mid;
+            }
+            spans.emplace_back(left, in);
+        }
+    }
+
+    void angularSpans(const Coordinate & from, const Coordinate & to, const std::pair<Coordinate, Coordinate> & fromRegion, const std::pair<Coordinate, Coordinate> & toRegion) {
+        // extent of the box around its position
+        const Coordinate below{std::max(from.x - fromRegion.first.x, to.x - toRegion.first.x), std::max(from.y - fromRegion.first.y, to.y - toRegion.first.y), std::max(from.z - fromRegion.first.z, to.z - toRegion.first.z)};
+        const Coordinate above{std::max(fromRegion.second.x - from.x, toRegion.second.x - to.x), std::max(fromRegion.second.y - from.y, toRegion.second.y - to.y), std::max(fromRegion.second.z - from.z, toRegion.second.z - to.z)};
+        const auto d = to - from;
+        // limits the sweep parameter t to the positions whose box contains pos on one axis
+        const auto restrict = [](double & tmin, double & tmax, const int pos, const int start, const int delta, const int lower, const int upper){
+            const double lo = pos - upper - start;// start + t·delta ∈ [pos - upper, pos + lower]
+            const double hi = pos + lower - start;
+            if (delta == 0) {
+                if (lo > 0 || hi < 0) {
+                    tmax = -1;
+                }
+            } else {
+                tmin = std::max(tmin, std::min(lo / delta, hi / delta));
+                tmax = std::min(tmax, std::max(lo / delta, hi / delta));
+            }
+        };
+        for (int z = first.z; z <= region.second.z; ++z)
+        for (int y = first.y; y <= region.second.y; ++y) {
+            double tmin = 0;
+            double tmax = 1;
+            restrict(tmin, tmax, y, from.y, d.y, below.y, above.y);
+            restrict(tmin, tmax, z, from.z, d.z, below.z, above.z);
+            if (tmin > tmax) {
+                spans.emplace_back(0, -1);
+            } else {
+                const auto left = from.x + std::min(tmin * d.x, tmax * d.x) - below.x;
+                const auto right = from.x + std::max(tmin * d.x, tmax * d.x) + above.x;
+                spans.emplace_back(static_cast<int>(std::ceil(left)), static_cast<int>(std::floor(right)));
+            }
+        }
+    }
+
+public:
+    //rows are visited at multiples of mag, so the first ones may lie before the region
+    StrokeStencil(const Coordinate & from, const Coordinate & to, const brush_t & brush, const int mag) {
+        const auto fromRegion = getRegion(from, brush);
+        const auto toRegion = getRegion(to, brush);
+        region = {{std::min(fromRegion.first.x, toRegion.first.x), std::min(fromRegion.first.y, toRegion.first.y), std::min(fromRegion.first.z, toRegion.first.z)}
+                , {std::max(fromRegion.second.x, toRegion.second.x), std::max(fromRegion.second.y, toRegion.second.y), std::max(fromRegion.second.z, toRegion.second.z)}};
+        first = {region.first.x, region.first.y / mag * mag, region.first.z / mag * mag};
+        rows = region.second.y - first.y + 1;
+        spans.reserve(static_cast<std::size_t>(std::max(0, rows)) * std::max(0, region.second.z - first.z + 1));
+        if (brush.shape == brush_t::shape_t::round) {
+            roundSpans(from, to, brush.radius);
+        } else {
+            angularSpans(from, to, fromRegion, toRegion);
+        }
+    }
+
+    const std::pair<Coordinate, Coordinate> & bounds() const {
+        return region;
+    }
+
+    bool covers(const int y, const int z) const {
+        return y >= first.y && y <= region.second.y && z >= first.z && z <= region.second.z;
+    }
+
+    //clipped to the region, which is capped to the movement area
+    std::pair<int, int> span(const int y, const int z) const {
+        const auto & span = spans[static_cast<std::size_t>(z - first.z) * rows + (y - first.y)];
+        return {std::max(span.first, region.first.x), std::min(span.second, region.second.x)};
+    }
+};
+
+// fills or erases voxels of a row, the brush differentiations are resolved once per stroke
+class BrushFill {
+    const uint64_t value;
+    const bool eraseSelected;
+    SelectedSubobjects selected;
+
+public:
+    BrushFill(const uint64_t value, const brush_t & brush)
+        //if there’re selected objects, inverse brushes only erase these
+        : value{value}, eraseSelected{brush.inverse && Segmentation::singleton().selectedObjectsCount() != 0} {}
+
+    bool erasesSelected() const {
+        return eraseSelected;
+    }
+
+    void operator()(uint64_t * voxels, const int count) {
+        if (!eraseSelected) {
+            std::fill_n(voxels, count, value);
+        } else {
+            for (int i = 0; i < count; ++i) {
+                if (selected(voxels[i])) {
+                    voxels[i] = 0;
+                }
+            }
+        }
+    }
+
+    //applies the inclusive global x span to the row, voxel i of the row is at globalRow.x + i * mag
+    void operator()(uint64_t * voxels, const int count, const Coordinate & globalRow, const std::pair<int, int> & span, const int mag) {
+        const auto first = (std::max(span.first - globalRow.x, 0) + mag - 1) / mag;
+        const auto last = span.second < globalRow.x ? -1 : std::min(count - 1, (span.second - globalRow.x) / mag);
+        if (first <= last) {
+            (*this)(voxels + first, last - first + 1);
+        }
+    }
+};
+
 subobjectRetrievalMap readVoxels(const Coordinate & centerPos, const brush_t &brush) {
     subobjectRetrievalMap subobjects;
     const auto region = getRegion(centerPos, brush);
-    processRegion(region.first, region.second, [&subobjects](uint64_t & voxel, Coordinate position){
+    processRegion(region.first, region.second, false, [&subobjects](uint64_t & voxel, Coordinate position){
         if (voxel != 0) {//don’t select the unsegmented area as object
             subobjects.emplace(std::piecewise_construct, std::make_tuple(voxel), std::make_tuple(position));
         }
@@ -186,45 +429,27 @@ subobjectRetrievalMap readVoxels(const Coordinate & centerPos, const brush_t &br
 }
 
 void writeVoxels(const Coordinate & centerPos, const uint64_t value, const brush_t & brush, bool isMarkChanged) {
-    //all the different invocations here are listed explicitly so the compiler can inline the fuck out of it
-    //the brush differentiations were moved outside the core lambda which is called for every voxel
     CubeCoordSet cubeChangeSet;
     CubeCoordSet cubeChangeSetWholeCube;
     if (Session::singleton().annotationMode.testFlag(AnnotationMode::Mode_Paint)) {
         const auto region = getRegion(centerPos, brush);
+        BrushFill fill(value, brush);
         if (brush.shape == brush_t::shape_t::angular) {
-            if (!brush.inverse || Segmentation::singleton().selectedObjectsCount() == 0) {
-                //for rectangular brushes no further range checks are needed
-                if (brush.mode == brush_t::mode_t::three_dim && brush.shape == brush_t::shape_t::angular) {
-                    //rarest special case: processes completely exclosed cubes first
-                    cubeChangeSet = processRegion(region.first, region.second, [value](uint64_t & voxel, Coordinate){
-                        voxel = value;
-                    }, wholeCubes(region.first, region.second, value, cubeChangeSetWholeCube));
-                } else {
-                    cubeChangeSet = processRegion(region.first, region.second, [value](uint64_t & voxel, Coordinate){
-                        voxel = value;
-                    });
-                }
-            } else {//inverse but selected
-                cubeChangeSet = processRegion(region.first, region.second, [](uint64_t & voxel, Coordinate){
-                    if (Segmentation::singleton().isSubObjectIdSelected(voxel)) {//if there’re selected objects, we only want to erase these
-                        voxel = 0;
-                    }
-                });
+            //for rectangular brushes no further range checks are needed
+            const auto fillRows = [&fill](uint64_t * voxels, const int count, const Coordinate &){
+                fill(voxels, count);
+            };
+            if (!fill.erasesSelected() && brush.mode == brush_t::mode_t::three_dim) {
+                //rarest special case: processes completely exclosed cubes first
+                cubeChangeSet = processRegionRows(region.first, region.second, true, fillRows, wholeCubes(region.first, region.second, value, cubeChangeSetWholeCube));
+            } else {
+                cubeChangeSet = processRegionRows(region.first, region.second, true, fillRows);
             }
-        } else if (!brush.inverse || Segmentation::singleton().selectedObjectsCount() == 0) {
-            //voxel need to check if they are inside the circle
-            cubeChangeSet = processRegion(region.first, region.second, [&brush, centerPos, value](uint64_t & voxel, Coordinate globalPos){
-                if (isInsideSphere(globalPos.x - centerPos.x, globalPos.y - centerPos.y, globalPos.z - centerPos.z, brush.radius)) {
-                    voxel = value;
-                }
-            });
-        } else {//circle, inverse and selected
-            cubeChangeSet = processRegion(region.first, region.second, [&brush, centerPos](uint64_t & voxel, Coordinate globalPos){
-                if (isInsideSphere(globalPos.x - centerPos.x, globalPos.y - centerPos.y, globalPos.z - centerPos.z, brush.radius)
-                        && Segmentation::singleton().isSubObjectIdSelected(voxel)) {
-                    voxel = 0;
-                }
+        } else {
+            const auto mag = Dataset::current().magnification;
+            const StrokeStencil stencil(centerPos, centerPos, brush, mag);
+            cubeChangeSet = processRegionRows(region.first, region.second, true, [&fill, &stencil, mag](uint64_t * voxels, const int count, const Coordinate & globalRow){
+                fill(voxels, count, globalRow, stencil.span(globalRow.y, globalRow.z), mag);
             });
         }
     }
@@ -236,10 +461,96 @@ void writeVoxels(const Coordinate & centerPos, const uint64_t value, const brush
     }
 }
 
+CubeCoordSet writeStroke(const std::vector<std::pair<Coordinate, Coordinate>> & segments, const uint64_t value, const brush_t & brush) {
+    CubeCoordSet cubeChangeSet;
+    if (segments.empty() || !Session::singleton().annotationMode.testFlag(AnnotationMode::Mode_Paint)) {
+        return cubeChangeSet;
+    }
+    const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
+    const auto mag = Dataset::current().magnification;
+    std::vector<StrokeStencil> stencils;
+    stencils.reserve(segments.size());
+    std::vector<CoordOfCube> cubes;// every cube of the swept volume is rasterised once, however many segments cross it
+    CubeCoordSet seenCubes;
+    for (const auto & segment : segments) {
+        stencils.emplace_back(segment.first, segment.second, brush, mag);
+        const auto & bounds = stencils.back().bounds();
+        const auto cubeBegin = bounds.first.cube(cubeEdgeLen, mag);
+        const auto cubeEnd = bounds.second.cube(cubeEdgeLen, mag);
+        for (int z = cubeBegin.z; z <= cubeEnd.z; ++z)
+        for (int y = cubeBegin.y; y <= cubeEnd.y; ++y)
+        for (int x = cubeBegin.x; x <= cubeEnd.x; ++x) {
+            if (seenCubes.emplace(x, y, z).second) {
+                cubes.emplace_back(x, y, z);
+            }
+        }
+    }
+    BrushFill fill(value, brush);
+    //like writeVoxels, large 3d angular brushes fill cubes enclosed by the brush box at one of the positions at once
+    std::vector<std::pair<Coordinate, Coordinate>> boxes;
+    if (brush.shape == brush_t::shape_t::angular && brush.mode == brush_t::mode_t::three_dim && !fill.erasesSelected()) {
+        for (const auto & segment : segments) {
+            boxes.emplace_back(getRegion(segment.first, brush));
+            boxes.emplace_back(getRegion(segment.second, brush));
+        }
+    }
+    std::vector<const StrokeStencil *> overlapping;
+    std::vector<std::pair<int, int>> rowSpans;
+    for (const auto & cubeCoord : cubes) {
+        const auto cubeFirst = cubeCoord.cube2Global(cubeEdgeLen, mag);
+        const auto cubeLast = cubeFirst + cubeEdgeLen * mag - 1;
+        const auto enclosed = std::any_of(std::begin(boxes), std::end(boxes), [&cubeFirst, &cubeLast](const std::pair<Coordinate, Coordinate> & box){
+            return box.first.x <= cubeFirst.x && box.first.y <= cubeFirst.y && box.first.z <= cubeFirst.z
+                    && box.second.x >= cubeLast.x && box.second.y >= cubeLast.y && box.second.z >= cubeLast.z;
+        });
+        if (enclosed) {
+            if (fillWholeCube(cubeCoord, value)) {
+                cubeChangeSet.emplace(cubeCoord);
+            }
+            continue;
+        }
+        overlapping.clear();
+        auto first = cubeLast;
+        auto last = cubeFirst;
+        for (const auto & stencil : stencils) {
+            const auto & bounds = stencil.bounds();
+            if (bounds.first.x <= cubeLast.x && bounds.second.x >= cubeFirst.x && bounds.first.y <= cubeLast.y && bounds.second.y >= cubeFirst.y && bounds.first.z <= cubeLast.z && bounds.second.z >= cubeFirst.z) {
+                overlapping.emplace_back(&stencil);
+                const auto clippedFirst = bounds.first.capped(cubeFirst, cubeLast);
+                const auto clippedLast = bounds.second.capped(cubeFirst, cubeLast);
+                first = {std::min(first.x, clippedFirst.x), std::min(first.y, clippedFirst.y), std::min(first.z, clippedFirst.z)};
+                last = {std::max(last.x, clippedLast.x), std::max(last.y, clippedLast.y), std::max(last.z, clippedLast.z)};
+            }
+        }
+        const auto changed = processRegionRows(first, last, true, [&](uint64_t * voxels, const int count, const Coordinate & globalRow){
+            rowSpans.clear();
+            for (const auto * stencil : overlapping) {
+                if (stencil->covers(globalRow.y, globalRow.z)) {
+                    const auto span = stencil->span(globalRow.y, globalRow.z);
+                    if (span.first <= span.second) {
+                        rowSpans.emplace_back(span);
+                    }
+                }
+            }
+            //successive segments overlap around their common position, merge them so no voxel is visited twice
+            std::sort(std::begin(rowSpans), std::end(rowSpans));
+            for (std::size_t i = 0; i < rowSpans.size();) {
+                auto merged = rowSpans[i];
+                for (++i; i < rowSpans.size() && rowSpans[i].first <= merged.second + 1; ++i) {
+                    merged.second = std::max(merged.second, rowSpans[i].second);
+                }
+                fill(voxels, count, globalRow, merged, mag);
+            }
+        });
+        cubeChangeSet.insert(std::begin(changed), std::end(changed));
+    }
+    return cubeChangeSet;
+}
+
 CubeCoordSet processRegionByStridedBuf(const Coordinate & globalFirst, const Coordinate &  globalLast, char * data, const Coordinate & strides, bool isWrite, bool markChanged) {
     CubeCoordSet cubeChangeSet;
     if (isWrite) {
-        cubeChangeSet = processRegion(globalFirst, globalLast,
+        cubeChangeSet = processRegion(globalFirst, globalLast, true,
                 [globalFirst,data,strides](uint64_t & voxel, Coordinate globalPos){
                 voxel = reinterpret_cast<const uint64_t &>(data[(globalPos - globalFirst).componentMul(strides).sum()]);
             });
@@ -248,20 +559,10 @@ CubeCoordSet processRegionByStridedBuf(const Coordinate & globalFirst, const Coo
         }
     }
     else {
-        cubeChangeSet = processRegion(globalFirst, globalLast,
+        cubeChangeSet = processRegion(globalFirst, globalLast, false,
                 [globalFirst,data,strides](uint64_t & voxel, Coordinate globalPos){
                 reinterpret_cast<uint64_t &>(data[(globalPos - globalFirst).componentMul(strides).sum()]) = voxel;
             });
     }
     return cubeChangeSet;
 }
-
-void listFill(const Coordinate & centerPos, const brush_t & brush, const uint64_t fillsoid, const std::unordered_set<Coordinate> & voxels) {
-    const auto region = getRegion(centerPos, brush);
-    auto cubeChangeSet = processRegion(region.first, region.second, [fillsoid, &voxels](uint64_t & voxel, Coordinate globalPos){
-        if (voxels.find(globalPos) != std::end(voxels)) {
-            voxel = fillsoid;
-        }
-    });
-    coordCubesMarkChanged(cubeChangeSet);
-}
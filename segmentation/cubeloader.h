@@ -28,19 +28,23 @@
 #include <cstdint>
 #include <unordered_set>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 class brush_t;
 using CubeCoordSet = std::unordered_set<CoordOfCube>;
 using subobjectRetrievalMap = std::unordered_map<uint64_t, Coordinate>;
 
 bool isInsideSphere(const double xi, const double yi, const double zi, const double radius);
+std::pair<Coordinate, Coordinate> getRegion(const floatCoordinate & centerPos, const brush_t & brush);
 
 void coordCubesMarkChanged(const CubeCoordSet & cubeChangeSet);
 uint64_t readVoxel(const Coordinate & pos);
 subobjectRetrievalMap readVoxels(const Coordinate & centerPos, const brush_t &);
 bool writeVoxel(const Coordinate & pos, const uint64_t value, bool isMarkChanged = true);
 void writeVoxels(const Coordinate & centerPos, const uint64_t value, const brush_t &, bool isMarkChanged = true);
+// paints the brush swept along every segment in one pass, returns the changed cubes without marking them
+CubeCoordSet writeStroke(const std::vector<std::pair<Coordinate, Coordinate>> & segments, const uint64_t value, const brush_t &);
 CubeCoordSet processRegionByStridedBuf(const Coordinate & globalFirst, const Coordinate &  globalLast, char * data, const Coordinate & strides, bool isWrite, bool markChanged);
-void listFill(const Coordinate & centerPos, const brush_t & brush, const uint64_t fillsoid, const std::unordered_set<Coordinate> & voxels);
 
 #endif//CUBELOADER_H
@@ -0,0 +1,76 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+
+#include "floodfill.h"
+
+#include "dataset.h"
+#include "loader.h"
+#include "segmentation.h"
+#include "session.h"
+#include "stateInfo.h"
+#include "undojournal.h"
+
+#include <algorithm>
+
+FloodFill::FloodFill(const Coordinate & areaMin, const Coordinate & areaMax, const int axes)
+    : cubeEdgeLen{Dataset::current().cubeEdgeLength}, mag{Dataset::current().magnification}
+    , layerId{Segmentation::singleton().layerId}, magIndex{Dataset::current().magIndex}
+    , enabled{Segmentation::singleton().enabled}, axes{axes}, cubeLock{&state->protectCube2Pointer} {
+    const auto globalMin = areaMin.capped(Session::singleton().movementAreaMin, Session::singleton().movementAreaMax);
+    const auto globalMax = areaMax.capped(Session::singleton().movementAreaMin, Session::singleton().movementAreaMax);
+    min = {std::max(0, globalMin.x / mag), std::max(0, globalMin.y / mag), std::max(0, globalMin.z / mag)};
+    max = {globalMax.x / mag, globalMax.y / mag, globalMax.z / mag};
+}
+
+FloodFill::FloodFill(const int axes) : FloodFill(Session::singleton().movementAreaMin, Session::singleton().movementAreaMax, axes) {}
+
+FloodFill::~FloodFill() {
+    cubeLock.unlock();// writing is done, let the loader continue before the cubes are announced
+    for (const auto & pair : cubes) {
+        if (pair.second.written) {
+            Loader::Controller::singleton().markOcCubeAsModified(pair.first, mag);
+        }
+    }
+}
+
+FloodFill::Cube * FloodFill::cubeAt(const Coordinate & voxel) {
+    const CoordOfCube cubeCoord{voxel.x / cubeEdgeLen, voxel.y / cubeEdgeLen, voxel.z / cubeEdgeLen};
+    if (lastCube != nullptr && cubeCoord == lastCubeCoord) {
+        return lastCube->voxels != nullptr ? lastCube : nullptr;
+    }
+    auto it = cubes.find(cubeCoord);
+    if (it == std::end(cubes)) {// missing cubes are remembered as well
+        auto * rawcube = cubeQuery(state->cube2Pointer, layerId, magIndex, cubeCoord);
+        const auto voxelCount = rawcube != nullptr ? static_cast<std::size_t>(cubeEdgeLen) * cubeEdgeLen * cubeEdgeLen : 0;
+        it = cubes.emplace(cubeCoord, Cube{reinterpret_cast<std::uint64_t *>(rawcube), std::vector<std::uint64_t>((voxelCount + 63) / 64), false}).first;
+    }
+    lastCubeCoord = cubeCoord;
+    lastCube = &it->second;
+    return lastCube->voxels != nullptr ? lastCube : nullptr;
+}
+
+void FloodFill::prepareWrite(const Coordinate & voxel, Cube & cube) {
+    const CoordOfCube cubeCoord{voxel.x / cubeEdgeLen, voxel.y / cubeEdgeLen, voxel.z / cubeEdgeLen};
+    UndoJournal::singleton().cubeWillChange(layerId, magIndex, cubeCoord, cube.voxels);
+    cube.written = true;
+}
@@ -0,0 +1,207 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+
+#ifndef FLOODFILL_H
+#define FLOODFILL_H
+
+#include "coordinate.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Scanline flood fill over the loaded segmentation cubes of the current mag.
+ *
+ * Spans are extended along the first enabled axis and seed the neighbouring lines of the other enabled axes.
+ * Cube pointers are resolved once per cube, visited voxels are tracked in a bitset per cube.
+ * Cubes which are not loaded or outside the area act as boundary.
+ * Writes are journaled before the first change of a cube and the cubes are marked as modified once,
+ * when the FloodFill is destroyed.
+ * The cubes stay locked (protectCube2Pointer) for the lifetime of the FloodFill, so cached cube pointers
+ * remain valid, accept and visit must not lock it again.
+ * Fills on the same FloodFill share the visited voxels. Main thread only.
+ */
+class FloodFill {
+public:
+    enum Axis { X = 1, Y = 2, Z = 4, All = X | Y | Z };
+
+private:
+    struct Cube {
+        std::uint64_t * voxels;
+        std::vector<std::uint64_t> visited;// one bit per voxel
+        bool written{false};
+    };
+    const int cubeEdgeLen;
+    const int mag;
+    const std::size_t layerId;
+    const std::size_t magIndex;
+    const bool enabled;
+    Coordinate min;// inclusive bounds in voxels of the current mag
+    Coordinate max;
+    const int axes;
+    QMutexLocker cubeLock;
+    std::unordered_map<CoordOfCube, Cube> cubes;
+    CoordOfCube lastCubeCoord;
+    Cube * lastCube{nullptr};
+    std::size_t voxelsVisited{0};
+
+    Cube * cubeAt(const Coordinate & voxel);
+    std::size_t indexInCube(const Coordinate & voxel) const {
+        return static_cast<std::size_t>(voxel.x % cubeEdgeLen) + cubeEdgeLen * (voxel.y % cubeEdgeLen + static_cast<std::size_t>(cubeEdgeLen) * (voxel.z % cubeEdgeLen));
+    }
+    void prepareWrite(const Coordinate & voxel, Cube & cube);
+
+public:
+    // areaMin and areaMax are inclusive global coordinates, capped to the movement area
+    FloodFill(const Coordinate & areaMin, const Coordinate & areaMax, const int axes = All);
+    FloodFill(const int axes = All);
+    ~FloodFill();
+    FloodFill(const FloodFill &) = delete;
+    FloodFill & operator=(const FloodFill &) = delete;
+
+    std::size_t visitedCount() const {
+        return voxelsVisited;
+    }
+
+    /**
+     * accept(value, globalPosition) → bool decides if the fill spreads into a voxel.
+     * visit(value, globalPosition) → new value is called once per accepted voxel.
+     */
+    template<typename Accept, typename Visit>
+    void fill(const Coordinate & globalSeed, Accept && accept, Visit && visit);
+};
+
+template<typename Accept, typename Visit>
+void FloodFill::fill(const Coordinate & globalSeed, Accept && accept, Visit && visit) {
+    if (!enabled) {
+        return;
+    }
+    const auto scanAxis = (axes & X) ? 0 : (axes & Y) ? 1 : 2;
+    const auto component = [](auto & coord, const int axis) -> decltype((coord.x)) {
+        return axis == 0 ? coord.x : axis == 1 ? coord.y : coord.z;
+    };
+    const auto axisStride = scanAxis == 0 ? 1 : scanAxis == 1 ? cubeEdgeLen : cubeEdgeLen * cubeEdgeLen;
+    std::vector<Coordinate> neighbourSteps;
+    for (const auto axis : {0, 1, 2}) {
+        if (axis != scanAxis && (axes & (1 << axis))) {
+            Coordinate step{0, 0, 0};
+            component(step, axis) = 1;
+            neighbourSteps.emplace_back(step);
+            component(step, axis) = -1;
+            neighbourSteps.emplace_back(step);
+        }
+    }
+    // calls func(voxel, cube, index) for up to count voxels along the scan axis until it returns false,
+    // cube is nullptr for voxels of missing cubes, the cube and index are only resolved once per cube
+    const auto walk = [&](Coordinate voxel, const int direction, int count, auto && func){
+        for (const auto axis : {0, 1, 2}) {
+            if (axis != scanAxis && (component(voxel, axis) < component(min, axis) || component(voxel, axis) > component(max, axis))) {
+                return;
+            }
+        }
+        auto & pos = component(voxel, scanAxis);
+        count = std::min(count, direction > 0 ? component(max, scanAxis) - pos + 1 : pos - component(min, scanAxis) + 1);
+        while (count > 0) {
+            auto * cube = cubeAt(voxel);
+            const auto inCube = pos % cubeEdgeLen;
+            const auto run = std::min(count, direction > 0 ? cubeEdgeLen - inCube : inCube + 1);
+            auto index = cube != nullptr ? indexInCube(voxel) : 0;
+            for (int i = 0; i < run; ++i, pos += direction, index += direction * axisStride) {
+                if (!func(voxel, cube, index)) {
+                    return;
+                }
+            }
+            count -= run;
+        }
+    };
+    // fillable: loaded, not visited and accepted
+    const auto fillable = [this, &accept](const Coordinate & voxel, Cube * cube, const std::size_t index){
+        return cube != nullptr && !((cube->visited[index / 64] >> (index % 64)) & 1)
+                && static_cast<bool>(accept(cube->voxels[index], Coordinate{voxel.x * mag, voxel.y * mag, voxel.z * mag}));
+    };
+    const auto claim = [this, &fillable, &visit](const Coordinate & voxel, Cube * cube, const std::size_t index){
+        if (!fillable(voxel, cube, index)) {
+            return false;
+        }
+        cube->visited[index / 64] |= std::uint64_t{1} << (index % 64);
+        ++voxelsVisited;
+        auto & value = cube->voxels[index];
+        const std::uint64_t newValue = visit(value, Coordinate{voxel.x * mag, voxel.y * mag, voxel.z * mag});
+        if (newValue != value) {
+            if (!cube->written) {
+                prepareWrite(voxel, *cube);
+            }
+            value = newValue;
+        }
+        return true;
+    };
+
+    std::vector<Coordinate> work{{globalSeed.x / mag, globalSeed.y / mag, globalSeed.z / mag}};
+    while (!work.empty()) {
+        const auto seed = work.back();
+        work.pop_back();
+        auto first = seed;
+        auto last = seed;
+        bool seeded = false;
+        walk(seed, 1, std::numeric_limits<int>::max(), [&](const Coordinate & voxel, Cube * cube, const std::size_t index){
+            if (claim(voxel, cube, index)) {
+                seeded = true;
+                last = voxel;
+                return true;
+            }
+            return false;
+        });
+        if (!seeded) {// already visited through another seed or no longer accepted
+            continue;
+        }
+        auto before = seed;
+        component(before, scanAxis) -= 1;
+        walk(before, -1, std::numeric_limits<int>::max(), [&](const Coordinate & voxel, Cube * cube, const std::size_t index){
+            if (claim(voxel, cube, index)) {
+                first = voxel;
+                return true;
+            }
+            return false;
+        });
+        const auto length = component(last, scanAxis) - component(first, scanAxis) + 1;
+        for (const auto & step : neighbourSteps) {
+            bool inRun = false;
+            walk(first + step, 1, length, [&](const Coordinate & voxel, Cube * cube, const std::size_t index){
+                const bool open = fillable(voxel, cube, index);
+                if (open && !inRun) {// one seed per run of the neighbouring line
+                    work.emplace_back(voxel);
+                }
+                inRun = open;
+                return true;
+            });
+        }
+    }
+}
+
+#endif // FLOODFILL_H
@@ -0,0 +1,383 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+
+#include "mergelist.h"
+
+#include <QThread>
+#include <QtConcurrentMap>
+
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+class LineReader {
+    const char * pos;
+    const char * const end;
+
+    void skipBlanks() {
+        while (pos != end && (*pos == ' ' || *pos == '\t' || *pos == '\r')) {
+            ++pos;
+        }
+    }
+
+public:
+    LineReader(const char * begin, const char * end) : pos(begin), end(end) {}
+
+    template<typename T>
+    bool read(T & value) {
+        skipBlanks();
+        if (pos != end && *pos == '+') {
+            ++pos;
+        }
+        const auto result = std::from_chars(pos, end, value);
+        if (result.ec != std::errc{}) {
+            return false;
+        }
+        pos = result.ptr;
+        return true;
+    }
+
+    bool read(bool & value) {// like std::istream, only 0 and 1
+        int number;
+        if (!read(number) || (number != 0 && number != 1)) {
+            return false;
+        }
+        value = number == 1;
+        return true;
+    }
+};
+
+QString textLine(const char * begin, const char * end) {
+    if (begin != end && *(end - 1) == '\r') {
+        --end;
+    }
+    return QString::fromUtf8(begin, static_cast<int>(end - begin));
+}
+
+// a subobject listed repeatedly for one object is kept once,
+// the old text loader added it once per occurrence, so the object contained it several times
+void sortSubobjects(MergelistEntry & entry) {
+    std::sort(std::begin(entry.subobjects), std::end(entry.subobjects));
+    entry.subobjects.erase(std::unique(std::begin(entry.subobjects), std::end(entry.subobjects)), std::end(entry.subobjects));
+}
+
+struct TextChunk {
+    std::size_t firstObject;
+    std::size_t lastObject;
+    std::vector<MergelistEntry> entries;
+    std::string error;
+};
+
+// lineStarts has 4 entries per object, textEnd excludes a final '\n'
+void parseTextChunk(TextChunk & chunk, const std::vector<const char *> & lineStarts, const char * textEnd) {
+    const auto lineEnd = [&lineStarts, textEnd](const std::size_t line){
+        return line + 1 < lineStarts.size() ? lineStarts[line + 1] - 1 : textEnd;// without '\n'
+    };
+    try {
+        chunk.entries.reserve(chunk.lastObject - chunk.firstObject);
+        for (auto object = chunk.firstObject; object < chunk.lastObject; ++object) {
+            const auto line = 4 * object;
+            MergelistEntry entry;
+            LineReader idLine(lineStarts[line], lineEnd(line));
+            std::uint64_t subobjectId;
+            if (!idLine.read(entry.id) || !idLine.read(entry.todo) || !idLine.read(entry.immutable) || !idLine.read(subobjectId)) {
+                throw std::runtime_error("mergelistLoad parsing failed");
+            }
+            do {
+                entry.subobjects.emplace_back(subobjectId);
+            } while (idLine.read(subobjectId));
+            LineReader attributeLine(lineStarts[line + 1], lineEnd(line + 1));
+            if (!attributeLine.read(entry.location.x) || !attributeLine.read(entry.location.y) || !attributeLine.read(entry.location.z)) {
+                throw std::runtime_error("mergelistLoad parsing failed");
+            }
+            unsigned int r, g, b;
+            if (attributeLine.read(r) && attributeLine.read(g) && attributeLine.read(b)) {
+                entry.color = std::make_tuple(static_cast<std::uint8_t>(r), static_cast<std::uint8_t>(g), static_cast<std::uint8_t>(b));
+            }
+            entry.category = textLine(lineStarts[line + 2], lineEnd(line + 2));
+            entry.comment = textLine(lineStarts[line + 3], lineEnd(line + 3));
+            sortSubobjects(entry);
+            chunk.entries.emplace_back(std::move(entry));
+        }
+    } catch (const std::exception & e) {// QtConcurrent only forwards QExceptions
+        chunk.error = e.what();
+    }
+}
+
+class BinaryReader {
+    const char * pos;
+    const char * const end;
+
+public:
+    BinaryReader(const QByteArray & data) : pos(data.constData()), end(data.constData() + data.size()) {}
+
+    const char * bytes(const std::size_t count) {
+        if (static_cast<std::size_t>(end - pos) < count) {
+            throw std::runtime_error("mergelist.bin is truncated");
+        }
+        const auto begin = pos;
+        pos += count;
+        return begin;
+    }
+
+    std::uint8_t byte() {
+        return static_cast<std::uint8_t>(*bytes(1));
+    }
+
+    std::uint64_t varint() {
+        std::uint64_t value{0};
+        for (int shift = 0; shift < 64; shift += 7) {
+            const auto next = byte();
+            value |= static_cast<std::uint64_t>(next & 0x7f) << shift;
+            if ((next & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw std::runtime_error("mergelist.bin contains an overlong number");
+    }
+
+    std::int64_t zigzag() {
+        const auto value = varint();
+        return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+    }
+
+    std::size_t count(const std::size_t minimumBytesPerElement) {// guards reserve against corrupt counts
+        const auto value = varint();
+        if (value > static_cast<std::uint64_t>(end - pos) / minimumBytesPerElement) {
+            throw std::runtime_error("mergelist.bin is truncated");
+        }
+        return value;
+    }
+};
+
+constexpr char binaryMagic[] = {'K', 'N', 'M', 'L'};
+constexpr std::uint8_t binaryVersion = 1;
+enum BinaryFlags : std::uint8_t {
+    HasTextChecksum = 1
+};
+enum BinaryObjectFlags : std::uint8_t {
+    Todo = 1, Immutable = 2, HasColor = 4
+};
+
+}
+
+std::vector<MergelistEntry> mergelistParseText(const QByteArray & data) {
+    std::vector<const char *> lineStarts;
+    lineStarts.reserve(4 * 1024);
+    const auto * pos = data.constData();
+    const auto * const end = pos + data.size();
+    while (pos != end) {
+        lineStarts.emplace_back(pos);
+        const auto * newline = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+        pos = newline != nullptr ? newline + 1 : end;
+    }
+    if (lineStarts.size() % 4 != 0) {
+        throw std::runtime_error("mergelistLoad parsing failed");
+    }
+    const auto * const textEnd = data.endsWith('\n') ? end - 1 : end;
+    const auto objectCount = lineStarts.size() / 4;
+    const std::size_t minChunkObjects = 1024;
+    const auto chunkCount = std::max<std::size_t>(1, std::min<std::size_t>(objectCount / minChunkObjects, 8 * QThread::idealThreadCount()));
+    std::vector<TextChunk> chunks(chunkCount);
+    for (std::size_t i = 0; i < chunkCount; ++i) {
+        chunks[i].firstObject = objectCount * i / chunkCount;
+        chunks[i].lastObject = objectCount * (i + 1) / chunkCount;
+    }
+    QtConcurrent::blockingMap(chunks, [&lineStarts, textEnd](TextChunk & chunk){
+        parseTextChunk(chunk, lineStarts, textEnd);
+    });
+    std::vector<MergelistEntry> entries;
+    entries.reserve(objectCount);
+    for (auto & chunk : chunks) {
+        if (!chunk.error.empty()) {
+            throw std::runtime_error(chunk.error);
+        }
+        std::move(std::begin(chunk.entries), std::end(chunk.entries), std::back_inserter(entries));
+    }
+    return entries;
+}
+
+std::vector<MergelistEntry> mergelistParseBinary(const QByteArray & data, boost::optional<quint32> & textChecksum) {
+    BinaryReader reader(data);
+    if (std::memcmp(reader.bytes(sizeof(binaryMagic)), binaryMagic, sizeof(binaryMagic)) != 0) {
+        throw std::runtime_error("mergelist.bin is not a binary mergelist");
+    }
+    if (const auto version = reader.byte(); version != binaryVersion) {
+        throw std::runtime_error("mergelist.bin has unsupported version " + std::to_string(version));
+    }
+    const auto flags = reader.byte();
+    textChecksum = boost::none;
+    if (flags & HasTextChecksum) {
+        const auto * checksum = reinterpret_cast<const unsigned char *>(reader.bytes(4));
+        textChecksum = checksum[0] | checksum[1] << 8 | checksum[2] << 16 | static_cast<quint32>(checksum[3]) << 24;
+    }
+    std::vector<QString> strings(reader.count(1));
+    for (auto & string : strings) {
+        const auto size = reader.count(1);
+        string = QString::fromUtf8(reader.bytes(size), static_cast<int>(size));
+    }
+    const auto string = [&reader, &strings]() -> const QString & {
+        const auto index = reader.varint();
+        if (index >= strings.size()) {
+            throw std::runtime_error("mergelist.bin references a missing string");
+        }
+        return strings[index];
+    };
+    std::vector<MergelistEntry> entries(reader.count(8));// every object needs at least 8 bytes
+    for (auto & entry : entries) {
+        entry.id = reader.varint();
+        const auto objectFlags = reader.byte();
+        entry.todo = objectFlags & Todo;
+        entry.immutable = objectFlags & Immutable;
+        for (auto * component : {&entry.location.x, &entry.location.y, &entry.location.z}) {
+            const auto value = reader.zigzag();
+            if (value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max()) {
+                throw std::runtime_error("mergelist.bin contains an invalid location");
+            }
+            *component = static_cast<int>(value);
+        }
+        if (objectFlags & HasColor) {
+            const auto * rgb = reinterpret_cast<const std::uint8_t *>(reader.bytes(3));
+            entry.color = std::make_tuple(rgb[0], rgb[1], rgb[2]);
+        }
+        entry.category = string();
+        entry.comment = string();
+        entry.subobjects.resize(reader.count(1));
+        if (entry.subobjects.empty()) {
+            throw std::runtime_error("mergelist.bin contains object " + std::to_string(entry.id) + " without subobjects");
+        }
+        std::uint64_t id{0};
+        for (std::size_t i = 0; i < entry.subobjects.size(); ++i) {
+            const auto gap = reader.varint();
+            const auto previous = id;
+            id = i == 0 ? gap : id + gap + 1;
+            if (i != 0 && id <= previous) {
+                throw std::runtime_error("mergelist.bin contains an invalid subobject id");
+            }
+            entry.subobjects[i] = id;
+        }
+    }
+    return entries;
+}
+
+void MergelistTextWriter::appendNumber(const std::uint64_t value) {
+    char buffer[24];
+    const auto result = std::to_chars(std::begin(buffer), std::end(buffer), value);
+    data.append(buffer, static_cast<int>(result.ptr - buffer));
+}
+
+void MergelistTextWriter::appendNumber(const std::int64_t value) {
+    char buffer[24];
+    const auto result = std::to_chars(std::begin(buffer), std::end(buffer), value);
+    data.append(buffer, static_cast<int>(result.ptr - buffer));
+}
+
+void MergelistTextWriter::addAttributes(const MergelistEntry & object) {
+    for (const auto component : {object.location.x, object.location.y, object.location.z}) {
+        appendNumber(static_cast<std::int64_t>(component));
+        data += ' ';
+    }
+    if (object.color) {
+        appendNumber(static_cast<std::uint64_t>(std::get<0>(object.color.get())));
+        data += ' ';
+        appendNumber(static_cast<std::uint64_t>(std::get<1>(object.color.get())));
+        data += ' ';
+        appendNumber(static_cast<std::uint64_t>(std::get<2>(object.color.get())));
+    }
+    data += '\n';
+    data += object.category.toUtf8();
+    data += '\n';
+    data += object.comment.toUtf8();
+    data += '\n';
+}
+
+QByteArray MergelistTextWriter::finish() {
+    return std::move(data);
+}
+
+std::uint64_t MergelistBinaryWriter::stringIndex(const QString & string) {
+    const auto it = stringIndices.find(string);
+    if (it != std::end(stringIndices)) {
+        return it.value();
+    }
+    strings.append(string);
+    return stringIndices[string] = strings.size() - 1;
+}
+
+void MergelistBinaryWriter::appendVarint(QByteArray & out, std::uint64_t value) const {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+void MergelistBinaryWriter::addAttributes(const MergelistEntry & object) {
+    ++objectCount;
+    appendVarint(body, object.id);
+    body += static_cast<char>((object.todo ? Todo : 0) | (object.immutable ? Immutable : 0) | (object.color ? HasColor : 0));
+    for (const auto component : {object.location.x, object.location.y, object.location.z}) {
+        const auto value = static_cast<std::int64_t>(component);
+        appendVarint(body, (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63));
+    }
+    if (object.color) {
+        body += static_cast<char>(std::get<0>(object.color.get()));
+        body += static_cast<char>(std::get<1>(object.color.get()));
+        body += static_cast<char>(std::get<2>(object.color.get()));
+    }
+    appendVarint(body, stringIndex(object.category));
+    appendVarint(body, stringIndex(object.comment));
+}
+
+void MergelistBinaryWriter::addSubobjects(const std::vector<std::uint64_t> & ids) {
+    appendVarint(body, ids.size());
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+        appendVarint(body, i == 0 ? ids[i] : ids[i] - ids[i - 1] - 1);
+    }
+}
+
+QByteArray MergelistBinaryWriter::finish(const boost::optional<quint32> textChecksum) {
+    QByteArray data(binaryMagic, sizeof(binaryMagic));
+    data += static_cast<char>(binaryVersion);
+    data += static_cast<char>(textChecksum ? HasTextChecksum : 0);
+    if (textChecksum) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            data += static_cast<char>(textChecksum.get() >> shift & 0xff);
+        }
+    }
+    appendVarint(data, strings.size());
+    for (const auto & string : strings) {
+        const auto utf8 = string.toUtf8();
+        appendVarint(data, utf8.size());
+        data += utf8;
+    }
+    appendVarint(data, objectCount);
+    data.reserve(data.size() + body.size());
+    data += body;
+    body.clear();
+    return data;
+}
@@ -0,0 +1,136 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+
+#ifndef MERGELIST_H
+#define MERGELIST_H
+
+#include "coordinate.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+#include <algorithm>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+/**
+ * Everything a mergelist stores about one object,
+ * subobjects are sorted and free of duplicates.
+ */
+struct MergelistEntry {
+    std::uint64_t id;
+    bool todo;
+    bool immutable;
+    std::vector<std::uint64_t> subobjects;
+    Coordinate location;
+    boost::optional<std::tuple<std::uint8_t, std::uint8_t, std::uint8_t>> color;
+    QString category;
+    QString comment;
+};
+
+/**
+ * Text mergelist, 4 lines per object:
+ *   id todo immutable subobject…
+ *   x y z [r g b]
+ *   category
+ *   comment
+ * Objects are parsed in chunks on the global thread pool.
+ * Throws std::runtime_error on malformed input.
+ */
+std::vector<MergelistEntry> mergelistParseText(const QByteArray & data);
+
+/**
+ * Binary mergelist (mergelist.bin in annotation files), little endian varints:
+ *   "KNML" version flags [crc32 of the accompanying mergelist.txt]
+ *   string count, strings (byte count + utf-8)
+ *   object count, objects:
+ *     id, flags (todo, immutable, color), zigzag x y z, [r g b],
+ *     category string index, comment string index,
+ *     subobject count, first subobject id, then gaps to the previous id minus one
+ * textChecksum is set if the file recorded one.
+ */
+std::vector<MergelistEntry> mergelistParseBinary(const QByteArray & data, boost::optional<quint32> & textChecksum);
+
+/**
+ * Writers take the object attributes from an entry and its subobjects from any range,
+ * subobjectId maps range elements to ids.
+ */
+class MergelistTextWriter {
+    QByteArray data;
+
+    void appendNumber(const std::uint64_t value);
+    void appendNumber(const std::int64_t value);
+    void addAttributes(const MergelistEntry & object);
+
+public:
+    template<typename SubobjectRange, typename SubobjectId>
+    void add(const MergelistEntry & object, const SubobjectRange & subobjects, SubobjectId && subobjectId) {
+        appendNumber(object.id);
+        data += ' ';
+        data += object.todo ? '1' : '0';
+        data += ' ';
+        data += object.immutable ? '1' : '0';
+        for (const auto & subobject : subobjects) {
+            data += ' ';
+            appendNumber(static_cast<std::uint64_t>(subobjectId(subobject)));
+        }
+        data += '\n';
+        addAttributes(object);
+    }
+    QByteArray finish();
+};
+
+class MergelistBinaryWriter {
+    QByteArray body;
+    QHash<QString, std::uint64_t> stringIndices;
+    QStringList strings;
+    std::uint64_t objectCount{0};
+    std::vector<std::uint64_t> sortedIds;
+
+    std::uint64_t stringIndex(const QString & string);
+    void appendVarint(QByteArray & out, std::uint64_t value) const;
+    void addAttributes(const MergelistEntry & object);
+    void addSubobjects(const std::vector<std::uint64_t> & ids);
+
+public:
+    template<typename SubobjectRange, typename SubobjectId>
+    void add(const MergelistEntry & object, const SubobjectRange & subobjects, SubobjectId && subobjectId) {
+        addAttributes(object);
+        sortedIds.clear();
+        for (const auto & subobject : subobjects) {
+            sortedIds.emplace_back(subobjectId(subobject));
+        }
+        if (!std::is_sorted(std::begin(sortedIds), std::end(sortedIds))) {// gaps need ascending ids
+            std::sort(std::begin(sortedIds), std::end(sortedIds));
+        }
+        sortedIds.erase(std::unique(std::begin(sortedIds), std::end(sortedIds)), std::end(sortedIds));
+        addSubobjects(sortedIds);
+    }
+    QByteArray finish(const boost::optional<quint32> textChecksum);
+};
+
+#endif // MERGELIST_H
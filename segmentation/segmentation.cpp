@@ -27,14 +27,16 @@
 #include "session.h"
 #include "skeleton/skeletonizer.h"
 #include "stateInfo.h"
+#include "statistics.h"
+#include "undojournal.h"
 #include "viewer.h"
 
+#include <QDataStream>
 #include <QSignalBlocker>
 #include <QTextStream>
 
 #include <algorithm>
 #include <fstream>
-#include <sstream>
 #include <utility>
 
 uint64_t Segmentation::SubObject::highestId = 0;
@@ -96,6 +98,13 @@ Segmentation & Segmentation::singleton() {
 }
 
 Segmentation::Segmentation() {
+    //selection changes invalidate only the subobjects of the (un)selected object, see selectObject
+    for (auto signal : {&Segmentation::appendedRow, &Segmentation::removedRow, &Segmentation::resetData}) {
+        QObject::connect(this, signal, this, static_cast<void(Segmentation::*)() const>(&Segmentation::invalidateSubobjectCache));
+    }
+    QObject::connect(this, &Segmentation::changedRow, this, static_cast<void(Segmentation::*)() const>(&Segmentation::invalidateSubobjectCache));
+    QObject::connect(this, &Segmentation::renderOnlySelectedObjsChanged, this, static_cast<void(Segmentation::*)() const>(&Segmentation::invalidateSubobjectCache));
+    QObject::connect(this, &Segmentation::backgroundIdChanged, this, static_cast<void(Segmentation::*)() const>(&Segmentation::invalidateSubobjectCache));
     loadOverlayLutFromFile();
 }
 
@@ -108,6 +117,7 @@ void Segmentation::clear() {
         //dispatch to loader thread, original cubes are reloaded automatically
         QTimer::singleShot(0, Loader::Controller::singleton().worker.get(), &Loader::Worker::snappyCacheClear);
     }
+    SegmentationStatistics::singleton().clear();
     mergelistClear();
 }
 
@@ -118,6 +128,7 @@ std::tuple<uint8_t, uint8_t, uint8_t, uint8_t> Segmentation::subobjectColor(cons
 
 void Segmentation::loadOverlayLutFromFile(const QString & path) {
     overlayColorMap = loadLookupTable(path);
+    invalidateSubobjectCache();//all default colors changed, receivers of resetData must not see stale entries
     emit resetData();
 }
 
@@ -127,8 +138,10 @@ bool Segmentation::hasObjects() const {
 
 void Segmentation::createAndSelectObject(const Coordinate & position) {
     clearObjectSelection();
-    auto & newObject = createObjectFromSubobjectId(SubObject::highestId + 1, position);
-    selectObject(newObject);
+    journalObjectChanges([this, &position](){
+        auto & newObject = createObjectFromSubobjectId(SubObject::highestId + 1, position);
+        selectObject(newObject);
+    });
 }
 
 Segmentation::Object & Segmentation::createObjectFromSubobjectId(const uint64_t initialSubobjectId, const Coordinate & location, uint64_t objectId, const bool todo, const bool immutable) {
@@ -268,6 +281,62 @@ std::tuple<uint8_t, uint8_t, uint8_t, uint8_t> Segmentation::colorObjectFromSubo
     return colorObjectFromIndex(largestObjectContainingSubobject(subobject));
 }
 
+const SubobjectCache::Entry & Segmentation::cachedSubobject(const uint64_t subObjectID) const {
+    if (subobjectCacheAlpha != alpha) {//alpha is assigned directly from the outside
+        subobjectCacheAlpha = alpha;
+        subobjectCache.invalidate();
+    }
+    return subobjectCache.get(subObjectID, [this](const uint64_t id){
+        const auto it = subobjects.find(id);
+        const auto found = it != std::end(subobjects);
+        return SubobjectCache::Entry{colorObjectFromSubobjectId(id), found && isSelected(it->second), found ? largestObjectContainingSubobject(it->second) : 0};
+    });
+}
+
+void Segmentation::invalidateSubobjectCache() const {
+    subobjectCache.invalidate();
+}
+
+void Segmentation::invalidateSubobjectCache(const Object & object) const {
+    std::vector<std::uint64_t> ids;
+    ids.reserve(object.subobjects.size());
+    for (const auto & subobject : object.subobjects) {
+        ids.emplace_back(subobject.get().id);
+    }
+    subobjectCache.invalidate(ids);
+}
+
+std::uint64_t Segmentation::subobjectCacheGeneration() const {
+    return subobjectCache.generation();
+}
+
+bool Segmentation::subobjectsChangedSince(const std::uint64_t generation, std::vector<std::uint64_t> & ids) const {
+    return subobjectCache.changedSince(generation, ids);
+}
+
+void Segmentation::markVolumeDirty() {
+    QMutexLocker locker(&volumeDirtyMutex);
+    volumeDirtyAll = true;
+    volumeDirtyPositions.clear();
+    volume_update_required = true;
+}
+
+void Segmentation::markVolumeDirty(const Coordinate & globalCoord) {
+    QMutexLocker locker(&volumeDirtyMutex);
+    if (!volumeDirtyAll) {
+        volumeDirtyPositions.emplace_back(globalCoord);
+    }
+    volume_update_required = true;
+}
+
+void Segmentation::markVolumeDirty(const std::vector<Coordinate> & globalCoords) {
+    QMutexLocker locker(&volumeDirtyMutex);
+    if (!volumeDirtyAll) {
+        volumeDirtyPositions.insert(std::end(volumeDirtyPositions), std::begin(globalCoords), std::end(globalCoords));
+    }
+    volume_update_required = true;
+}
+
 bool Segmentation::subobjectExists(const uint64_t & subobjectId) const {
     auto it = subobjects.find(subobjectId);
     return it != std::end(subobjects);
@@ -389,6 +458,7 @@ void Segmentation::selectObject(Object & object) {
     for (auto & subobj : object.subobjects) {
         ++subobj.get().selectedObjectsCount;
     }
+    invalidateSubobjectCache(object);
     selectedObjectIndices.emplace_back(object.index);
     emit changedRowSelection(object.index);
 }
@@ -407,6 +477,7 @@ void Segmentation::unselectObject(Object & object) {
     for (auto & subobj : object.subobjects) {
         --subobj.get().selectedObjectsCount;
     }
+    invalidateSubobjectCache(object);
     selectedObjectIndices.erase(object.index);
     emit changedRowSelection(object.index);
 }
@@ -535,8 +606,9 @@ std::size_t Segmentation::selectedObjectsCount() const {
 }
 
 void Segmentation::mergelistSave(QIODevice & file) const {
-    QTextStream stream(&file);
-    mergelistSave(stream);
+    if (file.write(mergelistText()) == -1) {
+        qDebug() << "mergelistSave fail";
+    }
 }
 
 void Segmentation::mergelistClear() {
@@ -556,76 +628,96 @@ void Segmentation::mergelistClear() {
     emit resetTouchedObjects();
 }
 
-void Segmentation::mergelistSave(QTextStream & stream) const {
+template<typename Writer>
+void Segmentation::mergelistWrite(Writer & writer) const {
+    MergelistEntry entry;
     for (const auto & obj : objects) {
-        stream << obj.id << ' ' << obj.todo << ' ' << obj.immutable;
-        for (const auto & subObj : obj.subobjects) {
-            stream << ' ' << subObj.get().id;
-        }
-        stream << '\n';
-        stream << obj.location.x << ' ' << obj.location.y << ' ' << obj.location.z << ' ';
-        if (obj.color) {
-            stream << std::get<0>(obj.color.get()) << ' ' << std::get<1>(obj.color.get()) << ' ' << std::get<2>(obj.color.get()) << '\n';
-        } else {
-            stream << '\n';
-        }
-        stream << obj.category << '\n';
-        stream << obj.comment << '\n';
+        entry.id = obj.id;
+        entry.todo = obj.todo;
+        entry.immutable = obj.immutable;
+        entry.location = obj.location;
+        entry.color = obj.color;
+        entry.category = obj.category;
+        entry.comment = obj.comment;
+        writer.add(entry, obj.subobjects, [](const SubObject & subobject){ return subobject.id; });
     }
+}
+
+QByteArray Segmentation::mergelistText() const {
+    MergelistTextWriter writer;
+    mergelistWrite(writer);
+    return writer.finish();
+}
+
+QByteArray Segmentation::mergelistBinary(const boost::optional<quint32> textChecksum) const {
+    MergelistBinaryWriter writer;
+    mergelistWrite(writer);
+    return writer.finish(textChecksum);
+}
+
+void Segmentation::mergelistSave(QTextStream & stream) const {
+    stream << QString::fromUtf8(mergelistText());
     if (stream.status() != QTextStream::Ok) {
         qDebug() << "mergelistSave fail";
     }
 }
 
 void Segmentation::mergelistLoad(QIODevice & file) {
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    if (!file.open(QIODevice::ReadOnly)) {
         throw std::runtime_error("mergelistLoad open failed");
     }
-    QTextStream stream(&file);
-    mergelistLoad(stream);
+    mergelistLoad(mergelistParseText(file.readAll()));
 }
 
 void Segmentation::mergelistLoad(QTextStream & stream) {
-    QString line;
-    {
-        QSignalBlocker blocker{this};
-        while (!(line = stream.readLine()).isNull()) {
-            std::istringstream lineStream(line.toStdString());
-            std::istringstream coordColorLineStream(stream.readLine().toStdString());
-
-            uint64_t objId;
-            bool todo;
-            bool immutable;
-            Coordinate location;
-            uint r; uint g; uint b;
-            uint64_t initialVolume;
-            QString category;
-            QString comment;
-
-            bool valid0 = (lineStream >> objId) && (lineStream >> todo) && (lineStream >> immutable) && (lineStream >> initialVolume);
-            bool valid1 = (coordColorLineStream >> location.x) && (coordColorLineStream >> location.y) && (coordColorLineStream >> location.z);
-            bool customColorValid = (coordColorLineStream >> r) && (coordColorLineStream >> g) && (coordColorLineStream >> b);
-            bool valid2 = !(category = stream.readLine()).isNull();
-            bool valid3 = !(comment = stream.readLine()).isNull();
-
-            if (valid0 && valid1 && valid2 && valid3) {
-                auto & obj = createObjectFromSubobjectId(initialVolume, location, objId, todo, immutable);
-                uint64_t subObjId;
-                while (lineStream >> subObjId) {
-                    newSubObject(obj, subObjId);
-                }
-                std::sort(std::begin(obj.subobjects), std::end(obj.subobjects));
-                changeCategory(obj, category);
-                if (customColorValid) {
-                    changeColor(obj, std::make_tuple(r, g, b));
-                }
-                obj.comment = comment;
-            } else {
-                Segmentation::clear();
-                throw std::runtime_error("mergelistLoad parsing failed");
-            }
+    mergelistLoad(mergelistParseText(stream.readAll().toUtf8()));
+}
+
+bool Segmentation::mergelistLoadBinary(QIODevice & file, const boost::optional<quint32> textChecksum) {
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "mergelistLoadBinary open failed, falling back to mergelist.txt";
+        return false;
+    }
+    boost::optional<quint32> writtenAlongside;
+    std::vector<MergelistEntry> entries;
+    try {// mergelist.bin is only a cache of mergelist.txt, nothing has been created from it yet
+        entries = mergelistParseBinary(file.readAll(), writtenAlongside);
+    } catch (const std::runtime_error & error) {
+        qDebug() << "mergelistLoadBinary failed, falling back to mergelist.txt:" << error.what();
+        return false;
+    }
+    if (textChecksum && textChecksum != writtenAlongside) {// the text mergelist was changed without us, e.g. by an older version
+        return false;
+    }
+    mergelistLoad(std::move(entries));
+    return true;
+}
+
+void Segmentation::mergelistLoad(std::vector<MergelistEntry> && entries) {
+    // entries are validated by the parsers, so construction cannot fail halfway
+    auto subobjectCount = subobjects.size();
+    for (const auto & entry : entries) {
+        subobjectCount += entry.subobjects.size();
+    }
+    subobjects.reserve(subobjectCount);
+    objects.reserve(objects.size() + entries.size());
+    objectIdToIndex.reserve(objects.size() + entries.size());
+    for (auto & entry : entries) {
+        const auto objectId = objectIdToIndex.find(entry.id) == std::end(objectIdToIndex) ? entry.id : ++Object::highestId;
+        objects.emplace_back(std::vector<std::reference_wrapper<SubObject>>{}, entry.location, objectId, entry.todo, entry.immutable);
+        auto & obj = objects.back();
+        objectIdToIndex[obj.id] = objects.size() - 1;
+        obj.subobjects.reserve(entry.subobjects.size());
+        for (const auto subobjectId : entry.subobjects) {
+            auto & subobject = subobjects.emplace(std::piecewise_construct, std::forward_as_tuple(subobjectId), std::forward_as_tuple(subobjectId)).first->second;
+            subobject.objects.emplace_back(obj.index);// the new object has the highest index, so parents stay sorted
+            obj.subobjects.emplace_back(subobject);
         }
-    }// QSignalBlocker
+        obj.category = std::move(entry.category);
+        categories.insert(obj.category);
+        obj.color = entry.color;
+        obj.comment = std::move(entry.comment);
+    }
     emit resetData();
 }
 
@@ -665,72 +757,175 @@ void Segmentation::startJobMode() {
 }
 
 void Segmentation::deleteSelectedObjects() {
-    {
+    journalObjectChanges([this](){
         QSignalBlocker blocker{this};
         while (!selectedObjectIndices.empty()) {
             removeObject(objects[selectedObjectIndices.back()]);
         }
-    }
+    });
     emit resetData();
 }
 
 void Segmentation::mergeSelectedObjects() {
-    while (selectedObjectIndices.size() > 1) {
-        auto & firstObj = objects[selectedObjectIndices.front()];//front is the merge origin
-        auto & secondObj = objects[selectedObjectIndices.back()];
-        //objects are no longer selected when they got merged
-        auto flat_deselect = [this](Object & object){
-            object.selected = false;
-            selectedObjectIndices.erase(object.index);
-            emit changedRowSelection(object.index);//deselect
-        };
-        //4 (im)mutability possibilities
-        if (secondObj.immutable && firstObj.immutable) {
-            flat_deselect(secondObj);
-            const auto firstIndex = firstObj.index;
-            const auto secondIndex = secondObj.index;
-
-            secondObj.todo = false;//secondObj will get invalidated
-            uint64_t newIndex = createObject(secondObj, firstObj).index;//create new object from merge result, invalidates firstObj and secondObj references since vector size changed
-
-            flat_deselect(objects[firstIndex]);//firstObj got invalidated
-            selectedObjectIndices.emplace_front(newIndex);//move new index to front, so it gets the new merge origin
-            emit changedRowSelection(firstIndex);
-            emit changedRowSelection(secondIndex);
-        } else if (secondObj.immutable) {
-            flat_deselect(secondObj);
-            firstObj.merge(secondObj);
-            secondObj.todo = false;
-            emit changedRowSelection(secondObj.index);
-            emit changedRow(firstObj.index);
-        } else if (firstObj.immutable) {
-            flat_deselect(firstObj);
-            secondObj.merge(firstObj);
-            firstObj.todo = false;
-            emit changedRowSelection(firstObj.index);
-            emit changedRow(secondObj.index);
-        } else {//if both are mutable the second object is merged into the first
-            flat_deselect(secondObj);
-            firstObj.merge(secondObj);
-            secondObj.todo = false;
-            emit changedRow(firstObj.index);
-            removeObject(secondObj);
+    journalObjectChanges([this](){
+        while (selectedObjectIndices.size() > 1) {
+            auto & firstObj = objects[selectedObjectIndices.front()];//front is the merge origin
+            auto & secondObj = objects[selectedObjectIndices.back()];
+            //objects are no longer selected when they got merged
+            auto flat_deselect = [this](Object & object){
+                object.selected = false;
+                invalidateSubobjectCache(object);
+                selectedObjectIndices.erase(object.index);
+                emit changedRowSelection(object.index);//deselect
+            };
+            //4 (im)mutability possibilities
+            if (secondObj.immutable && firstObj.immutable) {
+                flat_deselect(secondObj);
+                const auto firstIndex = firstObj.index;
+                const auto secondIndex = secondObj.index;
+
+                secondObj.todo = false;//secondObj will get invalidated
+                uint64_t newIndex = createObject(secondObj, firstObj).index;//create new object from merge result, invalidates firstObj and secondObj references since vector size changed
+
+                flat_deselect(objects[firstIndex]);//firstObj got invalidated
+                selectedObjectIndices.emplace_front(newIndex);//move new index to front, so it gets the new merge origin
+                emit changedRowSelection(firstIndex);
+                emit changedRowSelection(secondIndex);
+            } else if (secondObj.immutable) {
+                flat_deselect(secondObj);
+                firstObj.merge(secondObj);
+                secondObj.todo = false;
+                emit changedRowSelection(secondObj.index);
+                emit changedRow(firstObj.index);
+            } else if (firstObj.immutable) {
+                flat_deselect(firstObj);
+                secondObj.merge(firstObj);
+                firstObj.todo = false;
+                emit changedRowSelection(firstObj.index);
+                emit changedRow(secondObj.index);
+            } else {//if both are mutable the second object is merged into the first
+                flat_deselect(secondObj);
+                firstObj.merge(secondObj);
+                secondObj.todo = false;
+                emit changedRow(firstObj.index);
+                removeObject(secondObj);
+            }
+            emit todosLeftChanged();
+            emit merged(firstObj.id, secondObj.id);
         }
-        emit todosLeftChanged();
-        emit merged(firstObj.id, secondObj.id);
-    }
+    });
 }
 
 void Segmentation::unmergeSelectedObjects(const Coordinate & clickPos) {
     if (selectedObjectIndices.size() == 1) {
         deleteSelectedObjects();
-    } else while (selectedObjectIndices.size() > 1) {
-        auto & objectToUnmerge = objects[selectedObjectIndices.back()];
-        unmergeObject(objects[selectedObjectIndices.front()], objectToUnmerge, clickPos);
-        unselectObject(objectToUnmerge);
-        objectToUnmerge.todo = true;
+    } else {
+        journalObjectChanges([this, &clickPos](){
+            while (selectedObjectIndices.size() > 1) {
+                auto & objectToUnmerge = objects[selectedObjectIndices.back()];
+                unmergeObject(objects[selectedObjectIndices.front()], objectToUnmerge, clickPos);
+                unselectObject(objectToUnmerge);
+                objectToUnmerge.todo = true;
+            }
+        });
+    }
+    emit todosLeftChanged();
+}
+
+template<typename Func>
+void Segmentation::journalObjectChanges(Func func) {
+    if (journalingObjects || !UndoJournal::singleton().recording()) {
+        func();
+        return;
     }
+    std::vector<uint64_t> ids;// only selected objects are touched, plus the ones created
+    for (const auto index : selectedObjectIndices) {
+        ids.emplace_back(objects[index].id);
+    }
+    const auto previousObjects = serializeObjects(ids);
+    const auto highestIdBefore = Object::highestId;
+    journalingObjects = true;
+    func();
+    journalingObjects = false;
+    for (auto id = highestIdBefore + 1; id <= Object::highestId; ++id) {
+        ids.emplace_back(id);
+    }
+    ids.erase(std::remove_if(std::begin(ids), std::end(ids), [this](const uint64_t id){
+        return objectIdToIndex.find(id) == std::end(objectIdToIndex);
+    }), std::end(ids));
+    UndoJournal::singleton().objectsChanged(ids, previousObjects);
+}
+
+QByteArray Segmentation::serializeObjects(const std::vector<uint64_t> & objectIds) const {
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    for (const auto id : objectIds) {
+        const auto indexIt = objectIdToIndex.find(id);
+        if (indexIt == std::end(objectIdToIndex)) {
+            continue;
+        }
+        const auto & obj = objects[indexIt->second];
+        const auto color = obj.color.get_value_or(std::tuple<uint8_t, uint8_t, uint8_t>{});
+        stream << static_cast<quint64>(obj.id) << obj.todo << obj.immutable << obj.selected
+               << static_cast<qint32>(obj.location.x) << static_cast<qint32>(obj.location.y) << static_cast<qint32>(obj.location.z)
+               << obj.category << obj.comment << static_cast<bool>(obj.color)
+               << std::get<0>(color) << std::get<1>(color) << std::get<2>(color)
+               << static_cast<quint32>(obj.subobjects.size());
+        for (const auto & subobject : obj.subobjects) {
+            stream << static_cast<quint64>(subobject.get().id);
+        }
+    }
+    return data;
+}
+
+std::vector<uint64_t> Segmentation::restoreObjects(const std::vector<uint64_t> & removeIds, const QByteArray & previousObjects) {
+    std::vector<uint64_t> restoredIds;
+    {
+        QSignalBlocker blocker{this};
+        auto remove = [this](const uint64_t id){
+            const auto indexIt = objectIdToIndex.find(id);
+            if (indexIt != std::end(objectIdToIndex)) {
+                removeObject(objects[indexIt->second]);
+            }
+        };
+        for (const auto id : removeIds) {
+            remove(id);
+        }
+        QDataStream stream(previousObjects);
+        while (!stream.atEnd()) {
+            quint64 id;
+            bool todo, immutable, selected, customColor;
+            qint32 x, y, z;
+            QString category, comment;
+            uint8_t r, g, b;
+            quint32 count;
+            stream >> id >> todo >> immutable >> selected >> x >> y >> z >> category >> comment >> customColor >> r >> g >> b >> count;
+            std::vector<std::reference_wrapper<SubObject>> objectSubobjects;
+            for (quint32 i = 0; i < count; ++i) {
+                quint64 subobjectId;
+                stream >> subobjectId;
+                objectSubobjects.emplace_back(subobjects.emplace(std::piecewise_construct, std::forward_as_tuple(subobjectId), std::forward_as_tuple(subobjectId)).first->second);
+            }
+            remove(id);
+            auto & obj = createObject(objectSubobjects, Coordinate{x, y, z}, id, todo, immutable);
+            obj.category = category;
+            categories.insert(category);
+            obj.comment = comment;
+            if (customColor) {
+                obj.color = std::make_tuple(r, g, b);
+            }
+            if (selected) {
+                selectObject(obj);
+            }
+            restoredIds.emplace_back(id);
+        }
+    }
+    Session::singleton().unsavedChanges = true;
+    emit categoriesChanged();
+    emit resetData();
+    emit resetSelection();
     emit todosLeftChanged();
+    return restoredIds;
 }
 
 void Segmentation::jumpToSelectedObject() {
@@ -755,6 +950,7 @@ void Segmentation::restoreDefaultColorForSelectedObjects() {
             auto & colormap = Segmentation::singleton().overlayColorMap;
             auto & obj = objects[index];
             obj.color = colormap[obj.id % colormap.size()];
+            invalidateSubobjectCache(obj);
         }
         emit resetData();
     }
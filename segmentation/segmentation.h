@@ -25,10 +25,14 @@
 
 #include "coordinate.h"
 #include "hash_list.h"
+#include "mergelist.h"
 #include "segmentationsplit.h"
+#include "subobjectcache.h"
 
+#include <QByteArray>
 #include <QColor>
 #include <QDebug>
+#include <QMutex>
 #include <QSet>
 #include <QString>
 #include <QObject>
@@ -55,7 +59,9 @@ Q_OBJECT
     friend class CategoryDelegate;
     friend class CategoryModel;
     friend class SegmentationView;
+    friend class SegmentationStatistics;
     friend class SegmentationProxy;
+    friend class UndoJournal;
 
     class Object;
     class SubObject {
@@ -135,6 +141,10 @@ Q_OBJECT
     // The colors should be "maximally different".
     std::vector<std::tuple<uint8_t, uint8_t, uint8_t>> overlayColorMap;
 
+    // per subobject rendering info for the slicers, invalidated by the change signals below
+    mutable SubobjectCache subobjectCache;
+    mutable uint8_t subobjectCacheAlpha{0};
+
     Object & createObjectFromSubobjectId(const uint64_t initialSubobjectId, const Coordinate & location, uint64_t objectId = ++Object::highestId, const bool todo = false, const bool immutable = false);
     template<typename... Args>
     Object & createObject(Args && ... args);
@@ -149,6 +159,17 @@ Q_OBJECT
     void unmergeObject(Object & object, Object & other, const Coordinate & position);
 
     Object & objectFromSubobject(Segmentation::SubObject & subobject, const Coordinate & position);
+
+    template<typename Writer>
+    void mergelistWrite(Writer & writer) const;
+    void mergelistLoad(std::vector<MergelistEntry> && entries);
+
+    // undo support: state of the given objects before func ran, restorable with restoreObjects
+    bool journalingObjects{false};
+    template<typename Func>
+    void journalObjectChanges(Func func);
+    QByteArray serializeObjects(const std::vector<uint64_t> & objectIds) const;
+    std::vector<uint64_t> restoreObjects(const std::vector<uint64_t> & removeIds, const QByteArray & previousObjects);
 public:
     class Job {
     public:
@@ -189,11 +210,22 @@ public:
     std::tuple<uint8_t, uint8_t, uint8_t, uint8_t> colorOfSelectedObject() const;
     std::tuple<uint8_t, uint8_t, uint8_t, uint8_t> colorOfSelectedObject(const SubObject & subobject) const;
     std::tuple<uint8_t, uint8_t, uint8_t, uint8_t> colorObjectFromSubobjectId(const uint64_t subObjectID) const;
+    // cached color, selection and largest object of a subobject (gui thread only)
+    const SubobjectCache::Entry & cachedSubobject(const uint64_t subObjectID) const;
+    void invalidateSubobjectCache() const;
+    void invalidateSubobjectCache(const Object & object) const;// only its subobjects changed
+    std::uint64_t subobjectCacheGeneration() const;
+    // appends the subobjects whose cached info changed after generation, false if all may have changed
+    bool subobjectsChangedSince(const std::uint64_t generation, std::vector<std::uint64_t> & ids) const;
     //volume rendering
     bool volume_render_toggle = false;
     std::atomic_bool volume_update_required{false};
-    uint volume_tex_id = 0;
-    int volume_tex_len = 128;
+    QMutex volumeDirtyMutex;
+    bool volumeDirtyAll{true};
+    std::vector<Coordinate> volumeDirtyPositions;// global coordinates of changed cubes
+    void markVolumeDirty();
+    void markVolumeDirty(const Coordinate & globalCoord);
+    void markVolumeDirty(const std::vector<Coordinate> & globalCoords);
     int volume_mouse_move_x = 0;
     int volume_mouse_move_y = 0;
     float volume_mouse_zoom = 1.0f;
@@ -240,8 +272,13 @@ public:
     void mergelistClear();
     void mergelistSave(QIODevice & file) const;
     void mergelistSave(QTextStream & stream) const;
+    QByteArray mergelistText() const;
+    // textChecksum: crc32 of the mergelistText saved alongside
+    QByteArray mergelistBinary(const boost::optional<quint32> textChecksum) const;
     void mergelistLoad(QIODevice & file);
     void mergelistLoad(QTextStream & stream);
+    // returns false without loading if the file was not written alongside a text mergelist with textChecksum
+    bool mergelistLoadBinary(QIODevice & file, const boost::optional<quint32> textChecksum);
     void loadOverlayLutFromFile(const QString & filename = ":/resources/color_palette/default.json");
 signals:
     void beforeAppendRow();
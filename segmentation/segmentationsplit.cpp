@@ -22,89 +22,69 @@
 
 #include "segmentationsplit.h"
 
+#include "connectedcomponents.h"
 #include "coordinate.h"
 #include "cubeloader.h"
+#include "floodfill.h"
 #include "loader.h"
 #include "segmentation.h"
 
+#include <unordered_map>
 #include <unordered_set>
 
-void subobjectBucketFill(const Coordinate & seed, const Coordinate & center, const uint64_t fillsoid, const brush_t & brush, const Coordinate & areaMin, const Coordinate & areaMax) {
-    std::vector<Coordinate> work = {seed};
-    std::unordered_set<Coordinate> visitedVoxels;
-
-    const auto clickedsoid = readVoxel(seed);
-
-    while (!work.empty()) {
-        const auto pos = work.back();
-        work.pop_back();
-
-        if (readVoxel(pos) == clickedsoid) {
-            const auto walk = [&center, &visitedVoxels, &work](const auto x, const auto y, const auto z){
-                const bool wasntVisitedBefore = visitedVoxels.emplace(x, y, z).second;
-                if (wasntVisitedBefore && currentlyVisibleWrapWrap(center, {x, y, z})) {
-                    work.emplace_back(x, y, z);
-                }
-            };
-
-            const auto posDec = (pos - 1).capped(areaMin, areaMax);
-            const auto posInc = (pos + 1).capped(areaMin, areaMax);
-
-            if (brush.view != brush_t::view_t::zy || brush.mode == brush_t::mode_t::three_dim) {
-                walk(posInc.x, pos.y, pos.z);
-                walk(posDec.x, pos.y, pos.z);
-            }
-            if (brush.view != brush_t::view_t::xz || brush.mode == brush_t::mode_t::three_dim) {
-                walk(pos.x, posInc.y, pos.z);
-                walk(pos.x, posDec.y, pos.z);
-            }
-            if (brush.view != brush_t::view_t::xy || brush.mode == brush_t::mode_t::three_dim) {
-                walk(pos.x, pos.y, posInc.z);
-                walk(pos.x, pos.y, posDec.z);
+namespace {
+// whether a subobject id belongs to the object, memoised as neighbouring voxels mostly share their id
+auto partOfObject(const uint64_t objectIndex, const uint64_t excludedSubobjectId, const Coordinate & location) {
+    return [objectIndex, excludedSubobjectId, location, known = std::unordered_map<uint64_t, bool>{}, lastId = uint64_t{0}, lastResult = false](const uint64_t subobjectId, const Coordinate &) mutable {
+        if (subobjectId == Segmentation::singleton().getBackgroundId() || subobjectId == excludedSubobjectId) {
+            return false;
+        }
+        if (subobjectId != lastId || known.empty()) {
+            auto it = known.find(subobjectId);
+            if (it == std::end(known)) {
+                auto & subobject = Segmentation::singleton().subobjectFromId(subobjectId, location);
+                it = known.emplace(subobjectId, Segmentation::singleton().largestObjectContainingSubobject(subobject) == objectIndex).first;
             }
-        } else {
-            visitedVoxels.erase(pos);
+            lastId = subobjectId;
+            lastResult = it->second;
         }
-    }
+        return lastResult;
+    };
+}
+}
 
-    listFill(center, brush, fillsoid, visitedVoxels);
+void subobjectBucketFill(const Coordinate & seed, const Coordinate & center, const uint64_t fillsoid, const brush_t & brush, const Coordinate & areaMin, const Coordinate & areaMax) {
+    int axes = 0;
+    if (brush.view != brush_t::view_t::zy || brush.mode == brush_t::mode_t::three_dim) {
+        axes |= FloodFill::X;
+    }
+    if (brush.view != brush_t::view_t::xz || brush.mode == brush_t::mode_t::three_dim) {
+        axes |= FloodFill::Y;
+    }
+    if (brush.view != brush_t::view_t::xy || brush.mode == brush_t::mode_t::three_dim) {
+        axes |= FloodFill::Z;
+    }
+    const auto clickedsoid = readVoxel(seed);
+    const auto region = getRegion(center, brush);
+    FloodFill(areaMin, areaMax, axes).fill(seed, [&center, clickedsoid](const uint64_t value, const Coordinate & pos){
+        return value == clickedsoid && currentlyVisibleWrapWrap(center, pos);
+    }, [&region, fillsoid](const uint64_t value, const Coordinate & pos){
+        const bool inside = pos.x >= region.first.x && pos.y >= region.first.y && pos.z >= region.first.z
+                && pos.x <= region.second.x && pos.y <= region.second.y && pos.z <= region.second.z;
+        return inside ? fillsoid : value;
+    });
 }
 
 std::unordered_set<uint64_t> bucketFill(const Coordinate & seed, const uint64_t objIndexToSplit, const uint64_t newSubObjId, const std::unordered_set<uint64_t> & subObjectsToFill) {
-    std::vector<Coordinate> work = {seed};
-    std::unordered_set<Coordinate> visitedVoxels;
     std::unordered_set<uint64_t> visitedSubObjects;
-    while (!work.empty()) {
-        auto pos = work.back();
-        work.pop_back();
-
-        auto subobjectId = readVoxel(pos);
-        if (subobjectId != Segmentation::singleton().getBackgroundId() && subobjectId != newSubObjId) {
-            auto & subobject = Segmentation::singleton().subobjectFromId(subobjectId, seed);
-            auto objIndex = Segmentation::singleton().largestObjectContainingSubobject(subobject);
-            if (objIndex == objIndexToSplit) {
-                if (subObjectsToFill.find(subobjectId) != std::end(subObjectsToFill)) {
-                    //only write to cubes which were hit by the splitting plane
-                    writeVoxel(pos, newSubObjId);//write to cube
-                } else {
-                    visitedSubObjects.emplace(subobject.id);//accumulate visited subobjects
-                }
-
-                visitedVoxels.emplace(pos.x, pos.y, pos.z);
-                auto walk = [&](const Coordinate & newPos){
-                    if (visitedVoxels.find(newPos) == std::end(visitedVoxels)) {
-                        work.emplace_back(newPos);
-                    }
-                };
-                walk({pos.x + 1, pos.y, pos.z});
-                walk({pos.x - 1, pos.y, pos.z});
-                walk({pos.x, pos.y + 1, pos.z});
-                walk({pos.x, pos.y - 1, pos.z});
-                walk({pos.x, pos.y, pos.z + 1});
-                walk({pos.x, pos.y, pos.z - 1});
-            }
+    FloodFill().fill(seed, partOfObject(objIndexToSplit, newSubObjId, seed), [&](const uint64_t subobjectId, const Coordinate &){
+        if (subObjectsToFill.find(subobjectId) != std::end(subObjectsToFill)) {
+            //only write to cubes which were hit by the splitting plane
+            return newSubObjId;
         }
-    }
+        visitedSubObjects.emplace(subobjectId);//accumulate visited subobjects
+        return subobjectId;
+    });
     return visitedSubObjects;
 }
 
@@ -116,9 +96,14 @@ void connectedComponent(const Coordinate & seed) {
         auto newSubObjId = Segmentation::SubObject::highestId + 1;
         auto newObjectIndex = Segmentation::singleton().createObjectFromSubobjectId(newSubObjId, seed).index;
 
-        std::unordered_set<uint64_t> subObjectsToFill = {subobjectId};
-
-        std::unordered_set<uint64_t> visitedSubObjects = bucketFill({seed.x + 1, seed.y, seed.z}, splitIndex, newSubObjId, subObjectsToFill);
+        //voxels of subobjects whose largest object is the split one, resolved once per subobject instead of per voxel
+        std::unordered_set<uint64_t> members;
+        for (const auto & elem : Segmentation::singleton().objects[splitIndex].subobjects) {
+            if (elem.get().id != Segmentation::singleton().getBackgroundId() && Segmentation::singleton().largestObjectContainingSubobject(elem.get()) == splitIndex) {
+                members.emplace(elem.get().id);
+            }
+        }
+        std::unordered_set<uint64_t> visitedSubObjects = ConnectedComponents(members, {seed.x + 1, seed.y, seed.z}).splitOff(subobjectId, newSubObjId);
 
         //merge all traversed but unchanged supervoxel into the new object
         auto & newObject = Segmentation::singleton().objects[newObjectIndex];
@@ -136,34 +121,11 @@ void connectedComponent(const Coordinate & seed) {
 }
 
 std::unordered_set<uint64_t> verticalSplittingPlane(const Coordinate & pos, const uint64_t objIndexToSplit, const uint64_t newSubObjId) {
-    std::vector<Coordinate> work = {pos};
-    std::unordered_set<Coordinate> visitedVoxels;
     std::unordered_set<uint64_t> visitedSubObjects;
-    while (!work.empty()) {
-        auto pos = work.back();
-        work.pop_back();
-
-        auto subobjectId = readVoxel(pos);
-        if (subobjectId != Segmentation::singleton().getBackgroundId() && subobjectId != newSubObjId) {
-            auto & subobject = Segmentation::singleton().subobjectFromId(subobjectId, pos);
-            auto objIndex = Segmentation::singleton().largestObjectContainingSubobject(subobject);
-            if (objIndex == objIndexToSplit) {
-                writeVoxel(pos, newSubObjId);//write to cube
-                visitedSubObjects.emplace(subobject.id);//accumulate visited subobjects
-
-                visitedVoxels.emplace(pos.x, pos.y, pos.z);
-                auto walk = [&](const Coordinate & newPos){
-                    if (visitedVoxels.find(newPos) == std::end(visitedVoxels)) {
-                        work.emplace_back(newPos);
-                    }
-                };
-                walk({pos.x, pos.y + 1, pos.z});
-                walk({pos.x, pos.y - 1, pos.z});
-                walk({pos.x, pos.y, pos.z + 1});
-                walk({pos.x, pos.y, pos.z - 1});
-            }
-        }
-    }
+    FloodFill(FloodFill::Y | FloodFill::Z).fill(pos, partOfObject(objIndexToSplit, newSubObjId, pos), [&visitedSubObjects, newSubObjId](const uint64_t subobjectId, const Coordinate &){
+        visitedSubObjects.emplace(subobjectId);//accumulate visited subobjects
+        return newSubObjId;
+    });
     return visitedSubObjects;
 }
 
@@ -0,0 +1,312 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+
+#include "statistics.h"
+
+#include "dataset.h"
+#include "loader.h"
+#include "segmentation.h"
+#include "stateInfo.h"
+
+#include <QMutexLocker>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <snappy.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+// accumulates runs of equal ids along x, so the map is only touched once per run
+SegmentationStatistics::StatisticsMap scanCube(const std::uint64_t * voxels, const CoordOfCube & cubeCoord, const int cubeEdgeLen, const int mag, const std::uint64_t backgroundId) {
+    SegmentationStatistics::StatisticsMap statistics;
+    const auto cubeGlobal = cubeCoord.cube2Global(cubeEdgeLen, mag);
+    std::uint64_t lastId{backgroundId};
+    SegmentationStatistics::Statistics * last{nullptr};
+    for (int z = 0; z < cubeEdgeLen; ++z)
+    for (int y = 0; y < cubeEdgeLen; ++y) {
+        const auto * row = voxels + (static_cast<std::size_t>(z) * cubeEdgeLen + y) * cubeEdgeLen;
+        const auto globalY = cubeGlobal.y + y * mag;
+        const auto globalZ = cubeGlobal.z + z * mag;
+        for (int x = 0; x < cubeEdgeLen;) {
+            const auto id = row[x];
+            int end = x + 1;
+            while (end < cubeEdgeLen && row[end] == id) {
+                ++end;
+            }
+            if (id != backgroundId) {
+                if (last == nullptr || id != lastId) {
+                    last = &statistics[id];// references stay valid while inserting
+                    lastId = id;
+                }
+                const auto count = end - x;
+                const auto firstX = cubeGlobal.x + x * mag;
+                const auto lastX = cubeGlobal.x + (end - 1) * mag;
+                last->voxels += count;
+                last->min = {std::min(last->min.x, firstX), std::min(last->min.y, globalY), std::min(last->min.z, globalZ)};
+                last->max = {std::max(last->max.x, lastX), std::max(last->max.y, globalY), std::max(last->max.z, globalZ)};
+                last->sum[0] += count * (static_cast<double>(firstX) + lastX) / 2;
+                last->sum[1] += static_cast<double>(count) * globalY;
+                last->sum[2] += static_cast<double>(count) * globalZ;
+            }
+            x = end;
+        }
+    }
+    return statistics;
+}
+
+struct ScanJob {
+    CoordOfCube cubeCoord;
+    std::string snappy;// backup of a cube that isn’t loaded
+    SegmentationStatistics::StatisticsMap statistics;
+    bool scanned{false};
+};
+
+// the loader reuses the slots of unloaded cubes, so batches of loaded cubes are copied under the lock and scanned outside of it,
+// jobs of cubes that aren’t loaded (anymore) stay unscanned
+void scanLoaded(std::vector<ScanJob> & jobs, const std::size_t magIndex, const int cubeEdgeLen, const int mag) {
+    const auto & segmentation = Segmentation::singleton();
+    const auto backgroundId = segmentation.getBackgroundId();
+    const auto batchSize = std::min(jobs.size(), static_cast<std::size_t>(std::max(1, QThreadPool::globalInstance()->maxThreadCount())));
+    std::vector<std::vector<std::uint64_t>> buffers(batchSize, std::vector<std::uint64_t>(state->cubeBytes));
+    std::vector<std::pair<ScanJob *, const std::uint64_t *>> batch;
+    for (auto batchBegin = std::begin(jobs); batchBegin != std::end(jobs);) {
+        const auto batchEnd = std::next(batchBegin, std::min<std::size_t>(batchSize, std::distance(batchBegin, std::end(jobs))));
+        batch.clear();
+        {
+            QMutexLocker locker(&state->protectCube2Pointer);
+            for (auto it = batchBegin; it != batchEnd; ++it) {
+                if (const auto * cube = cubeQuery(state->cube2Pointer, segmentation.layerId, magIndex, it->cubeCoord)) {
+                    auto & buffer = buffers[batch.size()];
+                    std::memcpy(buffer.data(), cube, OBJID_BYTES * state->cubeBytes);
+                    batch.emplace_back(&*it, buffer.data());
+                }
+            }
+        }
+        QtConcurrent::blockingMap(batch, [cubeEdgeLen, mag, backgroundId](const std::pair<ScanJob *, const std::uint64_t *> & pair){
+            pair.first->statistics = scanCube(pair.second, pair.first->cubeCoord, cubeEdgeLen, mag, backgroundId);
+            pair.first->scanned = true;
+        });
+        batchBegin = batchEnd;
+    }
+}
+
+void scanBackups(std::vector<ScanJob> & jobs, const int cubeEdgeLen, const int mag) {
+    const auto backgroundId = Segmentation::singleton().getBackgroundId();
+    QtConcurrent::blockingMap(jobs, [cubeEdgeLen, mag, backgroundId](ScanJob & job){
+        std::vector<std::uint64_t> voxels(static_cast<std::size_t>(cubeEdgeLen) * cubeEdgeLen * cubeEdgeLen);
+        if (snappy::RawUncompress(job.snappy.data(), job.snappy.size(), reinterpret_cast<char *>(voxels.data()))) {
+            job.statistics = scanCube(voxels.data(), job.cubeCoord, cubeEdgeLen, mag, backgroundId);
+            job.scanned = true;
+        }
+        job.snappy = std::string{};
+    });
+}
+}
+
+void SegmentationStatistics::Statistics::add(const Statistics & other) {
+    voxels += other.voxels;
+    min = {std::min(min.x, other.min.x), std::min(min.y, other.min.y), std::min(min.z, other.min.z)};
+    max = {std::max(max.x, other.max.x), std::max(max.y, other.max.y), std::max(max.z, other.max.z)};
+    for (std::size_t i = 0; i < sum.size(); ++i) {
+        sum[i] += other.sum[i];
+    }
+}
+
+floatCoordinate SegmentationStatistics::Statistics::centroid() const {
+    if (voxels == 0) {
+        return {};
+    }
+    return {static_cast<float>(sum[0] / voxels), static_cast<float>(sum[1] / voxels), static_cast<float>(sum[2] / voxels)};
+}
+
+SegmentationStatistics & SegmentationStatistics::singleton() {
+    static SegmentationStatistics statistics;
+    return statistics;
+}
+
+SegmentationStatistics::SegmentationStatistics() {
+    //objects changed their subobjects
+    for (auto signal : {&Segmentation::appendedRow, &Segmentation::removedRow, &Segmentation::resetData}) {
+        QObject::connect(&Segmentation::singleton(), signal, this, [this](){
+            objectCache.clear();
+        });
+    }
+    QObject::connect(&Segmentation::singleton(), &Segmentation::changedRow, this, [this](){
+        objectCache.clear();
+    });
+}
+
+bool SegmentationStatistics::active() const {
+    return scanned;
+}
+
+void SegmentationStatistics::refresh() {
+    clear();
+    const auto & segmentation = Segmentation::singleton();
+    if (!segmentation.enabled) {
+        return;
+    }
+    magIndex = Dataset::current().magIndex;
+    const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
+    const auto mag = Dataset::current().magnification;
+    std::vector<ScanJob> jobs;
+    {
+        QMutexLocker locker(&state->protectCube2Pointer);
+        if (segmentation.layerId < state->cube2Pointer.size() && magIndex < state->cube2Pointer[segmentation.layerId].size()) {
+            for (const auto & pair : state->cube2Pointer[segmentation.layerId][magIndex]) {
+                jobs.push_back({pair.first, {}, {}});
+            }
+        }
+    }
+    scanLoaded(jobs, magIndex, cubeEdgeLen, mag);
+    for (auto & job : jobs) {
+        if (job.scanned) {
+            cubes.emplace(job.cubeCoord, std::move(job.statistics));
+        }
+    }
+    auto modifiedCubes = Loader::Controller::singleton().getAllModifiedCubes();// also flushes pending backups, includes the cubes unloaded meanwhile
+    std::vector<ScanJob> backups;
+    if (magIndex < modifiedCubes.size()) {
+        for (auto & pair : modifiedCubes[magIndex]) {
+            if (cubes.find(pair.first) == std::end(cubes)) {
+                backups.push_back({pair.first, std::move(pair.second), {}});
+            }
+        }
+    }
+    scanBackups(backups, cubeEdgeLen, mag);
+    for (auto & job : backups) {
+        if (job.scanned) {
+            cubes.emplace(job.cubeCoord, std::move(job.statistics));
+        }
+    }
+    scanned = true;
+    totalsDirty = true;
+    emit changed();
+}
+
+void SegmentationStatistics::cubeChanged(const CoordOfCube & cubeCoord, const int magnification) {
+    if (!scanned || static_cast<std::size_t>(std::log2(magnification)) != magIndex) {
+        return;
+    }
+    dirtyCubes.emplace(cubeCoord);
+    if (!updateScheduled) {// all cubes of an edit are rescanned together
+        updateScheduled = true;
+        QTimer::singleShot(0, this, &SegmentationStatistics::updateDirtyCubes);
+    }
+}
+
+void SegmentationStatistics::updateDirtyCubes() {
+    updateScheduled = false;
+    if (!scanned || dirtyCubes.empty() || magIndex != Dataset::current().magIndex) {
+        dirtyCubes.clear();
+        return;
+    }
+    const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
+    const auto mag = Dataset::current().magnification;
+    std::vector<ScanJob> jobs;
+    for (const auto & cubeCoord : dirtyCubes) {
+        jobs.push_back({cubeCoord, {}, {}});
+    }
+    dirtyCubes.clear();
+    scanLoaded(jobs, magIndex, cubeEdgeLen, mag);
+    std::vector<CoordOfCube> unloaded;
+    for (auto & job : jobs) {
+        if (job.scanned) {
+            cubes[job.cubeCoord] = std::move(job.statistics);
+        } else {
+            unloaded.emplace_back(job.cubeCoord);
+        }
+    }
+    if (!unloaded.empty()) {// modified cubes are backed up before they are unloaded
+        std::vector<ScanJob> backups;
+        for (auto & pair : Loader::Controller::singleton().getModifiedCubes(magIndex, unloaded)) {
+            backups.push_back({pair.first, std::move(pair.second), {}});
+        }
+        scanBackups(backups, cubeEdgeLen, mag);
+        for (auto & job : backups) {
+            if (job.scanned) {
+                cubes[job.cubeCoord] = std::move(job.statistics);
+            }
+        }
+    }
+    totalsDirty = true;
+    objectCache.clear();
+    emit changed();
+}
+
+void SegmentationStatistics::clear() {
+    scanned = false;
+    cubes.clear();
+    dirtyCubes.clear();
+    totals.clear();
+    totalsDirty = false;
+    objectCache.clear();
+    emit changed();
+}
+
+const SegmentationStatistics::StatisticsMap & SegmentationStatistics::subobjectTotals() const {
+    if (totalsDirty) {
+        totals.clear();
+        for (const auto & cube : cubes) {
+            for (const auto & pair : cube.second) {
+                totals[pair.first].add(pair.second);
+            }
+        }
+        totalsDirty = false;
+        objectCache.clear();
+    }
+    return totals;
+}
+
+SegmentationStatistics::Statistics SegmentationStatistics::subobjectStatistics(const std::uint64_t subobjectId) const {
+    const auto & subobjects = subobjectTotals();
+    const auto it = subobjects.find(subobjectId);
+    return it != std::end(subobjects) ? it->second : Statistics{};
+}
+
+SegmentationStatistics::Statistics SegmentationStatistics::objectStatistics(const std::uint64_t objectId) const {
+    const auto & subobjects = subobjectTotals();
+    const auto cacheIt = objectCache.find(objectId);
+    if (cacheIt != std::end(objectCache)) {
+        return cacheIt->second;
+    }
+    const auto & segmentation = Segmentation::singleton();
+    const auto indexIt = segmentation.objectIdToIndex.find(objectId);
+    if (indexIt == std::end(segmentation.objectIdToIndex)) {
+        throw std::runtime_error(QObject::tr("object with id %1 does not exist").arg(objectId).toStdString());
+    }
+    Statistics statistics;
+    for (const auto & subobject : segmentation.objects[indexIt->second].subobjects) {
+        const auto it = subobjects.find(subobject.get().id);
+        if (it != std::end(subobjects)) {
+            statistics.add(it->second);
+        }
+    }
+    return objectCache[objectId] = statistics;
+}
@@ -0,0 +1,83 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include "coordinate.h"
+
+#include <QObject>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * Voxel count, bounding box and centroid of every subobject in the loaded and snappy cached cubes of one mag.
+ * Every cube keeps its own contribution, so edited cubes are simply rescanned and the totals are
+ * merged again when they are asked for. Coordinates are global, counts are voxels of the scanned mag.
+ */
+class SegmentationStatistics : public QObject {
+    Q_OBJECT
+public:
+    struct Statistics {
+        std::uint64_t voxels{0};
+        Coordinate min{std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), std::numeric_limits<int>::max()};
+        Coordinate max{std::numeric_limits<int>::min(), std::numeric_limits<int>::min(), std::numeric_limits<int>::min()};
+        std::array<double, 3> sum{{0, 0, 0}};// of the voxel positions
+
+        void add(const Statistics & other);
+        floatCoordinate centroid() const;
+    };
+    using StatisticsMap = std::unordered_map<std::uint64_t, Statistics>;
+
+private:
+    bool scanned{false};
+    std::size_t magIndex{0};
+    std::unordered_map<CoordOfCube, StatisticsMap> cubes;
+    std::unordered_set<CoordOfCube> dirtyCubes;
+    bool updateScheduled{false};
+    mutable StatisticsMap totals;
+    mutable bool totalsDirty{false};
+    mutable std::unordered_map<std::uint64_t, Statistics> objectCache;// by object id
+
+    void updateDirtyCubes();
+    const StatisticsMap & subobjectTotals() const;
+
+public:
+    static SegmentationStatistics & singleton();
+    SegmentationStatistics();
+    bool active() const;// false until the first refresh
+    void refresh();// rescans all loaded and snappy cached cubes of the current mag
+    void cubeChanged(const CoordOfCube & cubeCoord, const int magnification);
+    void clear();
+    Statistics subobjectStatistics(const std::uint64_t subobjectId) const;
+    Statistics objectStatistics(const std::uint64_t objectId) const;
+signals:
+    void changed();
+};
+
+#endif//STATISTICS_H
@@ -0,0 +1,151 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+#ifndef SUBOBJECTCACHE_H
+#define SUBOBJECTCACHE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/**
+ * Flat open addressing table subobject id → rendering info (color, selection, largest object).
+ * Slots carry the version they were written in, so invalidating everything is a single increment
+ * and stale slots are simply treated as empty.
+ * Invalidations that only concern some subobjects are logged, so consumers which keep
+ * their own copy of the entries (gpu slot tables) can update just those.
+ * Not thread-safe, lookups insert on miss.
+ */
+class SubobjectCache {
+public:
+    struct Entry {
+        std::tuple<std::uint8_t, std::uint8_t, std::uint8_t, std::uint8_t> color;
+        bool selected;
+        std::uint64_t largestObjectIndex;// 0 if the subobject is not part of any object (same as tryLargestObjectContainingSubobject)
+    };
+
+private:
+    struct Slot {
+        std::uint64_t id;
+        std::uint32_t version{0};
+        Entry entry;
+    };
+    std::vector<Slot> slots = std::vector<Slot>(1 << 10);
+    std::size_t mask{slots.size() - 1};
+    std::size_t used{0};
+    std::uint32_t version{1};
+    std::uint64_t invalidations{0};
+    std::uint64_t lastFullInvalidation{0};
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> changedIds;// (generation, subobject) since the last full invalidation
+    static constexpr std::size_t maxChangedIds = 1 << 16;
+
+    std::size_t slotIndex(const std::uint64_t id) const {
+        return (id * 0x9E3779B97F4A7C15ull >> 20) & mask;// fibonacci hashing spreads consecutive ids
+    }
+
+    void grow() {
+        std::vector<Slot> old(slots.size() * 2);
+        std::swap(old, slots);
+        mask = slots.size() - 1;
+        for (const auto & slot : old) {
+            if (slot.version == version) {
+                auto i = slotIndex(slot.id);
+                while (slots[i].version == version) {
+                    i = (i + 1) & mask;
+                }
+                slots[i] = slot;
+            }
+        }
+    }
+
+    void reset() {
+        used = 0;
+        if (++version == 0) {// wrapped, old stamps could become valid again
+            for (auto & slot : slots) {
+                slot.version = 0;
+            }
+            version = 1;
+        }
+    }
+
+public:
+    // changes whenever the cached information may have changed
+    std::uint64_t generation() const {
+        return invalidations;
+    }
+
+    void invalidate() {
+        lastFullInvalidation = ++invalidations;
+        changedIds.clear();
+        reset();
+    }
+
+    // only the rendering info of ids changed
+    template<typename Ids>
+    void invalidate(const Ids & ids) {
+        ++invalidations;
+        for (const auto id : ids) {
+            changedIds.emplace_back(invalidations, id);
+        }
+        if (changedIds.size() > maxChangedIds) {// log got too long to be worth it
+            lastFullInvalidation = invalidations;
+            changedIds.clear();
+        }
+        reset();
+    }
+
+    // appends the subobjects changed after generation, false if everything has to be updated
+    bool changedSince(const std::uint64_t generation, std::vector<std::uint64_t> & ids) const {
+        if (generation < lastFullInvalidation) {
+            return false;
+        }
+        auto it = std::upper_bound(std::begin(changedIds), std::end(changedIds), std::make_pair(generation, ~std::uint64_t{0}));
+        for (; it != std::end(changedIds); ++it) {
+            ids.emplace_back(it->second);
+        }
+        return true;
+    }
+
+    template<typename Resolve>
+    const Entry & get(const std::uint64_t id, Resolve && resolve) {
+        auto i = slotIndex(id);
+        for (; slots[i].version == version; i = (i + 1) & mask) {
+            if (slots[i].id == id) {
+                return slots[i].entry;
+            }
+        }
+        if (2 * (used + 1) > slots.size()) {// keep load factor ≤ ½, probe sequences stay short
+            grow();
+            return get(id, std::forward<Resolve>(resolve));
+        }
+        ++used;
+        slots[i].id = id;
+        slots[i].version = version;
+        slots[i].entry = resolve(id);
+        return slots[i].entry;
+    }
+};
+
+#endif // SUBOBJECTCACHE_H
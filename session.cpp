@@ -26,6 +26,7 @@
 #include "segmentation/segmentation.h"
 #include "skeleton/skeletonizer.h"
 #include "stateInfo.h"
+#include "undojournal.h"
 
 #include <QApplication>
 
@@ -62,6 +63,7 @@ Session::Session() : annotationMode(AnnotationMode::Mode_Tracing) {
 void Session::clearAnnotation() {
     Skeletonizer::singleton().clearSkeleton();
     Segmentation::singleton().clear();
+    UndoJournal::singleton().clear();
     resetMovementArea();
     setAnnotationTime(0);
     annotationFilename = "";
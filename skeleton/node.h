@@ -44,7 +44,7 @@ public:
     int createdInMag;
     ViewportType createdInVp;
     uint64_t timestamp;
-    std::list<nodeListElement>::iterator iterator;
+    std::size_t nodesIndex{0};// position in correspondingTree->nodes
     treeListElement * correspondingTree = nullptr;
     Synapse * correspondingSynapse = nullptr;
 
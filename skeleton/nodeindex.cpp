@@ -0,0 +1,209 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+
+#include "nodeindex.h"
+
+#include "node.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+float squaredDistance(const floatCoordinate & lhs, const floatCoordinate & rhs) {
+    const auto delta = lhs - rhs;
+    return delta.dot(delta);
+}
+}
+
+CoordOfCube NodeIndex::cellOf(const floatCoordinate & position) {
+    return {static_cast<int>(std::floor(position.x / cellEdge)), static_cast<int>(std::floor(position.y / cellEdge)), static_cast<int>(std::floor(position.z / cellEdge))};
+}
+
+template<typename Func>
+void NodeIndex::forEachCell(const CoordOfCube & min, const CoordOfCube & max, Func && func) const {
+    const auto volume = static_cast<double>(max.x - min.x + 1) * (max.y - min.y + 1) * (max.z - min.z + 1);
+    if (volume > cells.size()) {// sparse skeleton: testing the occupied cells is cheaper than probing the range
+        for (const auto & pair : cells) {
+            const auto & cell = pair.first;
+            if (cell.x >= min.x && cell.x <= max.x && cell.y >= min.y && cell.y <= max.y && cell.z >= min.z && cell.z <= max.z) {
+                func(pair.second);
+            }
+        }
+        return;
+    }
+    for (int z = min.z; z <= max.z; ++z)
+    for (int y = min.y; y <= max.y; ++y)
+    for (int x = min.x; x <= max.x; ++x) {
+        const auto it = cells.find({x, y, z});
+        if (it != std::end(cells)) {
+            func(it->second);
+        }
+    }
+}
+
+void NodeIndex::insert(nodeListElement & node) {
+    cells[cellOf(node.position)].emplace_back(&node);
+    ++nodeCount;
+}
+
+void NodeIndex::remove(nodeListElement & node) {
+    const auto cellIt = cells.find(cellOf(node.position));
+    if (cellIt == std::end(cells)) {
+        return;
+    }
+    auto & nodes = cellIt->second;
+    const auto it = std::find(std::begin(nodes), std::end(nodes), &node);
+    if (it != std::end(nodes)) {
+        *it = nodes.back();
+        nodes.pop_back();
+        --nodeCount;
+    }
+    if (nodes.empty()) {
+        cells.erase(cellIt);
+    }
+}
+
+void NodeIndex::move(nodeListElement & node, const Coordinate & oldPosition) {
+    if (cellOf(oldPosition) == cellOf(node.position)) {
+        return;
+    }
+    const auto newPosition = node.position;
+    node.position = oldPosition;
+    remove(node);
+    node.position = newPosition;
+    insert(node);
+}
+
+std::vector<nodeListElement *> NodeIndex::nearest(const floatCoordinate & position, const std::size_t k, const Filter & filter) const {
+    using Candidate = std::pair<float, nodeListElement *>;// squared distance
+    std::vector<Candidate> best;// max heap of the k closest nodes so far
+    if (k == 0) {
+        return {};
+    }
+    const auto consider = [&](const std::vector<nodeListElement *> & nodes){
+        for (auto * node : nodes) {
+            if (filter && !filter(*node)) {
+                continue;
+            }
+            const auto distance = squaredDistance(node->position, position);
+            if (best.size() < k) {
+                best.emplace_back(distance, node);
+                std::push_heap(std::begin(best), std::end(best));
+            } else if (distance < best.front().first) {
+                std::pop_heap(std::begin(best), std::end(best));
+                best.back() = {distance, node};
+                std::push_heap(std::begin(best), std::end(best));
+            }
+        }
+    };
+    const auto center = cellOf(position);
+    std::size_t visited{0};
+    int ring{0};
+    bool done{false};
+    // visit shells of cells around the query position while they are smaller than the set of occupied cells
+    for (; !done && visited < cells.size(); ++ring) {
+        const auto side = 2.0 * ring + 1;
+        const auto shellSize = ring == 0 ? 1.0 : side * side * side - (side - 2) * (side - 2) * (side - 2);
+        if (shellSize > cells.size()) {
+            break;
+        }
+        for (int z = center.z - ring; z <= center.z + ring; ++z)
+        for (int y = center.y - ring; y <= center.y + ring; ++y) {
+            const bool inner = std::abs(z - center.z) < ring && std::abs(y - center.y) < ring;
+            for (int x = center.x - ring; x <= center.x + ring; x += inner ? 2 * ring : 1) {
+                const auto it = cells.find({x, y, z});
+                if (it != std::end(cells)) {
+                    consider(it->second);
+                    ++visited;
+                }
+            }
+        }
+        // every cell outside this shell is at least ring cell edges away
+        const auto bound = static_cast<float>(ring) * cellEdge;
+        done = best.size() == k && best.front().first <= bound * bound;
+    }
+    if (!done && visited < cells.size()) {// continue with the remaining cells by their distance
+        std::vector<std::pair<float, const std::vector<nodeListElement *> *>> remaining;
+        for (const auto & pair : cells) {
+            const auto & cell = pair.first;
+            if (std::max({std::abs(cell.x - center.x), std::abs(cell.y - center.y), std::abs(cell.z - center.z)}) < ring) {
+                continue;
+            }
+            const floatCoordinate min(cell.x * cellEdge, cell.y * cellEdge, cell.z * cellEdge);
+            const auto max = min + floatCoordinate(cellEdge - 1, cellEdge - 1, cellEdge - 1);
+            const floatCoordinate closest(std::min(std::max(position.x, min.x), max.x), std::min(std::max(position.y, min.y), max.y), std::min(std::max(position.z, min.z), max.z));
+            remaining.emplace_back(squaredDistance(closest, position), &pair.second);
+        }
+        std::sort(std::begin(remaining), std::end(remaining), [](const auto & lhs, const auto & rhs){
+            return lhs.first < rhs.first;
+        });
+        for (const auto & cell : remaining) {
+            if (best.size() == k && cell.first > best.front().first) {
+                break;
+            }
+            consider(*cell.second);
+        }
+    }
+    std::sort_heap(std::begin(best), std::end(best));
+    std::vector<nodeListElement *> result;
+    result.reserve(best.size());
+    for (const auto & candidate : best) {
+        result.emplace_back(candidate.second);
+    }
+    return result;
+}
+
+std::vector<nodeListElement *> NodeIndex::withinRadius(const floatCoordinate & position, const float radius, const Filter & filter) const {
+    std::vector<std::pair<float, nodeListElement *>> found;
+    const floatCoordinate extent(radius, radius, radius);
+    forEachCell(cellOf(position - extent), cellOf(position + extent), [&](const std::vector<nodeListElement *> & nodes){
+        for (auto * node : nodes) {
+            const auto distance = squaredDistance(node->position, position);
+            if (distance <= radius * radius && (!filter || filter(*node))) {
+                found.emplace_back(distance, node);
+            }
+        }
+    });
+    std::sort(std::begin(found), std::end(found), [](const auto & lhs, const auto & rhs){
+        return lhs.first < rhs.first;
+    });
+    std::vector<nodeListElement *> result;
+    result.reserve(found.size());
+    for (const auto & pair : found) {
+        result.emplace_back(pair.second);
+    }
+    return result;
+}
+
+std::vector<nodeListElement *> NodeIndex::inBox(const Coordinate & min, const Coordinate & max, const Filter & filter) const {
+    std::vector<nodeListElement *> result;
+    forEachCell(cellOf(min), cellOf(max), [&](const std::vector<nodeListElement *> & nodes){
+        for (auto * node : nodes) {
+            const auto & pos = node->position;
+            if (pos.x >= min.x && pos.x <= max.x && pos.y >= min.y && pos.y <= max.y && pos.z >= min.z && pos.z <= max.z && (!filter || filter(*node))) {
+                result.emplace_back(node);
+            }
+        }
+    });
+    return result;
+}
@@ -0,0 +1,69 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+
+#ifndef NODEINDEX_H
+#define NODEINDEX_H
+
+#include "coordinate.h"
+
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+class nodeListElement;
+
+/**
+ * Uniform grid over the node positions (in voxels) for nearest neighbour, radius and box queries.
+ * Cells are hashed, so only occupied cells cost memory.
+ * Kept up to date by Skeletonizer::addNode, delNode and setPosition.
+ */
+class NodeIndex {
+public:
+    using Filter = std::function<bool(const nodeListElement &)>;
+    static constexpr int cellEdge{128};
+
+private:
+    std::unordered_map<CoordOfCube, std::vector<nodeListElement *>> cells;
+    std::size_t nodeCount{0};
+
+    static CoordOfCube cellOf(const floatCoordinate & position);
+    template<typename Func>
+    void forEachCell(const CoordOfCube & min, const CoordOfCube & max, Func && func) const;
+
+public:
+    void insert(nodeListElement & node);
+    void remove(nodeListElement & node);
+    void move(nodeListElement & node, const Coordinate & oldPosition);
+    std::size_t size() const {
+        return nodeCount;
+    }
+
+    // results are ordered by distance
+    std::vector<nodeListElement *> nearest(const floatCoordinate & position, const std::size_t k, const Filter & filter = {}) const;
+    std::vector<nodeListElement *> withinRadius(const floatCoordinate & position, const float radius, const Filter & filter = {}) const;
+    // bounds are inclusive
+    std::vector<nodeListElement *> inBox(const Coordinate & min, const Coordinate & max, const Filter & filter = {}) const;
+};
+
+#endif // NODEINDEX_H
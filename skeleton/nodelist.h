@@ -0,0 +1,230 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+
+#ifndef NODELIST_H
+#define NODELIST_H
+
+#include "node.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Backing store of all skeleton nodes.
+ * Nodes are placed into chunks of consecutive slots and never move, so references to them
+ * (segments, nodesByNodeID, selection, …) stay valid while nodes change their tree.
+ * Freed slots are reused, nodes created in a row end up next to each other in memory.
+ * Not synchronized, like the rest of the skeleton it is only touched from the GUI thread.
+ */
+class NodePool {
+    static constexpr std::size_t chunkSize{4096};
+    using Slot = std::aligned_storage_t<sizeof(nodeListElement), alignof(nodeListElement)>;
+    std::vector<std::unique_ptr<Slot[]>> chunks;
+    std::vector<Slot *> freeSlots;
+    std::size_t usedInLastChunk{chunkSize};
+
+public:
+    static NodePool & singleton() {
+        static auto & pool = *new NodePool;// never destroyed, trees of static objects may be torn down later
+        return pool;
+    }
+
+    template<typename... Args>
+    nodeListElement & create(Args &&... args) {
+        Slot * slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            if (usedInLastChunk == chunkSize) {
+                chunks.emplace_back(new Slot[chunkSize]);
+                usedInLastChunk = 0;
+            }
+            slot = &chunks.back()[usedInLastChunk++];
+        }
+        return *new (slot) nodeListElement(std::forward<Args>(args)...);
+    }
+
+    void destroy(nodeListElement & node) {
+        node.~nodeListElement();
+        freeSlots.emplace_back(reinterpret_cast<Slot *>(&node));
+    }
+};
+
+/**
+ * Nodes of a tree in insertion order, kept as pointers into the NodePool.
+ * Erasing leaves a hole which iteration skips. Holes are never squeezed out, so iterators and
+ * nodeListElement::nodesIndex stay valid across insertions and erasures, a hole costs one pointer
+ * until the list is emptied by splicing or destroyed.
+ */
+class NodeList {
+    std::vector<nodeListElement *> handles;
+    std::size_t holes{0};
+    mutable std::size_t head{0};// there is no node before this index
+
+    std::size_t firstIndex() const {
+        while (head < handles.size() && handles[head] == nullptr) {
+            ++head;
+        }
+        return head;
+    }
+
+    void append(nodeListElement & node) {
+        node.nodesIndex = handles.size();
+        handles.emplace_back(&node);
+    }
+
+    void detach(nodeListElement & node) {
+        handles[node.nodesIndex] = nullptr;
+        ++holes;
+    }
+
+public:
+    template<typename Node>
+    class Iterator {
+        friend class NodeList;
+        template<typename> friend class Iterator;
+        const std::vector<nodeListElement *> * handles{nullptr};
+        std::size_t index{0};
+
+        Iterator(const std::vector<nodeListElement *> & handles, const std::size_t index) : handles{&handles}, index{index} {}
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = nodeListElement;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Node *;
+        using reference = Node &;
+
+        Iterator() = default;
+        operator Iterator<const Node>() const {
+            return {*handles, index};
+        }
+        reference operator*() const {
+            return *(*handles)[index];
+        }
+        pointer operator->() const {
+            return (*handles)[index];
+        }
+        Iterator & operator++() {
+            do {
+                ++index;
+            } while (index < handles->size() && (*handles)[index] == nullptr);
+            return *this;
+        }
+        Iterator operator++(int) {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+        bool operator==(const Iterator & other) const {
+            return index == other.index;
+        }
+        bool operator!=(const Iterator & other) const {
+            return index != other.index;
+        }
+    };
+    using iterator = Iterator<nodeListElement>;
+    using const_iterator = Iterator<const nodeListElement>;
+
+    NodeList() = default;
+    NodeList(const NodeList &) = delete;
+    NodeList & operator=(const NodeList &) = delete;
+    NodeList(NodeList && other) noexcept : handles{std::move(other.handles)}, holes{other.holes}, head{other.head} {
+        other.handles.clear();
+        other.holes = other.head = 0;
+    }
+    NodeList & operator=(NodeList && other) noexcept {
+        std::swap(handles, other.handles);
+        std::swap(holes, other.holes);
+        std::swap(head, other.head);
+        return *this;
+    }
+    ~NodeList() {
+        for (auto * node : handles) {
+            if (node != nullptr) {
+                NodePool::singleton().destroy(*node);
+            }
+        }
+    }
+
+    iterator begin() {
+        return {handles, firstIndex()};
+    }
+    iterator end() {
+        return {handles, handles.size()};
+    }
+    const_iterator begin() const {
+        return {handles, firstIndex()};
+    }
+    const_iterator end() const {
+        return {handles, handles.size()};
+    }
+    std::size_t size() const {
+        return handles.size() - holes;
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+    nodeListElement & front() const {
+        return *handles[firstIndex()];
+    }
+    nodeListElement & back() const {
+        auto it = std::find_if(std::rbegin(handles), std::rend(handles), [](const auto * node){
+            return node != nullptr;
+        });
+        return **it;
+    }
+
+    template<typename... Args>
+    nodeListElement & emplace_back(Args &&... args) {
+        auto & node = NodePool::singleton().create(std::forward<Args>(args)...);
+        append(node);
+        return node;
+    }
+    void erase(nodeListElement & node) {
+        detach(node);
+        NodePool::singleton().destroy(node);
+    }
+    // move node from other to the end of this list
+    void splice(NodeList & other, nodeListElement & node) {
+        other.detach(node);
+        append(node);
+    }
+    // move all nodes from other to the end of this list
+    void splice(NodeList & other) {
+        for (auto & node : other) {
+            append(node);
+        }
+        other.handles.clear();
+        other.holes = other.head = 0;
+    }
+};
+
+#endif // NODELIST_H
@@ -20,10 +20,310 @@
  *  or contact knossos-team@mpimf-heidelberg.mpg.de
  */
 
+
 #include "property_query.h"
 
+#include <QHash>
+
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+struct NameTable {
+    QHash<QString, PropertyMap::Name> ids;
+    std::deque<QString> names;// references stay valid while growing
+};
+
+NameTable & nameTable() {
+    static NameTable table;
+    return table;
+}
+
+enum class Type : std::uint8_t { None, Double, Int, UInt, Bool, String, Variant };
+
+union Number {
+    double d;
+    qlonglong i;
+    qulonglong u;
+    bool b;
+};
+
+// values of one property name, indexed by row, vectors only grow up to the highest row that used them
+struct Column {
+    std::vector<Type> types;
+    std::vector<Number> numbers;
+    std::vector<QString> strings;
+    std::unordered_map<std::uint32_t, QVariant> variants;// everything else, e.g. lists and maps set from Python, rare
+
+    Type type(const std::uint32_t row) const {
+        return row < types.size() ? types[row] : Type::None;
+    }
+    QVariant toVariant(const std::uint32_t row) const {
+        switch (type(row)) {
+        case Type::None: return {};
+        case Type::Double: return numbers[row].d;
+        case Type::Int: return numbers[row].i;
+        case Type::UInt: return numbers[row].u;
+        case Type::Bool: return numbers[row].b;
+        case Type::String: return strings[row];
+        case Type::Variant: return variants.at(row);
+        }
+        return {};
+    }
+    void clear(const std::uint32_t row) {
+        if (row < types.size()) {
+            if (types[row] == Type::String) {
+                strings[row] = QString{};
+            } else if (types[row] == Type::Variant) {
+                variants.erase(row);
+            }
+            types[row] = Type::None;
+        }
+    }
+};
+
+struct Columns {
+    std::vector<Column> byName;// indexed by PropertyMap::Name
+    std::vector<std::uint16_t> rowSizes;// number of properties per row
+    std::vector<std::uint32_t> freeRows;
+};
+
+Columns & columns() {
+    static auto & table = *new Columns;// never destroyed, properties of static objects may be torn down later
+    return table;
+}
+
+const auto commentName = PropertyMap::intern("comment");
+}
+
+PropertyMap::Name PropertyMap::intern(const QString & name) {
+    auto & table = nameTable();
+    const auto it = table.ids.constFind(name);
+    if (it != table.ids.constEnd()) {
+        return it.value();
+    }
+    const auto id = static_cast<Name>(table.names.size());
+    table.names.emplace_back(name);
+    table.ids.insert(name, id);
+    return id;
+}
+
+boost::optional<PropertyMap::Name> PropertyMap::find(const QString & name) {
+    const auto & table = nameTable();
+    const auto it = table.ids.constFind(name);
+    return it != table.ids.constEnd() ? boost::optional<Name>{it.value()} : boost::none;
+}
+
+const QString & PropertyMap::name(const Name id) {
+    return nameTable().names[id];
+}
+
+PropertyMap::PropertyMap(const QVariantHash & hash) {
+    for (auto it = std::cbegin(hash); it != std::cend(hash); ++it) {
+        insert(it.key(), it.value());
+    }
+}
+
+PropertyMap::PropertyMap(const PropertyMap & other) {
+    for (auto it = std::begin(other); it != std::end(other); ++it) {
+        insert(it.key(), it.value());
+    }
+}
+
+PropertyMap & PropertyMap::operator=(const PropertyMap & other) {
+    if (this != &other) {
+        PropertyMap copy{other};
+        std::swap(row, copy.row);
+    }
+    return *this;
+}
+
+void PropertyMap::release() {
+    if (row == noRow) {
+        return;
+    }
+    auto & table = columns();
+    for (auto & column : table.byName) {
+        column.clear(row);
+    }
+    table.rowSizes[row] = 0;
+    table.freeRows.emplace_back(row);
+    row = noRow;
+}
+
+PropertyMap::Name PropertyMap::next(const std::uint32_t row, Name name) {
+    const auto & byName = columns().byName;
+    if (row != noRow) {
+        for (; name < byName.size(); ++name) {
+            if (byName[name].type(row) != Type::None) {
+                return name;
+            }
+        }
+    }
+    return std::numeric_limits<Name>::max();
+}
+
+PropertyMap::const_iterator PropertyMap::begin() const {
+    return {row, next(row, 0)};
+}
+
+PropertyMap::const_iterator PropertyMap::end() const {
+    return {row, std::numeric_limits<Name>::max()};
+}
+
+QVariant PropertyMap::const_iterator::value() const {
+    return columns().byName[name].toVariant(row);
+}
+
+int PropertyMap::size() const {
+    return row != noRow ? columns().rowSizes[row] : 0;
+}
+
+QVariant PropertyMap::valueAt(const Name name) const {
+    const auto & byName = columns().byName;
+    return row != noRow && name < byName.size() ? byName[name].toVariant(row) : QVariant{};
+}
+
+bool PropertyMap::contains(const Name name) const {
+    const auto & byName = columns().byName;
+    return row != noRow && name < byName.size() && byName[name].type(row) != Type::None;
+}
+
+bool PropertyMap::contains(const QString & name) const {
+    const auto id = find(name);
+    return id && contains(id.get());
+}
+
+QVariant PropertyMap::value(const QString & name, const QVariant & defaultValue) const {
+    const auto id = find(name);
+    return id && contains(id.get()) ? valueAt(id.get()) : defaultValue;
+}
+
+double PropertyMap::number(const Name name, const double defaultValue) const {
+    if (!contains(name)) {
+        return defaultValue;
+    }
+    const auto & column = columns().byName[name];
+    switch (column.types[row]) {
+    case Type::None: return defaultValue;
+    case Type::Double: return column.numbers[row].d;
+    case Type::Int: return column.numbers[row].i;
+    case Type::UInt: return column.numbers[row].u;
+    case Type::Bool: return column.numbers[row].b;
+    case Type::String: return column.strings[row].toDouble();
+    case Type::Variant: return column.variants.at(row).toDouble();
+    }
+    return defaultValue;
+}
+
+QString PropertyMap::text(const Name name) const {
+    if (!contains(name)) {
+        return {};
+    }
+    const auto & column = columns().byName[name];
+    return column.types[row] == Type::String ? column.strings[row] : column.toVariant(row).toString();
+}
+
+void PropertyMap::insert(const QString & name, const QVariant & value) {
+    const auto id = intern(name);
+    auto & table = columns();
+    if (row == noRow) {
+        if (!table.freeRows.empty()) {
+            row = table.freeRows.back();
+            table.freeRows.pop_back();
+        } else {
+            row = static_cast<std::uint32_t>(table.rowSizes.size());
+            table.rowSizes.emplace_back(0);
+        }
+    }
+    if (id >= table.byName.size()) {
+        table.byName.resize(id + 1);
+    }
+    auto & column = table.byName[id];
+    if (column.type(row) == Type::None) {
+        ++table.rowSizes[row];
+    } else {
+        column.clear(row);
+    }
+    if (row >= column.types.size()) {
+        column.types.resize(row + 1, Type::None);
+    }
+    auto setNumber = [&column, this](const Type type, const Number number){
+        if (row >= column.numbers.size()) {
+            column.numbers.resize(row + 1);
+        }
+        column.numbers[row] = number;
+        column.types[row] = type;
+    };
+    Number number;
+    switch (static_cast<QMetaType::Type>(value.userType())) {
+    case QMetaType::Double:
+    case QMetaType::Float:
+        number.d = value.toDouble();
+        setNumber(Type::Double, number);
+        break;
+    case QMetaType::Int:
+    case QMetaType::Long:
+    case QMetaType::LongLong:
+        number.i = value.toLongLong();
+        setNumber(Type::Int, number);
+        break;
+    case QMetaType::UInt:
+    case QMetaType::ULong:
+    case QMetaType::ULongLong:
+        number.u = value.toULongLong();
+        setNumber(Type::UInt, number);
+        break;
+    case QMetaType::Bool:
+        number.b = value.toBool();
+        setNumber(Type::Bool, number);
+        break;
+    case QMetaType::QString:
+        if (row >= column.strings.size()) {
+            column.strings.resize(row + 1);
+        }
+        column.strings[row] = value.toString();
+        column.types[row] = Type::String;
+        break;
+    default:
+        column.variants[row] = value;
+        column.types[row] = Type::Variant;
+    }
+}
+
+void PropertyMap::remove(const QString & name) {
+    const auto id = find(name);
+    if (!id || !contains(id.get())) {
+        return;
+    }
+    auto & table = columns();
+    table.byName[id.get()].clear(row);
+    if (--table.rowSizes[row] == 0) {// give the row back
+        table.freeRows.emplace_back(row);
+        row = noRow;
+    }
+}
+
+QStringList PropertyMap::keys() const {
+    QStringList keys;
+    for (auto it = begin(); it != end(); ++it) {
+        keys.append(it.key());
+    }
+    return keys;
+}
+
+QVariantHash PropertyMap::toHash() const {
+    QVariantHash hash;
+    for (auto it = begin(); it != end(); ++it) {
+        hash.insert(it.key(), it.value());
+    }
+    return hash;
+}
+
 QString PropertyQuery::getComment() const {
-    return properties.value("comment").toString();
+    return properties.text(commentName);
 }
 
 void PropertyQuery::setComment(const QString & comment) {
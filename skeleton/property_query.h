@@ -20,15 +20,110 @@
  *  or contact knossos-team@mpimf-heidelberg.mpg.de
  */
 
+
 #ifndef PROPERTY_QUERY_H
 #define PROPERTY_QUERY_H
 
 #include <QString>
+#include <QStringList>
+#include <QVariant>
 #include <QVariantHash>
 
+#include <boost/optional.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+/**
+ * Properties of a node or tree.
+ * Names are interned once for the whole program. Values live in one typed column per name
+ * (number, text, other QVariants), each map only owns a row index into these columns.
+ * An element without properties holds no row, reading a property is an index into a vector.
+ * Keeps the parts of the QVariantHash interface the skeleton code uses.
+ * Not thread-safe, like the rest of the skeleton.
+ */
+class PropertyMap {
+public:
+    using Name = std::uint32_t;
+    static Name intern(const QString & name);
+    static boost::optional<Name> find(const QString & name);// lookup without interning unknown names
+    static const QString & name(const Name id);
+
+private:
+    static constexpr std::uint32_t noRow = std::numeric_limits<std::uint32_t>::max();
+    std::uint32_t row{noRow};// allocated on the first insert
+
+    QVariant valueAt(const Name name) const;
+    static Name next(const std::uint32_t row, const Name name);// first name ≥ name with a value in row
+    void release();
+
+public:
+    class const_iterator {
+        friend class PropertyMap;
+        std::uint32_t row;
+        Name name;
+        const_iterator(const std::uint32_t row, const Name name) : row{row}, name{name} {}
+    public:
+        const QString & key() const {
+            return PropertyMap::name(name);
+        }
+        QVariant value() const;
+        const_iterator & operator++() {
+            name = next(row, name + 1);
+            return *this;
+        }
+        bool operator==(const const_iterator & other) const {
+            return name == other.name;
+        }
+        bool operator!=(const const_iterator & other) const {
+            return name != other.name;
+        }
+    };
+
+    PropertyMap() = default;
+    PropertyMap(const QVariantHash & hash);
+    PropertyMap(const PropertyMap & other);
+    PropertyMap(PropertyMap && other) noexcept : row{other.row} {
+        other.row = noRow;
+    }
+    PropertyMap & operator=(const PropertyMap & other);
+    PropertyMap & operator=(PropertyMap && other) noexcept {
+        std::swap(row, other.row);
+        return *this;
+    }
+    ~PropertyMap() {
+        release();
+    }
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator constBegin() const {
+        return begin();
+    }
+    const_iterator constEnd() const {
+        return end();
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+    int size() const;
+
+    bool contains(const Name name) const;
+    bool contains(const QString & name) const;
+    QVariant value(const QString & name, const QVariant & defaultValue = {}) const;
+    // typed access without a QVariant, strings are converted
+    double number(const Name name, const double defaultValue = 0) const;
+    QString text(const Name name) const;
+    void insert(const QString & name, const QVariant & value);
+    void remove(const QString & name);
+    QStringList keys() const;
+    QVariantHash toHash() const;
+};
+
 class PropertyQuery {
 public:
-    QVariantHash properties;
+    PropertyMap properties;
     QString getComment() const;
     void setComment(const QString & comment);
 };
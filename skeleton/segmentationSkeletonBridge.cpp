@@ -30,9 +30,8 @@ const auto subobjectPropertyKey = "subobjectId";
 
 template<typename Func>
 void ifsoproperty(const nodeListElement & node, Func func) {
-    auto soPropertyIt = node.properties.find(subobjectPropertyKey);
-    if (soPropertyIt != std::end(node.properties)) {
-        const auto subobjectId = soPropertyIt->toULongLong();
+    if (node.properties.contains(subobjectPropertyKey)) {
+        const auto subobjectId = node.properties.value(subobjectPropertyKey).toULongLong();
         func(subobjectId);
     }
 }
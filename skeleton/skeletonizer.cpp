@@ -34,6 +34,7 @@
 #include "skeleton/tree.h"
 #include "stateInfo.h"
 #include "tinyply/tinyply.h"
+#include "undojournal.h"
 #include "viewer.h"
 #include "widgets/viewports/viewportbase.h"
 #include "widgets/mainwindow.h"
@@ -712,8 +713,8 @@ std::unordered_map<decltype(treeListElement::treeID), std::reference_wrapper<tre
 
     for (const auto & tree : state->skeletonState->trees) {
         if(tree.properties.contains("synapticCleft")) {
-            auto preSynapse = tree.properties.contains("preSynapse") ? getElem(nodeMap, tree.properties["preSynapse"].toULongLong(), findNodeByNodeID) : boost::none;
-            auto postSynapse = tree.properties.contains("postSynapse") ? getElem(nodeMap, tree.properties["postSynapse"].toULongLong(), findNodeByNodeID) : boost::none;
+            auto preSynapse = tree.properties.contains("preSynapse") ? getElem(nodeMap, tree.properties.value("preSynapse").toULongLong(), findNodeByNodeID) : boost::none;
+            auto postSynapse = tree.properties.contains("postSynapse") ? getElem(nodeMap, tree.properties.value("postSynapse").toULongLong(), findNodeByNodeID) : boost::none;
             auto synapticCleft = getElem(treeMap, tree.treeID, findTreeByTreeID);
             if (preSynapse && postSynapse && synapticCleft) {
                 addFinishedSynapse(**synapticCleft, **preSynapse, **postSynapse);
@@ -774,6 +775,7 @@ bool Skeletonizer::delSegment(std::list<segmentListElement>::iterator segToDelIt
     /* A bit cumbersome, but we cannot delete the segment and then find its source node.. */
     auto & source = segToDelIt->source;
     auto & target = segToDelIt->target;
+    UndoJournal::singleton().segmentRemoved(source, target);
     target.segments.erase(segToDelIt->sisterSegment);
     source.segments.erase(segToDelIt);
 
@@ -810,6 +812,7 @@ bool Skeletonizer::delNode(std::uint64_t nodeID, nodeListElement *nodeToDel) {
     }
 
     state->skeletonState->nodesByNodeID.erase(nodeToDel->nodeID);
+    state->skeletonState->nodeIndex.remove(*nodeToDel);
     if (nodeID < state->skeletonState->nextAvailableNodeID) {
         state->skeletonState->nextAvailableNodeID = nodeID;
     }
@@ -845,9 +848,10 @@ bool Skeletonizer::delNode(std::uint64_t nodeID, nodeListElement *nodeToDel) {
         delSegment(segmentIt);
     }
 
-    nodeToDel->correspondingTree->nodes.erase(nodeToDel->iterator);
+    UndoJournal::singleton().nodeRemoved(*nodeToDel);
+    nodeToDel->correspondingTree->nodes.erase(*nodeToDel);
 
-    emit nodeRemovedSignal(nodeID);
+    emit nodeRemovedSignal(nodeID, tree->treeID);
 
     if (resetActiveNode) {
         if (newActiveNode == nullptr) { // nodeToDel was not connected
@@ -900,6 +904,7 @@ bool Skeletonizer::delTree(decltype(treeListElement::treeID) treeID) {
         skeletonState.activeTree = nullptr;
     }
 
+    UndoJournal::singleton().treeRemoved(*treeToDel);
     skeletonState.trees.erase(treeToDel->iterator);
     skeletonState.treesByID.erase(treeID);
 
@@ -916,36 +921,35 @@ bool Skeletonizer::delTree(decltype(treeListElement::treeID) treeID) {
 }
 
 nodeListElement * Skeletonizer::findNearbyNode(treeListElement * nearbyTree, Coordinate searchPosition) {
-    nodeListElement * nodeWithCurrentlySmallestDistance = nullptr;
-    float smallestDistance = std::numeric_limits<float>::max();//maximum distance
-
-    auto searchTree = [&smallestDistance, &nodeWithCurrentlySmallestDistance, searchPosition](treeListElement & tree){
-        for (auto & currentNode : tree.nodes) {
-            // We make the nearest node the next active node
-            const floatCoordinate distanceVector = searchPosition - currentNode.position;
-            const auto distance = distanceVector.length();
-            //set nearest distance to distance to first node found, then to distance of any nearer node found.
-            if (distance  < smallestDistance) {
-                smallestDistance = distance;
-                nodeWithCurrentlySmallestDistance = &currentNode;
-            }
-        }
-    };
-
     //  If available, search for a node within nearbyTree first.
-    if (nearbyTree != nullptr) {
-        searchTree(*nearbyTree);
-    }
-
-    if (nodeWithCurrentlySmallestDistance == nullptr) {
-        // Ok, we didn't find any node in nearbyTree.
-        // Now we take the nearest node, independent of the tree it belongs to.
-        for (auto & currentTree : skeletonState.trees) {
-            searchTree(currentTree);
+    if (nearbyTree != nullptr && !nearbyTree->nodes.empty()) {
+        if (nearbyTree->nodes.size() < skeletonState.nodeIndex.size() / 256) {// scanning a small tree beats filtering the index
+            return &*std::min_element(std::begin(nearbyTree->nodes), std::end(nearbyTree->nodes), [&searchPosition](const auto & lhs, const auto & rhs){
+                const floatCoordinate lhsDistance = searchPosition - lhs.position;
+                const floatCoordinate rhsDistance = searchPosition - rhs.position;
+                return lhsDistance.length() < rhsDistance.length();
+            });
         }
+        return skeletonState.nodeIndex.nearest(searchPosition, 1, [nearbyTree](const nodeListElement & node){
+            return node.correspondingTree == nearbyTree;
+        }).front();
     }
+    // Ok, we didn't find any node in nearbyTree.
+    // Now we take the nearest node, independent of the tree it belongs to.
+    const auto nearest = skeletonState.nodeIndex.nearest(searchPosition, 1);
+    return nearest.empty() ? nullptr : nearest.front();
+}
+
+std::vector<nodeListElement *> Skeletonizer::findNearestNodes(const floatCoordinate & position, const std::size_t count) const {
+    return skeletonState.nodeIndex.nearest(position, count);
+}
+
+std::vector<nodeListElement *> Skeletonizer::findNodesInRadius(const floatCoordinate & position, const float radius) const {
+    return skeletonState.nodeIndex.withinRadius(position, radius);
+}
 
-    return nodeWithCurrentlySmallestDistance;
+std::vector<nodeListElement *> Skeletonizer::findNodesInBox(const Coordinate & min, const Coordinate & max) const {
+    return skeletonState.nodeIndex.inBox(min, max);
 }
 
 bool Skeletonizer::setActiveTreeByID(decltype(treeListElement::treeID) treeID) {
@@ -1024,7 +1028,7 @@ boost::optional<nodeListElement &> Skeletonizer::addNode(boost::optional<decltyp
 }
 
 boost::optional<nodeListElement &> Skeletonizer::addNode(boost::optional<std::uint64_t> nodeID, const float radius, const decltype(treeListElement::treeID) treeID, const Coordinate & position
-        , const ViewportType VPtype, const int inMag, boost::optional<uint64_t> time, const bool respectLocks, const QHash<QString, QVariant> & properties) {
+        , const ViewportType VPtype, const int inMag, boost::optional<uint64_t> time, const bool respectLocks, const PropertyMap & properties) {
     state->skeletonState->branchpointUnresolved = false;
 
      // respectLocks refers to locking the position to a specific coordinate such as to
@@ -1060,33 +1064,102 @@ boost::optional<nodeListElement &> Skeletonizer::addNode(boost::optional<std::ui
         time = Session::singleton().getAnnotationTime() + Session::singleton().currentTimeSliceMs();
     }
 
-    tempTree->nodes.emplace_back(nodeID.get(), radius, position, inMag, VPtype, time.get(), properties, *tempTree);
-    auto & tempNode = tempTree->nodes.back();
-    tempNode.iterator = std::prev(std::end(tempTree->nodes));
+    auto & tempNode = insertNode(nodeID.get(), radius, *tempTree, position, VPtype, inMag, time.get(), properties);
     updateCircRadius(&tempNode);
-    updateSubobjectCountFromProperty(tempNode);
 
-    state->skeletonState->nodesByNodeID.emplace(nodeID.get(), &tempNode);
+    if (registerProperties(properties)) {
+        emit propertiesChanged(numberProperties, textProperties);
+    }
+    Session::singleton().unsavedChanges = true;
+
+    emit nodeAddedSignal(tempNode);
+
+    return tempNode;
+}
+
+nodeListElement & Skeletonizer::insertNode(const decltype(nodeListElement::nodeID) nodeID, const float radius, treeListElement & tree, const Coordinate & position
+        , const ViewportType VPtype, const int inMag, const uint64_t time, const PropertyMap & properties) {
+    auto & node = tree.nodes.emplace_back(nodeID, radius, position, inMag, VPtype, time, properties, tree);
+    UndoJournal::singleton().nodeAdded(node);
+    updateSubobjectCountFromProperty(node);
 
+    skeletonState.nodesByNodeID.emplace(nodeID, &node);
+    skeletonState.nodeIndex.insert(node);
+
+    if (nodeID == skeletonState.nextAvailableNodeID) {
+        skeletonState.nextAvailableNodeID = findNextAvailableID(skeletonState.nextAvailableNodeID, skeletonState.nodesByNodeID);
+    }
+    return node;
+}
+
+bool Skeletonizer::registerProperties(const PropertyMap & properties) {
     bool isPropertiesChanged = false;
-    for (auto & property : properties.keys()) {
+    for (auto it = properties.constBegin(); it != properties.constEnd(); ++it) {
+        const auto & property = it.key();
         if (!numberProperties.contains(property) && !textProperties.contains(property)) {
             textProperties.insert(property);
             isPropertiesChanged = true;
         }
     }
-    if (isPropertiesChanged) {
-        emit propertiesChanged(numberProperties, textProperties);
+    return isPropertiesChanged;
+}
+
+std::vector<nodeListElement *> Skeletonizer::addNodes(const decltype(treeListElement::treeID) treeID, const NodeBatch & batch) {
+    const auto count = batch.positions.size();
+    auto * const tree = findTreeByTreeID(treeID);
+    if (!tree) {
+        throw std::runtime_error(tr("There exists no tree with the provided ID %1!").arg(treeID).toStdString());
+    }
+    if ((!batch.radii.empty() && batch.radii.size() != count) || (!batch.nodeIDs.empty() && batch.nodeIDs.size() != count)
+            || (!batch.properties.empty() && batch.properties.size() != count)) {
+        throw std::runtime_error(tr("Node batch: radii, ids and properties must be empty or have one entry per position.").toStdString());
+    }
+    // validate everything up front so a failing batch leaves the skeleton untouched
+    std::unordered_set<decltype(nodeListElement::nodeID)> batchIDs;
+    batchIDs.reserve(batch.nodeIDs.size());
+    for (const auto nodeID : batch.nodeIDs) {
+        if (findNodeByNodeID(nodeID) || !batchIDs.emplace(nodeID).second) {
+            throw std::runtime_error(tr("Node with ID %1 already exists, no nodes added.").arg(nodeID).toStdString());
+        }
+    }
+    for (const auto & segment : batch.segments) {
+        if (segment.first >= count || segment.second >= count || segment.first == segment.second) {
+            throw std::runtime_error(tr("Node batch: invalid segment %1 → %2.").arg(segment.first).arg(segment.second).toStdString());
+        }
     }
 
-    if (nodeID == state->skeletonState->nextAvailableNodeID) {
-        skeletonState.nextAvailableNodeID = findNextAvailableID(skeletonState.nextAvailableNodeID, skeletonState.nodesByNodeID);
+    std::vector<nodeListElement *> nodes;
+    nodes.reserve(count);
+    skeletonState.nodesByNodeID.reserve(skeletonState.nodesByNodeID.size() + count);
+    const auto time = Session::singleton().getAnnotationTime() + Session::singleton().currentTimeSliceMs();
+    bool isPropertiesChanged = false;
+    {
+        QSignalBlocker blocker{this};
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto nodeID = batch.nodeIDs.empty() ? skeletonState.nextAvailableNodeID : batch.nodeIDs[i];
+            const auto radius = batch.radii.empty() ? skeletonState.defaultNodeRadius : batch.radii[i];
+            static const PropertyMap noProperties;
+            const auto & properties = batch.properties.empty() ? noProperties : batch.properties[i];
+            nodes.emplace_back(&insertNode(nodeID, radius, *tree, batch.positions[i], ViewportType::VIEWPORT_UNDEFINED, -1, time, properties));
+            isPropertiesChanged |= registerProperties(properties);
+        }
+        for (const auto & segment : batch.segments) {
+            auto & source = *nodes[segment.first];
+            auto & target = *nodes[segment.second];
+            if (findSegmentBetween(source, target) == std::end(source.segments) && findSegmentBetween(target, source) == std::end(target.segments)) {
+                insertSegment(source, target);
+            }
+        }
+        for (auto * node : nodes) {// once per node instead of once per incident segment
+            updateCircRadius(node);
+        }
+    }
+    if (isPropertiesChanged) {
+        emit propertiesChanged(numberProperties, textProperties);
     }
     Session::singleton().unsavedChanges = true;
-
-    emit nodeAddedSignal(tempNode);
-
-    return tempNode;
+    emit nodesAdded(*tree, nodes);
+    return nodes;
 }
 
 bool Skeletonizer::addSegment(nodeListElement & sourceNode, nodeListElement & targetNode) {
@@ -1099,6 +1172,18 @@ bool Skeletonizer::addSegment(nodeListElement & sourceNode, nodeListElement & ta
         return false;
     }
 
+    insertSegment(sourceNode, targetNode);
+
+    updateCircRadius(&sourceNode);
+    updateCircRadius(&targetNode);
+
+    Session::singleton().unsavedChanges = true;
+    emit segmentAdded(sourceNode.nodeID, targetNode.nodeID);
+    return true;
+}
+
+void Skeletonizer::insertSegment(nodeListElement & sourceNode, nodeListElement & targetNode) {
+    UndoJournal::singleton().segmentAdded(sourceNode, targetNode);
      // Add the segment to the tree structure
     sourceNode.segments.emplace_back(sourceNode, targetNode);
     targetNode.segments.emplace_back(sourceNode, targetNode, false);//although it’s the ›reverse‹ segment, its direction doesn’t change
@@ -1109,13 +1194,6 @@ bool Skeletonizer::addSegment(nodeListElement & sourceNode, nodeListElement & ta
 
     /* Do we really skip this node? Test cum dist. to last rendered node! */
     sourceSegIt->length = sourceSegIt->sisterSegment->length = Dataset::current().scale.componentMul(targetNode.position - sourceNode.position).length();
-
-    updateCircRadius(&sourceNode);
-    updateCircRadius(&targetNode);
-
-    Session::singleton().unsavedChanges = true;
-    emit segmentAdded(sourceNode.nodeID, targetNode.nodeID);
-    return true;
 }
 
 void Skeletonizer::toggleLink(nodeListElement & lhs, nodeListElement & rhs) {
@@ -1130,6 +1208,7 @@ void Skeletonizer::toggleLink(nodeListElement & lhs, nodeListElement & rhs) {
 }
 
 void Skeletonizer::clearSkeleton() {
+    UndoJournal::singleton().clear();// its records refer to node and tree ids that are gone now
     skeletonState = SkeletonState{};
     numberProperties = textProperties = {};
     emit resetData();
@@ -1149,10 +1228,14 @@ bool Skeletonizer::mergeTrees(decltype(treeListElement::treeID) treeID1, decltyp
         return false;
     }
 
+    std::vector<decltype(nodeListElement::nodeID)> movedIDs;
+    movedIDs.reserve(tree2->nodes.size());
     for (auto & node : tree2->nodes) {
         node.correspondingTree = tree1;
+        movedIDs.emplace_back(node.nodeID);
     }
-    tree1->nodes.splice(std::end(tree1->nodes), tree2->nodes);
+    UndoJournal::singleton().nodesMoved(tree2->treeID, movedIDs);
+    tree1->nodes.splice(tree2->nodes);
     if (tree2->mesh) {
         if (tree1->mesh == nullptr) {
             std::swap(tree1->mesh, tree2->mesh);
@@ -1301,6 +1384,7 @@ treeListElement & Skeletonizer::addTree(boost::optional<decltype(treeListElement
 
     if (!color) {// set default tree color
         QSignalBlocker blocker{this};// don’t emit treeChanged before treeAdded later
+        UndoJournal::Blocker journalBlocker;// part of the addition
         restoreDefaultTreeColor(newTree);
     } else {
         newTree.color = color.get();
@@ -1311,6 +1395,7 @@ treeListElement & Skeletonizer::addTree(boost::optional<decltype(treeListElement
         skeletonState.nextAvailableTreeID = findNextAvailableID(skeletonState.nextAvailableTreeID, skeletonState.treesByID);
     }
 
+    UndoJournal::singleton().treeAdded(newTree);
     Session::singleton().unsavedChanges = true;
 
     emit treeAddedSignal(newTree);
@@ -1360,6 +1445,7 @@ treeListElement * Skeletonizer::getTreeWithNextID(treeListElement * currentTree)
 }
 
 void Skeletonizer::setColor(treeListElement & tree, const QColor & color) {
+    UndoJournal::singleton().colorChanged(tree);
     tree.color = color;
     tree.colorSetManually = true;
     Session::singleton().unsavedChanges = true;
@@ -1379,6 +1465,7 @@ std::list<segmentListElement>::iterator Skeletonizer::findSegmentBetween(nodeLis
 }
 
 void Skeletonizer::setRadius(nodeListElement & node, const float radius) {
+    UndoJournal::singleton().radiusChanged(node);
     node.radius = radius;
     updateCircRadius(&node);
     Session::singleton().unsavedChanges = true;
@@ -1386,8 +1473,10 @@ void Skeletonizer::setRadius(nodeListElement & node, const float radius) {
 }
 
 void Skeletonizer::setPosition(nodeListElement & node, const Coordinate & position) {
+    UndoJournal::singleton().positionChanged(node);
     auto oldPos = node.position;
     node.position = position.capped({0, 0, 0}, Dataset::current().boundary);
+    skeletonState.nodeIndex.move(node, oldPos);
     const quint64 newSubobjectId = readVoxel(position);
     Skeletonizer::singleton().movedHybridNode(node, newSubobjectId, oldPos);
     Session::singleton().unsavedChanges = true;
@@ -1437,15 +1526,7 @@ bool Skeletonizer::extractConnectedComponent(std::uint64_t nodeID) {
 
     auto & newTree = addTree();
     // Splitting the connected component.
-    for (auto * nodeIt : visitedNodes) {
-        if (nodeIt->correspondingTree->nodes.empty()) {//remove empty trees
-            delTree(nodeIt->correspondingTree->treeID);
-        }
-        // Removing node list element from its old position
-        // Inserting node list element into new list.
-        newTree.nodes.splice(std::end(newTree.nodes), nodeIt->correspondingTree->nodes, nodeIt->iterator);
-        nodeIt->correspondingTree = &newTree;
-    }
+    moveNodesToTree(std::vector<nodeListElement *>(std::begin(visitedNodes), std::end(visitedNodes)), newTree);
     Session::singleton().unsavedChanges = true;
     setActiveTreeByID(newTree.treeID);//the empty tree had no active node
 
@@ -1461,6 +1542,7 @@ void Skeletonizer::notifyChanged(nodeListElement & node) {
 
 template<typename T>
 void Skeletonizer::setComment(T & elem, const QString & newContent) {
+    UndoJournal::singleton().propertiesChanged(elem);
     if (newContent.isEmpty()) {
         elem.properties.remove("comment");
     } else {
@@ -1472,6 +1554,19 @@ void Skeletonizer::setComment(T & elem, const QString & newContent) {
 template void Skeletonizer::setComment(treeListElement &, const QString & newContent);// explicit instantiation for other TUs
 template void Skeletonizer::setComment(nodeListElement &, const QString & newContent);
 
+template<typename T>
+void Skeletonizer::setProperties(T & elem, const PropertyMap & properties) {
+    UndoJournal::singleton().propertiesChanged(elem);
+    elem.properties = properties;
+    if (registerProperties(properties)) {
+        emit propertiesChanged(numberProperties, textProperties);
+    }
+    Session::singleton().unsavedChanges = true;
+    notifyChanged(elem);
+}
+template void Skeletonizer::setProperties(treeListElement &, const PropertyMap & properties);
+template void Skeletonizer::setProperties(nodeListElement &, const PropertyMap & properties);
+
 /*
  * Create a synapse, starting with a presynapse
  * 1. 'shift+c': Active Node is marked as a presynapse
@@ -1593,6 +1688,7 @@ void Skeletonizer::jumpToNode(const nodeListElement & node) {
 }
 
 void Skeletonizer::restoreDefaultTreeColor(treeListElement & tree) {
+    UndoJournal::singleton().colorChanged(tree);
     const auto index = (tree.treeID - 1) % state->viewerState->treeColors.size();
     tree.color = QColor::fromRgb(std::get<0>(state->viewerState->treeColors[index])
                        , std::get<1>(state->viewerState->treeColors[index])
@@ -1627,9 +1723,9 @@ bool Skeletonizer::updateCircRadius(nodeListElement *node) {
 }
 
 float Skeletonizer::radius(const nodeListElement & node) const {
-    const auto propertyName = state->viewerState->highlightedNodePropertyByRadius;
-    if(!propertyName.isEmpty() && node.properties.contains(propertyName)) {
-        return state->viewerState->nodePropertyRadiusScale * node.properties.value(propertyName).toDouble();
+    const auto & propertyKey = state->viewerState->nodePropertyRadiusKey;
+    if(propertyKey && node.properties.contains(propertyKey.get())) {
+        return state->viewerState->nodePropertyRadiusScale * node.properties.number(propertyKey.get());
     } else {
         const auto comment = node.getComment();
         if(comment.isEmpty() == false && CommentSetting::useCommentNodeRadius) {
@@ -1648,9 +1744,8 @@ void Skeletonizer::convertToNumberProperty(const QString & property) {
     }
     for (auto pair : skeletonState.nodesByNodeID) {
         auto & node = *pair.second;
-        const auto it = node.properties.find(property);
-        if (it != std::end(node.properties)) {
-            node.properties[property] = it->toDouble();
+        if (node.properties.contains(property)) {
+            node.properties.insert(property, node.properties.value(property).toDouble());
         }
     }
     numberProperties.insert(property);
@@ -1688,12 +1783,24 @@ void Skeletonizer::goToNode(const NodeGenerator::Direction direction) {
     }
 }
 
+void Skeletonizer::moveNodesToTree(const std::vector<nodeListElement *> & nodes, treeListElement & tree) {
+    std::unordered_map<decltype(treeListElement::treeID), std::vector<decltype(nodeListElement::nodeID)>> movedIDs;// per previous tree
+    for (auto * const node : nodes) {
+        if (node->correspondingTree != &tree) {
+            movedIDs[node->correspondingTree->treeID].emplace_back(node->nodeID);
+            tree.nodes.splice(node->correspondingTree->nodes, *node);
+            node->correspondingTree = &tree;
+        }
+    }
+    for (const auto & pair : movedIDs) {
+        UndoJournal::singleton().nodesMoved(pair.first, pair.second);
+    }
+    Session::singleton().unsavedChanges = true;
+}
+
 void Skeletonizer::moveSelectedNodesToTree(decltype(treeListElement::treeID) treeID) {
     if (auto * newTree = findTreeByTreeID(treeID)) {
-        for (auto * const node : state->skeletonState->selectedNodes) {
-            newTree->nodes.splice(std::end(newTree->nodes), node->correspondingTree->nodes, node->iterator);
-            node->correspondingTree = newTree;
-        }
+        moveNodesToTree(state->skeletonState->selectedNodes, *newTree);
         emit resetData();
         emit setActiveTreeByID(treeID);
     }
@@ -24,6 +24,7 @@
 #define SKELETONIZER_H
 
 #include "session.h"
+#include "skeleton/nodeindex.h"
 #include "skeleton/skeleton_dfs.h"
 #include "skeleton/tree.h"
 #include "widgets/viewports/viewportbase.h"
@@ -40,6 +41,8 @@
 #include <algorithm>
 #include <memory>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 class nodeListElement;
 class segmentListElement;
@@ -95,7 +98,9 @@ public:
 
     void toggleDirection() {
         if(postSynapse != nullptr && preSynapse != nullptr) {
-            std::swap(synapticCleft->properties["preSynapse"], synapticCleft->properties["postSynapse"]);
+            const auto pre = synapticCleft->properties.value("preSynapse");
+            synapticCleft->properties.insert("preSynapse", synapticCleft->properties.value("postSynapse"));
+            synapticCleft->properties.insert("postSynapse", pre);
             std::swap(preSynapse, postSynapse);
         }
     }
@@ -141,6 +146,7 @@ struct SkeletonState {
     std::list<Synapse> synapses;
     std::unordered_map<decltype(treeListElement::treeID), treeListElement *> treesByID;
     std::unordered_map<decltype(nodeListElement::nodeID), nodeListElement *> nodesByNodeID;
+    NodeIndex nodeIndex;// spatial lookup of nodes
 
     decltype(treeListElement::treeID) nextAvailableTreeID{1};
     decltype(nodeListElement::nodeID) nextAvailableNodeID{1};
@@ -181,8 +187,14 @@ struct SkeletonState {
 
 class Skeletonizer : public QObject {
     Q_OBJECT
+    friend class UndoJournal;
+
     QSet<QString> textProperties;
     QSet<QString> numberProperties;
+    nodeListElement & insertNode(const decltype(nodeListElement::nodeID) nodeID, const float radius, treeListElement & tree, const Coordinate & position, const ViewportType VPtype, const int inMag, const uint64_t time, const PropertyMap & properties);
+    void insertSegment(nodeListElement & sourceNode, nodeListElement & targetNode);
+    bool registerProperties(const PropertyMap & properties);
+    void moveNodesToTree(const std::vector<nodeListElement *> & nodes, treeListElement & tree);
 public:
     bool simpleEnough(const std::vector<nodeListElement*> & nodes) {
         return nodes.size() < 100;
@@ -208,6 +220,14 @@ public:
             emit resetData();// is also blocked if it was blocked initially
         }
     }
+    // nodes and segments for addNodes, per node vectors are either empty (defaults) or as long as positions
+    struct NodeBatch {
+        std::vector<Coordinate> positions;
+        std::vector<float> radii;// default node radius if empty
+        std::vector<decltype(nodeListElement::nodeID)> nodeIDs;// next available ids if empty
+        std::vector<PropertyMap> properties;
+        std::vector<std::pair<std::size_t, std::size_t>> segments;// indices into positions
+    };
     template<typename T>
     T * active();
     template<typename T>
@@ -238,6 +258,9 @@ public:
     nodeListElement * getNodeWithPrevID(nodeListElement * currentNode, bool sameTree);
     nodeListElement * getNodeWithNextID(nodeListElement * currentNode, bool sameTree);
     nodeListElement * findNearbyNode(treeListElement * nearbyTree, Coordinate searchPosition);
+    std::vector<nodeListElement *> findNearestNodes(const floatCoordinate & position, const std::size_t count) const;
+    std::vector<nodeListElement *> findNodesInRadius(const floatCoordinate & position, const float radius) const;
+    std::vector<nodeListElement *> findNodesInBox(const Coordinate & min, const Coordinate & max) const;
 
     QList<treeListElement *> findTreesContainingComment(const QString &comment);
 
@@ -246,8 +269,11 @@ public:
 
     template<typename T>
     void setComment(T & elem, const QString & newContent);
+    template<typename T>
+    void setProperties(T & elem, const PropertyMap & properties);
 
-    boost::optional<nodeListElement &> addNode(boost::optional<decltype(nodeListElement::nodeID)> nodeID, const float radius, const decltype(treeListElement::treeID) treeID, const Coordinate & position, const ViewportType VPtype, const int inMag, boost::optional<uint64_t> time, const bool respectLocks, const QHash<QString, QVariant> & properties = {});
+    boost::optional<nodeListElement &> addNode(boost::optional<decltype(nodeListElement::nodeID)> nodeID, const float radius, const decltype(treeListElement::treeID) treeID, const Coordinate & position, const ViewportType VPtype, const int inMag, boost::optional<uint64_t> time, const bool respectLocks, const PropertyMap & properties = {});
+    std::vector<nodeListElement *> addNodes(const decltype(treeListElement::treeID) treeID, const NodeBatch & batch);
 
     void selectNodes(QSet<nodeListElement *> nodes);
     void toggleNodeSelection(const QSet<nodeListElement *> & nodes);
@@ -322,8 +348,9 @@ signals:
     void lockedToNode(const std::uint64_t nodeID);
     void unlockedNode();
     void nodeAddedSignal(const nodeListElement & node);
+    void nodesAdded(const treeListElement & tree, const std::vector<nodeListElement *> & nodes);// batch of addNodes, segments among them included
     void nodeChangedSignal(const nodeListElement & node);
-    void nodeRemovedSignal(const std::uint64_t nodeID);
+    void nodeRemovedSignal(const std::uint64_t nodeID, const std::uint64_t treeID);
     void jumpedToNodeSignal(const nodeListElement & node);
     void propertiesChanged(const QSet<QString> & numberProperties, const QSet<QString> & textProperties);
     void segmentAdded(const quint64 sourceID, const quint64 targetID);
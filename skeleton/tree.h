@@ -25,6 +25,7 @@
 
 #include "mesh/mesh.h"
 #include "node.h"
+#include "nodelist.h"
 #include "property_query.h"
 
 #include <QColor>
@@ -41,7 +42,7 @@ public:
     std::uint64_t treeID;
     std::list<treeListElement>::iterator iterator;
 
-    std::list<nodeListElement> nodes;
+    NodeList nodes;
     std::unique_ptr<Mesh> mesh;
 
     bool render{true};
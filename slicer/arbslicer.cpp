@@ -0,0 +1,278 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+#include "arbslicer.h"
+
+#include "dataset.h"
+#include "segmentation/segmentation.h"
+#include "stateInfo.h"
+
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr int tileRows = 16;
+
+// number of steps i ∈ [0, limit) for which lo ≤ p + i·v < hi holds
+int stepsInside(const float p, const float v, const float lo, const float hi, const int limit) {
+    if (p < lo || p >= hi) {
+        return 0;
+    }
+    if (v > 0) {
+        return std::min<float>(limit, std::ceil((hi - p) / v));
+    } else if (v < 0) {
+        return std::min<float>(limit, std::floor((p - lo) / -v) + 1);
+    }
+    return limit;
+}
+}
+
+ArbSlicer::ArbSlicer(const std::size_t layerId, const Plane & plane) : cubeEdgeLen{Dataset::datasets[layerId].cubeEdgeLength}, plane{plane}, cubeLock{&state->protectCube2Pointer} {
+    const auto last = static_cast<float>(plane.size - 1);
+    const std::array<floatCoordinate, 4> corners{{plane.origin, plane.origin + plane.v1 * last, plane.origin - plane.v2 * last, plane.origin + plane.v1 * last - plane.v2 * last}};
+    floatCoordinate min = corners[0], max = corners[0];
+    for (const auto & corner : corners) {
+        min = {std::min(min.x, corner.x), std::min(min.y, corner.y), std::min(min.z, corner.z)};
+        max = {std::max(max.x, corner.x), std::max(max.y, corner.y), std::max(max.z, corner.z)};
+    }
+    // one voxel margin for rounding and the upper interpolation neighbour
+    const auto toCube = [this](const float coord){ return static_cast<int>(std::floor(coord / cubeEdgeLen)); };
+    minCube = {toCube(min.x - 1), toCube(min.y - 1), toCube(min.z - 1)};
+    const CoordOfCube maxCube{toCube(max.x + 1), toCube(max.y + 1), toCube(max.z + 1)};
+    cubeCount = {maxCube.x - minCube.x + 1, maxCube.y - minCube.y + 1, maxCube.z - minCube.z + 1};
+    cubes.resize(cubeCount.x * cubeCount.y * cubeCount.z);
+
+    const auto magIndex = Dataset::datasets[layerId].magIndex;
+    for (int z = 0; z < cubeCount.z; ++z)
+    for (int y = 0; y < cubeCount.y; ++y)
+    for (int x = 0; x < cubeCount.x; ++x) {
+        cubes[x + y * cubeCount.x + z * cubeCount.x * cubeCount.y] = cubeQuery(state->cube2Pointer, layerId, magIndex, minCube + CoordOfCube{x, y, z});
+    }
+}
+
+void * ArbSlicer::cubeAt(const CoordOfCube & cube) const {
+    const auto rel = cube - minCube;
+    if (rel.x < 0 || rel.y < 0 || rel.z < 0 || rel.x >= cubeCount.x || rel.y >= cubeCount.y || rel.z >= cubeCount.z) {
+        return nullptr;
+    }
+    return cubes[rel.x + rel.y * cubeCount.x + rel.z * cubeCount.x * cubeCount.y];
+}
+
+void * ArbSlicer::cubeOfVoxel(const Coordinate & voxel) const {
+    const auto toCube = [this](const int coord){ return coord >= 0 ? coord / cubeEdgeLen : (coord + 1) / cubeEdgeLen - 1; };
+    return cubeAt({toCube(voxel.x), toCube(voxel.y), toCube(voxel.z)});
+}
+
+template<typename T>
+T ArbSlicer::voxelAt(const Coordinate & voxel, const T missing) const {
+    const auto * data = reinterpret_cast<const T *>(cubeOfVoxel(voxel));
+    if (data == nullptr) {
+        return missing;
+    }
+    const auto inCube = Coordinate{(voxel.x % cubeEdgeLen + cubeEdgeLen) % cubeEdgeLen, (voxel.y % cubeEdgeLen + cubeEdgeLen) % cubeEdgeLen, (voxel.z % cubeEdgeLen + cubeEdgeLen) % cubeEdgeLen};
+    return data[inCube.x + inCube.y * cubeEdgeLen + inCube.z * cubeEdgeLen * cubeEdgeLen];
+}
+
+/**
+ * Splits row into spans of texels sampling from a single cube.
+ * offset is added to the sample position before flooring (½ for nearest neighbour),
+ * shrink excludes the last voxel layers of a cube so the +1 neighbours stay inside as well.
+ * func(cube, position, positionInCube, firstTexel, count, inside) is called with count = 1 and inside = false
+ * for texels whose neighbourhood straddles a cube border, those need to be sampled per voxel.
+ */
+template<typename SpanFunc>
+void ArbSlicer::forEachSpan(const int row, const float offset, const int shrink, SpanFunc && func) const {
+    const auto rowStart = plane.origin - plane.v2 * row + offset;
+    for (int s = 0; s < plane.size;) {
+        const auto pos = rowStart + plane.v1 * s;
+        const auto toCube = [this](const float coord){ return static_cast<int>(std::floor(coord / cubeEdgeLen)); };
+        const CoordOfCube cube{toCube(pos.x), toCube(pos.y), toCube(pos.z)};
+        const auto cubeOrigin = cube.cube2Global(cubeEdgeLen, 1);
+        const auto remaining = plane.size - s;
+        const auto count = std::min({stepsInside(pos.x, plane.v1.x, cubeOrigin.x, cubeOrigin.x + cubeEdgeLen - shrink, remaining)
+                                   , stepsInside(pos.y, plane.v1.y, cubeOrigin.y, cubeOrigin.y + cubeEdgeLen - shrink, remaining)
+                                   , stepsInside(pos.z, plane.v1.z, cubeOrigin.z, cubeOrigin.z + cubeEdgeLen - shrink, remaining)});
+        const auto * data = cubeAt(cube);
+        func(data, pos, pos - cubeOrigin, s, std::max(1, count), count > 0);
+        s += std::max(1, count);
+    }
+}
+
+template<typename RowFunc>
+void ArbSlicer::forEachRow(RowFunc && func) const {
+    std::vector<int> tiles;
+    for (int row = 0; row < plane.size; row += tileRows) {
+        tiles.emplace_back(row);
+    }
+    QtConcurrent::blockingMap(tiles, [this, &func](const int first){
+        for (int row = first; row < std::min(first + tileRows, plane.size); ++row) {
+            func(row);
+        }
+    });
+}
+
+void ArbSlicer::sliceRaw(rgba * texture, const std::array<rgba, 256> & lut, const bool trilinear) const {
+    const rgba blank{{0, 0, 0, 255}};
+    const int edge = cubeEdgeLen;
+    const int area = cubeEdgeLen * cubeEdgeLen;
+    const auto v = plane.v1;
+    forEachRow([&](const int row){
+        auto * out = texture + row * plane.rowStride;
+        if (!trilinear) {
+            forEachSpan(row, 0.5f, 0, [&](const void * cube, const floatCoordinate & pos, const floatCoordinate & local, const int first, const int count, const bool inside){
+                if (cube == nullptr && inside) {
+                    std::fill(out + first, out + first + count, blank);
+                } else if (!inside) {
+                    const Coordinate voxel{static_cast<int>(std::floor(pos.x)), static_cast<int>(std::floor(pos.y)), static_cast<int>(std::floor(pos.z))};
+                    out[first] = cubeOfVoxel(voxel) == nullptr ? blank : lut[voxelAt<std::uint8_t>(voxel)];
+                } else {
+                    const auto * data = reinterpret_cast<const std::uint8_t *>(cube);
+                    // branch free, float inaccuracies at the span ends are clamped into the cube
+                    for (int i = 0; i < count; ++i) {
+                        const int x = std::min(edge - 1, std::max(0, static_cast<int>(local.x + i * v.x)));
+                        const int y = std::min(edge - 1, std::max(0, static_cast<int>(local.y + i * v.y)));
+                        const int z = std::min(edge - 1, std::max(0, static_cast<int>(local.z + i * v.z)));
+                        out[first + i] = lut[data[x + y * edge + z * area]];
+                    }
+                }
+            });
+        } else {
+            forEachSpan(row, 0.0f, 1, [&](const void * cube, const floatCoordinate & pos, const floatCoordinate & local, const int first, const int count, const bool inside){
+                if (cube == nullptr && inside) {
+                    std::fill(out + first, out + first + count, blank);
+                } else if (!inside) {
+                    const Coordinate base{static_cast<int>(std::floor(pos.x)), static_cast<int>(std::floor(pos.y)), static_cast<int>(std::floor(pos.z))};
+                    if (cubeOfVoxel(base) == nullptr) {// same as the spans of missing cubes
+                        out[first] = blank;
+                        return;
+                    }
+                    const auto baseValue = voxelAt<std::uint8_t>(base);
+                    const floatCoordinate frac = pos - base;
+                    float value = 0;
+                    for (int corner = 0; corner < 8; ++corner) {
+                        const Coordinate offset{corner & 1, (corner >> 1) & 1, (corner >> 2) & 1};
+                        const auto weight = (offset.x ? frac.x : 1 - frac.x) * (offset.y ? frac.y : 1 - frac.y) * (offset.z ? frac.z : 1 - frac.z);
+                        value += weight * voxelAt<std::uint8_t>(base + offset, baseValue);// missing neighbours don’t darken the border
+                    }
+                    out[first] = lut[static_cast<std::uint8_t>(std::min(255.f, value + 0.5f))];
+                } else {
+                    const auto * data = reinterpret_cast<const std::uint8_t *>(cube);
+                    for (int i = 0; i < count; ++i) {
+                        const float px = local.x + i * v.x, py = local.y + i * v.y, pz = local.z + i * v.z;
+                        const int x = std::min(edge - 2, std::max(0, static_cast<int>(px)));
+                        const int y = std::min(edge - 2, std::max(0, static_cast<int>(py)));
+                        const int z = std::min(edge - 2, std::max(0, static_cast<int>(pz)));
+                        const float fx = std::min(1.f, std::max(0.f, px - x));
+                        const float fy = std::min(1.f, std::max(0.f, py - y));
+                        const float fz = std::min(1.f, std::max(0.f, pz - z));
+                        const auto * c = data + x + y * edge + z * area;
+                        const float c00 = c[0] + fx * (c[1] - c[0]);
+                        const float c10 = c[edge] + fx * (c[edge + 1] - c[edge]);
+                        const float c01 = c[area] + fx * (c[area + 1] - c[area]);
+                        const float c11 = c[area + edge] + fx * (c[area + edge + 1] - c[area + edge]);
+                        const float c0 = c00 + fy * (c10 - c00);
+                        const float c1 = c01 + fy * (c11 - c01);
+                        out[first + i] = lut[static_cast<std::uint8_t>(c0 + fz * (c1 - c0) + 0.5f)];
+                    }
+                }
+            });
+        }
+    });
+}
+
+/**
+ * Subobject ids are sampled in parallel, colors are then resolved once per run of equal ids
+ * (on the calling thread, the subobject cache isn’t thread-safe).
+ * Borders of selected objects are highlighted by comparing the 4 neighbours within the plane.
+ */
+void ArbSlicer::sliceOverlay(rgba * texture) const {
+    auto & seg = Segmentation::singleton();
+    const auto background = seg.getBackgroundId();
+    const int edge = cubeEdgeLen;
+    const int area = cubeEdgeLen * cubeEdgeLen;
+    const auto v = plane.v1;
+    const auto stride = plane.rowStride;
+    std::vector<std::uint64_t> ids(static_cast<std::size_t>(stride) * plane.size);
+    forEachRow([&](const int row){
+        auto * out = ids.data() + row * stride;
+        forEachSpan(row, 0.5f, 0, [&](const void * cube, const floatCoordinate & pos, const floatCoordinate & local, const int first, const int count, const bool inside){
+            if (cube == nullptr && inside) {
+                std::fill(out + first, out + first + count, background);
+            } else if (!inside) {
+                out[first] = voxelAt<std::uint64_t>({static_cast<int>(std::floor(pos.x)), static_cast<int>(std::floor(pos.y)), static_cast<int>(std::floor(pos.z))}, background);
+            } else {
+                const auto * data = reinterpret_cast<const std::uint64_t *>(cube);
+                for (int i = 0; i < count; ++i) {
+                    const int x = std::min(edge - 1, std::max(0, static_cast<int>(local.x + i * v.x)));
+                    const int y = std::min(edge - 1, std::max(0, static_cast<int>(local.y + i * v.y)));
+                    const int z = std::min(edge - 1, std::max(0, static_cast<int>(local.z + i * v.z)));
+                    out[first + i] = data[x + y * edge + z * area];
+                }
+            }
+        });
+    });
+
+    const auto highlight = seg.highlightBorder;
+    const auto hover = seg.hoverVersion;
+    std::vector<std::uint8_t> selected(highlight ? ids.size() : 0);
+    std::vector<std::uint64_t> objects(highlight && hover ? ids.size() : 0);
+    for (int row = 0; row < plane.size; ++row) {
+        const auto rowOffset = static_cast<std::size_t>(row) * stride;
+        for (int s = 0; s < plane.size;) {
+            const auto id = ids[rowOffset + s];
+            const auto & entry = seg.cachedSubobject(id);
+            int end = s + 1;
+            while (end < plane.size && ids[rowOffset + end] == id) {
+                ++end;
+            }
+            const rgba color{{std::get<0>(entry.color), std::get<1>(entry.color), std::get<2>(entry.color), std::get<3>(entry.color)}};
+            std::fill(texture + rowOffset + s, texture + rowOffset + end, color);
+            if (highlight) {
+                const auto mark = hover ? entry.selected && entry.largestObjectIndex == seg.mouseFocusedObjectId : entry.selected;
+                std::fill(std::begin(selected) + rowOffset + s, std::begin(selected) + rowOffset + end, mark);
+                if (hover) {
+                    std::fill(std::begin(objects) + rowOffset + s, std::begin(objects) + rowOffset + end, entry.largestObjectIndex);
+                }
+            }
+            s = end;
+        }
+    }
+    if (!highlight) {
+        return;
+    }
+    forEachRow([&](const int row){
+        if (row == 0 || row == plane.size - 1) {
+            return;
+        }
+        // borders between objects when hovering, between subobjects otherwise
+        const auto & labels = hover ? objects : ids;
+        const auto rowOffset = static_cast<std::size_t>(row) * stride;
+        for (int s = 1; s < plane.size - 1; ++s) {
+            const auto i = rowOffset + s;
+            if (selected[i] && (labels[i] != labels[i - 1] || labels[i] != labels[i + 1] || labels[i] != labels[i - stride] || labels[i] != labels[i + stride])) {
+                texture[i][3] = std::min(255, texture[i][3] * 4);
+            }
+        }
+    });
+}
@@ -0,0 +1,80 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+#ifndef ARBSLICER_H
+#define ARBSLICER_H
+
+#include "coordinate.h"
+
+#include <QMutexLocker>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * CPU slicer for the arbitrary viewport.
+ *
+ * The cube pointers touched by the plane are queried once, protectCube2Pointer stays locked
+ * for the lifetime of the slicer so the loader cannot free them while they are sampled.
+ * Every texture row is then walked in spans that stay inside a single cube,
+ * so the inner loops only do index arithmetic and loads.
+ * Rows are distributed in tiles over the global thread pool.
+ */
+class ArbSlicer {
+public:
+    using rgba = std::array<std::uint8_t, 4>;
+
+    struct Plane {
+        floatCoordinate origin;// center of the first texel in voxels of the sliced mag
+        floatCoordinate v1;// step to the next texel in a row
+        floatCoordinate v2;// step to the previous row, rows advance along -v2
+        int size;// texels per row and number of rows
+        int rowStride;// texels between the starts of two rows in the output
+    };
+
+private:
+    const int cubeEdgeLen;
+    const Plane plane;
+    CoordOfCube minCube;
+    Coordinate cubeCount;
+    std::vector<void *> cubes;
+    QMutexLocker cubeLock;
+
+    void * cubeAt(const CoordOfCube & cube) const;
+    void * cubeOfVoxel(const Coordinate & voxel) const;
+    template<typename T>
+    T voxelAt(const Coordinate & voxel, const T missing = T{}) const;
+    template<typename SpanFunc>
+    void forEachSpan(const int row, const float offset, const int shrink, SpanFunc && func) const;
+    template<typename RowFunc>
+    void forEachRow(RowFunc && func) const;
+
+public:
+    ArbSlicer(const std::size_t layerId, const Plane & plane);
+
+    void sliceRaw(rgba * texture, const std::array<rgba, 256> & lut, const bool trilinear) const;
+    void sliceOverlay(rgba * texture) const;
+};
+
+#endif // ARBSLICER_H
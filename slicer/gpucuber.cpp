@@ -23,89 +23,253 @@
 #include "gpucuber.h"
 
 #include "segmentation/segmentation.h"
+#include "stateInfo.h"
 
-#include <boost/multi_array.hpp>
+#include <QDebug>
+#include <QOpenGLFunctions>
+#include <QtConcurrentRun>
 
-gpu_raw_cube::gpu_raw_cube(const int gpucubeedge, const bool index) {
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
+
+gpu_raw_cube::gpu_raw_cube(const int gpucubeedge, const QOpenGLTexture::TextureFormat format) {
+    const bool index = format != QOpenGLTexture::R8_UNorm;
     cube.setAutoMipMapGenerationEnabled(false);
     cube.setSize(gpucubeedge, gpucubeedge, gpucubeedge);
     cube.setMipLevels(1);
     cube.setMinificationFilter(index ? QOpenGLTexture::Nearest : QOpenGLTexture::Linear);
     cube.setMagnificationFilter(index ? QOpenGLTexture::Nearest : QOpenGLTexture::Linear);
-    cube.setFormat(index ? QOpenGLTexture::R16_UNorm : QOpenGLTexture::R8_UNorm);
+    cube.setFormat(format);
     cube.setWrapMode(QOpenGLTexture::ClampToEdge);
     cube.allocateStorage();
 }
 
-std::vector<char> gpu_raw_cube::prepare(boost::multi_array_ref<uint8_t, 3>::const_array_view<3>::type view) {
-    std::vector<char> data;
-    for (const auto & d2 : view)
-    for (const auto & d1 : d2)
-    for (const auto & elem : d1) {
-        data.emplace_back(elem);
+template<typename elem_type>
+std::vector<elem_type> gpu_raw_cube::subCube(const elem_type * data, const int cpucubeedge, const int gpucubeedge, const Coordinate offset) {
+    std::vector<elem_type> sub(static_cast<std::size_t>(gpucubeedge) * gpucubeedge * gpucubeedge);
+    auto * dest = sub.data();
+    for (int z = 0; z < gpucubeedge; ++z)
+    for (int y = 0; y < gpucubeedge; ++y) {// rows are contiguous in both cubes
+        const auto * row = data + (z + offset.z) * cpucubeedge * cpucubeedge + (y + offset.y) * cpucubeedge + offset.x;
+        std::memcpy(dest, row, gpucubeedge * sizeof(elem_type));
+        dest += gpucubeedge;
     }
-    return data;
+    return sub;
 }
 
-void gpu_raw_cube::upload(const std::vector<char> & data) {
+void gpu_raw_cube::upload(const std::vector<std::uint8_t> & data) {
     cube.setData(QOpenGLTexture::Red, QOpenGLTexture::UInt8, data.data());
 }
 
-void gpu_raw_cube::generate(boost::multi_array_ref<uint8_t, 3>::const_array_view<3>::type view) {
-    upload(prepare(view));
+gpu_slot_table::gpu_slot_table() {
+    assign({0});// fallback slot once the table is exhausted, never released
 }
 
-gpu_lut_cube::gpu_lut_cube(const int gpucubeedge) : gpu_raw_cube(gpucubeedge, true) {
-    lut.setAutoMipMapGenerationEnabled(false);
-    lut.setMipLevels(1);
-    lut.setMinificationFilter(QOpenGLTexture::Nearest);
-    lut.setMagnificationFilter(QOpenGLTexture::Nearest);
-    lut.setFormat(QOpenGLTexture::RGBA8_UNorm);
+std::vector<std::uint32_t> gpu_slot_table::assign(const std::vector<std::uint64_t> & ids) {
+    std::vector<std::uint32_t> result;
+    result.reserve(ids.size());
+    QMutexLocker locker(&mutex);
+    for (const auto id : ids) {
+        const auto it = slotOfId.find(id);
+        if (it != std::end(slotOfId)) {
+            result.emplace_back(it->second);
+        } else if (!freeSlots.empty()) {
+            result.emplace_back(slotOfId[id] = freeSlots.back());
+            freeSlots.pop_back();
+            idOfSlot[result.back()] = id;
+            newSlots.emplace_back(result.back());
+        } else if (idOfSlot.size() < maxSlots) {
+            result.emplace_back(slotOfId[id] = idOfSlot.size());
+            idOfSlot.emplace_back(id);
+            references.emplace_back(0);
+            newSlots.emplace_back(result.back());
+        } else {
+            if (!warnedFull) {
+                warnedFull = true;
+                qWarning() << "gpu slot table full, further subobjects are rendered as background";
+            }
+            result.emplace_back(0);
+        }
+        ++references[result.back()];
+    }
+    return result;
 }
 
-std::vector<gpu_lut_cube::gpu_index> gpu_lut_cube::prepare(boost::multi_array_ref<uint64_t, 3>::const_array_view<3>::type view) {
+void gpu_slot_table::release(const std::vector<std::uint32_t> & slots) {
+    QMutexLocker locker(&mutex);
+    for (const auto slot : slots) {
+        if (--references[slot] == 0) {
+            slotOfId.erase(idOfSlot[slot]);
+            freeSlots.emplace_back(slot);
+        }
+    }
+}
+
+bool gpu_slot_table::updateColors() {
+    const auto & seg = Segmentation::singleton();
+    const auto generation = seg.subobjectCacheGeneration();
+    QMutexLocker locker(&mutex);
+    const auto resize = !colorTexture.isCreated() || colors.size() < idOfSlot.size();
+    std::vector<std::uint64_t> changedIds;
+    const auto all = resize || (colorsGeneration != generation && !seg.subobjectsChangedSince(colorsGeneration, changedIds));
+    std::vector<std::uint32_t> dirty;
+    if (!all) {
+        dirty = std::move(newSlots);
+        for (const auto id : changedIds) {
+            const auto it = slotOfId.find(id);
+            if (it != std::end(slotOfId)) {
+                dirty.emplace_back(it->second);
+            }
+        }
+    }
+    newSlots.clear();
+    colorsGeneration = generation;
+    if (!all && dirty.empty()) {
+        return false;
+    }
+    colors.resize(idOfSlot.size());
+    auto resolve = [this, &seg](const std::uint32_t slot){
+        const auto & entry = seg.cachedSubobject(idOfSlot[slot]);
+        const auto color = entry.color;
+        // opacity is applied in the shader, alpha only tells hidden (0), visible (254) and selected (255) apart
+        const std::uint8_t visibility = std::get<3>(color) == 0 ? 0 : entry.selected ? 255 : 254;
+        colors[slot] = {{std::get<0>(color), std::get<1>(color), std::get<2>(color), visibility}};
+    };
+    if (all) {
+        for (std::uint32_t slot = 0; slot < idOfSlot.size(); ++slot) {
+            if (references[slot] != 0) {// free slots are resolved when they are reassigned
+                resolve(slot);
+            }
+        }
+    } else {
+        for (const auto slot : dirty) {
+            resolve(slot);
+        }
+    }
+
+    const int rows = std::max<int>(1, std::pow(2, std::ceil(std::log2((colors.size() + width - 1) / width))));
+    if (!colorTexture.isCreated() || colorTexture.height() < rows) {
+        colorTexture.destroy();
+        colorTexture.setAutoMipMapGenerationEnabled(false);
+        colorTexture.setMipLevels(1);
+        colorTexture.setMinificationFilter(QOpenGLTexture::Nearest);
+        colorTexture.setMagnificationFilter(QOpenGLTexture::Nearest);
+        colorTexture.setWrapMode(QOpenGLTexture::ClampToEdge);
+        colorTexture.setFormat(QOpenGLTexture::RGBA8_UNorm);
+        colorTexture.setSize(width, rows);
+        colorTexture.allocateStorage();
+    }
+    if (all) {
+        auto padded = colors;
+        padded.resize(static_cast<std::size_t>(width) * colorTexture.height());
+        colorTexture.setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, padded.data());
+        return true;
+    }
+    // upload only the rows containing changed slots
+    std::vector<int> dirtyRows;
+    for (const auto slot : dirty) {
+        dirtyRows.emplace_back(slot / width);
+    }
+    std::sort(std::begin(dirtyRows), std::end(dirtyRows));
+    dirtyRows.erase(std::unique(std::begin(dirtyRows), std::end(dirtyRows)), std::end(dirtyRows));
+    auto & gl = *QOpenGLContext::currentContext()->functions();
+    colorTexture.bind();
+    std::vector<std::array<std::uint8_t, 4>> row(width);
+    for (const auto y : dirtyRows) {
+        const auto first = std::begin(colors) + static_cast<std::size_t>(y) * width;
+        const auto last = std::begin(colors) + std::min(colors.size(), static_cast<std::size_t>(y + 1) * width);
+        std::fill(std::copy(first, last, std::begin(row)), std::end(row), std::array<std::uint8_t, 4>{});
+        gl.glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, 1, GL_RGBA, GL_UNSIGNED_BYTE, row.data());
+    }
+    colorTexture.release();
+    return true;
+}
+
+bool gpu_slot_table::selected(const std::uint32_t slot) const {
+    return slot < colors.size() && colors[slot][3] == 255;
+}
+
+gpu_lut_cube::gpu_lut_cube(const int gpucubeedge, const bool wideIndex)
+        : gpu_raw_cube(gpucubeedge, wideIndex ? QOpenGLTexture::RGBA8_UNorm : QOpenGLTexture::R16_UNorm), wideIndex{wideIndex} {
+    palette.setAutoMipMapGenerationEnabled(false);
+    palette.setMipLevels(1);
+    palette.setMinificationFilter(QOpenGLTexture::Nearest);
+    palette.setMagnificationFilter(QOpenGLTexture::Nearest);
+    palette.setWrapMode(QOpenGLTexture::ClampToEdge);
+    palette.setFormat(QOpenGLTexture::RGBA8_UNorm);
+}
+
+gpu_lut_cube::~gpu_lut_cube() {
+    if (slotTable != nullptr) {
+        slotTable->release(slots);
+    }
+}
+
+gpu_lut_cube::rgba gpu_lut_cube::pack(const std::uint32_t value) {
+    return {{static_cast<std::uint8_t>(value), static_cast<std::uint8_t>(value >> 8), static_cast<std::uint8_t>(value >> 16), 255}};
+}
+
+gpu_lut_cube::prepared gpu_lut_cube::prepare(const std::vector<std::uint64_t> & data, gpu_slot_table & slots) {
+    std::unordered_map<std::uint64_t, std::uint32_t> idToIndex;
+    std::vector<std::uint64_t> ids;
+    std::vector<std::uint32_t> indices;
+    indices.reserve(data.size());
     bool lastValid{false};
-    uint64_t lastElem{0};
-    uint64_t lastIndex{0};
-    std::array<std::uint8_t, 4> lastColor{{}};
-
-    std::vector<gpu_index> data;
-    for (const auto & d2 : view)
-    for (const auto & d1 : d2)
-    for (const auto & elem : d1) {
-        if (lastValid && elem == lastElem) {
-            data.emplace_back(lastIndex);
-        } else {
-            const auto it = id_to_lut_index.find(elem);
-            const auto existing = it != std::end(id_to_lut_index);
-            const auto index = existing ? it->second : (id_to_lut_index[elem] = highest_index++);//increment after assignment
-            data.emplace_back(index);
-            if (!existing) {
-                const auto color = Segmentation::singleton().colorObjectFromSubobjectId(elem);
-                lastColor = {{std::get<0>(color), std::get<1>(color), std::get<2>(color), std::get<3>(color)}};
-                colors.push_back(lastColor);
+    std::uint64_t lastElem{0};
+    std::uint32_t lastIndex{0};
+    for (const auto elem : data) {
+        if (!lastValid || elem != lastElem) {
+            const auto it = idToIndex.find(elem);
+            if (it != std::end(idToIndex)) {
+                lastIndex = it->second;
+            } else {
+                lastIndex = idToIndex[elem] = ids.size();
+                ids.emplace_back(elem);
             }
             lastElem = elem;
-            lastIndex = index;
-            lastColor = colors[index];
             lastValid = true;
         }
+        indices.emplace_back(lastIndex);
+    }
+    prepared result;
+    if (ids.size() <= std::numeric_limits<std::uint16_t>::max() + 1ul) {
+        result.indices.assign(std::begin(indices), std::end(indices));
+    } else {
+        result.wideIndices.reserve(indices.size());
+        for (const auto index : indices) {
+            result.wideIndices.emplace_back(pack(index));
+        }
+    }
+    result.slots = slots.assign(ids);
+    result.slotTable = &slots;
+    for (const auto slot : result.slots) {
+        result.palette.emplace_back(pack(slot));
     }
-    const auto lutSize = std::pow(2, std::ceil(std::log2(colors.size())));
-    colors.resize(lutSize);
-    return data;
+    result.palette.resize((result.palette.size() + paletteWidth - 1) / paletteWidth * paletteWidth);
+    return result;
 }
 
-void gpu_lut_cube::upload(const std::vector<gpu_index> & data) {
-    lut.setSize(colors.size());
-    lut.allocateStorage();
-
-    cube.setData(QOpenGLTexture::Red, QOpenGLTexture::UInt16, data.data());
-    lut.setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt32_RGBA8_Rev, colors.data());
+void gpu_lut_cube::upload(const prepared & data) {
+    if (wideIndex) {
+        cube.setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, data.wideIndices.data());
+    } else {
+        cube.setData(QOpenGLTexture::Red, QOpenGLTexture::UInt16, data.indices.data());
+    }
+    palette.setSize(paletteWidth, data.palette.size() / paletteWidth);
+    palette.allocateStorage();
+    palette.setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, data.palette.data());
+    slots = data.slots;
+    slotTable = data.slotTable;
 }
 
-void gpu_lut_cube::generate(boost::multi_array_ref<uint64_t, 3>::const_array_view<3>::type view) {
-    upload(prepare(view));
+QVector3D gpu_lut_cube::indexFactor() const {
+    if (wideIndex) {
+        return {255.0f, 255.0f * 256.0f, 255.0f * 65536.0f};
+    }
+    return {std::numeric_limits<std::uint16_t>::max(), 0.0f, 0.0f};
 }
 
 TextureLayer::TextureLayer(QOpenGLContext & sharectx) {
@@ -113,46 +277,182 @@ TextureLayer::TextureLayer(QOpenGLContext & sharectx) {
     ctx.setFormat(surface.format());
     ctx.setShareContext(&sharectx);
     ctx.create();
+
+    uploadSurface.create();
+    uploadCtx.setFormat(uploadSurface.format());
+    uploadCtx.setShareContext(&sharectx);
+    uploadCtx.create();
+    ctx.makeCurrent(&surface);
+    fenceSupport = ctx.format().version() >= qMakePair(3, 2) || ctx.hasExtension("GL_ARB_sync");
+    uploadCtx.moveToThread(&uploadThread);
+    uploadReceiver.moveToThread(&uploadThread);
+    uploadThread.start();
 }
+
 TextureLayer::~TextureLayer() {
+    preparePool.waitForDone();
+    // drain queued uploads and hand the context back before the thread stops
+    QMetaObject::invokeMethod(&uploadReceiver, [this, guiThread = QThread::currentThread()](){
+        uploadCtx.doneCurrent();
+        uploadCtx.moveToThread(guiThread);
+    }, Qt::BlockingQueuedConnection);
+    uploadThread.quit();
+    uploadThread.wait();
     ctx.makeCurrent(&surface);//QOpenGLTexture dtor needs a current ctx
+    for (auto & elem : uploaded) {
+        if (elem.fence != nullptr) {
+            ctx.extraFunctions()->glDeleteSync(elem.fence);
+        }
+    }
+    // cubes release their slots, the table is destroyed before them otherwise
+    uploaded.clear();
+    textures.clear();
+    bogusCube.reset();
 }
 
-template<typename cube_type, typename elem_type>
-void TextureLayer::createBogusCube(const int cpucubeedge, const int gpucubeedge) {
+void TextureLayer::createBogusCube(const int gpucubeedge) {
     ctx.makeCurrent(&surface);
-    std::vector<char> data;
-    data.resize(std::pow(cpucubeedge, 3) * sizeof(elem_type));
-    std::fill(std::begin(data), std::end(data), 0);
-    bogusCube.reset(new cube_type(gpucubeedge));
-    boost::multi_array_ref<elem_type, 3> cube(reinterpret_cast<elem_type*>(data.data()), boost::extents[cpucubeedge][cpucubeedge][cpucubeedge]);
-    using range = boost::multi_array_types::index_range;
-    static_cast<cube_type*>(bogusCube.get())->generate(cube[boost::indices[range(0,gpucubeedge)][range(cpucubeedge-gpucubeedge,cpucubeedge-0)][range(0,gpucubeedge)]]);
-}
-
-void TextureLayer::createBogusCube(const int cpucubeedge, const int gpucubeedge) {
+    const std::size_t size = std::pow(gpucubeedge, 3);
     if (isOverlayData) {
-        createBogusCube<gpu_lut_cube, std::uint64_t>(cpucubeedge, gpucubeedge);
+        auto * cube = new gpu_lut_cube(gpucubeedge);
+        bogusCube.reset(cube);
+        cube->upload(gpu_lut_cube::prepare(std::vector<std::uint64_t>(size, 0), slots));
     } else {
-        createBogusCube<gpu_raw_cube, std::uint8_t>(cpucubeedge, gpucubeedge);
+        bogusCube.reset(new gpu_raw_cube(gpucubeedge));
+        bogusCube->upload(std::vector<std::uint8_t>(size, 0));
     }
 }
 
-template<typename cube_type, typename elem_type>
-void TextureLayer::cubeSubArray(const boost::const_multi_array_ref<elem_type, 3> cube, const int gpucubeedge, const CoordOfGPUCube gpuCoord, const Coordinate offset) {
-    ctx.makeCurrent(&surface);
-    using range = boost::multi_array_types::index_range;
-    const auto view = cube[boost::indices[range(0+offset.z,gpucubeedge+offset.z)][range(0+offset.y,gpucubeedge+offset.y)][range(0+offset.x,gpucubeedge+offset.x)]];
-    textures[gpuCoord].reset(new cube_type(gpucubeedge));
-    static_cast<cube_type*>(textures[gpuCoord].get())->generate(view);
+void TextureLayer::requestCube(const std::size_t layerId, const std::size_t magIndex, const CoordOfCube cpuCoord, const int cpucubeedge, const int gpucubeedge, const CoordOfGPUCube gpuCoord, const Coordinate offset) {
+    if (upToDate(gpuCoord)) {
+        return;
+    }
+    const UploadKey key{layerId, magIndex, gpuCoord, generation};
+    const auto flightIt = inFlight.find(gpuCoord);
+    if (flightIt != std::end(inFlight) && flightIt->second.layerId == layerId && flightIt->second.magIndex == magIndex && !stale(flightIt->second)) {
+        return;
+    }
+    inFlight[gpuCoord] = key;
+    ++outstanding;
+    const auto overlay = isOverlayData;
+    QtConcurrent::run(&preparePool, [=](){
+        auto copy = [&](auto elem){// the loader may recycle the cube otherwise
+            using elem_type = decltype(elem);
+            QMutexLocker locker(&state->protectCube2Pointer);
+            const auto * data = reinterpret_cast<const elem_type *>(cubeQuery(state->cube2Pointer, layerId, magIndex, cpuCoord));
+            return data != nullptr ? gpu_raw_cube::subCube(data, cpucubeedge, gpucubeedge, offset) : std::vector<elem_type>{};
+        };
+        if (overlay) {
+            auto sub = copy(std::uint64_t{});
+            auto prepared = sub.empty() ? gpu_lut_cube::prepared{} : gpu_lut_cube::prepare(sub, slots);
+            QMetaObject::invokeMethod(&uploadReceiver, [this, key, gpucubeedge, prepared = std::move(prepared)](){
+                std::unique_ptr<gpu_raw_cube> cube;
+                if (!prepared.palette.empty()) {
+                    uploadCtx.makeCurrent(&uploadSurface);
+                    auto * lutCube = new gpu_lut_cube(gpucubeedge, !prepared.wideIndices.empty());
+                    cube.reset(lutCube);
+                    lutCube->upload(prepared);
+                }
+                finishUpload(key, std::move(cube));
+            }, Qt::QueuedConnection);
+        } else {
+            auto sub = copy(std::uint8_t{});
+            QMetaObject::invokeMethod(&uploadReceiver, [this, key, gpucubeedge, sub = std::move(sub)](){
+                std::unique_ptr<gpu_raw_cube> cube;
+                if (!sub.empty()) {
+                    uploadCtx.makeCurrent(&uploadSurface);
+                    cube.reset(new gpu_raw_cube(gpucubeedge));
+                    cube->upload(sub);
+                }
+                finishUpload(key, std::move(cube));
+            }, Qt::QueuedConnection);
+        }
+    });
 }
 
-void TextureLayer::cubeSubArray(const void * data, const int cpucubeedge, const int gpucubeedge, const CoordOfGPUCube gpuCoord, const Coordinate offset) {
-    if (isOverlayData) {
-        boost::const_multi_array_ref<std::uint64_t, 3> cube(reinterpret_cast<const std::uint64_t *>(data), boost::extents[cpucubeedge][cpucubeedge][cpucubeedge]);
-        cubeSubArray<gpu_lut_cube>(cube, gpucubeedge, gpuCoord, offset);
-    } else {
-        boost::const_multi_array_ref<std::uint8_t, 3> cube(reinterpret_cast<const std::uint8_t *>(data), boost::extents[cpucubeedge][cpucubeedge][cpucubeedge]);
-        cubeSubArray<gpu_raw_cube>(cube, gpucubeedge, gpuCoord, offset);
+void TextureLayer::finishUpload(const UploadKey key, std::unique_ptr<gpu_raw_cube> cube) {
+    GLsync fence{nullptr};
+    if (cube != nullptr) {
+        if (fenceSupport) {
+            fence = uploadCtx.extraFunctions()->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            uploadCtx.functions()->glFlush();// the fence has to reach the gpu for other contexts to see it signaled
+        } else {
+            uploadCtx.functions()->glFinish();
+        }
+    }
+    QMutexLocker locker(&uploadedMutex);
+    uploaded.push_back({key, std::move(cube), fence});
+}
+
+bool TextureLayer::upToDate(const CoordOfGPUCube & coord) const {
+    return textures.find(coord) != std::end(textures) && outdated.find(coord) == std::end(outdated);
+}
+
+bool TextureLayer::stale(const UploadKey & key) const {
+    if (key.generation < allStaleBefore) {
+        return true;
+    }
+    const auto it = staleBefore.find(key.coord);
+    return it != std::end(staleBefore) && key.generation < it->second;
+}
+
+void TextureLayer::adoptUploadedCubes(const std::size_t layerId, const std::size_t magIndex, const std::function<bool(const CoordOfGPUCube &)> & keep) {
+    std::vector<UploadedCube> ready;
+    {
+        QMutexLocker locker(&uploadedMutex);
+        if (uploaded.empty()) {
+            return;
+        }
+        ctx.makeCurrent(&surface);
+        auto * gl = ctx.extraFunctions();
+        const auto pendingIt = std::partition(std::begin(uploaded), std::end(uploaded), [gl](const UploadedCube & elem){
+            if (elem.fence == nullptr) {
+                return true;
+            }
+            const auto result = gl->glClientWaitSync(elem.fence, 0, 0);
+            return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+        });
+        std::move(std::begin(uploaded), pendingIt, std::back_inserter(ready));
+        uploaded.erase(std::begin(uploaded), pendingIt);
+    }
+    for (auto & elem : ready) {
+        if (elem.fence != nullptr) {
+            ctx.extraFunctions()->glDeleteSync(elem.fence);
+        }
+        const auto & key = elem.key;
+        const auto flightIt = inFlight.find(key.coord);
+        if (flightIt != std::end(inFlight) && flightIt->second == key) {
+            inFlight.erase(flightIt);
+        }
+        --outstanding;
+        const bool current = key.layerId == layerId && key.magIndex == magIndex && !stale(key);
+        if (elem.cube != nullptr && current && keep(key.coord) && !upToDate(key.coord)) {
+            textures[key.coord] = std::move(elem.cube);
+            outdated.erase(key.coord);
+        }
+    }
+    if (outstanding == 0) {// nothing older can arrive anymore
+        staleBefore.clear();
+    }
+    for (auto it = std::begin(outdated); it != std::end(outdated);) {// evicted meanwhile
+        it = textures.find(*it) == std::end(textures) ? outdated.erase(it) : std::next(it);
+    }
+}
+
+void TextureLayer::invalidate() {
+    allStaleBefore = ++generation;
+    staleBefore.clear();
+    outdated.clear();
+    ctx.makeCurrent(&surface);//QOpenGLTexture dtor needs a current ctx
+    textures.clear();
+}
+
+void TextureLayer::invalidate(const std::vector<CoordOfGPUCube> & coords) {
+    ++generation;
+    for (const auto & coord : coords) {
+        staleBefore[coord] = generation;
+        if (textures.find(coord) != std::end(textures)) {
+            outdated.emplace(coord);
+        }
     }
 }
@@ -25,18 +25,23 @@
 
 #include "coordinate.h"
 
+#include <QMutex>
 #include <QOffscreenSurface>
 #include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
 #include <QOpenGLTexture>
+#include <QThread>
+#include <QThreadPool>
 #include <QVector3D>
 
 #include <boost/functional/hash.hpp>
-#include <boost/multi_array/multi_array_ref.hpp>
 
+#include <array>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace std {
@@ -52,33 +57,114 @@ class gpu_raw_cube {
 public:
     QOpenGLTexture cube{QOpenGLTexture::Target3D};
     std::vector<floatCoordinate> vertices;
-    gpu_raw_cube(const int gpucubeedge, const bool index = false);
+    gpu_raw_cube(const int gpucubeedge, const QOpenGLTexture::TextureFormat format = QOpenGLTexture::R8_UNorm);// everything but R8 is an index
     virtual ~gpu_raw_cube() = default;
-    std::vector<char> prepare(boost::multi_array_ref<std::uint8_t, 3>::const_array_view<3>::type view);
-    void upload(const std::vector<char> & data);
-    void generate(boost::multi_array_ref<std::uint8_t, 3>::const_array_view<3>::type view);
+    // copies the gpu cube at offset out of a cpu cube (thread-safe)
+    template<typename elem_type>
+    static std::vector<elem_type> subCube(const elem_type * data, const int cpucubeedge, const int gpucubeedge, const Coordinate offset);
+    void upload(const std::vector<std::uint8_t> & data);
 };
 
+/**
+ * Global slot numbers for the subobject ids referenced by the overlay cubes.
+ * Cubes only store slots, the colors are resolved per slot into one table texture,
+ * so merges and selection changes update that table instead of every cube.
+ * Slots are reference counted by the cubes using them and recycled once unused.
+ * assign and release are thread-safe, updateColors needs the subobject cache (gui thread, current ctx).
+ * Used by the gpu slicer overlay layer and the volume renderer.
+ */
+class gpu_slot_table {
+    QMutex mutex;
+    std::unordered_map<std::uint64_t, std::uint32_t> slotOfId;
+    std::vector<std::uint64_t> idOfSlot;
+    std::vector<std::uint32_t> references;// per slot
+    std::vector<std::uint32_t> freeSlots;
+    std::vector<std::uint32_t> newSlots;// (re)assigned since the last updateColors
+    std::vector<std::array<std::uint8_t, 4>> colors;
+    std::uint64_t colorsGeneration{0};
+    bool warnedFull{false};
+public:
+    static constexpr int width = 4096;// slots per texture row
+    static constexpr std::uint32_t maxSlots = 1 << 24;// 24 bit packed into rgb
+    QOpenGLTexture colorTexture{QOpenGLTexture::Target2D};
+    gpu_slot_table();
+    std::vector<std::uint32_t> assign(const std::vector<std::uint64_t> & ids);// references each slot once
+    void release(const std::vector<std::uint32_t> & slots);
+    bool updateColors();// returns whether the table changed
+    bool selected(const std::uint32_t slot) const;// as of the last updateColors
+};
+
+/**
+ * Palette compressed overlay cube: the index texture references a per cube palette
+ * whose entries hold the global slot of the subobject id.
+ */
 class gpu_lut_cube : public gpu_raw_cube {
 public:
-    using gpu_index = std::uint16_t;
+    using rgba = std::array<std::uint8_t, 4>;
+    struct prepared {
+        std::vector<std::uint16_t> indices;// palettes up to 2^16 entries
+        std::vector<rgba> wideIndices;// packed 24 bit indices for larger palettes
+        std::vector<rgba> palette;// packed global slot of each index
+        std::vector<std::uint32_t> slots;// referenced in the slot table, owned by the cube after upload
+        gpu_slot_table * slotTable{nullptr};
+    };
+    static constexpr int paletteWidth = 4096;
+    QOpenGLTexture palette{QOpenGLTexture::Target2D};
+    const bool wideIndex;
+    gpu_lut_cube(const int gpucubeedge, const bool wideIndex = false);
+    virtual ~gpu_lut_cube() override;
+    static rgba pack(const std::uint32_t value);
+    static prepared prepare(const std::vector<std::uint64_t> & data, gpu_slot_table & slots);
+    void upload(const prepared & data);
+    QVector3D indexFactor() const;// unpacks normalized index texels in the shader
 private:
-    std::unordered_map<std::uint64_t, gpu_index> id_to_lut_index;
-    gpu_index highest_index = 0;
-    std::vector<std::array<std::uint8_t, 4>> colors;
-public:
-    QOpenGLTexture lut{QOpenGLTexture::Target1D};
-    gpu_lut_cube(const int gpucubeedge);
-    std::vector<gpu_index> prepare(boost::multi_array_ref<uint64_t, 3>::const_array_view<3>::type view);
-    void upload(const std::vector<gpu_index> & data);
-    void generate(boost::multi_array_ref<std::uint64_t, 3>::const_array_view<3>::type view);
+    std::vector<std::uint32_t> slots;
+    gpu_slot_table * slotTable{nullptr};
 };
 
+/**
+ * Gpu cubes are cut out of the cpu cubes on a thread pool and uploaded on a dedicated thread
+ * through an own context in the share group. Finished uploads are fenced and only handed
+ * to the renderer (adoptUploadedCubes) once the gpu has completed them.
+ * Uploads remember layer, mag and data generation they were requested for,
+ * those that no longer match when they are done are dropped.
+ */
 class TextureLayer {
+    struct UploadKey {
+        std::size_t layerId;
+        std::size_t magIndex;
+        CoordOfGPUCube coord;
+        std::uint64_t generation;
+        bool operator==(const UploadKey & other) const {
+            return layerId == other.layerId && magIndex == other.magIndex && coord == other.coord && generation == other.generation;
+        }
+    };
+    struct UploadedCube {
+        UploadKey key;
+        std::unique_ptr<gpu_raw_cube> cube;// nullptr if the cpu cube vanished meanwhile
+        GLsync fence;
+    };
+    QOffscreenSurface uploadSurface;
+    QOpenGLContext uploadCtx;
+    QObject uploadReceiver;// lives in uploadThread
+    QThread uploadThread;
+    QThreadPool preparePool;
+    QMutex uploadedMutex;
+    std::vector<UploadedCube> uploaded;
+    std::unordered_map<CoordOfGPUCube, UploadKey> inFlight;// latest request per cube
+    std::size_t outstanding{0};// requested but not yet adopted or dropped
+    std::uint64_t generation{0};
+    std::uint64_t allStaleBefore{0};
+    std::unordered_map<CoordOfGPUCube, std::uint64_t> staleBefore;// uploads of older generations carry outdated data
+    std::unordered_set<CoordOfGPUCube> outdated;// textures kept on screen until their replacement is adopted
+    bool fenceSupport{false};
+    bool stale(const UploadKey & key) const;
+    void finishUpload(const UploadKey key, std::unique_ptr<gpu_raw_cube> cube);
 public:
     QOffscreenSurface surface;
     QOpenGLContext ctx;//ctx has to live past textures
     std::unordered_map<CoordOfGPUCube, std::unique_ptr<gpu_raw_cube>> textures;
+    gpu_slot_table slots;// overlay only
     std::unique_ptr<gpu_raw_cube> bogusCube;
     float opacity = 1.0f;
     bool enabled = true;
@@ -87,12 +173,12 @@ public:
     std::vector<std::pair<CoordOfGPUCube, Coordinate>> pendingArbCubes;
     TextureLayer(QOpenGLContext & sharectx);
     ~TextureLayer();
-    template<typename cube_type, typename elem_type>
-    void createBogusCube(const int cpucubeedge, const int gpucubeedge);
-    void createBogusCube(const int cpucubeedge, const int gpucubeedge);
-    template<typename cube_type, typename elem_type>
-    void cubeSubArray(const boost::const_multi_array_ref<elem_type, 3> cube, const int gpucubeedge, const CoordOfGPUCube gpuCoord, const Coordinate offset);
-    void cubeSubArray(const void * data, const int cpucubeedge, const int gpucubeedge, const CoordOfGPUCube gpuCoord, const Coordinate offset);
+    void createBogusCube(const int gpucubeedge);
+    void requestCube(const std::size_t layerId, const std::size_t magIndex, const CoordOfCube cpuCoord, const int cpucubeedge, const int gpucubeedge, const CoordOfGPUCube gpuCoord, const Coordinate offset);
+    bool upToDate(const CoordOfGPUCube & coord) const;
+    void adoptUploadedCubes(const std::size_t layerId, const std::size_t magIndex, const std::function<bool(const CoordOfGPUCube &)> & keep);
+    void invalidate();// e.g. the mag changed
+    void invalidate(const std::vector<CoordOfGPUCube> & coords);// the data of these cubes changed
 };
 
 #endif//GPUCUBER_H
@@ -0,0 +1,662 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+#include "undojournal.h"
+
+#include "dataset.h"
+#include "loader.h"
+#include "segmentation/segmentation.h"
+#include "skeleton/node.h"
+#include "skeleton/skeletonizer.h"
+#include "skeleton/tree.h"
+#include "stateInfo.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QMutexLocker>
+#include <QSignalBlocker>
+#include <QTimer>
+
+#include <boost/optional.hpp>
+
+#include <snappy.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace {
+template<typename... Args>
+QByteArray serialize(const Args &... args) {
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    (stream << ... << args);
+    return payload;
+}
+
+Coordinate readCoordinate(QDataStream & stream) {
+    qint32 x, y, z;
+    stream >> x >> y >> z;
+    return {x, y, z};
+}
+
+std::vector<std::uint64_t> readIds(QDataStream & stream) {
+    quint32 count;
+    stream >> count;
+    std::vector<std::uint64_t> ids(count);
+    for (auto & id : ids) {
+        quint64 value;
+        stream >> value;
+        id = value;
+    }
+    return ids;
+}
+
+void writeIds(QDataStream & stream, const std::vector<std::uint64_t> & ids) {
+    stream << static_cast<quint32>(ids.size());
+    for (const auto id : ids) {
+        stream << static_cast<quint64>(id);
+    }
+}
+
+std::size_t cubeByteSize() {
+    return OBJID_BYTES * state->cubeBytes;
+}
+
+struct CubeDiffHeader {
+    std::size_t layerId;
+    std::size_t magIndex;
+    CoordOfCube cubeCoord;
+};
+
+CubeDiffHeader readCubeDiffHeader(QDataStream & stream) {
+    quint64 layerId, magIndex;
+    stream >> layerId >> magIndex;
+    const auto coord = readCoordinate(stream);
+    return {layerId, magIndex, {coord.x, coord.y, coord.z}};
+}
+}
+
+UndoJournal & UndoJournal::singleton() {
+    static UndoJournal journal;
+    return journal;
+}
+
+bool UndoJournal::canUndo() const {
+    return !undoSteps.empty() || !current.isEmpty() || !cubeSnapshots.empty();
+}
+
+bool UndoJournal::canRedo() const {
+    return !redoSteps.empty();
+}
+
+void UndoJournal::beginGroup() {
+    ++groupDepth;
+}
+
+void UndoJournal::endGroup() {
+    if (groupDepth > 0 && --groupDepth == 0) {
+        commit();
+    }
+}
+
+void UndoJournal::clear() {
+    undoSteps.clear();
+    redoSteps.clear();
+    current.clear();
+    cubeSnapshots.clear();
+    snapshotBytes = 0;
+    memoryUsed = 0;
+    spilledSteps = 0;
+    spilledBytes = 0;
+    if (spillFile.isOpen()) {
+        spillFile.resize(0);
+    }
+    emit changed();
+}
+
+void UndoJournal::scheduleCommit() {
+    if (!commitScheduled && replayTarget == nullptr) {
+        commitScheduled = true;
+        QTimer::singleShot(0, this, &UndoJournal::commit);
+    }
+}
+
+void UndoJournal::record(const Op op, const QByteArray & payload) {
+    QDataStream stream(&current, QIODevice::WriteOnly | QIODevice::Append);
+    stream << static_cast<quint8>(op) << payload;
+    scheduleCommit();
+}
+
+void UndoJournal::appendCubeDiffs() {
+    QByteArray content(static_cast<int>(cubeByteSize()), Qt::Uninitialized);
+    auto * const diff = reinterpret_cast<std::uint64_t *>(content.data());
+    const auto words = static_cast<std::size_t>(content.size()) / sizeof(std::uint64_t);
+    for (const auto & pair : cubeSnapshots) {
+        const auto & key = pair.first;
+        const auto & snapshot = pair.second;
+        std::size_t length;
+        if (!snappy::GetUncompressedLength(snapshot.constData(), snapshot.size(), &length) || length != cubeByteSize()
+                || !snappy::RawUncompress(snapshot.constData(), snapshot.size(), content.data())) {
+            qWarning() << tr("snapshot of cube (%1, %2, %3) is corrupt, its changes cannot be undone").arg(key.cubeCoord.x).arg(key.cubeCoord.y).arg(key.cubeCoord.z);
+            continue;
+        }
+        {
+            QMutexLocker locker(&state->protectCube2Pointer);
+            const auto * cube = reinterpret_cast<const std::uint64_t *>(cubeQuery(state->cube2Pointer, key.layerId, key.magIndex, key.cubeCoord));
+            if (cube == nullptr) {
+                qWarning() << tr("cube (%1, %2, %3) was unloaded before its changes could be recorded, they cannot be undone").arg(key.cubeCoord.x).arg(key.cubeCoord.y).arg(key.cubeCoord.z);
+                continue;
+            }
+            for (std::size_t i = 0; i < words; ++i) {
+                diff[i] ^= cube[i];
+            }
+        }
+        if (std::all_of(diff, diff + words, [](const std::uint64_t word){ return word == 0; })) {
+            continue;// written with the values it already had
+        }
+        std::string compressed;// unchanged voxels are zero after the xor and compress very well
+        snappy::Compress(content.constData(), content.size(), &compressed);
+        record(Op::CubeDiff, serialize(static_cast<quint64>(key.layerId), static_cast<quint64>(key.magIndex)
+                                       , static_cast<qint32>(key.cubeCoord.x), static_cast<qint32>(key.cubeCoord.y), static_cast<qint32>(key.cubeCoord.z)
+                                       , QByteArray(compressed.data(), static_cast<int>(compressed.size()))));
+    }
+    cubeSnapshots.clear();
+    snapshotBytes = 0;
+}
+
+void UndoJournal::commit() {
+    if (groupDepth > 0 || replayTarget != nullptr) {
+        commitScheduled = false;
+        return;
+    }
+    appendCubeDiffs();
+    commitScheduled = false;
+    if (current.isEmpty()) {
+        return;
+    }
+    for (const auto & step : redoSteps) {// a new edit invalidates everything that was undone
+        discard(step);
+    }
+    redoSteps.clear();
+    push(undoSteps, std::exchange(current, {}));
+    enforceBudget();
+    emit changed();
+}
+
+void UndoJournal::push(std::deque<Step> & steps, QByteArray && data) {
+    memoryUsed += static_cast<std::size_t>(data.size());
+    steps.push_back(Step{std::move(data)});
+}
+
+void UndoJournal::discard(const Step & step) {
+    if (step.offset == -1) {
+        memoryUsed -= static_cast<std::size_t>(step.data.size());
+    } else {
+        spilledBytes -= step.size;
+        if (--spilledSteps == 0) {// nothing alive in the spill file anymore
+            spillFile.resize(0);
+        }
+    }
+}
+
+void UndoJournal::compactSpillFile() {
+    const auto garbage = spillFile.size() - spilledBytes;
+    if (spilledSteps == 0 || garbage < 64 * 1024 * 1024 || garbage < spilledBytes) {// at least half of the file is garbage
+        return;
+    }
+    std::vector<Step *> spilled;
+    for (auto * steps : {&undoSteps, &redoSteps}) {
+        for (auto & step : *steps) {
+            if (step.offset != -1) {
+                spilled.emplace_back(&step);
+            }
+        }
+    }
+    std::sort(std::begin(spilled), std::end(spilled), [](const Step * lhs, const Step * rhs){
+        return lhs->offset < rhs->offset;
+    });
+    qint64 end{0};// steps only move towards the front, so none is overwritten before it was read
+    for (auto * step : spilled) {
+        if (step->offset != end) {
+            QByteArray data;
+            if (spillFile.seek(step->offset)) {
+                data = spillFile.read(step->size);
+            }
+            if (data.size() != step->size || !spillFile.seek(end) || spillFile.write(data) != data.size()) {
+                qWarning() << tr("compacting undo spill file %1 failed").arg(spillFile.fileName());
+                return;
+            }
+            step->offset = end;
+        }
+        end += step->size;
+    }
+    spillFile.resize(end);
+}
+
+void UndoJournal::enforceBudget() {
+    while (undoSteps.size() + redoSteps.size() > maxSteps && !undoSteps.empty()) {
+        discard(undoSteps.front());
+        undoSteps.pop_front();
+    }
+    compactSpillFile();
+    auto spill = [this](std::deque<Step> & steps){// oldest steps first
+        for (auto & step : steps) {
+            if (memoryUsed + snapshotBytes <= memoryBudget) {
+                return;
+            }
+            if (step.offset != -1) {
+                continue;
+            }
+            if (!spillFile.isOpen() && !spillFile.open()) {
+                qWarning() << tr("cannot open undo spill file %1, keeping history in memory").arg(spillFile.fileName());
+                return;
+            }
+            if (spillFile.size() + step.data.size() > diskBudget) {
+                qWarning() << tr("undo spill file exceeds %1 MiB, dropping the oldest history").arg(diskBudget / 1024 / 1024);
+                while (!undoSteps.empty() && undoSteps.front().offset != -1) {
+                    discard(undoSteps.front());
+                    undoSteps.pop_front();
+                }
+                for (auto it = std::begin(redoSteps); it != std::end(redoSteps) && spilledSteps > 0;) {
+                    if (it->offset != -1) {
+                        discard(*it);
+                        it = redoSteps.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+                return;// iterators are invalid now, next commit continues
+            }
+            const auto offset = spillFile.size();
+            if (!spillFile.seek(offset) || spillFile.write(step.data) != step.data.size()) {
+                qWarning() << tr("writing undo spill file %1 failed, keeping history in memory").arg(spillFile.fileName());
+                return;
+            }
+            memoryUsed -= static_cast<std::size_t>(step.data.size());
+            step.offset = offset;
+            step.size = step.data.size();
+            step.data = QByteArray{};
+            ++spilledSteps;
+            spilledBytes += step.size;
+        }
+    };
+    spill(undoSteps);
+    spill(redoSteps);
+}
+
+QByteArray UndoJournal::load(const Step & step) {
+    if (step.offset == -1) {
+        return step.data;
+    }
+    QByteArray data;
+    if (spillFile.seek(step.offset)) {
+        data = spillFile.read(step.size);
+    }
+    if (data.size() != step.size) {
+        throw std::runtime_error(tr("reading undo step from %1 failed").arg(spillFile.fileName()).toStdString());
+    }
+    return data;
+}
+
+void UndoJournal::undo() {
+    replay(undoSteps, redoSteps);
+}
+
+void UndoJournal::redo() {
+    replay(redoSteps, undoSteps);
+}
+
+std::vector<std::pair<UndoJournal::Op, QByteArray>> UndoJournal::parse(const QByteArray & data) {
+    std::vector<std::pair<Op, QByteArray>> records;
+    QDataStream stream(data);
+    while (!stream.atEnd()) {
+        quint8 op;
+        QByteArray payload;
+        stream >> op >> payload;
+        records.emplace_back(static_cast<Op>(op), std::move(payload));
+    }
+    return records;
+}
+
+void UndoJournal::replay(std::deque<Step> & from, std::deque<Step> & to) {
+    if (groupDepth > 0 || !recording()) {// e.g. during a brush stroke
+        return;
+    }
+    commit();// pending edits become undoable first
+    if (from.empty()) {
+        return;
+    }
+    const auto records = parse(load(from.back()));
+    // refuse before anything was applied, a half undone step couldn’t be redone consistently
+    for (const auto & record : records) {
+        if (record.first == Op::CubeDiff) {
+            QDataStream stream(record.second);
+            const auto header = readCubeDiffHeader(stream);
+            if (header.magIndex != Dataset::current().magIndex) {
+                throw std::runtime_error(tr("This step changed the segmentation in another magnification, switch back to undo it.").toStdString());
+            }
+            QMutexLocker locker(&state->protectCube2Pointer);
+            if (cubeQuery(state->cube2Pointer, header.layerId, header.magIndex, header.cubeCoord) == nullptr) {
+                throw std::runtime_error(tr("This step changed segmentation cubes which are not loaded, move closer to undo it.").toStdString());
+            }
+        }
+    }
+
+    replayTarget = &to;
+    const bool bulk = records.size() > 1000;// let views rebuild once instead of updating per element
+    boost::optional<std::runtime_error> failure;
+    {
+        QSignalBlocker blocker{bulk ? &Skeletonizer::singleton() : nullptr};
+        try {
+            std::for_each(records.rbegin(), records.rend(), [this](const auto & record){
+                apply(record.first, record.second);
+            });
+        } catch (const std::runtime_error & error) {
+            failure = error;
+            // the inverses of the records applied so far are in current, applying them restores the state before the step
+            const auto rollback = parse(std::exchange(current, {}));
+            try {
+                std::for_each(rollback.rbegin(), rollback.rend(), [this](const auto & record){
+                    apply(record.first, record.second);
+                });
+            } catch (const std::runtime_error & rollbackError) {
+                qWarning() << tr("undo journal: rolling back a failed step failed:") << rollbackError.what();
+            }
+            current.clear();
+        }
+    }
+    replayTarget = nullptr;
+    if (bulk) {
+        Skeletonizer::singleton().resetData();
+    }
+    if (failure) {// the step stays where it was
+        throw std::runtime_error(tr("This step could not be applied and was rolled back: %1").arg(failure->what()).toStdString());
+    }
+    discard(from.back());
+    from.pop_back();
+    if (!current.isEmpty()) {
+        push(to, std::exchange(current, {}));
+    }
+    enforceBudget();
+    emit changed();
+}
+
+void UndoJournal::apply(const Op op, const QByteArray & payload) {
+    QDataStream stream(payload);
+    auto & skeletonizer = Skeletonizer::singleton();
+    auto readNode = [&stream](){
+        quint64 nodeID;
+        stream >> nodeID;
+        if (auto * node = Skeletonizer::findNodeByNodeID(nodeID)) {
+            return node;
+        }
+        throw std::runtime_error(tr("node %1 doesn’t exist").arg(nodeID).toStdString());
+    };
+    auto readTree = [&stream](){
+        quint64 treeID;
+        stream >> treeID;
+        if (auto * tree = Skeletonizer::findTreeByTreeID(treeID)) {
+            return tree;
+        }
+        throw std::runtime_error(tr("tree %1 doesn’t exist").arg(treeID).toStdString());
+    };
+    switch (op) {
+    case Op::AddNode: {
+        quint64 nodeID, treeID, time;
+        float radius;
+        qint32 viewport, mag;
+        QVariantHash properties;
+        stream >> nodeID >> treeID;
+        const auto position = readCoordinate(stream);
+        stream >> radius >> viewport >> mag >> time >> properties;
+        if (!skeletonizer.addNode(nodeID, radius, treeID, position, static_cast<ViewportType>(viewport), mag, time, false, properties)) {
+            throw std::runtime_error(tr("re-adding node %1 failed").arg(nodeID).toStdString());
+        }
+        break;
+    }
+    case Op::DelNode:
+        skeletonizer.delNode(0, readNode());
+        break;
+    case Op::AddSegment: {
+        auto * source = readNode();
+        skeletonizer.addSegment(*source, *readNode());
+        break;
+    }
+    case Op::DelSegment: {
+        auto * source = readNode();
+        auto * target = readNode();
+        const auto segmentIt = skeletonizer.findSegmentBetween(*source, *target);
+        if (segmentIt != std::end(source->segments)) {
+            skeletonizer.delSegment(segmentIt);
+        }
+        break;
+    }
+    case Op::AddTree: {
+        quint64 treeID;
+        QColor color;
+        bool colorSetManually;
+        QVariantHash properties;
+        stream >> treeID >> color >> colorSetManually >> properties;
+        auto & tree = skeletonizer.addTree(treeID, color, properties);
+        tree.colorSetManually = colorSetManually;
+        break;
+    }
+    case Op::DelTree: {
+        quint64 treeID;
+        stream >> treeID;
+        skeletonizer.delTree(treeID);
+        break;
+    }
+    case Op::MoveNodes: {
+        auto * target = readTree();
+        std::vector<nodeListElement *> nodes;
+        for (const auto nodeID : readIds(stream)) {
+            if (auto * node = Skeletonizer::findNodeByNodeID(nodeID)) {
+                nodes.emplace_back(node);
+            }
+        }
+        skeletonizer.moveNodesToTree(nodes, *target);
+        skeletonizer.resetData();
+        break;
+    }
+    case Op::SetPosition: {
+        auto * target = readNode();
+        skeletonizer.setPosition(*target, readCoordinate(stream));
+        break;
+    }
+    case Op::SetRadius: {
+        auto * target = readNode();
+        float radius;
+        stream >> radius;
+        skeletonizer.setRadius(*target, radius);
+        break;
+    }
+    case Op::SetProperties: {
+        bool isTree;
+        stream >> isTree;
+        if (isTree) {
+            auto * target = readTree();
+            QVariantHash properties;
+            stream >> properties;
+            skeletonizer.setProperties(*target, properties);
+        } else {
+            auto * target = readNode();
+            QVariantHash properties;
+            stream >> properties;
+            skeletonizer.setProperties(*target, properties);
+        }
+        break;
+    }
+    case Op::SetTreeColor: {
+        auto * target = readTree();
+        QColor color;
+        bool colorSetManually;
+        stream >> color >> colorSetManually;
+        if (colorSetManually) {
+            skeletonizer.setColor(*target, color);
+        } else {
+            skeletonizer.restoreDefaultTreeColor(*target);
+        }
+        break;
+    }
+    case Op::RestoreObjects: {
+        const auto removeIds = readIds(stream);
+        QByteArray previousObjects;
+        stream >> previousObjects;
+        auto & segmentation = Segmentation::singleton();
+        auto currentObjects = segmentation.serializeObjects(removeIds);
+        objectsChanged(segmentation.restoreObjects(removeIds, previousObjects), currentObjects);
+        break;
+    }
+    case Op::CubeDiff: {
+        const auto header = readCubeDiffHeader(stream);
+        QByteArray compressed;
+        stream >> compressed;
+        QByteArray diff(static_cast<int>(cubeByteSize()), Qt::Uninitialized);
+        std::size_t length;
+        if (!snappy::GetUncompressedLength(compressed.constData(), compressed.size(), &length) || length != cubeByteSize()
+                || !snappy::RawUncompress(compressed.constData(), compressed.size(), diff.data())) {
+            throw std::runtime_error(tr("corrupt cube diff").toStdString());
+        }
+        {
+            QMutexLocker locker(&state->protectCube2Pointer);
+            auto * cube = reinterpret_cast<std::uint64_t *>(cubeQuery(state->cube2Pointer, header.layerId, header.magIndex, header.cubeCoord));
+            if (cube == nullptr) {
+                throw std::runtime_error(tr("cube (%1, %2, %3) is not loaded").arg(header.cubeCoord.x).arg(header.cubeCoord.y).arg(header.cubeCoord.z).toStdString());
+            }
+            const auto * words = reinterpret_cast<const std::uint64_t *>(diff.constData());
+            for (std::size_t i = 0; i < cubeByteSize() / sizeof(std::uint64_t); ++i) {
+                cube[i] ^= words[i];
+            }
+        }
+        Loader::Controller::singleton().markOcCubeAsModified(header.cubeCoord, Dataset::current().magnification);
+        record(Op::CubeDiff, payload);// xor is its own inverse
+        break;
+    }
+    }
+}
+
+void UndoJournal::nodeAdded(const nodeListElement & node) {
+    if (recording()) {
+        record(Op::DelNode, serialize(static_cast<quint64>(node.nodeID)));
+    }
+}
+
+void UndoJournal::nodeRemoved(const nodeListElement & node) {
+    if (recording()) {
+        record(Op::AddNode, serialize(static_cast<quint64>(node.nodeID), static_cast<quint64>(node.correspondingTree->treeID)
+                                      , static_cast<qint32>(node.position.x), static_cast<qint32>(node.position.y), static_cast<qint32>(node.position.z)
+                                      , node.radius, static_cast<qint32>(node.createdInVp), static_cast<qint32>(node.createdInMag)
+                                      , static_cast<quint64>(node.timestamp), node.properties.toHash()));
+    }
+}
+
+void UndoJournal::segmentAdded(const nodeListElement & source, const nodeListElement & target) {
+    if (recording()) {
+        record(Op::DelSegment, serialize(static_cast<quint64>(source.nodeID), static_cast<quint64>(target.nodeID)));
+    }
+}
+
+void UndoJournal::segmentRemoved(const nodeListElement & source, const nodeListElement & target) {
+    if (recording()) {
+        record(Op::AddSegment, serialize(static_cast<quint64>(source.nodeID), static_cast<quint64>(target.nodeID)));
+    }
+}
+
+void UndoJournal::treeAdded(const treeListElement & tree) {
+    if (recording()) {
+        record(Op::DelTree, serialize(static_cast<quint64>(tree.treeID)));
+    }
+}
+
+void UndoJournal::treeRemoved(const treeListElement & tree) {
+    if (recording()) {
+        record(Op::AddTree, serialize(static_cast<quint64>(tree.treeID), tree.color, tree.colorSetManually, tree.properties.toHash()));
+    }
+}
+
+void UndoJournal::nodesMoved(const std::uint64_t fromTreeID, const std::vector<std::uint64_t> & nodeIDs) {
+    if (recording() && !nodeIDs.empty()) {
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream << static_cast<quint64>(fromTreeID);
+        writeIds(stream, nodeIDs);
+        record(Op::MoveNodes, payload);
+    }
+}
+
+void UndoJournal::positionChanged(const nodeListElement & node) {
+    if (recording()) {
+        record(Op::SetPosition, serialize(static_cast<quint64>(node.nodeID), static_cast<qint32>(node.position.x), static_cast<qint32>(node.position.y), static_cast<qint32>(node.position.z)));
+    }
+}
+
+void UndoJournal::radiusChanged(const nodeListElement & node) {
+    if (recording()) {
+        record(Op::SetRadius, serialize(static_cast<quint64>(node.nodeID), node.radius));
+    }
+}
+
+void UndoJournal::propertiesChanged(const nodeListElement & node) {
+    if (recording()) {
+        record(Op::SetProperties, serialize(false, static_cast<quint64>(node.nodeID), node.properties.toHash()));
+    }
+}
+
+void UndoJournal::propertiesChanged(const treeListElement & tree) {
+    if (recording()) {
+        record(Op::SetProperties, serialize(true, static_cast<quint64>(tree.treeID), tree.properties.toHash()));
+    }
+}
+
+void UndoJournal::colorChanged(const treeListElement & tree) {
+    if (recording()) {
+        record(Op::SetTreeColor, serialize(static_cast<quint64>(tree.treeID), tree.color, tree.colorSetManually));
+    }
+}
+
+void UndoJournal::objectsChanged(const std::vector<std::uint64_t> & changedIds, const QByteArray & previousObjects) {
+    if (recording()) {
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        writeIds(stream, changedIds);
+        stream << previousObjects;
+        record(Op::RestoreObjects, payload);
+    }
+}
+
+void UndoJournal::cubeWillChange(const std::size_t layerId, const std::size_t magIndex, const CoordOfCube & cubeCoord, const void * cube) {
+    const CubeKey key{layerId, magIndex, cubeCoord};
+    if (!recording() || replayTarget != nullptr || cubeSnapshots.find(key) != std::end(cubeSnapshots)) {
+        return;
+    }
+    std::string compressed;// cubes are mostly runs of few ids, the raw snapshot would be several MiB
+    snappy::Compress(reinterpret_cast<const char *>(cube), cubeByteSize(), &compressed);
+    const auto & snapshot = cubeSnapshots.emplace(key, QByteArray(compressed.data(), static_cast<int>(compressed.size()))).first->second;
+    snapshotBytes += static_cast<std::size_t>(snapshot.size());
+    if (memoryUsed + snapshotBytes > memoryBudget) {
+        enforceBudget();// make room by spilling committed steps
+    }
+    scheduleCommit();
+}
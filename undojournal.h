@@ -0,0 +1,156 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+#ifndef UNDOJOURNAL_H
+#define UNDOJOURNAL_H
+
+#include "coordinate.h"
+
+#include <QByteArray>
+#include <QObject>
+#include <QTemporaryFile>
+
+#include <boost/functional/hash.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+class nodeListElement;
+class treeListElement;
+
+/**
+ * Undo/redo history of skeleton, segmentation object and voxel edits.
+ *
+ * Mutators report what they are about to change and the journal stores the inverse operation,
+ * serialized into a compact byte record. Records are grouped into undo steps: everything recorded
+ * within one event loop iteration forms a step unless an explicit group (e.g. a brush stroke) is open.
+ * Undoing a step applies its records in reverse through the regular mutators,
+ * which in turn record the inverse of the inverse for redo.
+ *
+ * Voxel writes snapshot each touched cube once per step (snappy compressed right away), on commit
+ * only the snappy compressed xor of old and new content is kept.
+ * Steps beyond memoryBudget (which includes the snapshots of the open step) are spilled to a temporary file,
+ * beyond diskBudget or maxSteps they are dropped.
+ * A step is applied completely or not at all, if one of its records fails the applied ones are rolled back.
+ * The spill file is compacted once most of it belongs to dropped steps.
+ */
+class UndoJournal : public QObject {
+    Q_OBJECT
+public:
+    enum class Op : std::uint8_t {
+        AddNode, DelNode, AddSegment, DelSegment, AddTree, DelTree, MoveNodes,
+        SetPosition, SetRadius, SetProperties, SetTreeColor, RestoreObjects, CubeDiff
+    };
+
+private:
+    struct Step {
+        QByteArray data;// empty if spilled
+        qint64 offset{-1};// position in spillFile
+        qint64 size{0};
+    };
+    struct CubeKey {
+        std::size_t layerId;
+        std::size_t magIndex;
+        CoordOfCube cubeCoord;
+        bool operator==(const CubeKey & other) const {
+            return layerId == other.layerId && magIndex == other.magIndex && cubeCoord == other.cubeCoord;
+        }
+    };
+    struct CubeKeyHash {
+        std::size_t operator()(const CubeKey & key) const {
+            return boost::hash_value(std::make_tuple(key.layerId, key.magIndex, key.cubeCoord.x, key.cubeCoord.y, key.cubeCoord.z));
+        }
+    };
+
+    std::deque<Step> undoSteps;
+    std::deque<Step> redoSteps;
+    std::size_t memoryUsed{0};// of steps not spilled
+    int spilledSteps{0};
+    qint64 spilledBytes{0};// of steps alive in spillFile, the rest of it is garbage
+    QTemporaryFile spillFile;
+
+    QByteArray current;// records of the open step
+    std::unordered_map<CubeKey, QByteArray, CubeKeyHash> cubeSnapshots;// compressed original content of cubes written in the open step
+    std::size_t snapshotBytes{0};
+    int groupDepth{0};
+    bool commitScheduled{false};
+    int blocked{0};
+    std::deque<Step> * replayTarget{nullptr};// redirects records while undoing or redoing
+
+    void scheduleCommit();
+    void record(const Op op, const QByteArray & payload);
+    void appendCubeDiffs();
+    void commit();
+    void push(std::deque<Step> & steps, QByteArray && data);
+    void discard(const Step & step);
+    void compactSpillFile();
+    void enforceBudget();
+    QByteArray load(const Step & step);
+    static std::vector<std::pair<Op, QByteArray>> parse(const QByteArray & data);
+    void replay(std::deque<Step> & from, std::deque<Step> & to);
+    void apply(const Op op, const QByteArray & payload);
+
+public:
+    std::size_t memoryBudget{256 * 1024 * 1024};
+    qint64 diskBudget{4ll * 1024 * 1024 * 1024};
+    std::size_t maxSteps{1000};
+
+    static UndoJournal & singleton();
+
+    class Blocker {// suppresses recording, e.g. while loading files
+    public:
+        Blocker() { ++UndoJournal::singleton().blocked; }
+        ~Blocker() { --UndoJournal::singleton().blocked; }
+    };
+
+    bool recording() const { return blocked == 0; }
+    bool canUndo() const;
+    bool canRedo() const;
+    void beginGroup();
+    void endGroup();
+    void clear();
+    void undo();
+    void redo();
+
+    void nodeAdded(const nodeListElement & node);
+    void nodeRemoved(const nodeListElement & node);
+    void segmentAdded(const nodeListElement & source, const nodeListElement & target);
+    void segmentRemoved(const nodeListElement & source, const nodeListElement & target);
+    void treeAdded(const treeListElement & tree);
+    void treeRemoved(const treeListElement & tree);
+    void nodesMoved(const std::uint64_t fromTreeID, const std::vector<std::uint64_t> & nodeIDs);
+    void positionChanged(const nodeListElement & node);
+    void radiusChanged(const nodeListElement & node);
+    void propertiesChanged(const nodeListElement & node);
+    void propertiesChanged(const treeListElement & tree);
+    void colorChanged(const treeListElement & tree);
+    void objectsChanged(const std::vector<std::uint64_t> & changedIds, const QByteArray & previousObjects);
+    void cubeWillChange(const std::size_t layerId, const std::size_t magIndex, const CoordOfCube & cubeCoord, const void * cube);
+signals:
+    void changed();// availability of undo or redo changed
+};
+
+#endif // UNDOJOURNAL_H
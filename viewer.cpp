@@ -24,9 +24,11 @@
 
 #include "file_io.h"
 #include "loader.h"
+#include "segmentation/brushstroke.h"
 #include "segmentation/segmentation.h"
 #include "session.h"
 #include "skeleton/skeletonizer.h"
+#include "slicer/arbslicer.h"
 #include "stateInfo.h"
 #include "widgets/mainwindow.h"
 #include "widgets/viewports/viewportbase.h"
@@ -40,6 +42,7 @@
 #include <boost/container/static_vector.hpp>
 #include <boost/range/combine.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <cmath>
 
@@ -69,50 +72,57 @@ Viewer::Viewer() : evilHack{[this](){ state->viewer = this; return true; }()} {
         state->viewerState->AllTreesBuffers.regenVertBuffer = true;
         state->viewerState->selectedTreesBuffers.regenVertBuffer = true;
     };
+    static auto forBuffers = [](auto func){
+        func(state->viewerState->AllTreesBuffers);
+        func(state->viewerState->selectedTreesBuffers);
+    };
 
     QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::guiModeLoaded, regVBuff);
-    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeAddedSignal, regVBuff);
-    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeChangedSignal, regVBuff);
-    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeRemovedSignal, regVBuff);
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeAddedSignal, [](const nodeListElement & node){
+        forBuffers([&node](GLBuffers & glBuffers){ glBuffers.nodeAdded(node); });
+    });
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodesAdded, [](const treeListElement &, const std::vector<nodeListElement *> & nodes){
+        forBuffers([&nodes](GLBuffers & glBuffers){
+            for (const auto * node : nodes) {
+                glBuffers.nodeAdded(*node);
+            }
+        });
+    });
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeChangedSignal, [](const nodeListElement & node){
+        forBuffers([&node](GLBuffers & glBuffers){ glBuffers.nodeChanged(node); });
+    });
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeRemovedSignal, [](const std::uint64_t nodeID){
+        forBuffers([nodeID](GLBuffers & glBuffers){ glBuffers.nodeRemoved(nodeID); });
+    });
+    const auto segmentChanged = [](const quint64 sourceID, const quint64 targetID){
+        for (const auto nodeID : {sourceID, targetID}) {
+            const auto it = state->skeletonState->nodesByNodeID.find(nodeID);
+            if (it != std::end(state->skeletonState->nodesByNodeID)) {
+                forBuffers([&it](GLBuffers & glBuffers){ glBuffers.nodeChanged(*it->second); });
+            }
+        }
+    };
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::segmentAdded, segmentChanged);
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::segmentRemoved, segmentChanged);
     QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::propertiesChanged, regVBuff);
     QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::treeAddedSignal, regVBuff);
     QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::treeChangedSignal, regVBuff);
     QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::treeRemovedSignal, regVBuff);
     QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::treesMerged, regVBuff);
 
-    static auto updateSelectionColor = [this](GLBuffers & glBuffers) {
-        if(!glBuffers.regenVertBuffer) {
-            auto & svp = glBuffers.pointVertBuffer;
-
-            //restore old node color
-            size_t offset = svp.colorBufferOffset[svp.lastSelectedNode];
-            QColor color = getNodeColor(*state->skeletonState->nodesByNodeID[svp.lastSelectedNode]);
-
-            svp.colors[offset] = decltype(glBuffers.lineVertBuffer.colors)::value_type{{static_cast<std::uint8_t>(color.red()), static_cast<std::uint8_t>(color.green()), static_cast<std::uint8_t>(color.blue()), static_cast<std::uint8_t>(color.alpha())}};
-
-            svp.color_buffer.bind();
-            svp.color_buffer.write(static_cast<int>(offset * sizeof(svp.colors[offset])), &svp.colors[offset], sizeof(svp.colors[offset]));
-            svp.color_buffer.release();
-
-            //colorize new active node
-            svp.lastSelectedNode = state->skeletonState->selectedNodes.front()->nodeID;
-            offset = svp.colorBufferOffset[svp.lastSelectedNode];
-
-            color = Qt::green;
-            decltype(glBuffers.lineVertBuffer.colors)::value_type activeNodeColor{{static_cast<std::uint8_t>(color.red()), static_cast<std::uint8_t>(color.green()), static_cast<std::uint8_t>(color.blue()), static_cast<std::uint8_t>(color.alpha())}};
-
-            svp.color_buffer.bind();
-            svp.color_buffer.write(static_cast<int>(offset * sizeof(activeNodeColor)), &activeNodeColor, sizeof(activeNodeColor));
-            svp.color_buffer.release();
-        } else {
-            glBuffers.regenVertBuffer = true;
-        }
-    };
     QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeSelectionChangedSignal, []() {
-        if (state->skeletonState->selectedNodes.size() == 1) {
-            updateSelectionColor(state->viewerState->AllTreesBuffers);
-            updateSelectionColor(state->viewerState->selectedTreesBuffers);
-        }
+        forBuffers([](GLBuffers & glBuffers){
+            // restore the previously highlighted nodes and highlight the current selection
+            for (const auto nodeID : glBuffers.highlightedNodes) {
+                const auto it = state->skeletonState->nodesByNodeID.find(nodeID);
+                if (it != std::end(state->skeletonState->nodesByNodeID)) {
+                    glBuffers.nodeChanged(*it->second);
+                }
+            }
+            for (const auto * node : state->skeletonState->selectedNodes) {
+                glBuffers.nodeChanged(*node);
+            }
+        });
     });
     QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::treeSelectionChangedSignal, regVBuff);
     QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::resetData, regVBuff);
@@ -136,6 +146,24 @@ Viewer::Viewer() : evilHack{[this](){ state->viewer = this; return true; }()} {
     keyRepeatTimer.start();
 }
 
+void GLBuffers::nodeAdded(const nodeListElement & node) {
+    addedNodes.emplace(node.nodeID);
+    nodeChanged(node);
+}
+
+void GLBuffers::nodeChanged(const nodeListElement & node) {
+    dirtyNodes.emplace(node.nodeID);
+    dirtyChunks.emplace(chunkOf(node.position));
+    for (const auto & segment : node.segments) {
+        dirtyChunks.emplace(chunkOf(segment.forward ? segment.target.position : segment.source.position));
+    }
+}
+
+void GLBuffers::nodeRemoved(const std::uint64_t nodeID) {
+    addedNodes.erase(nodeID);
+    dirtyNodes.emplace(nodeID);
+}
+
 void Viewer::saveSettings() {
     QSettings settings;
     settings.beginGroup(VIEWER);
@@ -315,55 +343,6 @@ void Viewer::dcSliceExtract(std::uint8_t * datacube, Coordinate cubePosInAbsPx,
     }
 }
 
-void Viewer::dcSliceExtract(std::uint8_t * datacube, floatCoordinate *currentPxInDc_float, std::uint8_t * slice, int s, int *t, const floatCoordinate & v2, bool useCustomLUT, float usedSizeInCubePixels) {
-    Coordinate currentPxInDc = {roundFloat(currentPxInDc_float->x), roundFloat(currentPxInDc_float->y), roundFloat(currentPxInDc_float->z)};
-    const auto cubeEdgeLen = Dataset::current().cubeEdgeLength;
-    if((currentPxInDc.x < 0) || (currentPxInDc.y < 0) || (currentPxInDc.z < 0) ||
-       (currentPxInDc.x >= cubeEdgeLen) || (currentPxInDc.y >= cubeEdgeLen) || (currentPxInDc.z >= cubeEdgeLen)) {
-        const int sliceIndex = 3 * ( s + *t  *  cubeEdgeLen * state->M);
-        slice[sliceIndex] = slice[sliceIndex + 1] = slice[sliceIndex + 2] = 0;
-        slice[sliceIndex + 3] = 255;
-        (*t)++;
-        if(*t < usedSizeInCubePixels) {
-            // Actually, although currentPxInDc_float is passed by reference and updated here,
-            // it is totally ignored (i.e. not read, then overwritten) by the calling function.
-            // But to keep the functionality here compatible after this bugfix, we also replicate
-            // this update here - from the originial below
-            *currentPxInDc_float -= v2;
-        }
-        return;
-    }
-
-    while((0 <= currentPxInDc.x && currentPxInDc.x < cubeEdgeLen)
-          && (0 <= currentPxInDc.y && currentPxInDc.y < cubeEdgeLen)
-          && (0 <= currentPxInDc.z && currentPxInDc.z < cubeEdgeLen)) {
-
-        const int sliceIndex = 4 * ( s + *t  *  cubeEdgeLen * state->M);
-        const int dcIndex = currentPxInDc.x + currentPxInDc.y * cubeEdgeLen + currentPxInDc.z * state->cubeSliceArea;
-        if(datacube == nullptr) {
-            slice[sliceIndex] = slice[sliceIndex + 1] = slice[sliceIndex + 2] = 0;
-        } else {
-            if(useCustomLUT) {
-                //extract data as unsigned number from the datacube
-                const unsigned char adjustIndex = datacube[dcIndex];
-                slice[sliceIndex + 0] = std::get<0>(state->viewerState->datasetAdjustmentTable[adjustIndex]);
-                slice[sliceIndex + 1] = std::get<1>(state->viewerState->datasetAdjustmentTable[adjustIndex]);
-                slice[sliceIndex + 2] = std::get<2>(state->viewerState->datasetAdjustmentTable[adjustIndex]);
-            }
-            else {
-                slice[sliceIndex] = slice[sliceIndex + 1] = slice[sliceIndex + 2] = datacube[dcIndex];
-            }
-        }
-        slice[sliceIndex + 3] = 255;
-        (*t)++;
-        if(*t >= usedSizeInCubePixels) {
-            break;
-        }
-        *currentPxInDc_float -= v2;
-        currentPxInDc = {roundFloat(currentPxInDc_float->x), roundFloat(currentPxInDc_float->y), roundFloat(currentPxInDc_float->z)};
-    }
-}
-
 /**
  * @brief Viewer::ocSliceExtract extracts subObject IDs from datacube
  *      and paints slice at the corresponding position with a color depending on the ID.
@@ -403,8 +382,7 @@ void Viewer::ocSliceExtract(std::uint64_t * datacube, Coordinate cubePosInAbsPx,
     auto & seg = Segmentation::singleton();
     //cache
     uint64_t subobjectIdCache = Segmentation::singleton().getBackgroundId();
-    bool selectedCache = seg.isSubObjectIdSelected(subobjectIdCache);
-    std::tuple<uint8_t, uint8_t, uint8_t, uint8_t> colorCache = seg.colorObjectFromSubobjectId(subobjectIdCache);
+    const auto * entryCache = &seg.cachedSubobject(subobjectIdCache);
     //first and last row boundaries
     const std::size_t min = cubeEdgeLen;
     const std::size_t max = cubeEdgeLen * (cubeEdgeLen - 1);
@@ -432,13 +410,17 @@ void Viewer::ocSliceExtract(std::uint64_t * datacube, Coordinate cubePosInAbsPx,
             if(hide == false) {
                 const uint64_t subobjectId = datacube[0];
 
-                const auto color = (subobjectIdCache == subobjectId) ? colorCache : seg.colorObjectFromSubobjectId(subobjectId);
+                if (subobjectIdCache != subobjectId) {
+                    subobjectIdCache = subobjectId;
+                    entryCache = &seg.cachedSubobject(subobjectId);
+                }
+                const auto & color = entryCache->color;
                 slice[0] = std::get<0>(color);
                 slice[1] = std::get<1>(color);
                 slice[2] = std::get<2>(color);
                 slice[3] = std::get<3>(color);
 
-                const bool selected = (subobjectIdCache == subobjectId) ? selectedCache : seg.isSubObjectIdSelected(subobjectId);
+                const bool selected = entryCache->selected;
                 const bool isPastFirstRow = counter >= min;
                 const bool isBeforeLastRow = counter < max;
                 const bool isNotFirstColumn = counter % cubeEdgeLen != 0;
@@ -447,13 +429,15 @@ void Viewer::ocSliceExtract(std::uint64_t * datacube, Coordinate cubePosInAbsPx,
                 // highlight edges where needed
                 if(seg.highlightBorder) {
                     if(seg.hoverVersion) {
-                        uint64_t objectId = seg.tryLargestObjectContainingSubobject(subobjectId);
+                        const uint64_t objectId = entryCache->largestObjectIndex;
                         if (selected && seg.mouseFocusedObjectId == objectId) {
                             if(isPastFirstRow && isBeforeLastRow && isNotFirstColumn && isNotLastColumn) {
-                                const uint64_t left   = seg.tryLargestObjectContainingSubobject(*reinterpret_cast<uint64_t*>(datacube - voxelIncrement));
-                                const uint64_t right  = seg.tryLargestObjectContainingSubobject(*reinterpret_cast<uint64_t*>(datacube + voxelIncrement));
-                                const uint64_t top    = seg.tryLargestObjectContainingSubobject(*reinterpret_cast<uint64_t*>(datacube - sliceIncrement));
-                                const uint64_t bottom = seg.tryLargestObjectContainingSubobject(*reinterpret_cast<uint64_t*>(datacube + sliceIncrement));
+                                // the entry reference is only valid until the next lookup
+                                const uint64_t left   = seg.cachedSubobject(datacube[-voxelIncrement]).largestObjectIndex;
+                                const uint64_t right  = seg.cachedSubobject(datacube[+voxelIncrement]).largestObjectIndex;
+                                const uint64_t top    = seg.cachedSubobject(datacube[-sliceIncrement]).largestObjectIndex;
+                                const uint64_t bottom = seg.cachedSubobject(datacube[+sliceIncrement]).largestObjectIndex;
+                                entryCache = &seg.cachedSubobject(subobjectId);
                                 //enhance alpha of this voxel if any of the surrounding voxels belong to another object
                                 if (objectId != left || objectId != right || objectId != top || objectId != bottom) {
                                     slice[3] = std::min(255, slice[3]*4);
@@ -472,11 +456,6 @@ void Viewer::ocSliceExtract(std::uint64_t * datacube, Coordinate cubePosInAbsPx,
                         }
                     }
                 }
-
-                //fill cache
-                subobjectIdCache = subobjectId;
-                colorCache = color;
-                selectedCache = selected;
             }
             ++counter;
             datacube += voxelIncrement;
@@ -692,7 +671,8 @@ void Viewer::arbCubes(ViewportArb & vp) {
                     auto cubeIt = layer.textures.find(gpuCoord);
                     if (cubeIt != std::end(layer.textures)) {
                         cubeIt->second->vertices = /*std::move*/(points);
-                    } else {
+                    }
+                    if (!layer.upToDate(gpuCoord)) {
                         const auto cubeCoord = globalCoord.cube(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
                         const auto offset = globalCoord - cubeCoord.cube2Global(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
                         layer.pendingArbCubes.emplace_back(gpuCoord, offset);
@@ -714,49 +694,30 @@ void Viewer::setDefaultVPSizeAndPos(const bool on) {
 }
 
 void Viewer::vpGenerateTexture(ViewportArb &vp, const std::size_t layerId) {
-    if (Dataset::datasets[layerId].isOverlay() || !vp.resliceNecessary[layerId]) {
+    if (!vp.resliceNecessary[layerId]) {
         return;
     }
     vp.resliceNecessary[layerId] = false;
 
-    // Load the texture for a viewport by going through all relevant datacubes and copying slices
-    // from those cubes into the texture.
-    floatCoordinate currentPxInDc_float, rowPx_float, currentPx_float;
-
-    rowPx_float = vp.texture.leftUpperPxInAbsPx / Dataset::current().magnification;
-    currentPx_float = rowPx_float;
-
-    std::vector<std::uint8_t> texData(4 * std::pow(state->viewerState->texEdgeLength, 2));// RGBA
-
-    int s = 0, t = 0, t_old = 0;
-    while(s < vp.texture.usedSizeInCubePixels) {
-        t = 0;
-        while(t < vp.texture.usedSizeInCubePixels) {
-            Coordinate currentPx = {roundFloat(currentPx_float.x), roundFloat(currentPx_float.y), roundFloat(currentPx_float.z)};
-            Coordinate currentDc = currentPx / Dataset::current().cubeEdgeLength;
-
-            if(currentPx.x < 0) { currentDc.x -= 1; }
-            if(currentPx.y < 0) { currentDc.y -= 1; }
-            if(currentPx.z < 0) { currentDc.z -= 1; }
-
-            state->protectCube2Pointer.lock();
-            void * const datacube = cubeQuery(state->cube2Pointer, layerId, Dataset::datasets[layerId].magIndex, {currentDc.x, currentDc.y, currentDc.z});
-            state->protectCube2Pointer.unlock();
-
-            currentPxInDc_float = currentPx_float - currentDc * Dataset::current().cubeEdgeLength;
-            t_old = t;
-
-            dcSliceExtract(reinterpret_cast<std::uint8_t *>(datacube),
-                           &currentPxInDc_float,
-                           texData.data(),
-                           s, &t,
-                           vp.v2,
-                           state->viewerState->datasetAdjustmentOn, vp.texture.usedSizeInCubePixels);
-            currentPx_float = currentPx_float - vp.v2 * (t - t_old);
+    const auto texEdge = state->M * Dataset::current().cubeEdgeLength;
+    const ArbSlicer::Plane plane{vp.texture.leftUpperPxInAbsPx / Dataset::current().magnification, vp.v1, vp.v2, static_cast<int>(vp.texture.usedSizeInCubePixels), texEdge};
+    std::vector<ArbSlicer::rgba> texData(std::pow(state->viewerState->texEdgeLength, 2));
+    std::array<ArbSlicer::rgba, 256> lut;
+    for (std::size_t i = 0; i < lut.size(); ++i) {
+        if (state->viewerState->datasetAdjustmentOn) {
+            const auto & color = state->viewerState->datasetAdjustmentTable[i];
+            lut[i] = {{std::get<0>(color), std::get<1>(color), std::get<2>(color), 255}};
+        } else {
+            lut[i] = {{static_cast<std::uint8_t>(i), static_cast<std::uint8_t>(i), static_cast<std::uint8_t>(i), 255}};
+        }
+    }
+    {// the slicer keeps the cubes locked until it goes out of scope
+        const ArbSlicer slicer(layerId, plane);
+        if (Dataset::datasets[layerId].isOverlay()) {
+            slicer.sliceOverlay(texData.data());
+        } else {
+            slicer.sliceRaw(texData.data(), lut, viewerState.textureFilter == QOpenGLTexture::Linear);
         }
-        s++;
-        rowPx_float += vp.v1;
-        currentPx_float = rowPx_float;
     }
 
     vp.texture.texHandle[layerId].bind();
@@ -764,11 +725,11 @@ void Viewer::vpGenerateTexture(ViewportArb &vp, const std::size_t layerId) {
                     0,
                     0,
                     0,
-                    state->M*Dataset::current().cubeEdgeLength,
-                    state->M*Dataset::current().cubeEdgeLength,
+                    texEdge,
+                    texEdge,
                     GL_RGBA,
                     GL_UNSIGNED_BYTE,
-                texData.data());
+                    texData.data());
 
     vp.texture.texHandle[layerId].release();
     glBindTexture(GL_TEXTURE_2D, 0);
@@ -892,6 +853,9 @@ bool Viewer::updateDatasetMag(const int mag) {
             });
         }
     }
+    for (auto & layer : layers) {// uploads of the previous mag must not be adopted
+        layer.invalidate();
+    }
     //clear the viewports
     reslice_notify();
 
@@ -942,32 +906,32 @@ void Viewer::run() {
     // might cancel the current loading process. When all textures
     // have been processed, we go into an idle state, in which we wait for events.
     if (state->gpuSlicer && gpuRendering) {
-        const auto & loadPendingCubes = [&](TextureLayer & layer, std::vector<std::pair<CoordOfGPUCube, Coordinate>> & pendingCubes, QElapsedTimer & timer) {
-            while (!pendingCubes.empty() && !timer.hasExpired(3)) {
-                const auto pair = pendingCubes.back();
-                pendingCubes.pop_back();
-                if (layer.textures.find(pair.first) == std::end(layer.textures)) {
-                    const auto globalCoord = pair.first.cube2Global(gpucubeedge, Dataset::current().magnification);
-                    const auto cubeCoord = globalCoord.cube(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
-                    state->protectCube2Pointer.lock();
-                    const auto * ptr = cubeQuery(state->cube2Pointer, layer.isOverlayData, Dataset::current().magIndex, cubeCoord);
-                    state->protectCube2Pointer.unlock();
-                    if (ptr != nullptr) {
-                        layer.cubeSubArray(ptr, Dataset::current().cubeEdgeLength, gpucubeedge, pair.first, pair.second);
-                    }
+        const auto & requestPendingCubes = [&](TextureLayer & layer, std::vector<std::pair<CoordOfGPUCube, Coordinate>> & pendingCubes) {
+            for (const auto & pair : pendingCubes) {
+                const auto globalCoord = pair.first.cube2Global(gpucubeedge, Dataset::current().magnification);
+                const auto cubeCoord = globalCoord.cube(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
+                state->protectCube2Pointer.lock();
+                const auto * ptr = cubeQuery(state->cube2Pointer, layer.isOverlayData, Dataset::current().magIndex, cubeCoord);
+                state->protectCube2Pointer.unlock();
+                if (ptr != nullptr) {// preparation and upload happen in the background
+                    layer.requestCube(layer.isOverlayData, Dataset::current().magIndex, cubeCoord, Dataset::current().cubeEdgeLength, gpucubeedge, pair.first, pair.second);
                 }
             }
+            pendingCubes.clear();
         };
 
-        QElapsedTimer timer;
-        timer.start();
         for (auto & layer : layers) {
+            layer.adoptUploadedCubes(layer.isOverlayData, Dataset::current().magIndex, [this](const CoordOfGPUCube & gpuCoord){
+                return gpuCubeVisible(gpuCoord);
+            });
             calculateMissingOrthoGPUCubes(layer);
-            loadPendingCubes(layer, layer.pendingOrthoCubes, timer);
-            loadPendingCubes(layer, layer.pendingArbCubes, timer);
+            requestPendingCubes(layer, layer.pendingOrthoCubes);
+            requestPendingCubes(layer, layer.pendingArbCubes);
         }
     }
 
+    BrushStroke::singleton().flush();// paint everything the brush swept since the last frame
+
     window->forEachOrthoVPDo([](ViewportOrtho & vp) {
         vp.update();
     });
@@ -1053,15 +1017,12 @@ void Viewer::userMoveVoxels(const Coordinate & step, UserMoveType userMoveType,
     }
 
     if (state->gpuSlicer && newPosition_gpudc != lastPosition_gpudc) {
-        const auto supercubeedge = state->M * Dataset::current().cubeEdgeLength / gpucubeedge - (Dataset::current().cubeEdgeLength / gpucubeedge - 1);
         for (auto & layer : layers) {
             layer.ctx.makeCurrent(&layer.surface);
             std::vector<CoordOfGPUCube> obsoleteCubes;
             for (const auto & pair : layer.textures) {
-                const auto pos = pair.first;
-                const auto globalCoord = pos.cube2Global(gpucubeedge, Dataset::current().magnification);
-                if (!currentlyVisible(globalCoord, viewerState.currentPosition, supercubeedge, gpucubeedge)) {
-                    obsoleteCubes.emplace_back(pos);
+                if (!gpuCubeVisible(pair.first)) {
+                    obsoleteCubes.emplace_back(pair.first);
                 }
             }
             for (const auto & pos : obsoleteCubes) {
@@ -1091,6 +1052,11 @@ void Viewer::userMoveClear() {
     moveCache = {};
 }
 
+bool Viewer::gpuCubeVisible(const CoordOfGPUCube & gpuCoord) const {
+    const auto gpusupercube = (state->M - 1) * Dataset::current().cubeEdgeLength / gpucubeedge + 1;//remove cpu overlap and add gpu overlap
+    return currentlyVisible(gpuCoord.cube2Global(gpucubeedge, Dataset::current().magnification), state->viewerState->currentPosition, gpusupercube, gpucubeedge);
+}
+
 void Viewer::calculateMissingOrthoGPUCubes(TextureLayer & layer) {
     layer.pendingOrthoCubes.clear();
 
@@ -1104,7 +1070,7 @@ void Viewer::calculateMissingOrthoGPUCubes(TextureLayer & layer) {
     for (int z = edge.z; z < end.z; ++z) {
         const auto gpuCoord = CoordOfGPUCube{x, y, z};
         const auto globalCoord = gpuCoord.cube2Global(gpucubeedge, Dataset::current().magnification);
-        if (currentlyVisible(globalCoord, state->viewerState->currentPosition, gpusupercube, gpucubeedge) && layer.textures.count(gpuCoord) == 0) {
+        if (gpuCubeVisible(gpuCoord) && !layer.upToDate(gpuCoord)) {
             const auto cubeCoord = globalCoord.cube(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
             const auto offset = globalCoord - cubeCoord.cube2Global(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
             layer.pendingOrthoCubes.emplace_back(gpuCoord, offset);
@@ -1120,9 +1086,13 @@ void Viewer::reslice_notify() {
 
 void Viewer::reslice_notify(const std::size_t layerId) {
     reslice_notify_all(layerId, viewerState.currentPosition);
+    if (layerId == Segmentation::singleton().layerId) {
+        Segmentation::singleton().markVolumeDirty();
+    }
 }
 
 void Viewer::reslice_notify_all(const std::size_t layerId, const Coordinate coord) {
+    invalidateGPUCubes(layerId, {coord});
     if (currentlyVisibleWrapWrap(state->viewerState->currentPosition, coord)) {
         window->forEachOrthoVPDo([layerId](ViewportOrtho & vpOrtho) {
             vpOrtho.resliceNecessary[layerId] = true;
@@ -1130,13 +1100,61 @@ void Viewer::reslice_notify_all(const std::size_t layerId, const Coordinate coor
     }
     window->viewportArb->resliceNecessary[layerId] = true;//arb visibility is not tested
     if (layerId == Segmentation::singleton().layerId) {
-        // if anything has changed, update the volume texture data
-        Segmentation::singleton().volume_update_required = true;
+        // update the volume texture data of the changed cube
+        Segmentation::singleton().markVolumeDirty(coord);
+    }
+}
+
+void Viewer::reslice_notify_all(const std::size_t layerId, const std::vector<Coordinate> & coords) {
+    invalidateGPUCubes(layerId, coords);
+    const auto visible = std::any_of(std::begin(coords), std::end(coords), [](const Coordinate & coord){
+        return currentlyVisibleWrapWrap(state->viewerState->currentPosition, coord);
+    });
+    if (visible) {
+        window->forEachOrthoVPDo([layerId](ViewportOrtho & vpOrtho) {
+            vpOrtho.resliceNecessary[layerId] = true;
+        });
+    }
+    window->viewportArb->resliceNecessary[layerId] = true;//arb visibility is not tested
+    if (layerId == Segmentation::singleton().layerId) {
+        Segmentation::singleton().markVolumeDirty(coords);
+    }
+}
+
+void Viewer::invalidateGPUCubes(const std::size_t layerId, const std::vector<Coordinate> & globalCoords) {
+    if (!state->gpuSlicer) {
+        return;
     }
+    // also called from the loader thread, the layers belong to the gui thread
+    QTimer::singleShot(0, this, [this, layerId, globalCoords](){
+        const auto cubeEdge = Dataset::current().cubeEdgeLength;
+        const auto mag = Dataset::current().magnification;
+        std::vector<CoordOfGPUCube> gpuCoords;
+        for (const auto & globalCoord : globalCoords) {
+            const auto first = globalCoord.cube(gpucubeedge, mag);
+            const auto last = (globalCoord + cubeEdge * mag - 1).cube(gpucubeedge, mag);
+            for (int z = first.z; z <= last.z; ++z)
+            for (int y = first.y; y <= last.y; ++y)
+            for (int x = first.x; x <= last.x; ++x) {
+                gpuCoords.emplace_back(CoordOfGPUCube{x, y, z});
+            }
+        }
+        for (auto & layer : layers) {
+            if (static_cast<std::size_t>(layer.isOverlayData) == layerId) {
+                layer.invalidate(gpuCoords);
+            }
+        }
+    });
 }
 
 void Viewer::segmentation_changed() {
-    reslice_notify(Segmentation::singleton().layerId);
+    const auto layerId = Segmentation::singleton().layerId;
+    window->forEachOrthoVPDo([layerId](ViewportOrtho & vpOrtho) {
+        vpOrtho.resliceNecessary[layerId] = true;
+    });
+    window->viewportArb->resliceNecessary[layerId] = true;
+    // the volume texture only stores ids, it is redrawn with the new slot colors without resampling
+    Segmentation::singleton().volume_update_required = true;
 }
 
 void Viewer::recalcTextureOffsets() {
@@ -1305,12 +1323,12 @@ void Viewer::loadTreeLUT(const QString & path) {
 }
 
 QColor Viewer::getNodeColor(const nodeListElement & node) const {
-    const auto property = state->viewerState->highlightedNodePropertyByColor;
+    const auto & propertyKey = state->viewerState->nodePropertyColorKey;
     const auto range = state->viewerState->nodePropertyColorMapMax - state->viewerState->nodePropertyColorMapMin;
     const auto & nodeColors = state->viewerState->nodeColors;
     QColor color;
-    if (!property.isEmpty() && node.properties.contains(property) && range > 0) {
-        const int index = (node.properties[property].toDouble() / range * nodeColors.size()) - 1;
+    if (propertyKey && node.properties.contains(propertyKey.get()) && range > 0) {
+        const int index = (node.properties.number(propertyKey.get()) / range * nodeColors.size()) - 1;
         color = QColor::fromRgb(std::get<0>(nodeColors[index]), std::get<1>(nodeColors[index]), std::get<2>(nodeColors[index]));
     }
     else if (node.isBranchNode) { //branch nodes are always blue
@@ -25,6 +25,7 @@
 
 #include "functions.h"
 #include "remote.h"
+#include "skeleton/property_query.h"
 #include "slicer/gpucuber.h"
 #include "usermove.h"
 #include "widgets/preferences/navigationtab.h"
@@ -40,6 +41,8 @@
 #include <QQuaternion>
 #include <QTimer>
 
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 enum TreeDisplay {
@@ -61,22 +64,18 @@ enum class RotationCenter {
 };
 
 struct GLBuffers {
-    bool regenVertBuffer{true};
+    bool regenVertBuffer{true};// regenerate every chunk
 
     // vertex buffers that are available for rendering
     struct RenderBuffer {
         std::vector<floatCoordinate> vertices;
         std::vector<std::array<std::uint8_t, 4>> colors;
-        std::unordered_map<size_t, unsigned int> colorBufferOffset;
         QOpenGLBuffer vertex_buffer{QOpenGLBuffer::VertexBuffer};
         QOpenGLBuffer color_buffer{QOpenGLBuffer::VertexBuffer};
 
-        size_t lastSelectedNode{0};
-
         void clear() {
             vertices.clear();
             colors.clear();
-            colorBufferOffset.clear();
         }
 
         template<typename T, typename U>
@@ -84,8 +83,29 @@ struct GLBuffers {
             vertices.emplace_back(std::forward<T>(coord));
             colors.emplace_back(std::forward<U>(color));
         }
-    } lineVertBuffer, pointVertBuffer;
-    std::vector<std::array<std::uint8_t, 4>> colorPickingBuffer24, colorPickingBuffer48, colorPickingBuffer64;
+    };
+    // the skeleton geometry is split into a grid of chunks, edits only regenerate the chunks they touch
+    struct Chunk {
+        RenderBuffer lineVertBuffer, pointVertBuffer;
+        std::vector<std::array<std::uint8_t, 4>> colorPickingBuffer32, colorPickingBuffer64;// low and high half of the picking names
+        std::vector<std::uint64_t> nodeIDs;// nodes located in this chunk, segments belong to their target node
+        floatCoordinate center;// bounding sphere of the geometry for frustum culling
+        float radius{0};
+    };
+    int chunkEdge{512};// in voxels
+    std::unordered_map<CoordOfCube, Chunk> chunks;
+    RenderBuffer synapseLineBuffer;// virtual segments between synapse nodes, always regenerated
+    std::unordered_set<CoordOfCube> dirtyChunks;
+    std::unordered_set<std::uint64_t> dirtyNodes;// added, changed or removed since the last generation
+    std::unordered_set<std::uint64_t> addedNodes;// not listed in any chunk yet
+    std::vector<std::uint64_t> highlightedNodes;// selected nodes drawn in the highlight color
+
+    CoordOfCube chunkOf(const Coordinate & position) const {
+        return position.cube(chunkEdge, 1);
+    }
+    void nodeAdded(const nodeListElement & node);
+    void nodeChanged(const nodeListElement & node);
+    void nodeRemoved(const std::uint64_t nodeID);
 };
 
 
@@ -156,8 +176,10 @@ struct ViewerState {
     std::vector<std::tuple<uint8_t, uint8_t, uint8_t>> nodeColors;
     std::vector<std::tuple<uint8_t, uint8_t, uint8_t>> treeColors;
     QString highlightedNodePropertyByRadius{""};
+    boost::optional<PropertyMap::Name> nodePropertyRadiusKey;// interned highlightedNodePropertyByRadius
     double nodePropertyRadiusScale{1};
     QString highlightedNodePropertyByColor{""};
+    boost::optional<PropertyMap::Name> nodePropertyColorKey;// interned highlightedNodePropertyByColor
     double nodePropertyColorMapMin{0};
     double nodePropertyColorMapMax{0};
     // viewport rendering options
@@ -207,7 +229,6 @@ private:
     void vpGenerateTexture(ViewportArb & vp, const std::size_t layerId);
 
     void dcSliceExtract(std::uint8_t * datacube, Coordinate cubePosInAbsPx, std::uint8_t * slice, ViewportOrtho & vp, bool useCustomLUT);
-    void dcSliceExtract(std::uint8_t * datacube, floatCoordinate *currentPxInDc_float, std::uint8_t * slice, int s, int *t, const floatCoordinate & v2, bool useCustomLUT, float usedSizeInCubePixels);
 
     void ocSliceExtract(std::uint64_t * datacube, Coordinate cubePosInAbsPx, std::uint8_t * slice, ViewportOrtho & vp);
 
@@ -280,10 +301,13 @@ public slots:
     void vpGenerateTexture(ViewportOrtho & vp, const std::size_t layerId);
     void addRotation(const QQuaternion & quaternion);
     void resetRotation();
+    bool gpuCubeVisible(const CoordOfGPUCube & gpuCoord) const;
     void calculateMissingOrthoGPUCubes(TextureLayer & layer);
+    void invalidateGPUCubes(const std::size_t layerId, const std::vector<Coordinate> & globalCoords);
     void reslice_notify();
     void reslice_notify(const std::size_t layerId);
     void reslice_notify_all(const std::size_t layerId, const Coordinate coord);
+    void reslice_notify_all(const std::size_t layerId, const std::vector<Coordinate> & coords);
     void segmentation_changed();
     void setMovementAreaFactor(float alpha);
     int highestMag();
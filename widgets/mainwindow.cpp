@@ -33,6 +33,7 @@
 #include "skeleton/skeleton_dfs.h"
 #include "skeleton/skeletonizer.h"
 #include "stateInfo.h"
+#include "undojournal.h"
 #include "viewer.h"
 #include "viewports/viewportbase.h"
 #include "widgetcontainer.h"
@@ -572,6 +573,23 @@ void MainWindow::createMenus() {
     fileMenu.addSeparator();
     addApplicationShortcut(fileMenu, QIcon(":/resources/icons/menubar/quit.png"), tr("Quit"), this, &MainWindow::close, QKeySequence::Quit);
 
+    auto undoRedo = [this](const bool undo) {
+        try {
+            undo ? UndoJournal::singleton().undo() : UndoJournal::singleton().redo();
+        } catch (std::runtime_error & error) {
+            QMessageBox::warning(this, undo ? tr("Undo") : tr("Redo"), error.what());
+        }
+    };
+    undoAction = &addApplicationShortcut(actionMenu, QIcon(), tr("Undo"), this, [undoRedo]() { undoRedo(true); }, QKeySequence::Undo);
+    redoAction = &addApplicationShortcut(actionMenu, QIcon(), tr("Redo"), this, [undoRedo]() { undoRedo(false); }, QKeySequence::Redo);
+    undoAction->setEnabled(false);
+    redoAction->setEnabled(false);
+    QObject::connect(&UndoJournal::singleton(), &UndoJournal::changed, this, [this]() {
+        undoAction->setEnabled(UndoJournal::singleton().canUndo());
+        redoAction->setEnabled(UndoJournal::singleton().canRedo());
+    });
+    actionMenu.addSeparator();
+
     compressionToggleAction = &addApplicationShortcut(actionMenu, QIcon(), tr("Toggle Dataset Compression: None"), this, [this]() {
         if (Dataset::datasets.size() > 1 && !Dataset::datasets[1].allocationEnabled && !Dataset::datasets[1].isOverlay()) {// TODO multi layer
             std::swap(Dataset::datasets[0], Dataset::datasets[1]);
@@ -796,6 +814,7 @@ bool MainWindow::openFileDispatch(QStringList fileNames, const bool mergeAll, co
     try {
         LoadingCursor loadingcursor;
         QSignalBlocker blocker{Skeletonizer::singleton()};
+        UndoJournal::Blocker journalBlocker;// loading starts a new history
         for (const auto & filename : nmls) {
             const QString treeCmtOnMultiLoad = multipleFiles ? QFileInfo(filename).fileName() : "";
             QFile file(filename);
@@ -827,6 +846,7 @@ bool MainWindow::openFileDispatch(QStringList fileNames, const bool mergeAll, co
         return false;
     }
     Skeletonizer::singleton().resetData();
+    UndoJournal::singleton().clear();
 
     Session::singleton().unsavedChanges = multipleFiles || mergeSkeleton || mergeSegmentation; //merge implies changes
     if (!mergeSkeleton && !mergeSegmentation) { // if an annotation was already open don't change its filename, otherwise…
@@ -1106,6 +1126,7 @@ void MainWindow::clearSkeletonSlot() {
         question.exec();
         if (question.clickedButton() == ok) {
             Skeletonizer::singleton().clearSkeleton();
+            UndoJournal::singleton().clear();
         }
     }
 }
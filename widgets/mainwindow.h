@@ -131,6 +131,8 @@ class MainWindow : public QMainWindow {
     QAction *pushBranchAction;
     QAction *swapSynapticNodes;
     QAction *toggleSegmentsAction;
+    QAction *undoAction;
+    QAction *redoAction;
 
     QAction *newObjectAction;
     QAction *decreaseOpacityAction;
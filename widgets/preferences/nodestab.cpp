@@ -113,15 +113,12 @@ NodesTab::NodesTab(QWidget *parent) : QWidget(parent) {
     setLayout(&mainLayout);
 
     static auto findAndSetPropertyRange = [this](const auto & property){
-        const auto minmax = std::minmax_element(std::begin(state->skeletonState->nodesByNodeID), std::end(state->skeletonState->nodesByNodeID), [property](const auto & lhs, const auto & rhs){
-            const auto lhsIt = lhs.second->properties.find(property);
-            const auto rhsIt = rhs.second->properties.find(property);
-            const auto lhsValue = lhsIt != std::end(lhs.second->properties) ? lhsIt->toDouble() : 0.0;
-            const auto rhsValue = rhsIt != std::end(rhs.second->properties) ? rhsIt->toDouble() : 0.0;
-            return lhsValue < rhsValue;
+        const auto propertyId = PropertyMap::intern(property);
+        const auto minmax = std::minmax_element(std::begin(state->skeletonState->nodesByNodeID), std::end(state->skeletonState->nodesByNodeID), [propertyId](const auto & lhs, const auto & rhs){
+            return lhs.second->properties.number(propertyId) < rhs.second->properties.number(propertyId);
         });
-        propertyMinSpin.setValue(minmax.first->second->properties[property].toDouble());
-        propertyMaxSpin.setValue(minmax.second->second->properties[property].toDouble());
+        propertyMinSpin.setValue(minmax.first->second->properties.number(propertyId));
+        propertyMaxSpin.setValue(minmax.second->second->properties.number(propertyId));
         propertyMinMaxButton.setEnabled(false);
     };
 
@@ -162,6 +159,7 @@ NodesTab::NodesTab(QWidget *parent) : QWidget(parent) {
         const auto property = (index > 0) ? propertyModel.properties[index] : "";
         if (propertyConversionCheck(index, property, propertyRadiusCombo)) {
             state->viewerState->highlightedNodePropertyByRadius = property;
+            state->viewerState->nodePropertyRadiusKey = index > 0 ? boost::make_optional(PropertyMap::intern(property)) : boost::none;
             propertyRadiusScaleSpin.setEnabled(index > 0);
         }
     });
@@ -170,6 +168,7 @@ NodesTab::NodesTab(QWidget *parent) : QWidget(parent) {
         const auto property = (index > 0) ? propertyModel.properties[index] : "";
         if (propertyConversionCheck(index, property, propertyColorCombo)) {
             state->viewerState->highlightedNodePropertyByColor = property;
+            state->viewerState->nodePropertyColorKey = index > 0 ? boost::make_optional(PropertyMap::intern(property)) : boost::none;
             propertyMinSpin.setEnabled(index > 0);
             propertyMaxSpin.setEnabled(index > 0);
             propertyMinMaxButton.setEnabled(index > 0);
@@ -203,6 +202,7 @@ NodesTab::NodesTab(QWidget *parent) : QWidget(parent) {
     });
 
     QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeAddedSignal, [this](){ propertyMinMaxButton.setEnabled(propertyColorCombo.currentIndex() != 0); });
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodesAdded, [this](){ propertyMinMaxButton.setEnabled(propertyColorCombo.currentIndex() != 0); });
     QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeRemovedSignal, [this](){ propertyMinMaxButton.setEnabled(propertyColorCombo.currentIndex() != 0); });
     QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeChangedSignal, [this](){ propertyMinMaxButton.setEnabled(propertyColorCombo.currentIndex() != 0); });
     QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::resetData, [this](){ propertyMinMaxButton.setEnabled(propertyColorCombo.currentIndex() != 0); });
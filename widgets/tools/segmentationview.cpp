@@ -26,6 +26,7 @@
 #include "dataset.h"
 #include "mesh/mesh_generation.h"
 #include "model_helper.h"
+#include "segmentation/statistics.h"
 #include "stateInfo.h"
 #include "viewer.h"
 
@@ -38,7 +39,9 @@
 #include <QSplitter>
 #include <QString>
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 
 CategoryDelegate::CategoryDelegate(CategoryModel & categoryModel) {
     box.setModel(&categoryModel);
@@ -100,6 +103,27 @@ QVariant SegmentationObjectModel::headerData(int section, Qt::Orientation orient
 }
 
 QVariant SegmentationObjectModel::objectGet(const Segmentation::Object &obj, const QModelIndex & index, int role) const {
+    if (role == SortRole && (index.column() == 7 || index.column() == 8)) {
+        if (!SegmentationStatistics::singleton().active()) {
+            return QVariant();
+        }
+        const auto statistics = SegmentationStatistics::singleton().objectStatistics(obj.id);
+        if (statistics.voxels == 0) {
+            return QVariant();
+        } else if (index.column() == 7) {// by size
+            const auto extent = statistics.max - statistics.min + 1;
+            return static_cast<quint64>(extent.x) * static_cast<quint64>(extent.y) * static_cast<quint64>(extent.z);
+        }
+        // by position, z before y before x
+        const auto & boundary = Dataset::current().boundary;
+        const auto centroid = statistics.centroid();
+        const auto x = static_cast<quint64>(std::max(0.f, std::round(centroid.x)));
+        const auto y = static_cast<quint64>(std::max(0.f, std::round(centroid.y)));
+        const auto z = static_cast<quint64>(std::max(0.f, std::round(centroid.z)));
+        return (z * static_cast<quint64>(boundary.y + 1) + y) * static_cast<quint64>(boundary.x + 1) + x;
+    } else if (role == SortRole) {
+        role = Qt::DisplayRole;
+    }
     if (index.column() == 0 && (role == Qt::BackgroundRole || role == Qt::DecorationRole || role == Qt::UserRole)) {
         const auto color = Segmentation::singleton().colorObjectFromIndex(obj.index);
         return QColor(std::get<0>(color), std::get<1>(color), std::get<2>(color));
@@ -111,7 +135,26 @@ QVariant SegmentationObjectModel::objectGet(const Segmentation::Object &obj, con
         case 3: return obj.category;
         case 4: return obj.comment;
         case 5: return static_cast<quint64>(obj.subobjects.size());
-        case 6: {
+        case 6:
+        case 7:
+        case 8: {
+            if (!SegmentationStatistics::singleton().active()) {
+                return QVariant();
+            }
+            const auto statistics = SegmentationStatistics::singleton().objectStatistics(obj.id);
+            if (index.column() == 6) {
+                return static_cast<quint64>(statistics.voxels);
+            } else if (statistics.voxels == 0) {
+                return QVariant();
+            } else if (index.column() == 7) {
+                //0-based like the object_statistics of the python api, so values can be compared directly
+                return QString("%1, %2, %3 – %4, %5, %6").arg(statistics.min.x).arg(statistics.min.y).arg(statistics.min.z)
+                        .arg(statistics.max.x).arg(statistics.max.y).arg(statistics.max.z);
+            }
+            const auto centroid = statistics.centroid();
+            return QString("%1, %2, %3").arg(centroid.x, 0, 'f', 1).arg(centroid.y, 0, 'f', 1).arg(centroid.z, 0, 'f', 1);
+        }
+        case 9: {
             QString output;
             const auto limit = role != Qt::UserRole && obj.subobjects.size() > MAX_SHOWN_SUBOBJECTS;
             const auto elemCount = limit ? MAX_SHOWN_SUBOBJECTS : obj.subobjects.size();
@@ -198,6 +241,12 @@ void SegmentationObjectModel::changeRow(int idx) {
     emit dataChanged(index(idx, 0), index(idx, columnCount()-1));
 }
 
+void SegmentationObjectModel::changeStatistics() {
+    if (rowCount() > 0) {
+        emit dataChanged(index(0, 6), index(rowCount() - 1, 8));
+    }
+}
+
 void CategoryModel::recreate() {
     beginResetModel();
     categoriesCache.clear();
@@ -286,6 +335,7 @@ SegmentationView::SegmentationView(QWidget * const parent) : QWidget(parent), ca
     objectProxyModelCategory.setFilterKeyColumn(3);
     objectProxyModelComment.setFilterKeyColumn(4);
     setupTable(objectsTable, objectProxyModelComment);
+    objectProxyModelComment.setSortRole(SegmentationObjectModel::SortRole);
     objectsTable.setSortingEnabled(true);
     objectsTable.sortByColumn(objSortSectionIndex = 1, Qt::SortOrder::AscendingOrder);
 
@@ -332,6 +382,8 @@ SegmentationView::SegmentationView(QWidget * const parent) : QWidget(parent), ca
         objectsTable.resizeColumnToContents(index);
     }
 
+    QObject::connect(&SegmentationStatistics::singleton(), &SegmentationStatistics::changed, &objectModel, &SegmentationObjectModel::changeStatistics);
+    QObject::connect(&SegmentationStatistics::singleton(), &SegmentationStatistics::changed, &touchedObjectModel, &TouchedObjectModel::changeStatistics);
     QObject::connect(&Segmentation::singleton(), &Segmentation::beforeAppendRow, &objectModel, &SegmentationObjectModel::appendRowBegin);
     QObject::connect(&Segmentation::singleton(), &Segmentation::beforeRemoveRow, [this](){
         objectSelectionProtection = true;
@@ -471,6 +523,9 @@ SegmentationView::SegmentationView(QWidget * const parent) : QWidget(parent), ca
         addDisabledSeparator(objectsContextMenu);
         auto & newAction = *objectsContextMenu.addAction("Create new object");
         QObject::connect(&newAction, &QAction::triggered, []() { Segmentation::singleton().createAndSelectObject(state->viewerState->currentPosition); });
+        addDisabledSeparator(objectsContextMenu);
+        auto & statisticsAction = *objectsContextMenu.addAction("Update statistics");
+        QObject::connect(&statisticsAction, &QAction::triggered, []() { SegmentationStatistics::singleton().refresh(); });
     }
     createContextMenu(touchedObjsContextMenu, touchedObjsTable);
     static auto showContextMenu = [](auto & contextMenu, const QTreeView & table, const QPoint & pos){
@@ -56,9 +56,10 @@ class SegmentationObjectModel : public QAbstractListModel {
 Q_OBJECT
     friend class SegmentationView;//selection
 protected:
-    const std::vector<QString> header{""/*color*/, "Object ID", "Lock", "Category", "Comment", "#", "Subobject IDs"};
+    const std::vector<QString> header{""/*color*/, "Object ID", "Lock", "Category", "Comment", "#", "Voxels", "Bounding box", "Centroid", "Subobject IDs"};
     const std::size_t MAX_SHOWN_SUBOBJECTS = 10;
 public:
+    static constexpr int SortRole = Qt::UserRole + 1;// numeric keys for columns whose text doesn’t sort
     virtual int rowCount(const QModelIndex & parent = QModelIndex()) const override;
     virtual int columnCount(const QModelIndex & parent = QModelIndex()) const override;
     virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
@@ -73,6 +74,7 @@ public:
     void appendRow();
     void popRow();
     void changeRow(int idx);
+    void changeStatistics();
 };
 
 class TouchedObjectModel : public SegmentationObjectModel {
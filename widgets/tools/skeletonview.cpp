@@ -40,6 +40,11 @@
 #include <QRegExpValidator>
 #include <QSignalBlocker>
 
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+
 template<typename Func>
 void question(Func func, const QString & acceptButtonText, const QString & text, const QString & extraText = "") {
     QMessageBox prompt{QApplication::activeWindow()};
@@ -54,26 +59,133 @@ void question(Func func, const QString & acceptButtonText, const QString & text,
     }
 }
 
-template<typename ConcreteModel>
-int AbstractSkeletonModel<ConcreteModel>::columnCount(const QModelIndex &) const {
+std::uint64_t elemID(const treeListElement & tree) {
+    return tree.treeID;
+}
+std::uint64_t elemID(const nodeListElement & node) {
+    return node.nodeID;
+}
+
+template<typename ConcreteModel, typename Elem>
+int AbstractSkeletonModel<ConcreteModel, Elem>::columnCount(const QModelIndex &) const {
     return static_cast<ConcreteModel const * const>(this)->header.size();
 }
-template<typename ConcreteModel>
-QVariant AbstractSkeletonModel<ConcreteModel>::headerData(int section, Qt::Orientation orientation, int role) const {
+template<typename ConcreteModel, typename Elem>
+QVariant AbstractSkeletonModel<ConcreteModel, Elem>::headerData(int section, Qt::Orientation orientation, int role) const {
     return (orientation == Qt::Horizontal && role == Qt::DisplayRole) ? static_cast<ConcreteModel const * const>(this)->header[section] : QVariant();
 }
-template<typename ConcreteModel>
-Qt::ItemFlags AbstractSkeletonModel<ConcreteModel>::flags(const QModelIndex &index) const {
+template<typename ConcreteModel, typename Elem>
+Qt::ItemFlags AbstractSkeletonModel<ConcreteModel, Elem>::flags(const QModelIndex &index) const {
     return QAbstractItemModel::flags(index) | Qt::ItemNeverHasChildren | static_cast<ConcreteModel const * const>(this)->flagModifier[index.column()];
 }
-template<typename ConcreteModel>
-int AbstractSkeletonModel<ConcreteModel>::rowCount(const QModelIndex &) const {
-    return static_cast<ConcreteModel const * const>(this)->cache.size();
+template<typename ConcreteModel, typename Elem>
+int AbstractSkeletonModel<ConcreteModel, Elem>::rowCount(const QModelIndex &) const {
+    return cache.size();
+}
+
+template<typename ConcreteModel, typename Elem>
+template<typename Func>
+const QString & AbstractSkeletonModel<ConcreteModel, Elem>::cachedPropertyString(const Elem & elem, Func func) const {
+    auto it = propertyStrings.find(elemID(elem));
+    if (it == std::end(propertyStrings)) {
+        it = propertyStrings.emplace(elemID(elem), func()).first;
+    }
+    return it->second;
+}
+
+template<typename ConcreteModel, typename Elem>
+void AbstractSkeletonModel<ConcreteModel, Elem>::resetRows() {
+    cache.clear();
+    rowById.clear();
+    validRows = 0;
+    propertyStrings.clear();
+}
+
+template<typename ConcreteModel, typename Elem>
+int AbstractSkeletonModel<ConcreteModel, Elem>::rowOf(const std::uint64_t id) const {
+    auto it = rowById.find(id);
+    if ((it == std::end(rowById) || static_cast<std::size_t>(it->second) >= validRows) && validRows < cache.size()) {// renumber the rows behind the first removal
+        for (auto row = validRows; row < cache.size(); ++row) {
+            rowById[elemID(cache[row].get())] = static_cast<int>(row);
+        }
+        validRows = cache.size();
+        it = rowById.find(id);
+    }
+    return it != std::end(rowById) ? it->second : -1;
+}
+
+template<typename ConcreteModel, typename Elem>
+void AbstractSkeletonModel<ConcreteModel, Elem>::append(Elem & elem) {
+    const auto row = static_cast<int>(cache.size());
+    beginInsertRows(QModelIndex{}, row, row);
+    cache.emplace_back(elem);
+    if (validRows + 1 == cache.size()) {
+        rowById[elemID(elem)] = row;
+        ++validRows;
+    }
+    endInsertRows();
 }
 
-template class AbstractSkeletonModel<TreeModel>;//please clang, should actually be implicitly instantiated in here anyway
+template<typename ConcreteModel, typename Elem>
+void AbstractSkeletonModel<ConcreteModel, Elem>::append(const std::vector<Elem *> & elems) {
+    if (elems.empty()) {
+        return;
+    }
+    const auto row = static_cast<int>(cache.size());
+    beginInsertRows(QModelIndex{}, row, row + static_cast<int>(elems.size()) - 1);
+    const bool rowsValid = validRows == cache.size();
+    for (auto * elem : elems) {
+        if (rowsValid) {
+            rowById[elemID(*elem)] = static_cast<int>(cache.size());
+        }
+        cache.emplace_back(*elem);
+    }
+    if (rowsValid) {
+        validRows = cache.size();
+    }
+    endInsertRows();
+}
 
-QString propertyStringWithoutComment(const QVariantHash & properties) {
+template<typename ConcreteModel, typename Elem>
+void AbstractSkeletonModel<ConcreteModel, Elem>::remove(const std::uint64_t id) {
+    const auto row = rowOf(id);
+    if (row == -1) {
+        return;
+    }
+    beginRemoveRows(QModelIndex{}, row, row);
+    cache.erase(std::next(std::begin(cache), row));
+    rowById.erase(id);
+    validRows = std::min(validRows, static_cast<std::size_t>(row));
+    propertyStrings.erase(id);
+    endRemoveRows();
+}
+
+template<typename ConcreteModel, typename Elem>
+void AbstractSkeletonModel<ConcreteModel, Elem>::changed(const Elem & elem) {
+    const auto row = rowOf(elemID(elem));
+    if (row != -1) {
+        propertyStrings.erase(elemID(elem));
+        emit dataChanged(index(row, 0), index(row, columnCount() - 1));
+    }
+}
+
+// copies the values of a column, so the proxy can turn them into keys in the background
+template<typename Cache, typename Func>
+SortFilterProxy::Snapshot snapshotOf(const Cache & cache, Func func) {
+    auto values = std::make_shared<std::vector<decltype(func(cache.front().get()))>>();
+    values->reserve(cache.size());
+    for (const auto & elem : cache) {
+        values->emplace_back(func(elem.get()));
+    }
+    return [values](const int row){
+        return QVariant::fromValue((*values)[row]);
+    };
+}
+
+template class AbstractSkeletonModel<TreeModel, treeListElement>;//please clang, should actually be implicitly instantiated in here anyway
+template class AbstractSkeletonModel<NodeModel, nodeListElement>;
+
+QString propertyStringWithoutComment(const PropertyMap & properties) {
     QString propertiesString("");
     for (auto it = std::cbegin(properties); it != std::cend(properties); ++it) {
         if (it.key() != "comment") {
@@ -97,16 +209,27 @@ QVariant TreeModel::data(const QModelIndex &index, int role) const {
         case 3: return static_cast<quint64>(tree.nodes.size());
         case 4: return tree.getComment();
         case 5:
-            auto treeProperties = propertyStringWithoutComment(tree.properties);
-            if(tree.mesh != nullptr) {
-                treeProperties.prepend("Mesh");
-            }
-            return treeProperties;
+            return cachedPropertyString(tree, [&tree](){
+                auto treeProperties = propertyStringWithoutComment(tree.properties);
+                if(tree.mesh != nullptr) {
+                    treeProperties.prepend("Mesh");
+                }
+                return treeProperties;
+            });
         }
     }
     return QVariant();//return invalid QVariant
 }
 
+SortFilterProxy::Snapshot TreeModel::snapshot(const int column) const {// like data
+    switch (column) {
+    case 0: return snapshotOf(cache, [](const treeListElement & tree){ return static_cast<quint64>(tree.treeID); });
+    case 3: return snapshotOf(cache, [](const treeListElement & tree){ return static_cast<quint64>(tree.nodes.size()); });
+    case 4: return snapshotOf(cache, [](const treeListElement & tree){ return tree.getComment(); });
+    }
+    return {};// properties are formatted on demand
+}
+
 bool TreeModel::setData(const QModelIndex & index, const QVariant & value, int role) {
     if (!index.isValid()) {
         return false;
@@ -144,20 +267,34 @@ QVariant NodeModel::data(const QModelIndex &index, int role) const {
         case 4: return node.radius;
         case 5: return node.getComment();
         case 6:
-            auto nodeProperties = propertyStringWithoutComment(node.properties);
-            if(node.isSynapticNode) {
-                if(node.correspondingSynapse->getPreSynapse() == &node) {
-                    nodeProperties.prepend("PreSynapse");
-                } else if(node.correspondingSynapse->getPostSynapse() == &node){
-                    nodeProperties.prepend("PostSynapse");
+            return cachedPropertyString(node, [&node](){
+                auto nodeProperties = propertyStringWithoutComment(node.properties);
+                if(node.isSynapticNode) {
+                    if(node.correspondingSynapse->getPreSynapse() == &node) {
+                        nodeProperties.prepend("PreSynapse");
+                    } else if(node.correspondingSynapse->getPostSynapse() == &node){
+                        nodeProperties.prepend("PostSynapse");
+                    }
                 }
-            }
-            return nodeProperties;
+                return nodeProperties;
+            });
         }
     }
     return QVariant();//return invalid QVariant
 }
 
+SortFilterProxy::Snapshot NodeModel::snapshot(const int column) const {// like data
+    switch (column) {
+    case 0: return snapshotOf(cache, [](const nodeListElement & node){ return static_cast<quint64>(node.nodeID); });
+    case 1: return snapshotOf(cache, [](const nodeListElement & node){ return node.position.x + 1; });
+    case 2: return snapshotOf(cache, [](const nodeListElement & node){ return node.position.y + 1; });
+    case 3: return snapshotOf(cache, [](const nodeListElement & node){ return node.position.z + 1; });
+    case 4: return snapshotOf(cache, [](const nodeListElement & node){ return node.radius; });
+    case 5: return snapshotOf(cache, [](const nodeListElement & node){ return node.getComment(); });
+    }
+    return {};// properties are formatted on demand
+}
+
 bool NodeModel::setData(const QModelIndex & index, const QVariant & value, int role) {
     if (state->skeletonState->trees.empty() || !index.isValid() || !(role == Qt::DisplayRole || role == Qt::EditRole)) {
         return false;
@@ -193,49 +330,86 @@ bool TreeModel::dropMimeData(const QMimeData *, Qt::DropAction, int, int, const
     return false;
 }
 
+bool TreeModel::matches(const treeListElement & tree) const {
+    return (mode == SynapseDisplayModes::Hide && tree.isSynapticCleft == false)
+            || (mode == SynapseDisplayModes::Show)
+            || (mode == SynapseDisplayModes::ShowOnly && tree.isSynapticCleft);
+}
+
+void TreeModel::add(treeListElement & tree) {
+    if (matches(tree)) {
+        append(tree);
+    }
+}
+
 void TreeModel::recreate() {
     beginResetModel();
-    cache.clear();
+    resetRows();
     for (auto && tree : state->skeletonState->trees) {
-        if ((mode == SynapseDisplayModes::Hide && tree.isSynapticCleft == false)
-                || (mode == SynapseDisplayModes::Show)
-                || (mode == SynapseDisplayModes::ShowOnly && tree.isSynapticCleft)) {
+        if (matches(tree)) {
             cache.emplace_back(tree);
         }
     }
     endResetModel();
 }
 
+bool NodeModel::matches(const nodeListElement & node) const {
+    if (mode.testFlag(FilterMode::All)) {
+        return true;
+    }
+    // show node if for all criteria: either criterion not demanded or fulfilled
+    const auto oneMatched = (mode.testFlag(FilterMode::Selected) && node.selected)
+            || (mode.testFlag(FilterMode::InSelectedTree) && node.correspondingTree->selected)
+            || (mode.testFlag(FilterMode::Branch) && node.isBranchNode)
+            || (mode.testFlag(FilterMode::Comment) && node.getComment().isEmpty() == false)
+            || (mode.testFlag(FilterMode::Synapse) && node.isSynapticNode);
+    const auto allMatched = (!mode.testFlag(FilterMode::Selected) || node.selected)
+            && (!mode.testFlag(FilterMode::InSelectedTree) || node.correspondingTree->selected)
+            && (!mode.testFlag(FilterMode::Branch) || node.isBranchNode)
+            && (!mode.testFlag(FilterMode::Comment) || node.getComment().isEmpty() == false)
+            && (!mode.testFlag(FilterMode::Synapse) || node.isSynapticNode);
+    return (!matchAll && oneMatched) || (matchAll && allMatched);
+}
+
+void NodeModel::add(nodeListElement & node) {
+    if (matches(node)) {
+        append(node);
+    }
+}
+
+void NodeModel::add(const std::vector<nodeListElement *> & nodes) {
+    std::vector<nodeListElement *> shown;
+    std::copy_if(std::begin(nodes), std::end(nodes), std::back_inserter(shown), [this](const nodeListElement * node){
+        return matches(*node);
+    });
+    append(shown);
+}
+
+void NodeModel::update(nodeListElement & node) {
+    const auto shown = rowOf(node.nodeID) != -1;
+    const auto show = matches(node);
+    if (!shown && show) {
+        append(node);
+    } else if (shown && !show) {
+        remove(node.nodeID);
+    } else {
+        changed(node);
+    }
+}
+
 void NodeModel::recreate(const bool matchAll = true) {
     beginResetModel();
-    cache.clear();
+    resetRows();
+    this->matchAll = matchAll;
     for (auto && tree : state->skeletonState->trees)
     for (auto && node : tree.nodes) {
-        cache.emplace_back(node);
-    }
-
-    if(mode.testFlag(FilterMode::All) == false) {
-        decltype(cache) hits;
-        for (auto && node : cache) {// show node if for all criteria: either criterion not demanded or fulfilled
-            const auto oneMatched = (mode.testFlag(FilterMode::Selected) && node.get().selected)
-                    || (mode.testFlag(FilterMode::InSelectedTree) && node.get().correspondingTree->selected)
-                    || (mode.testFlag(FilterMode::Branch) && node.get().isBranchNode)
-                    || (mode.testFlag(FilterMode::Comment) && node.get().getComment().isEmpty() == false)
-                    || (mode.testFlag(FilterMode::Synapse) && node.get().isSynapticNode);
-            const auto allMatched = (!mode.testFlag(FilterMode::Selected) || node.get().selected)
-                    && (!mode.testFlag(FilterMode::InSelectedTree) || node.get().correspondingTree->selected)
-                    && (!mode.testFlag(FilterMode::Branch) || node.get().isBranchNode)
-                    && (!mode.testFlag(FilterMode::Comment) || node.get().getComment().isEmpty() == false)
-                    && (!mode.testFlag(FilterMode::Synapse) || node.get().isSynapticNode);
-            if ((!matchAll && oneMatched) || (matchAll && allMatched)) {
-                hits.emplace_back(node);
-            } else if (matchAll && mode.testFlag(FilterMode::Selected) && node.get().selected) {
-                selectionFromModel = true;
-                Skeletonizer::singleton().toggleNodeSelection({&node.get()});
-                selectionFromModel = false;
-            }
+        if (matches(node)) {
+            cache.emplace_back(node);
+        } else if (matchAll && mode.testFlag(FilterMode::Selected) && node.selected) {
+            selectionFromModel = true;
+            Skeletonizer::singleton().toggleNodeSelection({&node});
+            selectionFromModel = false;
         }
-        cache = hits;
     }
     endResetModel();
 }
@@ -281,28 +455,32 @@ auto selectElems(View & view, Model & model, Proxy & proxy) {
 }
 
 template<typename Model, typename Proxy>
-auto updateSelection(QTreeView & view, Model & model, Proxy & proxy) {
+auto updateSelection(QTreeView & view, Model & model, Proxy & proxy, const bool followActive = false) {
     auto isSelectedFunc = [&model, &proxy, &selectionModel = *view.selectionModel()](const int rowIndex){
         return selectionModel.isSelected(proxy.mapFromSource(model.index(rowIndex, 0)));
     };
     const auto selection = deltaBlockSelection(model, model.cache, isSelectedFunc);
+    const auto deselection = deltaBlockSelection(model, model.cache, isSelectedFunc, true);// rows are not reset anymore for every change
     const auto selectedIndices = proxy.mapSelectionFromSource(selection);
+    const auto deselectedIndices = proxy.mapSelectionFromSource(deselection);
 
     model.selectionProtection = true;
+    if (!deselectedIndices.isEmpty()) {
+        view.selectionModel()->select(deselectedIndices, QItemSelectionModel::Deselect);
+    }
     if (!selectedIndices.isEmpty()) {// selecting an empty index range apparently clears
-        view.selectionModel()->select(selectedIndices, QItemSelectionModel::SelectCurrent);
+        view.selectionModel()->select(selectedIndices, QItemSelectionModel::Select);
     }
     model.selectionProtection = false;
 
     auto * active = Skeletonizer::singleton().active<typename decltype(model.cache)::value_type::type>();
-    if (!view.currentIndex().isValid() && active != nullptr) {// find active elem and set as current index
-        const auto activeIt = std::find_if(std::begin(model.cache), std::end(model.cache), [&active](const auto & elem){
-            return &elem.get() == active;
-        });
-        if (activeIt != std::end(model.cache)) {
-            const std::size_t activeIndex = std::distance(std::begin(model.cache), activeIt);
-            const auto modelIndex = proxy.mapFromSource(model.index(activeIndex, 0));
+    if ((followActive || !view.currentIndex().isValid()) && active != nullptr) {// set active elem as current index
+        const auto activeIndex = model.rowOf(elemID(*active));
+        const auto modelIndex = proxy.mapFromSource(model.index(activeIndex, 0));
+        if (activeIndex != -1 && modelIndex.isValid() && modelIndex.row() != view.currentIndex().row()) {
+            model.selectionProtection = true;
             view.selectionModel()->setCurrentIndex(modelIndex, QItemSelectionModel::NoUpdate);
+            model.selectionProtection = false;
         }
     }
     if (!selectedIndices.indexes().isEmpty()) {// scroll to first selected entry
@@ -329,6 +507,7 @@ SkeletonView::SkeletonView(QWidget * const parent) : QWidget{parent}
     treeCommentFilter.setPlaceholderText("Tree comment");
     treeSortAndCommentFilterProxy.setFilterCaseSensitivity(Qt::CaseInsensitive);
     treeSortAndCommentFilterProxy.setFilterKeyColumn(4);
+    treeSortAndCommentFilterProxy.columnSnapshot = [this](const int column){ return treeModel.snapshot(column); };
     treeSortAndCommentFilterProxy.setSourceModel(&treeModel);
 
     setupTable(treeView, treeSortAndCommentFilterProxy, treeSortSectionIndex);
@@ -361,6 +540,7 @@ SkeletonView::SkeletonView(QWidget * const parent) : QWidget{parent}
 
     nodeCommentFilter.setPlaceholderText("Node comment");
 
+    nodeSortAndCommentFilterProxy.columnSnapshot = [this](const int column){ return nodeModel.snapshot(column); };
     nodeSortAndCommentFilterProxy.setSourceModel(&nodeModel);
     nodeSortAndCommentFilterProxy.setFilterCaseSensitivity(Qt::CaseInsensitive);
     nodeSortAndCommentFilterProxy.setFilterKeyColumn(5);
@@ -445,20 +625,26 @@ SkeletonView::SkeletonView(QWidget * const parent) : QWidget{parent}
     connect(&Skeletonizer::singleton(), &Skeletonizer::lockedToNode, [this](const std::uint64_t nodeID) { lockedNodeLabel.setText(tr("Locked to node %1").arg(nodeID)); });
     connect(&Skeletonizer::singleton(), &Skeletonizer::unlockedNode, [this]() { lockedNodeLabel.setText(tr("Locked to nothing at the moment")); });
 
-    static auto updateTreeSelection = [this](){
-        updateSelection(treeView, treeModel, treeSortAndCommentFilterProxy);
+    static auto updateTreeCount = [this](){
         const auto all = state->skeletonState->trees.size();
         const auto shown = static_cast<std::size_t>(treeView.model()->rowCount());
         const auto selected = state->skeletonState->selectedTrees.size();
         treeCountLabel.setText(tr("%1 trees").arg(all) + (all != shown ? tr(", %2 shown").arg(shown) : "") + (selected != 0 ? tr(", %3 selected").arg(selected) : ""));
     };
-    static auto updateNodeSelection = [this](){
-        updateSelection(nodeView, nodeModel, nodeSortAndCommentFilterProxy);
+    static auto updateNodeCount = [this](){
         const auto all = state->skeletonState->nodesByNodeID.size();
         const auto shown = static_cast<std::size_t>(nodeView.model()->rowCount());
         const auto selected = state->skeletonState->selectedNodes.size();
         nodeCountLabel.setText(tr("%1 nodes").arg(all) + (all != shown ? tr(", %2 shown").arg(shown) : "") + (selected != 0 ? tr(", %3 selected").arg(selected) : ""));
     };
+    static auto updateTreeSelection = [this](const bool followActive = false){
+        updateSelection(treeView, treeModel, treeSortAndCommentFilterProxy, followActive);
+        updateTreeCount();
+    };
+    static auto updateNodeSelection = [this](const bool followActive = false){
+        updateSelection(nodeView, nodeModel, nodeSortAndCommentFilterProxy, followActive);
+        updateNodeCount();
+    };
     static auto treeRecreate = [&, this](){
         treeModel.recreate();
         updateTreeSelection();
@@ -474,6 +660,9 @@ SkeletonView::SkeletonView(QWidget * const parent) : QWidget{parent}
     // populate count labels
     updateTreeSelection();
     updateNodeSelection();
+    // asynchronous sorting and filtering replaced the rows
+    QObject::connect(&treeSortAndCommentFilterProxy, &SortFilterProxy::refreshed, [](){ updateTreeSelection(); });
+    QObject::connect(&nodeSortAndCommentFilterProxy, &SortFilterProxy::refreshed, [](){ updateNodeSelection(); });
 
     QObject::connect(&treeFilterCombo, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged), [this](const int index) {
         treeModel.mode = static_cast<TreeModel::SynapseDisplayModes>(index);
@@ -498,56 +687,64 @@ SkeletonView::SkeletonView(QWidget * const parent) : QWidget{parent}
         nodeRecreate();
     });
 
-    const auto treeIndex = [this](const auto & tree){
-        const auto it = std::find_if(std::cbegin(treeModel.cache), std::cend(treeModel.cache), [&tree](const auto & elem){
-            return elem.get().treeID == tree.treeID;
-        });
-        return static_cast<int>(std::distance(std::cbegin(treeModel.cache), it));
-    };
-    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::treeAddedSignal, allRecreate);
-    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::treeChangedSignal, [this, treeIndex](const auto & tree){
-        const auto index = treeIndex(tree);
-        treeModel.dataChanged(treeModel.index(index, 0), treeModel.index(index, treeModel.columnCount() - 1));
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::treeAddedSignal, [this](const auto & tree){
+        treeModel.add(*Skeletonizer::findTreeByTreeID(tree.treeID));
+        updateTreeCount();
     });
-    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::treeRemovedSignal, allRecreate);
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::treeChangedSignal, [this](const auto & tree){
+        treeModel.changed(tree);
+    });
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::treeRemovedSignal, allRecreate);// its nodes were removed silently
     QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::treesMerged, treeRecreate);
     QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::treeSelectionChangedSignal, [this](){
-        if (!treeModel.selectionFromModel) {
-            treeRecreate();// show active node from vp selection
-        } else {
-            updateTreeSelection();
-        }
+        updateTreeSelection(!treeModel.selectionFromModel);// show active tree from vp selection
         treeModel.selectionFromModel = false;
         if (nodeModel.mode.testFlag(NodeModel::FilterMode::InSelectedTree)) {
             nodeRecreate();
         }
     });
 
-    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::branchPoppedSignal, nodeRecreate);
-    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::branchPushedSignal, nodeRecreate);
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::branchPoppedSignal, [this](){
+        if (nodeModel.mode.testFlag(NodeModel::FilterMode::Branch)) {
+            nodeRecreate();
+        }
+    });
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::branchPushedSignal, [this](){
+        if (nodeModel.mode.testFlag(NodeModel::FilterMode::Branch)) {
+            nodeRecreate();
+        }
+    });
     QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeSelectionChangedSignal, [this](){
-        if (!nodeModel.selectionFromModel) {
-            nodeRecreate();// show active node from vp selection
+        if (!nodeModel.selectionFromModel && nodeModel.mode.testFlag(NodeModel::FilterMode::Selected)) {
+            nodeRecreate();
         } else {
-            updateNodeSelection();
+            updateNodeSelection(!nodeModel.selectionFromModel);// show active node from vp selection
         }
         nodeModel.selectionFromModel = false;
     });
 
-    const auto nodeIndex = [this](const auto & node){
-        const auto it = std::find_if(std::cbegin(nodeModel.cache), std::cend(nodeModel.cache), [&node](const auto & elem){
-            return elem.get().nodeID == node.nodeID;
-        });
-        return static_cast<int>(std::distance(std::cbegin(nodeModel.cache), it));
-    };
-    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeAddedSignal, nodeRecreate);
-    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeChangedSignal, [this, nodeIndex](const auto & node){
-        const auto index = nodeIndex(node);
-        nodeModel.dataChanged(nodeModel.index(index, 0), nodeModel.index(index, nodeModel.columnCount() - 1));
-    });
-    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeRemovedSignal, nodeRecreate);
-    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::jumpedToNodeSignal, [this, nodeIndex](const auto & node){
-        const auto modelIndex = nodeSortAndCommentFilterProxy.mapFromSource(nodeModel.index(nodeIndex(node), 0));
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeAddedSignal, [this](const auto & node){
+        nodeModel.add(*Skeletonizer::findNodeByNodeID(node.nodeID));
+        treeModel.changed(*node.correspondingTree);// node count
+        updateNodeCount();
+    });
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodesAdded, [this](const treeListElement & tree, const std::vector<nodeListElement *> & nodes){
+        nodeModel.add(nodes);
+        treeModel.changed(tree);// node count
+        updateNodeCount();
+    });
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeChangedSignal, [this](const auto & node){
+        nodeModel.update(*Skeletonizer::findNodeByNodeID(node.nodeID));
+    });
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::nodeRemovedSignal, [this](const std::uint64_t nodeID, const std::uint64_t treeID){
+        nodeModel.remove(nodeID);
+        if (auto * tree = Skeletonizer::findTreeByTreeID(treeID)) {
+            treeModel.changed(*tree);// node count
+        }
+        updateNodeCount();
+    });
+    QObject::connect(&Skeletonizer::singleton(), &Skeletonizer::jumpedToNodeSignal, [this](const auto & node){
+        const auto modelIndex = nodeSortAndCommentFilterProxy.mapFromSource(nodeModel.index(nodeModel.rowOf(node.nodeID), 0));
         if (modelIndex.isValid()) {
             nodeView.scrollTo(modelIndex);
         }
@@ -688,12 +885,12 @@ SkeletonView::SkeletonView(QWidget * const parent) : QWidget{parent}
     QObject::connect(treeContextMenu.addAction("Jump to preSynapse"), &QAction::triggered, [](){
         const auto * tree = state->skeletonState->selectedTrees.front();
         assert(tree->properties.contains("preSynapse"));
-        Skeletonizer::singleton().jumpToNode(*state->skeletonState->nodesByNodeID[tree->properties["preSynapse"].toLongLong()]);
+        Skeletonizer::singleton().jumpToNode(*state->skeletonState->nodesByNodeID[tree->properties.value("preSynapse").toLongLong()]);
     });
     QObject::connect(treeContextMenu.addAction("Jump to postSynapse"), &QAction::triggered, [](){
         const auto * tree = state->skeletonState->selectedTrees.front();
         assert(tree->properties.contains("preSynapse"));
-        Skeletonizer::singleton().jumpToNode(*state->skeletonState->nodesByNodeID[tree->properties["postSynapse"].toLongLong()]);
+        Skeletonizer::singleton().jumpToNode(*state->skeletonState->nodesByNodeID[tree->properties.value("postSynapse").toLongLong()]);
     });
     QObject::connect(treeContextMenu.addAction("Reverse synapse direction"), &QAction::triggered, this, &SkeletonView::reverseSynapseDirection);
     addDisabledSeparator(treeContextMenu);
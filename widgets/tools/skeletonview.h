@@ -24,6 +24,7 @@
 #define SKELETONVIEW_H
 
 #include "widgets/Spoiler.h"
+#include "widgets/tools/sortfilterproxy.h"
 #include "widgets/UserOrientableSplitter.h"
 
 #include <QAbstractListModel>
@@ -39,30 +40,44 @@
 #include <QMenu>
 #include <QPushButton>
 #include <QSpinBox>
-#include <QSortFilterProxyModel>
 #include <QTreeView>
 #include <QVBoxLayout>
 
+#include <cstdint>
 #include <functional>
+#include <unordered_map>
+#include <vector>
 
-template<typename ConcreteModel>
+template<typename ConcreteModel, typename Elem>
 class AbstractSkeletonModel : public QAbstractListModel {
+    mutable std::unordered_map<std::uint64_t, int> rowById;
+    mutable std::size_t validRows{0};// entries for rows behind this may be outdated after removals
+protected:
+    mutable std::unordered_map<std::uint64_t, QString> propertyStrings;// only formatted for rows that were displayed
+    template<typename Func>
+    const QString & cachedPropertyString(const Elem & elem, Func func) const;
+    void resetRows();// call between beginResetModel and endResetModel
 public:
+    std::vector<std::reference_wrapper<Elem>> cache;
     bool selectionProtection{false};
     bool selectionFromModel{false};
     virtual int columnCount(const QModelIndex & parent = QModelIndex()) const override;
     virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
     virtual Qt::ItemFlags flags(const QModelIndex & index) const override;
     virtual int rowCount(const QModelIndex &) const override;
+    int rowOf(const std::uint64_t id) const;// -1 if not shown
+    void append(Elem & elem);
+    void append(const std::vector<Elem *> & elems);// as one inserted range
+    void remove(const std::uint64_t id);
+    void changed(const Elem & elem);
 };
 
-class TreeModel : public AbstractSkeletonModel<TreeModel> {
+class TreeModel : public AbstractSkeletonModel<TreeModel, class treeListElement> {
     Q_OBJECT
-    friend class AbstractSkeletonModel<TreeModel>;
+    friend class AbstractSkeletonModel<TreeModel, treeListElement>;
     const std::vector<QString> header = {"ID", ""/*color*/, "Show", "#", "Comment", "Properties"};
     const std::vector<Qt::ItemFlags> flagModifier = {Qt::ItemIsDropEnabled, 0, Qt::ItemIsUserCheckable, 0, Qt::ItemIsEditable, 0};
 public:
-    std::vector<std::reference_wrapper<class treeListElement>> cache;
     enum SynapseDisplayModes {
         Hide     = 0,
         Show     = 1,
@@ -72,17 +87,20 @@ public:
     virtual QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const override;
     virtual bool setData(const QModelIndex & index, const QVariant & value, int role = Qt::EditRole) override;
     virtual bool dropMimeData(const QMimeData * data, Qt::DropAction action, int row, int column, const QModelIndex & parent) override;
+    bool matches(const treeListElement & tree) const;
+    void add(treeListElement & tree);
     void recreate();
+    SortFilterProxy::Snapshot snapshot(const int column) const;
 signals:
     void moveNodes(const QModelIndex &);
 };
 
-class NodeModel : public AbstractSkeletonModel<NodeModel> {
-    friend class AbstractSkeletonModel<NodeModel>;
+class NodeModel : public AbstractSkeletonModel<NodeModel, class nodeListElement> {
+    friend class AbstractSkeletonModel<NodeModel, nodeListElement>;
     const std::vector<QString> header = {"ID", "x", "y", "z", "Radius", "Comment", "Properties"};
     const std::vector<Qt::ItemFlags> flagModifier = {Qt::ItemIsDragEnabled, Qt::ItemIsEditable, Qt::ItemIsEditable, Qt::ItemIsEditable, Qt::ItemIsEditable, Qt::ItemIsEditable, 0};
+    bool matchAll{true};
 public:
-    std::vector<std::reference_wrapper<class nodeListElement>> cache;
     enum FilterMode {
         All = 0,
         InSelectedTree = 1 << 1,
@@ -94,15 +112,20 @@ public:
     QFlags<FilterMode> mode = FilterMode::InSelectedTree;
     virtual QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const override;
     virtual bool setData(const QModelIndex & index, const QVariant & value, int role = Qt::EditRole) override;
+    bool matches(const nodeListElement & node) const;
+    void add(nodeListElement & node);
+    void add(const std::vector<nodeListElement *> & nodes);
+    void update(nodeListElement & node);// shows, hides or refreshes the node depending on the filter
     void recreate(const bool matchAll);
+    SortFilterProxy::Snapshot snapshot(const int column) const;
 };
 
 class NodeView : public QTreeView {
-    QSortFilterProxyModel & proxy;
+    SortFilterProxy & proxy;
     NodeModel & source;
     virtual void mousePressEvent(QMouseEvent * event) override;
 public:
-    NodeView(QSortFilterProxyModel & proxy, NodeModel & source) : proxy{proxy}, source{source} {}
+    NodeView(SortFilterProxy & proxy, NodeModel & source) : proxy{proxy}, source{source} {}
 };
 
 class SkeletonView : public QWidget {
@@ -123,7 +146,7 @@ class SkeletonView : public QWidget {
     QCheckBox treeRegex{"Regex"};
 
     TreeModel treeModel;
-    QSortFilterProxyModel treeSortAndCommentFilterProxy;
+    SortFilterProxy treeSortAndCommentFilterProxy;
     int treeSortSectionIndex{-1};
     QTreeView treeView;
     QLabel treeCountLabel;
@@ -148,7 +171,7 @@ class SkeletonView : public QWidget {
     QCheckBox nodeFilterSynapseCheckbox{"Synapse node"};
 
     NodeModel nodeModel;
-    QSortFilterProxyModel nodeSortAndCommentFilterProxy;
+    SortFilterProxy nodeSortAndCommentFilterProxy;
     int nodeSortSectionIndex{-1};
     NodeView nodeView;
     QLabel nodeCountLabel;
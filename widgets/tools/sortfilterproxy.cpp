@@ -0,0 +1,554 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+
+#include "sortfilterproxy.h"
+
+#include <QtConcurrentRun>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <numeric>
+
+// everything a refresh needs, copied so the worker never touches the models
+struct SortFilterProxy::Job {
+    int rowCount;
+    bool sorted;
+    bool filtered;
+    std::vector<Key> keys;// cached ones, or made from sortValues
+    std::vector<QString> texts;// cached ones, or made from filterValues
+    Snapshot sortValues;
+    Snapshot filterValues;
+    QString pattern;
+    bool regex;
+    Qt::CaseSensitivity caseSensitivity;
+    Qt::SortOrder order;
+};
+
+namespace {
+SortFilterProxy::Key keyOf(const QVariant & value) {
+    switch (static_cast<QMetaType::Type>(value.userType())) {
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+    case QMetaType::Float:
+    case QMetaType::Double:
+        return {true, value.toDouble(), {}};
+    default:
+        return {false, 0, value.toString()};
+    }
+}
+
+bool keyLess(const SortFilterProxy::Key & lhs, const SortFilterProxy::Key & rhs) {
+    if (lhs.numeric != rhs.numeric) {
+        return lhs.numeric;// numbers before text
+    }
+    return lhs.numeric ? lhs.number < rhs.number : QString::compare(lhs.text, rhs.text) < 0;
+}
+
+bool keyEqual(const SortFilterProxy::Key & lhs, const SortFilterProxy::Key & rhs) {
+    return lhs.numeric == rhs.numeric && lhs.number == rhs.number && lhs.text == rhs.text;
+}
+
+// equal keys keep source order like a stable sort would
+bool rowLess(const std::vector<SortFilterProxy::Key> & keys, const Qt::SortOrder order, const int lhs, const int rhs) {
+    if (keys.empty()) {
+        return lhs < rhs;
+    }
+    const auto & first = order == Qt::AscendingOrder ? keys[lhs] : keys[rhs];
+    const auto & second = order == Qt::AscendingOrder ? keys[rhs] : keys[lhs];
+    if (keyLess(first, second)) {
+        return true;
+    }
+    return !keyLess(second, first) && lhs < rhs;
+}
+
+SortFilterProxy::Result computeRows(SortFilterProxy::Job & job) {
+    SortFilterProxy::Result result;
+    if (job.sortValues) {
+        job.keys.reserve(job.rowCount);
+        for (int row = 0; row < job.rowCount; ++row) {
+            job.keys.emplace_back(keyOf(job.sortValues(row)));
+        }
+        result.keysMade = true;
+    }
+    if (job.filterValues) {
+        job.texts.reserve(job.rowCount);
+        for (int row = 0; row < job.rowCount; ++row) {
+            job.texts.emplace_back(job.filterValues(row).toString());
+        }
+        result.textsMade = true;
+    }
+    auto & rows = result.rows;
+    rows.reserve(job.rowCount);
+    QRegExp regExp{job.pattern, job.caseSensitivity, QRegExp::RegExp};// own instance, QRegExp keeps match state
+    for (int row = 0; row < job.rowCount; ++row) {
+        if (!job.filtered || (job.regex ? regExp.indexIn(job.texts[row]) != -1 : job.texts[row].contains(job.pattern, job.caseSensitivity))) {
+            rows.emplace_back(row);
+        }
+    }
+    if (job.sorted) {
+        std::sort(std::begin(rows), std::end(rows), [&job](const int lhs, const int rhs){
+            return rowLess(job.keys, job.order, lhs, rhs);
+        });
+    }
+    if (result.keysMade) {
+        result.keys = std::move(job.keys);
+    }
+    if (result.textsMade) {
+        result.texts = std::move(job.texts);
+    }
+    return result;
+}
+}
+
+SortFilterProxy::SortFilterProxy() {
+    refreshTimer.setSingleShot(true);
+    refreshTimer.setInterval(0);// coalesce all changes of one event loop iteration
+    QObject::connect(&refreshTimer, &QTimer::timeout, this, &SortFilterProxy::refresh);
+    QObject::connect(&watcher, &QFutureWatcher<Result>::finished, this, [this](){
+        if (launchedGeneration == generation) {
+            apply(adopt(watcher.result()));
+        } else {// the source changed while sorting
+            scheduleRefresh();
+        }
+    });
+}
+
+bool SortFilterProxy::filterActive() const {
+    return !filterPattern.isEmpty();
+}
+
+bool SortFilterProxy::accepts(const QString & text) const {
+    return !filterActive() || (filterRegex ? filterRegExp.indexIn(text) != -1 : text.contains(filterPattern, caseSensitivity));
+}
+
+SortFilterProxy::Key SortFilterProxy::sourceKey(const int sourceRow) const {
+    return keyOf(sourceModel()->data(sourceModel()->index(sourceRow, sortColumn)));
+}
+
+QString SortFilterProxy::sourceFilterText(const int sourceRow) const {
+    return sourceModel()->data(sourceModel()->index(sourceRow, filterColumn)).toString();
+}
+
+void SortFilterProxy::updateSourceToProxy() {
+    sourceToProxy.assign(sourceModel()->rowCount(), -1);
+    for (std::size_t proxyRow = 0; proxyRow < proxyToSource.size(); ++proxyRow) {
+        sourceToProxy[proxyToSource[proxyRow]] = static_cast<int>(proxyRow);
+    }
+}
+
+void SortFilterProxy::scheduleRefresh() {
+    refreshTimer.start();
+}
+
+std::shared_ptr<SortFilterProxy::Job> SortFilterProxy::prepareJob() {
+    const auto rowCount = sourceModel()->rowCount();
+    auto job = std::make_shared<Job>();
+    job->rowCount = rowCount;
+    job->sorted = sortColumn >= 0;
+    job->filtered = filterActive();
+    if (job->sorted && !sortKeysValid && columnSnapshot) {// made in the job
+        job->sortValues = columnSnapshot(sortColumn);
+    }
+    if (job->filtered && !filterTextsValid && columnSnapshot) {
+        job->filterValues = columnSnapshot(filterColumn);
+    }
+    if (job->sorted && !job->sortValues) {
+        if (!sortKeysValid) {
+            sortKeys.clear();
+            sortKeys.reserve(rowCount);
+            for (int row = 0; row < rowCount; ++row) {
+                sortKeys.emplace_back(sourceKey(row));
+            }
+            sortKeysValid = true;
+        }
+        job->keys = sortKeys;
+    }
+    if (job->filtered && !job->filterValues) {
+        if (!filterTextsValid) {
+            filterTexts.clear();
+            filterTexts.reserve(rowCount);
+            for (int row = 0; row < rowCount; ++row) {
+                filterTexts.emplace_back(sourceFilterText(row));
+            }
+            filterTextsValid = true;
+        }
+        job->texts = filterTexts;
+    }
+    job->pattern = filterPattern;
+    job->regex = filterRegex;
+    job->caseSensitivity = caseSensitivity;
+    job->order = sortOrder;
+    return job;
+}
+
+void SortFilterProxy::refresh() {
+    if (sourceModel() == nullptr) {
+        return;
+    }
+    refreshTimer.stop();
+    const auto job = prepareJob();
+    ++generation;// results of jobs still running are stale now
+    if (job->rowCount < synchronousRowLimit) {
+        apply(adopt(computeRows(*job)));
+    } else {
+        launchedGeneration = generation;
+        watcher.setFuture(QtConcurrent::run([job](){
+            return computeRows(*job);
+        }));
+    }
+}
+
+// caches the keys and texts the job made, only call for results of the current generation
+std::vector<int> SortFilterProxy::adopt(Result result) {
+    if (result.keysMade) {
+        sortKeys = std::move(result.keys);
+        sortKeysValid = true;
+    }
+    if (result.textsMade) {
+        filterTexts = std::move(result.texts);
+        filterTextsValid = true;
+    }
+    return std::move(result.rows);
+}
+
+void SortFilterProxy::apply(std::vector<int> rows) {
+    const auto sameRows = rows.size() == proxyToSource.size() && std::all_of(std::begin(rows), std::end(rows), [this](const int row){
+        return sourceToProxy[row] != -1;
+    });
+    if (sameRows) {// keep selection and current index
+        emit layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+        const auto oldIndices = persistentIndexList();
+        std::vector<int> persistentSourceRows;
+        persistentSourceRows.reserve(oldIndices.size());
+        for (const auto & oldIndex : oldIndices) {
+            persistentSourceRows.emplace_back(proxyToSource[oldIndex.row()]);
+        }
+        proxyToSource = std::move(rows);
+        updateSourceToProxy();
+        QModelIndexList newIndices;
+        newIndices.reserve(oldIndices.size());
+        for (int i = 0; i < oldIndices.size(); ++i) {
+            newIndices.append(index(sourceToProxy[persistentSourceRows[i]], oldIndices[i].column()));
+        }
+        changePersistentIndexList(oldIndices, newIndices);
+        emit layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+    } else {
+        beginResetModel();
+        proxyToSource = std::move(rows);
+        updateSourceToProxy();
+        endResetModel();
+    }
+    emit refreshed();
+}
+
+void SortFilterProxy::sourceReset() {
+    ++generation;
+    sortKeysValid = filterTextsValid = false;
+    const auto rowCount = sourceModel()->rowCount();
+    const auto small = rowCount < synchronousRowLimit;
+    if (small) {
+        proxyToSource = adopt(computeRows(*prepareJob()));
+    } else if (!filterActive()) {// show rows in source order until sorted
+        proxyToSource.resize(rowCount);
+        std::iota(std::begin(proxyToSource), std::end(proxyToSource), 0);
+    } else {
+        proxyToSource.clear();
+    }
+    updateSourceToProxy();
+    endResetModel();
+    if (!small && (sortColumn >= 0 || filterActive())) {
+        refresh();
+    }
+}
+
+void SortFilterProxy::sourceRowsInserted(const QModelIndex & parent, const int first, const int last) {
+    if (parent.isValid()) {
+        return;
+    }
+    ++generation;
+    const auto count = last - first + 1;
+    for (auto & row : proxyToSource) {
+        if (row >= first) {
+            row += count;
+        }
+    }
+    sourceToProxy.insert(std::begin(sourceToProxy) + first, count, -1);
+    if (sortKeysValid) {
+        sortKeys.insert(std::begin(sortKeys) + first, count, Key{});
+        for (int row = first; row <= last; ++row) {
+            sortKeys[row] = sourceKey(row);
+        }
+    }
+    if (filterTextsValid) {
+        filterTexts.insert(std::begin(filterTexts) + first, count, QString{});
+        for (int row = first; row <= last; ++row) {
+            filterTexts[row] = sourceFilterText(row);
+        }
+    }
+    std::vector<int> accepted;
+    for (int row = first; row <= last; ++row) {
+        if (!filterActive() || accepts(filterTextsValid ? filterTexts[row] : sourceFilterText(row))) {
+            accepted.emplace_back(row);
+        }
+    }
+    const auto sorted = sortColumn >= 0;
+    if (accepted.size() <= 16 && (!sorted || sortKeysValid)) {// put few rows directly into place
+        static const std::vector<Key> noKeys;
+        const auto & keys = sorted ? sortKeys : noKeys;
+        for (const auto row : accepted) {
+            const auto it = std::upper_bound(std::begin(proxyToSource), std::end(proxyToSource), row, [this, &keys](const int lhs, const int rhs){
+                return rowLess(keys, sortOrder, lhs, rhs);
+            });
+            const auto proxyRow = static_cast<int>(std::distance(std::begin(proxyToSource), it));
+            beginInsertRows({}, proxyRow, proxyRow);
+            proxyToSource.insert(it, row);
+            updateSourceToProxy();
+            endInsertRows();
+        }
+    } else if (!accepted.empty()) {// append and let the refresh sort them in
+        const auto proxyFirst = static_cast<int>(proxyToSource.size());
+        beginInsertRows({}, proxyFirst, proxyFirst + static_cast<int>(accepted.size()) - 1);
+        for (const auto row : accepted) {
+            sourceToProxy[row] = static_cast<int>(proxyToSource.size());
+            proxyToSource.emplace_back(row);
+        }
+        endInsertRows();
+        scheduleRefresh();
+    }
+}
+
+void SortFilterProxy::sourceRowsAboutToBeRemoved(const QModelIndex & parent, const int first, const int last) {
+    if (parent.isValid()) {
+        return;
+    }
+    std::vector<int> proxyRows;
+    for (int row = first; row <= last; ++row) {
+        if (sourceToProxy[row] != -1) {
+            proxyRows.emplace_back(sourceToProxy[row]);
+        }
+    }
+    std::sort(std::begin(proxyRows), std::end(proxyRows), std::greater<>{});
+    for (std::size_t i = 0; i < proxyRows.size();) {// remove contiguous runs from the back, earlier rows stay valid
+        auto j = i;
+        while (j + 1 < proxyRows.size() && proxyRows[j + 1] == proxyRows[j] - 1) {
+            ++j;
+        }
+        beginRemoveRows({}, proxyRows[j], proxyRows[i]);
+        proxyToSource.erase(std::begin(proxyToSource) + proxyRows[j], std::begin(proxyToSource) + proxyRows[i] + 1);
+        endRemoveRows();
+        i = j + 1;
+    }
+}
+
+void SortFilterProxy::sourceRowsRemoved(const QModelIndex & parent, const int first, const int last) {
+    if (parent.isValid()) {
+        return;
+    }
+    ++generation;
+    const auto count = last - first + 1;
+    for (auto & row : proxyToSource) {
+        if (row > last) {
+            row -= count;
+        }
+    }
+    if (sortKeysValid) {
+        sortKeys.erase(std::begin(sortKeys) + first, std::begin(sortKeys) + last + 1);
+    }
+    if (filterTextsValid) {
+        filterTexts.erase(std::begin(filterTexts) + first, std::begin(filterTexts) + last + 1);
+    }
+    updateSourceToProxy();
+}
+
+void SortFilterProxy::sourceDataChanged(const QModelIndex & topLeft, const QModelIndex & bottomRight) {
+    if (!topLeft.isValid() || topLeft.parent().isValid()) {
+        return;
+    }
+    const auto sortAffected = sortColumn >= topLeft.column() && sortColumn <= bottomRight.column();
+    const auto filterAffected = filterColumn >= topLeft.column() && filterColumn <= bottomRight.column();
+    bool needsRefresh{false};
+    int proxyMin = std::numeric_limits<int>::max();
+    int proxyMax = -1;
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        const auto shown = sourceToProxy[row] != -1;
+        if (sortAffected && sortKeysValid) {
+            auto key = sourceKey(row);
+            if (!keyEqual(key, sortKeys[row])) {
+                sortKeys[row] = std::move(key);
+                needsRefresh |= shown;
+            }
+        }
+        if (filterAffected && filterTextsValid) {
+            filterTexts[row] = sourceFilterText(row);
+        }
+        if (filterAffected && filterActive()) {
+            needsRefresh |= accepts(filterTextsValid ? filterTexts[row] : sourceFilterText(row)) != shown;
+        }
+        if (shown) {
+            proxyMin = std::min(proxyMin, sourceToProxy[row]);
+            proxyMax = std::max(proxyMax, sourceToProxy[row]);
+        }
+    }
+    if (proxyMax != -1) {
+        emit dataChanged(index(proxyMin, topLeft.column()), index(proxyMax, bottomRight.column()));
+    }
+    if (needsRefresh) {
+        ++generation;
+        scheduleRefresh();
+    }
+}
+
+void SortFilterProxy::setFilterKeyColumn(const int column) {
+    filterColumn = column;
+    filterTextsValid = false;
+    if (filterActive()) {
+        refresh();
+    }
+}
+
+void SortFilterProxy::setFilterCaseSensitivity(const Qt::CaseSensitivity cs) {
+    caseSensitivity = cs;
+    filterRegExp.setCaseSensitivity(cs);
+    if (filterActive()) {
+        refresh();
+    }
+}
+
+void SortFilterProxy::setFilterFixedString(const QString & pattern) {
+    filterPattern = pattern;
+    filterRegex = false;
+    refresh();
+}
+
+void SortFilterProxy::setFilterRegExp(const QString & pattern) {
+    filterPattern = pattern;
+    filterRegex = true;
+    filterRegExp = QRegExp{pattern, caseSensitivity, QRegExp::RegExp};
+    refresh();
+}
+
+void SortFilterProxy::setSourceModel(QAbstractItemModel * model) {
+    beginResetModel();
+    if (sourceModel() != nullptr) {
+        QObject::disconnect(sourceModel(), nullptr, this, nullptr);
+    }
+    QAbstractProxyModel::setSourceModel(model);
+    QObject::connect(model, &QAbstractItemModel::modelAboutToBeReset, this, &SortFilterProxy::beginResetModel);
+    QObject::connect(model, &QAbstractItemModel::modelReset, this, &SortFilterProxy::sourceReset);
+    QObject::connect(model, &QAbstractItemModel::layoutAboutToBeChanged, this, &SortFilterProxy::beginResetModel);
+    QObject::connect(model, &QAbstractItemModel::layoutChanged, this, &SortFilterProxy::sourceReset);
+    QObject::connect(model, &QAbstractItemModel::rowsInserted, this, &SortFilterProxy::sourceRowsInserted);
+    QObject::connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &SortFilterProxy::sourceRowsAboutToBeRemoved);
+    QObject::connect(model, &QAbstractItemModel::rowsRemoved, this, &SortFilterProxy::sourceRowsRemoved);
+    QObject::connect(model, &QAbstractItemModel::dataChanged, this, &SortFilterProxy::sourceDataChanged);
+    sourceReset();
+}
+
+QModelIndex SortFilterProxy::index(int row, int column, const QModelIndex & parent) const {
+    return hasIndex(row, column, parent) ? createIndex(row, column) : QModelIndex{};
+}
+
+QModelIndex SortFilterProxy::parent(const QModelIndex &) const {
+    return {};
+}
+
+int SortFilterProxy::rowCount(const QModelIndex & parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(proxyToSource.size());
+}
+
+int SortFilterProxy::columnCount(const QModelIndex & parent) const {
+    return parent.isValid() || sourceModel() == nullptr ? 0 : sourceModel()->columnCount();
+}
+
+QVariant SortFilterProxy::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation == Qt::Horizontal && sourceModel() != nullptr) {// base maps through row 0 which fails for empty tables
+        return sourceModel()->headerData(section, orientation, role);
+    }
+    return QAbstractProxyModel::headerData(section, orientation, role);
+}
+
+QModelIndex SortFilterProxy::mapToSource(const QModelIndex & proxyIndex) const {
+    if (!proxyIndex.isValid() || sourceModel() == nullptr || static_cast<std::size_t>(proxyIndex.row()) >= proxyToSource.size()) {
+        return {};
+    }
+    return sourceModel()->index(proxyToSource[proxyIndex.row()], proxyIndex.column());
+}
+
+QModelIndex SortFilterProxy::mapFromSource(const QModelIndex & sourceIndex) const {
+    if (!sourceIndex.isValid() || static_cast<std::size_t>(sourceIndex.row()) >= sourceToProxy.size() || sourceToProxy[sourceIndex.row()] == -1) {
+        return {};
+    }
+    return index(sourceToProxy[sourceIndex.row()], sourceIndex.column());
+}
+
+template<typename Map, typename MakeIndex>
+QItemSelection mapSelection(const QItemSelection & selection, Map && map, MakeIndex && makeIndex) {
+    QItemSelection mapped;
+    std::vector<int> rows;
+    for (const auto & range : selection) {
+        rows.clear();
+        for (int row = range.top(); row <= range.bottom(); ++row) {
+            const auto mappedRow = map(row);
+            if (mappedRow != -1) {
+                rows.emplace_back(mappedRow);
+            }
+        }
+        std::sort(std::begin(rows), std::end(rows));
+        for (std::size_t i = 0; i < rows.size();) {// one range per contiguous run
+            auto j = i;
+            while (j + 1 < rows.size() && rows[j + 1] == rows[j] + 1) {
+                ++j;
+            }
+            mapped.select(makeIndex(rows[i], range.left()), makeIndex(rows[j], range.right()));
+            i = j + 1;
+        }
+    }
+    return mapped;
+}
+
+QItemSelection SortFilterProxy::mapSelectionToSource(const QItemSelection & proxySelection) const {
+    return mapSelection(proxySelection, [this](const int row){
+        return static_cast<std::size_t>(row) < proxyToSource.size() ? proxyToSource[row] : -1;
+    }, [this](const int row, const int column){
+        return sourceModel()->index(row, column);
+    });
+}
+
+QItemSelection SortFilterProxy::mapSelectionFromSource(const QItemSelection & sourceSelection) const {
+    return mapSelection(sourceSelection, [this](const int row){
+        return static_cast<std::size_t>(row) < sourceToProxy.size() ? sourceToProxy[row] : -1;
+    }, [this](const int row, const int column){
+        return index(row, column);
+    });
+}
+
+void SortFilterProxy::sort(int column, Qt::SortOrder order) {
+    sortKeysValid = sortKeysValid && column == sortColumn;
+    sortColumn = column;
+    sortOrder = order;
+    refresh();
+}
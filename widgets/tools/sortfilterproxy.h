@@ -0,0 +1,131 @@
+/*
+ *  This file is a part of KNOSSOS.
+ *
+ *  (C) Copyright 2007-2018
+ *  Max-Planck-Gesellschaft zur Foerderung der Wissenschaften e.V.
+ *
+ *  KNOSSOS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 of
+ *  the License as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *  For further information, visit https://knossostool.org
+ *  or contact knossos-team@mpimf-heidelberg.mpg.de
+ */
+
+
+#ifndef SORTFILTERPROXY_H
+#define SORTFILTERPROXY_H
+
+#include <QAbstractProxyModel>
+#include <QFutureWatcher>
+#include <QItemSelection>
+#include <QRegExp>
+#include <QString>
+#include <QTimer>
+#include <QVariant>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * Flat sort and filter proxy for large list models.
+ *
+ * Sort keys and filter texts are cached per source row and kept up to date from the source signals.
+ * Inserted rows are appended right away, row removals and data changes are mapped without a reset.
+ * Resorting and refiltering run on the global thread pool
+ * (unless the model is small) and the result is applied as a layout change if the set of rows did not change.
+ * If the source provides columnSnapshot, missing keys and texts are made there as well, from copies of its data.
+ */
+class SortFilterProxy : public QAbstractProxyModel {
+    Q_OBJECT
+public:
+    struct Key {
+        bool numeric;
+        double number;
+        QString text;
+    };
+    struct Job;
+    struct Result {
+        std::vector<int> rows;
+        std::vector<Key> keys;// made in the job, empty otherwise
+        std::vector<QString> texts;
+        bool keysMade{false};
+        bool textsMade{false};
+    };
+    using Snapshot = std::function<QVariant(const int sourceRow)>;// values of one column, safe to use from any thread
+    std::function<Snapshot(const int column)> columnSnapshot;// called in the gui thread, may return an empty Snapshot
+private:
+    static constexpr int synchronousRowLimit = 20000;
+
+    std::vector<int> proxyToSource;
+    std::vector<int> sourceToProxy;// -1 if filtered out
+    std::vector<Key> sortKeys;
+    std::vector<QString> filterTexts;
+    bool sortKeysValid{false};
+    bool filterTextsValid{false};
+
+    int sortColumn{-1};
+    Qt::SortOrder sortOrder{Qt::AscendingOrder};
+    int filterColumn{0};
+    Qt::CaseSensitivity caseSensitivity{Qt::CaseSensitive};
+    QString filterPattern;
+    bool filterRegex{false};
+    QRegExp filterRegExp;
+
+    std::uint64_t generation{0};// bumped on every change that invalidates a running refresh
+    std::uint64_t launchedGeneration{0};
+    QFutureWatcher<Result> watcher;
+    QTimer refreshTimer;
+
+    bool filterActive() const;
+    bool accepts(const QString & text) const;
+    Key sourceKey(const int sourceRow) const;
+    QString sourceFilterText(const int sourceRow) const;
+    void updateSourceToProxy();
+    std::shared_ptr<Job> prepareJob();
+    void scheduleRefresh();
+    void refresh();
+    std::vector<int> adopt(Result result);
+    void apply(std::vector<int> rows);
+
+    void sourceReset();
+    void sourceRowsInserted(const QModelIndex & parent, const int first, const int last);
+    void sourceRowsAboutToBeRemoved(const QModelIndex & parent, const int first, const int last);
+    void sourceRowsRemoved(const QModelIndex & parent, const int first, const int last);
+    void sourceDataChanged(const QModelIndex & topLeft, const QModelIndex & bottomRight);
+
+public:
+    SortFilterProxy();
+
+    void setFilterKeyColumn(const int column);
+    void setFilterCaseSensitivity(const Qt::CaseSensitivity cs);
+    void setFilterFixedString(const QString & pattern);
+    void setFilterRegExp(const QString & pattern);
+
+    virtual void setSourceModel(QAbstractItemModel * sourceModel) override;
+    virtual QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const override;
+    virtual QModelIndex parent(const QModelIndex & child) const override;
+    virtual int rowCount(const QModelIndex & parent = QModelIndex()) const override;
+    virtual int columnCount(const QModelIndex & parent = QModelIndex()) const override;
+    virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    virtual QModelIndex mapToSource(const QModelIndex & proxyIndex) const override;
+    virtual QModelIndex mapFromSource(const QModelIndex & sourceIndex) const override;
+    virtual QItemSelection mapSelectionToSource(const QItemSelection & proxySelection) const override;
+    virtual QItemSelection mapSelectionFromSource(const QItemSelection & sourceSelection) const override;
+    virtual void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+signals:
+    void refreshed();// rows were reordered or refiltered
+};
+
+#endif//SORTFILTERPROXY_H
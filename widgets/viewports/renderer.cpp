@@ -36,12 +36,16 @@
 #include "stateInfo.h"
 #include "viewer.h"
 
+#include <QDebug>
 #include <QMatrix4x4>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
 #include <QOpenGLFramebufferObject>
 #include <QOpenGLPaintDevice>
 #include <QOpenGLTimeMonitor>
 #include <QPainter>
 #include <QQuaternion>
+#include <QVector2D>
 #include <QVector3D>
 
 #ifdef Q_OS_MAC
@@ -51,9 +55,14 @@
 #endif
 
 #include <boost/math/constants/constants.hpp>
+#include <boost/optional.hpp>
 
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
 
 enum GLNames {
     None,
@@ -77,24 +86,28 @@ auto lineSize(const float nanometerPerPixel) {
     return std::max(smallestVisibleNodeSize(), state->viewerState->segRadiusToNodeRadius * uniformPointDiameter(nanometerPerPixel));
 }
 
-QColor getPickingColor(const nodeListElement & node, const RenderOptions::SelectionPass &selectionPass) {
-    QColor color;
-
+// nodeidshader reassembles the 64 bit name from the color (low half) and the idHigh attribute (high half)
+std::array<std::uint8_t, 4> pickingColor(const nodeListElement & node, const bool highHalf) {
     const auto name = GLNames::NodeOffset + node.nodeID;
+    const auto bits = static_cast<std::uint32_t>(name >> (highHalf ? 32 : 0));
+    return {{static_cast<std::uint8_t>(bits), static_cast<std::uint8_t>(bits >> 8), static_cast<std::uint8_t>(bits >> 16), static_cast<std::uint8_t>(bits >> 24)}};
+}
 
+// RGBA fallback without integer buffers: 24 first, middle or 16 last bits of the name per pass
+std::array<std::uint8_t, 4> pickingColor(const std::uint64_t name, const RenderOptions::SelectionPass & selectionPass) {
     int shift{0};
     if (selectionPass == RenderOptions::SelectionPass::NodeID24_48Bits) {
         shift = 24;
     } else if (selectionPass == RenderOptions::SelectionPass::NodeID48_64Bits) {
         shift = 48;
     }
-    const auto bits = static_cast<GLuint>(name >> shift);// extract 24 first, middle or 16 last bits of interest
-    color.setRed(static_cast<std::uint8_t>(bits));
-    color.setGreen(static_cast<std::uint8_t>(bits >> 8));
-    color.setBlue(static_cast<std::uint8_t>(bits >> 16));
-    color.setAlpha(255);
+    const auto bits = static_cast<GLuint>(name >> shift);
+    return {{static_cast<std::uint8_t>(bits), static_cast<std::uint8_t>(bits >> 8), static_cast<std::uint8_t>(bits >> 16), 255}};
+}
 
-    return color;
+QColor getPickingColor(const nodeListElement & node, const RenderOptions::SelectionPass & selectionPass) {
+    const auto color = pickingColor(GLNames::NodeOffset + node.nodeID, selectionPass);
+    return QColor(color[0], color[1], color[2], color[3]);
 }
 
 void ViewportBase::renderCylinder(const Coordinate & base, float baseRadius, const Coordinate & top, float topRadius, const QColor & color, const RenderOptions & options) {
@@ -179,7 +192,12 @@ void ViewportBase::renderNode(const nodeListElement & node, const RenderOptions
     auto color = state->viewer->getNodeColor(node);
     const float radius = Skeletonizer::singleton().radius(node);
 
-    if (options.nodePicking) {
+    if (options.nodePicking && options.selectionPass == RenderOptions::SelectionPass::NodeID64Bits) {
+        const auto low = pickingColor(node, false);
+        const auto high = pickingColor(node, true);
+        color = QColor(low[0], low[1], low[2], low[3]);
+        nodeIdShader.setAttributeValue(1, high[0] / 255.f, high[1] / 255.f, high[2] / 255.f, high[3] / 255.f);
+    } else if (options.nodePicking) {
         color = getPickingColor(node, options.selectionPass);
     }
 
@@ -206,7 +224,14 @@ void ViewportBase::renderNode(const nodeListElement & node, const RenderOptions
 void ViewportOrtho::renderNode(const nodeListElement & node, const RenderOptions & options) {
     ViewportBase::renderNode(node, options);
     if (1.5f <  Skeletonizer::singleton().radius(node)) { // draw node center to make large nodes visible and clickable in ortho vps
-        renderSphere(node.position, 1.5, state->viewer->getNodeColor(node));
+        auto color = state->viewer->getNodeColor(node);
+        if (options.nodePicking && options.selectionPass == RenderOptions::SelectionPass::NodeID64Bits) {// idHigh is still set from ViewportBase::renderNode
+            const auto low = pickingColor(node, false);
+            color = QColor(low[0], low[1], low[2], low[3]);
+        } else if (options.nodePicking) {
+            color = getPickingColor(node, options.selectionPass);
+        }
+        renderSphere(node.position, 1.5, color);
     }
     if (!options.nodePicking) {
         // Render the node description
@@ -599,8 +624,8 @@ void ViewportOrtho::renderViewportFast() {
     overlay_data_shader.setUniformValue("view_matrix", viewMatrix);
     overlay_data_shader.setUniformValue("projection_matrix", projectionMatrix);
     overlay_data_shader.setUniformValue("indexTexture", 0);
-    overlay_data_shader.setUniformValue("textureLUT", 1);
-    overlay_data_shader.setUniformValue("factor", static_cast<float>(std::numeric_limits<gpu_lut_cube::gpu_index>::max()));
+    overlay_data_shader.setUniformValue("paletteTexture", 1);
+    overlay_data_shader.setUniformValue("colorTexture", 2);
 
     glEnable(GL_TEXTURE_3D);
 
@@ -609,6 +634,9 @@ void ViewportOrtho::renderViewportFast() {
             if (layer.isOverlayData) {
                 overlay_data_shader.bind();
                 overlay_data_shader.setUniformValue("textureOpacity", Segmentation::singleton().alpha / 256.0f);
+                layer.slots.updateColors();
+                layer.slots.colorTexture.bind(2);
+                overlay_data_shader.setUniformValue("colorTableSize", QVector2D(layer.slots.colorTexture.width(), layer.slots.colorTexture.height()));
             } else {
                 raw_data_shader.bind();
                 raw_data_shader.setUniformValue("textureOpacity", layer.opacity);
@@ -618,9 +646,10 @@ void ViewportOrtho::renderViewportFast() {
                 if (layer.isOverlayData) {
                     auto & punned = static_cast<gpu_lut_cube&>(cube);
                     punned.cube.bind(0);
-                    punned.lut.bind(1);
+                    punned.palette.bind(1);
                     overlay_data_shader.setUniformValue("model_matrix", modelMatrix);
-                    overlay_data_shader.setUniformValue("lutSize", static_cast<float>(punned.lut.width() * punned.lut.height() * punned.lut.depth()));
+                    overlay_data_shader.setUniformValue("indexFactor", punned.indexFactor());
+                    overlay_data_shader.setUniformValue("paletteSize", QVector2D(punned.palette.width(), punned.palette.height()));
                 } else {
                     raw_data_shader.setUniformValue("model_matrix", modelMatrix);
                     cube.cube.bind(0);
@@ -897,20 +926,17 @@ void Viewport3D::renderVolumeVP() {
     glClearColor(background_color[0], background_color[1], background_color[2], 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    if(seg.volume_tex_id != 0) {
+    if(volumeAtlasTexId != 0 && volumeShader.isLinked()) {
         static float volumeClippingAdjust = 1.73f;
         static float translationSpeedAdjust = 1.0 / 500.0f;
         auto cubeLen = Dataset::current().cubeEdgeLength;
-        int texLen = seg.volume_tex_len;
-        GLuint volTexId = seg.volume_tex_id;
+        const int volumeEdge = volumeM * volumeCubeEdge;
 
         static Profiler render_profiler;
 
         render_profiler.start(); // ----------------------------------------------------------- profiling
 
-        glMatrixMode(GL_PROJECTION);
-        glLoadIdentity();
-        glOrtho(-1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f);
+        updateVolumeOccupancy();
 
         // volume viewport rotation
         static QMatrix4x4 volRotMatrix;
@@ -965,51 +991,68 @@ void Viewport3D::renderVolumeVP() {
         float scaley = 1.0f / (datascale.y / biggestScale);
         float scalez = 1.0f / (datascale.z / biggestScale);
 
-        glMatrixMode(GL_TEXTURE);
-        glLoadIdentity();
-
+        // slab space (s, t, depth) → volume texture coordinates, depth 1 is closest to the viewer
+        QMatrix4x4 slabToTexture;
         // dataset translation adjustment
-        glTranslatef((static_cast<float>(state->viewerState->currentPosition.x % cubeLen) / cubeLen - 0.5f) / state->M,
-                     (static_cast<float>(state->viewerState->currentPosition.y % cubeLen) / cubeLen - 0.5f) / state->M,
-                     (static_cast<float>(state->viewerState->currentPosition.z % cubeLen) / cubeLen - 0.5f) / state->M);
-
-        glTranslatef(0.5f, 0.5f, 0.5f);
-        glScalef(volumeClippingAdjust, volumeClippingAdjust, volumeClippingAdjust); // scale to remove cube corner clipping
-        glScalef(scalex, scaley, scalez); // dataset scaling adjustment
-        glMultMatrixf(volRotMatrix.data()); // volume viewport rotation
-        glScalef(1.0f/zoom, 1.0f/zoom, 1.0f/zoom*2.0f); // volume viewport zoom
-        glTranslatef(-0.5f, -0.5f, -0.5f);
-        glTranslatef(transx, transy, 0.0f); // volume viewport translation
-
-        glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
-
-        glEnable(GL_DEPTH_TEST);
-        glEnable(GL_TEXTURE_3D);
-
-        glBindTexture(GL_TEXTURE_3D, volTexId);
-        float volume_opacity = seg.volume_opacity / 255.0f;
-        for(int i = 0; i < texLen * volumeClippingAdjust * maxScaleRatio; ++i) {
-            float depth = i/(texLen * volumeClippingAdjust * maxScaleRatio);
-            glColor4f(depth, depth, depth, volume_opacity);
-            glBegin(GL_QUADS);
-                glTexCoord3f(0.0f, 1.0f, depth);
-                glVertex3f(-1.0f, -1.0f,  1.0f-depth*2.0f);
-                glTexCoord3f(1.0f, 1.0f, depth);
-                glVertex3f( 1.0f, -1.0f,  1.0f-depth*2.0f);
-                glTexCoord3f(1.0f, 0.0f, depth);
-                glVertex3f( 1.0f,  1.0f,  1.0f-depth*2.0f);
-                glTexCoord3f(0.0f, 0.0f, depth);
-                glVertex3f(-1.0f,  1.0f,  1.0f-depth*2.0f);
-            glEnd();
-        }
-
-        glMatrixMode(GL_TEXTURE);
-        glLoadIdentity();
-        glMatrixMode(GL_MODELVIEW);
+        slabToTexture.translate((static_cast<float>(state->viewerState->currentPosition.x % cubeLen) / cubeLen - 0.5f) / state->M,
+                                (static_cast<float>(state->viewerState->currentPosition.y % cubeLen) / cubeLen - 0.5f) / state->M,
+                                (static_cast<float>(state->viewerState->currentPosition.z % cubeLen) / cubeLen - 0.5f) / state->M);
+
+        slabToTexture.translate(0.5f, 0.5f, 0.5f);
+        slabToTexture.scale(volumeClippingAdjust); // scale to remove cube corner clipping
+        slabToTexture.scale(scalex, scaley, scalez); // dataset scaling adjustment
+        slabToTexture *= volRotMatrix; // volume viewport rotation
+        slabToTexture.scale(1.0f/zoom, 1.0f/zoom, 1.0f/zoom*2.0f); // volume viewport zoom
+        slabToTexture.translate(-0.5f, -0.5f, -0.5f);
+        slabToTexture.translate(transx, transy, 0.0f); // volume viewport translation
+
+        // rays are marched front to back through the id volume, colors come from the slot table
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);// premultiplied
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_3D, volumeAtlasTexId);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_3D, volumePageTexId);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, volumePaletteTexId);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_3D, volumeOccupancyTexId);
+        volumeSlotTable.colorTexture.bind(4);
+
+        const std::array<GLfloat, 8> quad{{-1.0f, -1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f, 1.0f}};
+        volumeShader.bind();
+        const int vertexLocation = volumeShader.attributeLocation("vertex");
+        volumeShader.enableAttributeArray(vertexLocation);
+        volumeShader.setAttributeArray(vertexLocation, quad.data(), 2);
+        volumeShader.setUniformValue("indexAtlas", 0);
+        volumeShader.setUniformValue("pageTable", 1);
+        volumeShader.setUniformValue("paletteTexture", 2);
+        volumeShader.setUniformValue("occupancyTexture", 3);
+        volumeShader.setUniformValue("colorTexture", 4);
+        volumeShader.setUniformValue("cubeEdge", volumeCubeEdge);
+        volumeShader.setUniformValue("volumeEdge", volumeEdge);
+        volumeShader.setUniformValue("brickSize", volumeBrickSize);
+        volumeShader.setUniformValue("occupancyLevels", static_cast<int>(volumeOccupancy.size()));
+        volumeShader.setUniformValue("paletteWidth", volumePaletteWidth);
+        volumeShader.setUniformValue("colorWidth", gpu_slot_table::width);
+        volumeShader.setUniformValue("slabToTexture", slabToTexture);
+        volumeShader.setUniformValue("steps", volumeEdge * volumeClippingAdjust * maxScaleRatio);
+        volumeShader.setUniformValue("opacity", seg.volume_opacity / 255.0f);
+        glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+        volumeShader.disableAttributeArray(vertexLocation);
+        volumeShader.release();
 
         // Reset previously changed OGL parameters
-        glDisable(GL_TEXTURE_3D);
+        volumeSlotTable.colorTexture.release(4);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_3D, 0);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_3D, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_3D, 0);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         glEnable(GL_TEXTURE_2D);
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         glDisable(GL_LIGHTING);
@@ -1850,38 +1893,112 @@ boost::optional<nodeListElement &> ViewportBase::pickNode(int x, int y, int widt
     return boost::none;
 }
 
+void ViewportBase::preparePickingFbo() {
+    const QSize size{width(), height()};
+    if (pickingFbo != 0 && pickingFboSize == size) {
+        return;
+    }
+    destroyPickingFbo();
+    auto * gl = context()->extraFunctions();
+    gl->glGenTextures(1, &pickingNameTexture);
+    gl->glBindTexture(GL_TEXTURE_2D, pickingNameTexture);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    gl->glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32UI, size.width(), size.height(), 0, GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr);
+    gl->glBindTexture(GL_TEXTURE_2D, 0);
+    gl->glGenRenderbuffers(1, &pickingDepthBuffer);
+    gl->glBindRenderbuffer(GL_RENDERBUFFER, pickingDepthBuffer);
+    gl->glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size.width(), size.height());
+    gl->glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    gl->glGenFramebuffers(1, &pickingFbo);
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, pickingFbo);
+    gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pickingNameTexture, 0);
+    gl->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, pickingDepthBuffer);
+    if (gl->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        qWarning() << "node picking framebuffer incomplete";
+    }
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+    pickingFboSize = size;
+}
+
+void ViewportBase::destroyPickingFbo() {
+    if (pickingFbo == 0 || context() == nullptr) {
+        return;
+    }
+    auto * gl = context()->extraFunctions();
+    gl->glDeleteFramebuffers(1, &pickingFbo);
+    gl->glDeleteRenderbuffers(1, &pickingDepthBuffer);
+    gl->glDeleteTextures(1, &pickingNameTexture);
+    pickingFbo = pickingDepthBuffer = pickingNameTexture = 0;
+}
+
 hash_list<nodeListElement *> ViewportBase::pickNodes(int centerX, int centerY, int width, int height) {
+    hash_list<nodeListElement *> foundNodes;
     makeCurrent();
     glPushAttrib(GL_VIEWPORT_BIT);
     glViewport(0, 0, this->width(), this->height());
-    QOpenGLFramebufferObject fbo(this->width(), this->height(), QOpenGLFramebufferObject::CombinedDepthStencil);
-    fbo.bind();
-    auto pickingPass = [this, &fbo](auto flag){
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        renderViewport(RenderOptions::nodePickingRenderOptions(flag));
-        return fbo.toImage();
-    };
-    auto image24 = pickingPass(RenderOptions::SelectionPass::NodeID0_24Bits);
-    auto image48 = pickingPass(RenderOptions::SelectionPass::NodeID24_48Bits);
-    auto image64 = pickingPass(RenderOptions::SelectionPass::NodeID48_64Bits);
-    fbo.release();
+    // only read back the requested rectangle (widget coordinates are top-down)
+    const auto minx = std::max(0, centerX - width/2);
+    const auto miny = std::max(0, centerY - height/2);
+    const auto maxx = std::min(this->width(), minx + width);
+    const auto maxy = std::min(this->height(), miny + height);
+    const auto rectWidth = std::max(0, maxx - minx);
+    const auto rectHeight = std::max(0, maxy - miny);
+    std::vector<std::array<GLuint, 2>> names(rectWidth * rectHeight);
+    if (nodeIdShader.isLinked()) {
+        preparePickingFbo();
+        auto * gl = context()->extraFunctions();
+        gl->glBindFramebuffer(GL_FRAMEBUFFER, pickingFbo);
+        const std::array<GLuint, 4> noName{};
+        gl->glClearBufferuiv(GL_COLOR, 0, noName.data());
+        glClear(GL_DEPTH_BUFFER_BIT);
+        // one pass writes the full 64 bit names, nodes get them from pickingColor
+        nodeIdShader.bind();
+        nodeIdShader.setAttributeValue(1, 0.f, 0.f, 0.f, 0.f);
+        renderViewport(RenderOptions::nodePickingRenderOptions(RenderOptions::SelectionPass::NodeID64Bits));
+        nodeIdShader.release();
+        if (!names.empty()) {
+            glReadBuffer(GL_COLOR_ATTACHMENT0);
+            glReadPixels(minx, this->height() - maxy, rectWidth, rectHeight, GL_RG_INTEGER, GL_UNSIGNED_INT, names.data());
+        }
+        gl->glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+    } else {// no integer targets before GL 3, the name is assembled from three RGBA passes
+        QOpenGLFramebufferObject fbo(this->width(), this->height(), QOpenGLFramebufferObject::CombinedDepthStencil);
+        fbo.bind();
+        std::vector<std::array<std::uint8_t, 4>> pixels(names.size());
+        auto pickingPass = [&](const RenderOptions::SelectionPass pass, const int shift){
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            renderViewport(RenderOptions::nodePickingRenderOptions(pass));
+            if (names.empty()) {
+                return;
+            }
+            glReadPixels(minx, this->height() - maxy, rectWidth, rectHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+            for (std::size_t i = 0; i < names.size(); ++i) {
+                const auto bits = static_cast<std::uint64_t>(pixels[i][0] | pixels[i][1] << 8 | pixels[i][2] << 16) << shift;
+                names[i][0] |= static_cast<GLuint>(bits);
+                names[i][1] |= static_cast<GLuint>(bits >> 32);
+            }
+        };
+        pickingPass(RenderOptions::SelectionPass::NodeID0_24Bits, 0);
+        pickingPass(RenderOptions::SelectionPass::NodeID24_48Bits, 24);
+        pickingPass(RenderOptions::SelectionPass::NodeID48_64Bits, 48);
+        fbo.release();
+    }
     glPopAttrib();
 
-    hash_list<nodeListElement *> foundNodes;
+    std::unordered_set<std::uint64_t> seen;
+    // walk rings of growing size around the center, so closer nodes are listed first
     for (int d = 1; d <= std::max(height, width); d += 2) {
-        const auto minx = std::max(0, centerX - std::min(d/2, width/2));
-        const auto miny = std::max(0, centerY - std::min(d/2, height/2));
-        const auto maxx = std::min(image24.width(), minx + std::min(d, width));
-        const auto maxy = std::min(image24.height(), miny + std::min(d, height));
-        for (int y = miny; y < maxy; y += 1)
-        for (int x = minx; x < maxx; x += (y == miny || y == maxy - 1) ? 1 : d - 1) {
-            const auto color24 = image24.pixelColor(x, y);
-            const auto color48 = image48.pixelColor(x, y);
-            const auto color64 = image64.pixelColor(x, y);
-            std::array<int, 8> bytes{{color24.red(), color24.green(), color24.blue(), color48.red(), color48.green(), color48.blue(), color64.red(), color64.green()}};
-            std::uint64_t name{};
-            for (std::size_t i = 0; i < bytes.size(); ++i) {
-                name |= static_cast<std::uint64_t>(bytes[i]) << (8 * i);
+        const auto ringMinx = std::max(minx, centerX - std::min(d/2, width/2));
+        const auto ringMiny = std::max(miny, centerY - std::min(d/2, height/2));
+        const auto ringMaxx = std::min(maxx, ringMinx + std::min(d, width));
+        const auto ringMaxy = std::min(maxy, ringMiny + std::min(d, height));
+        for (int y = ringMiny; y < ringMaxy; y += 1)
+        for (int x = ringMinx; x < ringMaxx; x += (y == ringMiny || y == ringMaxy - 1) ? 1 : d - 1) {
+            const auto & pixel = names[(maxy - 1 - y) * rectWidth + (x - minx)];
+            const auto name = static_cast<std::uint64_t>(pixel[1]) << 32 | pixel[0];
+            if (name < GLNames::NodeOffset || !seen.emplace(name).second) {
+                continue;
             }
             nodeListElement * const foundNode = Skeletonizer::findNodeByNodeID(name - GLNames::NodeOffset);
             if (foundNode != nullptr) {
@@ -1934,52 +2051,126 @@ void synapseLoop(Func func, const ViewportType vpType){
 }
 
 void generateSkeletonGeometry(GLBuffers & glBuffers, const RenderOptions &options, const ViewportType viewportType) {
-    glBuffers.regenVertBuffer = false;
-    glBuffers.lineVertBuffer.clear();
-    glBuffers.pointVertBuffer.clear();
-    glBuffers.colorPickingBuffer24.clear();
-    glBuffers.colorPickingBuffer48.clear();
-    glBuffers.colorPickingBuffer64.clear();
+    auto & nodesByNodeID = state->skeletonState->nodesByNodeID;
+    if (glBuffers.regenVertBuffer) {
+        glBuffers.regenVertBuffer = false;
+        glBuffers.chunkEdge = 4 * Dataset::current().cubeEdgeLength;
+        for (auto & pair : glBuffers.chunks) {// regenerate (or drop) every existing chunk
+            pair.second.nodeIDs.clear();
+            glBuffers.dirtyChunks.emplace(pair.first);
+        }
+        boost::optional<CoordOfCube> lastKey;
+        std::vector<std::uint64_t> * lastIDs{nullptr};
+        for (const auto & tree : Skeletonizer::singleton().skeletonState.trees) {
+            for (const auto & node : tree.nodes) {
+                const auto key = glBuffers.chunkOf(node.position);
+                if (!lastKey || key != lastKey.get()) {// consecutive nodes are mostly close
+                    lastKey = key;
+                    lastIDs = &glBuffers.chunks[key].nodeIDs;
+                    glBuffers.dirtyChunks.emplace(key);
+                }
+                lastIDs->emplace_back(node.nodeID);
+            }
+        }
+    } else {
+        // moved and removed nodes may still be listed in a chunk that is not dirty yet
+        std::unordered_set<std::uint64_t> displaced;
+        for (const auto nodeID : glBuffers.dirtyNodes) {
+            const auto it = nodesByNodeID.find(nodeID);
+            if (it == std::end(nodesByNodeID)) {
+                displaced.emplace(nodeID);
+                continue;
+            }
+            const auto key = glBuffers.chunkOf(it->second->position);
+            glBuffers.dirtyChunks.emplace(key);
+            auto & ids = glBuffers.chunks[key].nodeIDs;
+            if (glBuffers.addedNodes.count(nodeID) != 0) {
+                ids.emplace_back(nodeID);
+            } else if (std::find(std::begin(ids), std::end(ids), nodeID) == std::end(ids)) {
+                ids.emplace_back(nodeID);
+                displaced.emplace(nodeID);
+            }
+        }
+        const auto findDisplaced = [&displaced, &glBuffers, &nodesByNodeID](const CoordOfCube & key, const GLBuffers::Chunk & chunk, std::vector<CoordOfCube> & found){
+            for (const auto nodeID : chunk.nodeIDs) {
+                const auto it = nodesByNodeID.find(nodeID);
+                if (displaced.count(nodeID) != 0 && (it == std::end(nodesByNodeID) || glBuffers.chunkOf(it->second->position) != key)) {
+                    displaced.erase(nodeID);
+                    found.emplace_back(key);
+                }
+            }
+        };
+        std::vector<CoordOfCube> found;
+        for (const auto & key : glBuffers.dirtyChunks) {// cheap, moves are mostly local
+            const auto it = glBuffers.chunks.find(key);
+            if (displaced.empty()) {
+                break;
+            } else if (it != std::end(glBuffers.chunks)) {
+                findDisplaced(key, it->second, found);
+            }
+        }
+        for (const auto & pair : glBuffers.chunks) {
+            if (displaced.empty()) {
+                break;
+            } else if (glBuffers.dirtyChunks.count(pair.first) == 0) {
+                findDisplaced(pair.first, pair.second, found);
+            }
+        }
+        glBuffers.dirtyChunks.insert(std::begin(found), std::end(found));
+    }
+    glBuffers.dirtyNodes.clear();
+    glBuffers.addedNodes.clear();
+    glBuffers.highlightedNodes.clear();
 
     auto arrayFromQColor = [](QColor color){
-        return decltype(glBuffers.lineVertBuffer.colors)::value_type{{static_cast<std::uint8_t>(color.red()), static_cast<std::uint8_t>(color.green()), static_cast<std::uint8_t>(color.blue()), static_cast<std::uint8_t>(color.alpha())}};
+        return decltype(GLBuffers::RenderBuffer::colors)::value_type{{static_cast<std::uint8_t>(color.red()), static_cast<std::uint8_t>(color.green()), static_cast<std::uint8_t>(color.blue()), static_cast<std::uint8_t>(color.alpha())}};
     };
-
-    auto addSegment = [arrayFromQColor, &glBuffers](const segmentListElement & segment, const QColor & color) {
-        const auto isoBase = Dataset::current().scale.componentMul(segment.source.position);
-        const auto isoTop = Dataset::current().scale.componentMul(segment.target.position);
-
-        glBuffers.lineVertBuffer.emplace_back(isoBase, arrayFromQColor(color));
-        glBuffers.lineVertBuffer.emplace_back(isoTop, arrayFromQColor(color));
+    const auto uploadVertexData = [](auto & buf, const auto & vertices){
+        buf.destroy();
+        buf.create();
+        buf.bind();
+        buf.allocate(vertices.data(), static_cast<int>(vertices.size() * sizeof(vertices.front())));
+        buf.release();
     };
-
-    auto addNode = [arrayFromQColor, options, &glBuffers](const nodeListElement & node) {
-        auto color = state->viewer->getNodeColor(node);
-
-        if (node.selected && options.highlightSelection) {// highlight selected nodes
-            auto selectedNodeColor = QColor(Qt::green);
-//            selectedNodeColor.setAlphaF(0.5f);// results in half-transparent nodes in low mode
-            color = selectedNodeColor;
-            glBuffers.pointVertBuffer.lastSelectedNode = node.nodeID;
-        }
-
-        const auto isoPos = Dataset::current().scale.componentMul(node.position);
-
-        glBuffers.colorPickingBuffer24.emplace_back(arrayFromQColor(getPickingColor(node, RenderOptions::SelectionPass::NodeID0_24Bits)));
-        glBuffers.colorPickingBuffer48.emplace_back(arrayFromQColor(getPickingColor(node, RenderOptions::SelectionPass::NodeID24_48Bits)));
-        glBuffers.colorPickingBuffer64.emplace_back(arrayFromQColor(getPickingColor(node, RenderOptions::SelectionPass::NodeID48_64Bits)));
-        glBuffers.pointVertBuffer.emplace_back(isoPos, arrayFromQColor(color));
-        glBuffers.pointVertBuffer.colorBufferOffset[node.nodeID] = static_cast<unsigned int>(glBuffers.pointVertBuffer.vertices.size()-1);
+    const auto upload = [&uploadVertexData](GLBuffers::RenderBuffer & buffer){
+        uploadVertexData(buffer.color_buffer, buffer.colors);
+        uploadVertexData(buffer.vertex_buffer, buffer.vertices);
     };
-
-    for (auto & currentTree : Skeletonizer::singleton().skeletonState.trees) {
-        // focus on synapses, darken rest of skeleton
-        bool darken, hide;
-        std::tie(darken, hide) = darkenOrHideTree(currentTree, viewportType);
-        if (hide) {
+    std::unordered_map<const treeListElement *, std::pair<bool, bool>> treeDarkenOrHide;
+    for (const auto & key : glBuffers.dirtyChunks) {
+        const auto chunkIt = glBuffers.chunks.find(key);
+        if (chunkIt == std::end(glBuffers.chunks)) {
             continue;
         }
-        for (auto nodeIt = std::begin(currentTree.nodes); nodeIt != std::end(currentTree.nodes); ++nodeIt) {
+        auto & chunk = chunkIt->second;
+        chunk.lineVertBuffer.clear();
+        chunk.pointVertBuffer.clear();
+        chunk.colorPickingBuffer32.clear();
+        chunk.colorPickingBuffer64.clear();
+        floatCoordinate min{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+        floatCoordinate max{std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+        const auto extend = [&min, &max](const floatCoordinate & pos){
+            min = {std::min(min.x, pos.x), std::min(min.y, pos.y), std::min(min.z, pos.z)};
+            max = {std::max(max.x, pos.x), std::max(max.y, pos.y), std::max(max.z, pos.z)};
+        };
+        std::vector<std::uint64_t> nodeIDs;
+        for (const auto nodeID : chunk.nodeIDs) {
+            const auto it = nodesByNodeID.find(nodeID);
+            if (it == std::end(nodesByNodeID) || glBuffers.chunkOf(it->second->position) != key) {
+                continue;// removed or moved to another chunk
+            }
+            nodeIDs.emplace_back(nodeID);
+            const auto & node = *it->second;
+            auto & currentTree = *node.correspondingTree;
+            auto treeIt = treeDarkenOrHide.find(&currentTree);
+            if (treeIt == std::end(treeDarkenOrHide)) {
+                treeIt = treeDarkenOrHide.emplace(&currentTree, darkenOrHideTree(currentTree, viewportType)).first;
+            }
+            bool darken, hide;
+            std::tie(darken, hide) = treeIt->second;
+            if (hide) {
+                continue;
+            }
             //This sets the current color for the segment rendering
             QColor currentColor = currentTree.color;
             if (state->viewerState->highlightActiveTree && currentTree.treeID == state->skeletonState->activeTree->treeID) {
@@ -1988,34 +2179,58 @@ void generateSkeletonGeometry(GLBuffers & glBuffers, const RenderOptions &option
             if (darken) {
                 currentColor.setAlpha(Synapse::darkenedAlpha);
             }
-
-            for (const auto & currentSegment : nodeIt->segments) {
+            for (const auto & currentSegment : node.segments) {
                 if (currentSegment.forward) {
                     continue;
                 }
-                addSegment(currentSegment, currentColor);
+                const auto isoBase = Dataset::current().scale.componentMul(currentSegment.source.position);
+                const auto isoTop = Dataset::current().scale.componentMul(currentSegment.target.position);
+                chunk.lineVertBuffer.emplace_back(isoBase, arrayFromQColor(currentColor));
+                chunk.lineVertBuffer.emplace_back(isoTop, arrayFromQColor(currentColor));
+                extend(isoBase);
             }
 
-            addNode(*nodeIt);
+            auto color = state->viewer->getNodeColor(node);
+            if (node.selected && options.highlightSelection) {// highlight selected nodes
+                auto selectedNodeColor = QColor(Qt::green);
+//                selectedNodeColor.setAlphaF(0.5f);// results in half-transparent nodes in low mode
+                color = selectedNodeColor;
+            }
+            const auto isoPos = Dataset::current().scale.componentMul(node.position);
+            chunk.colorPickingBuffer32.emplace_back(pickingColor(node, false));
+            chunk.colorPickingBuffer64.emplace_back(pickingColor(node, true));
+            chunk.pointVertBuffer.emplace_back(isoPos, arrayFromQColor(color));
+            extend(isoPos);
+        }
+        if (nodeIDs.empty()) {
+            for (auto * buffer : {&chunk.lineVertBuffer, &chunk.pointVertBuffer}) {
+                buffer->vertex_buffer.destroy();
+                buffer->color_buffer.destroy();
+            }
+            glBuffers.chunks.erase(chunkIt);
+            continue;
+        }
+        chunk.nodeIDs = std::move(nodeIDs);
+        if (!chunk.pointVertBuffer.vertices.empty()) {
+            chunk.center = (min + max) / 2;
+            chunk.radius = (max - min).length() / 2;
+        }
+        upload(chunk.lineVertBuffer);
+        upload(chunk.pointVertBuffer);
+    }
+    glBuffers.dirtyChunks.clear();
+    if (options.highlightSelection) {// selection changes mark the previous and the current selection dirty
+        for (const auto * node : state->skeletonState->selectedNodes) {
+            glBuffers.highlightedNodes.emplace_back(node->nodeID);
         }
     }
 
-    synapseLoop([&addSegment](const auto &, const auto & virtualSegment, const auto & color){
-        addSegment(virtualSegment, color);
+    glBuffers.synapseLineBuffer.clear();
+    synapseLoop([&glBuffers, &arrayFromQColor](const auto &, const auto & virtualSegment, const auto & color){
+        glBuffers.synapseLineBuffer.emplace_back(Dataset::current().scale.componentMul(virtualSegment.source.position), arrayFromQColor(color));
+        glBuffers.synapseLineBuffer.emplace_back(Dataset::current().scale.componentMul(virtualSegment.target.position), arrayFromQColor(color));
     }, viewportType);
-
-    const auto uploadVertexData = [](auto & buf, const auto & vertices){
-        buf.destroy();
-        buf.create();
-        buf.bind();
-        buf.allocate(vertices.data(), static_cast<int>(vertices.size() * sizeof(vertices.front())));
-        buf.release();
-    };
-    uploadVertexData(glBuffers.pointVertBuffer.color_buffer, glBuffers.pointVertBuffer.colors);
-    uploadVertexData(glBuffers.pointVertBuffer.vertex_buffer, glBuffers.pointVertBuffer.vertices);
-
-    uploadVertexData(glBuffers.lineVertBuffer.color_buffer, glBuffers.lineVertBuffer.colors);
-    uploadVertexData(glBuffers.lineVertBuffer.vertex_buffer, glBuffers.lineVertBuffer.vertices);
+    upload(glBuffers.synapseLineBuffer);
 }
 
 /*
@@ -2060,7 +2275,7 @@ void ViewportBase::renderSkeleton(const RenderOptions &options) {
     glPushMatrix();
     const auto displayFlag = (viewportType == VIEWPORT_SKELETON) ? state->viewerState->skeletonDisplayVP3D : state->viewerState->skeletonDisplayVPOrtho;
     auto & glBuffers = displayFlag.testFlag(TreeDisplay::OnlySelected) ? state->viewerState->selectedTreesBuffers : state->viewerState->AllTreesBuffers;
-    if(glBuffers.regenVertBuffer) {
+    if (glBuffers.regenVertBuffer || !glBuffers.dirtyNodes.empty() || !glBuffers.dirtyChunks.empty()) {
         generateSkeletonGeometry(glBuffers, options, viewportType);
     }
     if(!state->viewerState->onlyLinesAndPoints) {
@@ -2183,21 +2398,48 @@ void ViewportBase::renderSkeleton(const RenderOptions &options) {
     const auto alwaysLinesAndPoints = state->viewerState->cumDistRenderThres > 19.f && options.enableLoddingAndLinesAndPoints;
     // higher render qualities only use lines and points if node < smallestVisibleSize
     glLineWidth(alwaysLinesAndPoints ? lineSize(width()/displayedlengthInNmX) : smallestVisibleNodeSize());
+    const auto integerPicking = options.selectionPass == RenderOptions::SelectionPass::NodeID64Bits;
+    std::vector<std::array<std::uint8_t, 4>> fallbackPickingColors;
+    const auto drawBuffer = [this, &options, integerPicking, &fallbackPickingColors](GLBuffers::RenderBuffer & buffer, const GLenum mode, const GLBuffers::Chunk * pickingChunk = nullptr){
+        if (buffer.vertices.empty()) {
+            return;
+        }
+        buffer.vertex_buffer.bind();
+        glVertexPointer(3, GL_FLOAT, 0, nullptr);
+        buffer.vertex_buffer.release();
+        if (pickingChunk != nullptr && integerPicking) {
+            glColorPointer(4, GL_UNSIGNED_BYTE, 0, pickingChunk->colorPickingBuffer32.data());
+            nodeIdShader.setAttributeArray(1, GL_UNSIGNED_BYTE, pickingChunk->colorPickingBuffer64.data(), 4);
+        } else if (pickingChunk != nullptr) {// slice this pass’ bits out of the stored name halves
+            fallbackPickingColors.clear();
+            for (std::size_t i = 0; i < pickingChunk->colorPickingBuffer32.size(); ++i) {
+                std::uint64_t name{0};
+                for (std::size_t byte = 0; byte < 4; ++byte) {
+                    name |= static_cast<std::uint64_t>(pickingChunk->colorPickingBuffer32[i][byte]) << (8 * byte);
+                    name |= static_cast<std::uint64_t>(pickingChunk->colorPickingBuffer64[i][byte]) << (8 * byte + 32);
+                }
+                fallbackPickingColors.emplace_back(pickingColor(name, options.selectionPass));
+            }
+            glColorPointer(4, GL_UNSIGNED_BYTE, 0, fallbackPickingColors.data());
+        } else {
+            buffer.color_buffer.bind();
+            glColorPointer(4, GL_UNSIGNED_BYTE, 0, nullptr);
+            buffer.color_buffer.release();
+        }
+        glDrawArrays(mode, 0, static_cast<GLsizei>(buffer.vertices.size()));
+    };
     /* Render line geometry batch if it contains data and we don’t pick nodes */
     if (!options.nodePicking) {
         glEnableClientState(GL_VERTEX_ARRAY);
         glEnableClientState(GL_COLOR_ARRAY);
 
-        /* draw all segments */
-        glBuffers.lineVertBuffer.vertex_buffer.bind();
-        glVertexPointer(3, GL_FLOAT, 0, nullptr);
-        glBuffers.lineVertBuffer.vertex_buffer.release();
-
-        glBuffers.lineVertBuffer.color_buffer.bind();
-        glColorPointer(4, GL_UNSIGNED_BYTE, 0, nullptr);
-        glBuffers.lineVertBuffer.color_buffer.release();
-
-        glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(glBuffers.lineVertBuffer.vertices.size()));
+        /* draw all segments of chunks inside the frustum */
+        for (auto & pair : glBuffers.chunks) {
+            if (sphereInFrustum(pair.second.center, pair.second.radius)) {
+                drawBuffer(pair.second.lineVertBuffer, GL_LINES);
+            }
+        }
+        drawBuffer(glBuffers.synapseLineBuffer, GL_LINES);
 
         glDisableClientState(GL_COLOR_ARRAY);
         glDisableClientState(GL_VERTEX_ARRAY);
@@ -2208,27 +2450,21 @@ void ViewportBase::renderSkeleton(const RenderOptions &options) {
     /* Render point geometry batch if it contains data */
     glEnableClientState(GL_VERTEX_ARRAY);
     glEnableClientState(GL_COLOR_ARRAY);
+    if (options.nodePicking && integerPicking) {
+        nodeIdShader.enableAttributeArray(1);
+    }
 
-    /* draw all nodes */
-    glBuffers.pointVertBuffer.vertex_buffer.bind();
-    glVertexPointer(3, GL_FLOAT, 0, nullptr);
-    glBuffers.pointVertBuffer.vertex_buffer.release();
-
-    if(options.nodePicking) {
-        if(options.selectionPass == RenderOptions::SelectionPass::NodeID0_24Bits) {
-            glColorPointer(4, GL_UNSIGNED_BYTE, 0, glBuffers.colorPickingBuffer24.data());
-        } else if(options.selectionPass == RenderOptions::SelectionPass::NodeID24_48Bits) {
-            glColorPointer(4, GL_UNSIGNED_BYTE, 0, glBuffers.colorPickingBuffer48.data());
-        } else if(options.selectionPass == RenderOptions::SelectionPass::NodeID48_64Bits) {
-            glColorPointer(4, GL_UNSIGNED_BYTE, 0, glBuffers.colorPickingBuffer64.data());
+    /* draw all nodes of chunks inside the frustum */
+    for (auto & pair : glBuffers.chunks) {
+        auto & chunk = pair.second;
+        if (!sphereInFrustum(chunk.center, chunk.radius)) {
+            continue;
         }
-    } else {
-        glBuffers.pointVertBuffer.color_buffer.bind();
-        glColorPointer(4, GL_UNSIGNED_BYTE, 0, nullptr);
-        glBuffers.pointVertBuffer.color_buffer.release();
+        drawBuffer(chunk.pointVertBuffer, GL_POINTS, options.nodePicking ? &chunk : nullptr);
+    }
+    if (options.nodePicking && integerPicking) {
+        nodeIdShader.disableAttributeArray(1);
     }
-
-    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(glBuffers.pointVertBuffer.vertices.size()));
 
     glDisableClientState(GL_COLOR_ARRAY);
     glDisableClientState(GL_VERTEX_ARRAY);
@@ -2,7 +2,8 @@
 #define RENDEROPTIONS_H
 
 struct RenderOptions {
-    enum class SelectionPass { NoSelection, NodeID0_24Bits, NodeID24_48Bits, NodeID48_64Bits };
+    // NodeID64Bits writes whole names into the integer picking buffer, the others are the RGBA fallback passes
+    enum class SelectionPass { NoSelection, NodeID0_24Bits, NodeID24_48Bits, NodeID48_64Bits, NodeID64Bits };
     RenderOptions();
     static RenderOptions nodePickingRenderOptions(SelectionPass pass);
     static RenderOptions meshPickingRenderOptions();
@@ -28,6 +28,17 @@
 #include "stateInfo.h"
 #include "viewer.h"
 
+#include <QThread>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
 bool Viewport3D::showBoundariesInUm = false;
 
 Viewport3D::Viewport3D(QWidget *parent, ViewportType viewportType) : ViewportBase(parent, viewportType) {
@@ -111,10 +122,25 @@ Viewport3D::Viewport3D(QWidget *parent, ViewportType viewportType) : ViewportBas
 
 Viewport3D::~Viewport3D() {
     makeCurrent();
-    if (Segmentation::singleton().volume_tex_id != 0) {
-        glDeleteTextures(1, &Segmentation::singleton().volume_tex_id);
+    for (auto * texId : {&volumeAtlasTexId, &volumePageTexId, &volumePaletteTexId, &volumeOccupancyTexId}) {
+        if (*texId != 0) {
+            glDeleteTextures(1, texId);
+        }
+    }
+}
+
+void Viewport3D::initializeGL() {
+    ViewportBase::initializeGL();
+    if (context()->format().version() >= qMakePair(3, 0)) {// integer textures, the volume stays empty otherwise
+        volumeShader.addShaderFromSourceFile(QOpenGLShader::Vertex, ":/resources/shaders/volumeshader.vert");
+        volumeShader.addShaderFromSourceFile(QOpenGLShader::Fragment, ":/resources/shaders/volumeshader.frag");
+        volumeShader.link();
+        if (!volumeShader.log().isEmpty()) {
+            qDebug() << volumeShader.log();
+        }
+    } else {
+        qDebug() << "volume rendering needs OpenGL 3.0";
     }
-    Segmentation::singleton().volume_tex_id = 0;
 }
 
 void Viewport3D::paintGL() {
@@ -140,166 +166,369 @@ void Viewport3D::refocus(const boost::optional<Coordinate> position) {
     glGetFloatv(GL_MODELVIEW_MATRIX, state->skeletonState->skeletonVpModelView);
 }
 
-void Viewport3D::updateVolumeTexture() {
-    if (!Segmentation::singleton().enabled) {
-        return;
+namespace {
+struct PreparedVolumeCube {
+    std::vector<std::uint64_t> ids;
+    std::vector<std::uint16_t> indices;
+    std::vector<std::vector<std::uint16_t>> brickIndices;
+};
+
+// palette compresses a cube (cube edges are multiples of the brick size) and collects the indices present in each brick
+PreparedVolumeCube prepareVolumeCube(const std::uint64_t * data, const int cubeEdge, const int brickSize) {
+    PreparedVolumeCube result;
+    if (data == nullptr) {// not loaded, rendered empty until it arrives
+        return result;
     }
-    auto& seg = Segmentation::singleton();
-    int texLen = seg.volume_tex_len;
-    if(seg.volume_tex_id == 0) {
-        glGenTextures(1, &seg.volume_tex_id);
-        glBindTexture(GL_TEXTURE_3D, seg.volume_tex_id);
-
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-
-        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA, texLen, texLen, texLen, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    const int bricks = cubeEdge / brickSize;
+    result.indices.resize(static_cast<std::size_t>(cubeEdge) * cubeEdge * cubeEdge);
+    result.brickIndices.resize(static_cast<std::size_t>(bricks) * bricks * bricks);
+    std::unordered_map<std::uint64_t, std::uint32_t> idToIndex;
+    bool lastValid{false};
+    std::uint64_t lastId{0};
+    std::uint32_t lastIndex{0};
+    std::size_t i{0};
+    for (int z = 0; z < cubeEdge; ++z)
+    for (int y = 0; y < cubeEdge; ++y) {
+        auto * brickRow = result.brickIndices.data() + (z / brickSize) * bricks * bricks + (y / brickSize) * bricks;
+        for (int x = 0; x < cubeEdge; ++x, ++i) {
+            if (!lastValid || data[i] != lastId) {
+                const auto it = idToIndex.find(data[i]);
+                if (it != std::end(idToIndex)) {
+                    lastIndex = it->second;
+                } else {
+                    lastIndex = idToIndex[data[i]] = result.ids.size();
+                    result.ids.emplace_back(data[i]);
+                }
+                lastId = data[i];
+                lastValid = true;
+            }
+            result.indices[i] = lastIndex;
+            auto & brick = brickRow[x / brickSize];
+            if (brick.empty() || brick.back() != lastIndex) {
+                brick.emplace_back(lastIndex);
+            }
+        }
+    }
+    if (result.ids.size() > std::numeric_limits<std::uint16_t>::max() + 1ul) {
+        qWarning() << "more than 2^16 subobjects in a cube, it is left out of the volume";
+        return {};
     }
+    for (auto & brick : result.brickIndices) {
+        std::sort(std::begin(brick), std::end(brick));
+        brick.erase(std::unique(std::begin(brick), std::end(brick)), std::end(brick));
+        brick.shrink_to_fit();
+    }
+    return result;
+}
 
-    static Profiler tex_gen_profiler;
-    static Profiler dcfetch_profiler;
-    static Profiler colorfetch_profiler;
-    static Profiler occlusion_profiler;
-    static Profiler tex_transfer_profiler;
+void createVolumeTexture(QOpenGLFunctions_1_4 & gl, uint & texId, const GLenum target, const GLint minFilter = GL_NEAREST) {
+    gl.glGenTextures(1, &texId);
+    gl.glBindTexture(target, texId);
+    gl.glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gl.glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    gl.glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    gl.glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);// integer textures are incomplete with linear filtering
+    gl.glTexParameteri(target, GL_TEXTURE_MIN_FILTER, minFilter);
+}
+}
 
-    tex_gen_profiler.start(); // ----------------------------------------------------------- profiling
-    const auto currentPosDc = state->viewerState->currentPosition.cube(Dataset::current().cubeEdgeLength, Dataset::current().magnification);
-    int cubeLen = Dataset::current().cubeEdgeLength;
-    int M = state->M;
-    int M_radius = (M - 1) / 2;
-    GLubyte* colcube = new GLubyte[4*texLen*texLen*texLen];
-    std::tuple<uint64_t, std::tuple<uint8_t, uint8_t, uint8_t, uint8_t>> lastIdColor;
-
-    state->protectCube2Pointer.lock();
-
-    dcfetch_profiler.start(); // ----------------------------------------------------------- profiling
-    uint64_t** rawcubes = new uint64_t*[M*M*M];
-    for(int z = 0; z < M; ++z)
-    for(int y = 0; y < M; ++y)
-    for(int x = 0; x < M; ++x) {
-        auto cubeIndex = z*M*M + y*M + x;
-        const CoordOfCube cubeCoordRelative{x - M_radius, y - M_radius, z - M_radius};
-        rawcubes[cubeIndex] = reinterpret_cast<uint64_t*>(cubeQuery(state->cube2Pointer
-            , Segmentation::singleton().layerId, Dataset::current().magIndex, currentPosDc + cubeCoordRelative));
+bool Viewport3D::selectedInside(const VolumeCube & cube) const {
+    return std::any_of(std::begin(cube.slots), std::end(cube.slots), [this](const std::uint32_t slot){
+        return volumeSlotTable.selected(slot);
+    });
+}
+
+void Viewport3D::resetVolume(const int M, const int cubeEdge) {
+    for (const auto & cube : volumeCubes) {
+        volumeSlotTable.release(cube.slots);
     }
-    dcfetch_profiler.end(); // ----------------------------------------------------------- profiling
-
-    colorfetch_profiler.start(); // ----------------------------------------------------------- profiling
-
-    for(int z = 0; z < texLen; ++z)
-    for(int y = 0; y < texLen; ++y)
-    for(int x = 0; x < texLen; ++x) {
-        Coordinate DcCoord{(x * M)/cubeLen, (y * M)/cubeLen, (z * M)/cubeLen};
-        auto cubeIndex = DcCoord.z*M*M + DcCoord.y*M + DcCoord.x;
-        auto& rawcube = rawcubes[cubeIndex];
-
-        if(rawcube != nullptr) {
-            auto indexInDc  = ((z * M)%cubeLen)*cubeLen*cubeLen + ((y * M)%cubeLen)*cubeLen + (x * M)%cubeLen;
-            auto indexInTex = z*texLen*texLen + y*texLen + x;
-            auto subobjectId = rawcube[indexInDc];
-            if(subobjectId == std::get<0>(lastIdColor)) {
-                auto idColor = std::get<1>(lastIdColor);
-                colcube[4*indexInTex+0] = std::get<0>(idColor);
-                colcube[4*indexInTex+1] = std::get<1>(idColor);
-                colcube[4*indexInTex+2] = std::get<2>(idColor);
-                colcube[4*indexInTex+3] = std::get<3>(idColor);
-            } else if (seg.isSubObjectIdSelected(subobjectId)) {
-                auto idColor = seg.colorObjectFromSubobjectId(subobjectId);
-                std::get<3>(idColor) = 255; // ignore color alpha
-                colcube[4*indexInTex+0] = std::get<0>(idColor);
-                colcube[4*indexInTex+1] = std::get<1>(idColor);
-                colcube[4*indexInTex+2] = std::get<2>(idColor);
-                colcube[4*indexInTex+3] = std::get<3>(idColor);
-                lastIdColor = std::make_tuple(subobjectId, idColor);
-            } else {
-                colcube[4*indexInTex+0] = 0;
-                colcube[4*indexInTex+1] = 0;
-                colcube[4*indexInTex+2] = 0;
-                colcube[4*indexInTex+3] = 0;
+    volumeCubes = decltype(volumeCubes)(M * M * M);
+    if (M != volumeM || cubeEdge != volumeCubeEdge || volumeAtlasTexId == 0) {
+        for (auto * texId : {&volumeAtlasTexId, &volumePageTexId, &volumePaletteTexId, &volumeOccupancyTexId}) {
+            if (*texId != 0) {
+                glDeleteTextures(1, texId);
             }
-        } else {
-            auto indexInTex = z*texLen*texLen + y*texLen + x;
-            colcube[4*indexInTex+0] = 0;
-            colcube[4*indexInTex+1] = 0;
-            colcube[4*indexInTex+2] = 0;
-            colcube[4*indexInTex+3] = 0;
         }
+        GLint max3DSize;
+        glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &max3DSize);
+        const std::size_t cubeBytes = std::pow(cubeEdge, 3) * sizeof(std::uint16_t);
+        const std::size_t maxPerAxis = max3DSize / cubeEdge;
+        volumeAtlasCapacity = std::min({static_cast<std::size_t>(M * M * M), volumeAtlasBudget / cubeBytes, maxPerAxis * maxPerAxis * maxPerAxis});
+        volumeAtlasCubes = 1;
+        while (std::pow(volumeAtlasCubes, 3) < volumeAtlasCapacity) {
+            ++volumeAtlasCubes;
+        }
+        const int atlasLayers = (volumeAtlasCapacity + volumeAtlasCubes * volumeAtlasCubes - 1) / (volumeAtlasCubes * volumeAtlasCubes);
+        createVolumeTexture(*this, volumeAtlasTexId, GL_TEXTURE_3D);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_R16UI, volumeAtlasCubes * cubeEdge, volumeAtlasCubes * cubeEdge, atlasLayers * cubeEdge, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+        createVolumeTexture(*this, volumePageTexId, GL_TEXTURE_3D);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA32UI, M, M, M, 0, GL_RGBA_INTEGER, GL_UNSIGNED_INT, nullptr);
+        createVolumeTexture(*this, volumePaletteTexId, GL_TEXTURE_2D);
+
+        volumeOccupancyEdge = 1;
+        while (volumeOccupancyEdge < M * cubeEdge / volumeBrickSize) {// power of 2, so each level halves exactly
+            volumeOccupancyEdge *= 2;
+        }
+        volumeOccupancy.clear();
+        for (int edge = volumeOccupancyEdge; edge > 0; edge /= 2) {
+            volumeOccupancy.emplace_back(std::pow(edge, 3), 0);
+        }
+        createVolumeTexture(*this, volumeOccupancyTexId, GL_TEXTURE_3D, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, volumeOccupancy.size() - 1);
     }
+    volumeFreeAtlasSlots.resize(volumeAtlasCapacity);
+    std::iota(std::rbegin(volumeFreeAtlasSlots), std::rend(volumeFreeAtlasSlots), 0);// slot 0 is handed out first
+    volumeAtlasFullWarned = false;
+    glBindTexture(GL_TEXTURE_3D, volumeOccupancyTexId);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (std::size_t level = 0; level < volumeOccupancy.size(); ++level) {
+        const int edge = volumeOccupancyEdge >> level;
+        std::fill(std::begin(volumeOccupancy[level]), std::end(volumeOccupancy[level]), 0);
+        glTexImage3D(GL_TEXTURE_3D, level, GL_R8, edge, edge, edge, 0, GL_RED, GL_UNSIGNED_BYTE, volumeOccupancy[level].data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    volumeM = M;
+    volumeCubeEdge = cubeEdge;
+}
 
-    delete[] rawcubes;
+void Viewport3D::updateVolumeTexture() {
+    auto & seg = Segmentation::singleton();
+    if (!seg.enabled || !volumeShader.isLinked()) {
+        return;
+    }
+    static Profiler tex_gen_profiler;
+    tex_gen_profiler.start(); // ----------------------------------------------------------- profiling
 
-    state->protectCube2Pointer.unlock();
+    const int cubeEdge = Dataset::current().cubeEdgeLength;
+    const auto currentPosDc = state->viewerState->currentPosition.cube(cubeEdge, Dataset::current().magnification);
+    const int M = state->M;
+    const int M_radius = (M - 1) / 2;
+
+    bool all;
+    std::vector<Coordinate> dirtyPositions;
+    {
+        QMutexLocker locker(&seg.volumeDirtyMutex);
+        all = seg.volumeDirtyAll;
+        seg.volumeDirtyAll = false;
+        std::swap(dirtyPositions, seg.volumeDirtyPositions);
+    }
+    all = all || !volumeCenter || volumeCenter.get() != currentPosDc || volumeM != M || volumeCubeEdge != cubeEdge;
+
+    std::vector<int> cubes;
+    if (all) {
+        resetVolume(M, cubeEdge);
+        cubes.resize(volumeCubes.size());
+        std::iota(std::begin(cubes), std::end(cubes), 0);
+    } else {
+        std::unordered_set<int> dirtyCubes;
+        for (const auto & pos : dirtyPositions) {
+            const auto cube = pos.cube(cubeEdge, Dataset::current().magnification);
+            const Coordinate rel{cube.x - currentPosDc.x + M_radius, cube.y - currentPosDc.y + M_radius, cube.z - currentPosDc.z + M_radius};
+            if (rel.x >= 0 && rel.y >= 0 && rel.z >= 0 && rel.x < M && rel.y < M && rel.z < M) {
+                dirtyCubes.emplace(rel.z * M * M + rel.y * M + rel.x);
+            }
+        }
+        cubes.assign(std::begin(dirtyCubes), std::end(dirtyCubes));
+    }
+    volumeCenter = currentPosDc;
+    loadVolumeCubes(cubes);
 
-    colorfetch_profiler.end(); // ----------------------------------------------------------- profiling
+    tex_gen_profiler.end(); // ----------------------------------------------------------- profiling
+    // qDebug() << "tex gen avg time: " << tex_gen_profiler.average_time()*1000 << "ms";
+}
 
-    occlusion_profiler.start(); // ----------------------------------------------------------- profiling
-    for(int z = 1; z < texLen - 1; ++z)
-    for(int y = 1; y < texLen - 1; ++y)
-    for(int x = 1; x < texLen - 1; ++x) {
-        auto indexInTex = (z)*texLen*texLen + (y)*texLen + x;
-        if(colcube[4*indexInTex+3] != 0) {
-            for(int xi = -1; xi <= 1; ++xi) {
-                auto othrIndexInTex = (z)*texLen*texLen + (y)*texLen + x+xi;
-                if((xi != 0) && colcube[4*othrIndexInTex+3] != 0) {
-                    colcube[4*indexInTex+0] *= 0.95f;
-                    colcube[4*indexInTex+1] *= 0.95f;
-                    colcube[4*indexInTex+2] *= 0.95f;
+/**
+ * (Re)reads the given cubes of the supercube. Cubes are scanned in batches of thread count size
+ * so only a few full resolution index cubes are alive at once, only those containing
+ * a selected subobject are uploaded into the atlas.
+ */
+void Viewport3D::loadVolumeCubes(const std::vector<int> & cubes) {
+    if (cubes.empty()) {
+        return;
+    }
+    const int M = volumeM;
+    const int M_radius = (M - 1) / 2;
+    const auto layerId = Segmentation::singleton().layerId;
+    const auto magIndex = Dataset::current().magIndex;
+    const std::size_t batchSize = std::max(1, QThread::idealThreadCount());
+    glBindTexture(GL_TEXTURE_3D, volumeAtlasTexId);
+    for (std::size_t batchStart = 0; batchStart < cubes.size(); batchStart += batchSize) {
+        const std::vector<int> batch(std::begin(cubes) + batchStart, std::begin(cubes) + std::min(cubes.size(), batchStart + batchSize));
+        std::vector<PreparedVolumeCube> prepared(batch.size());
+        std::vector<std::size_t> jobs(batch.size());
+        std::iota(std::begin(jobs), std::end(jobs), 0);
+        {
+            QMutexLocker locker(&state->protectCube2Pointer);// the loader must not free the cubes while they are scanned
+            QtConcurrent::blockingMap(jobs, [&](const std::size_t job){
+                const auto index = batch[job];
+                const CoordOfCube rel{index % M - M_radius, index / M % M - M_radius, index / (M * M) - M_radius};
+                const auto * data = reinterpret_cast<const std::uint64_t *>(cubeQuery(state->cube2Pointer, layerId, magIndex, volumeCenter.get() + rel));
+                prepared[job] = prepareVolumeCube(data, volumeCubeEdge, volumeBrickSize);
+            });
+        }
+        for (std::size_t job = 0; job < batch.size(); ++job) {
+            auto & cube = volumeCubes[batch[job]];
+            const auto oldSlots = std::move(cube.slots);
+            cube.slots = volumeSlotTable.assign(prepared[job].ids);
+            volumeSlotTable.release(oldSlots);// after assigning, ids that are still present keep their slots
+            cube.brickIndices = std::move(prepared[job].brickIndices);
+        }
+        volumeColorsChanged |= volumeSlotTable.updateColors();// selection state of the new slots
+        for (std::size_t job = 0; job < batch.size(); ++job) {
+            auto & cube = volumeCubes[batch[job]];
+            if (selectedInside(cube) && !prepared[job].indices.empty()) {
+                if (cube.atlasSlot == -1) {
+                    if (volumeFreeAtlasSlots.empty()) {
+                        if (!volumeAtlasFullWarned) {
+                            volumeAtlasFullWarned = true;
+                            qWarning() << "volume atlas full, further cubes of the selection are not rendered";
+                        }
+                        continue;
+                    }
+                    cube.atlasSlot = volumeFreeAtlasSlots.back();
+                    volumeFreeAtlasSlots.pop_back();
                 }
+                const auto slot = cube.atlasSlot;
+                const auto origin = Coordinate{slot % volumeAtlasCubes, slot / volumeAtlasCubes % volumeAtlasCubes, slot / (volumeAtlasCubes * volumeAtlasCubes)} * volumeCubeEdge;
+                glTexSubImage3D(GL_TEXTURE_3D, 0, origin.x, origin.y, origin.z, volumeCubeEdge, volumeCubeEdge, volumeCubeEdge, GL_RED_INTEGER, GL_UNSIGNED_SHORT, prepared[job].indices.data());
+            } else if (cube.atlasSlot != -1) {
+                volumeFreeAtlasSlots.emplace_back(cube.atlasSlot);
+                cube.atlasSlot = -1;
             }
         }
     }
+    glBindTexture(GL_TEXTURE_3D, 0);
+    updateVolumeBricks(cubes);
+    updateVolumeLookup();
+}
 
-    for(int z = 1; z < texLen - 1; ++z)
-    for(int y = 1; y < texLen - 1; ++y)
-    for(int x = 1; x < texLen - 1; ++x) {
-        auto indexInTex = (z)*texLen*texLen + (y)*texLen + x;
-        if(colcube[4*indexInTex+3] != 0) {
-            for(int yi = -1; yi <= 1; ++yi) {
-                auto othrIndexInTex = (z)*texLen*texLen + (y+yi)*texLen + x;
-                if((yi != 0) && colcube[4*othrIndexInTex+3] != 0) {
-                    colcube[4*indexInTex+0] *= 0.95f;
-                    colcube[4*indexInTex+1] *= 0.95f;
-                    colcube[4*indexInTex+2] *= 0.95f;
-                }
-            }
+// page table and the concatenated palettes of the uploaded cubes
+void Viewport3D::updateVolumeLookup() {
+    constexpr auto missing = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::array<std::uint32_t, 4>> pages(volumeCubes.size(), {{missing, missing, missing, 0}});
+    std::vector<std::uint32_t> palette;
+    for (std::size_t i = 0; i < volumeCubes.size(); ++i) {
+        const auto & cube = volumeCubes[i];
+        if (cube.atlasSlot != -1) {
+            const std::uint32_t slot = cube.atlasSlot;
+            const std::uint32_t atlasCubes = volumeAtlasCubes;
+            pages[i] = {{slot % atlasCubes, slot / atlasCubes % atlasCubes, slot / (atlasCubes * atlasCubes), static_cast<std::uint32_t>(palette.size())}};
+            palette.insert(std::end(palette), std::begin(cube.slots), std::end(cube.slots));
         }
     }
+    palette.resize(std::max<std::size_t>(1, (palette.size() + volumePaletteWidth - 1) / volumePaletteWidth) * volumePaletteWidth);
+    glBindTexture(GL_TEXTURE_3D, volumePageTexId);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, volumeM, volumeM, volumeM, GL_RGBA_INTEGER, GL_UNSIGNED_INT, pages.data());
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glBindTexture(GL_TEXTURE_2D, volumePaletteTexId);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, volumePaletteWidth, palette.size() / volumePaletteWidth, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, palette.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
 
-    for(int z = 1; z < texLen - 1; ++z)
-    for(int y = 1; y < texLen - 1; ++y)
-    for(int x = 1; x < texLen - 1; ++x) {
-        auto indexInTex = (z)*texLen*texLen + (y)*texLen + x;
-        if(colcube[4*indexInTex+3] != 0) {
-            for(int zi = -1; zi <= 1; ++zi) {
-                auto othrIndexInTex = (z+zi)*texLen*texLen + (y)*texLen + x;
-                if((zi != 0) && colcube[4*othrIndexInTex+3] != 0) {
-                    colcube[4*indexInTex+0] *= 0.95f;
-                    colcube[4*indexInTex+1] *= 0.95f;
-                    colcube[4*indexInTex+2] *= 0.95f;
+/**
+ * Recomputes the occupancy bricks of the given cubes and propagates the changed box
+ * up the pyramid, only that box is uploaded per level.
+ */
+void Viewport3D::updateVolumeBricks(const std::vector<int> & cubes) {
+    if (cubes.empty() || volumeOccupancy.empty()) {
+        return;
+    }
+    const int M = volumeM;
+    const int bricksPerCube = volumeCubeEdge / volumeBrickSize;
+    auto & level0 = volumeOccupancy.front();
+    const int edge0 = volumeOccupancyEdge;
+    Coordinate lo{edge0, edge0, edge0}, hi{0, 0, 0};// changed box [lo, hi)
+    for (const auto index : cubes) {
+        const auto & cube = volumeCubes[index];
+        const auto cubeBrick = Coordinate{index % M, index / M % M, index / (M * M)} * bricksPerCube;
+        for (int bz = 0; bz < bricksPerCube; ++bz)
+        for (int by = 0; by < bricksPerCube; ++by)
+        for (int bx = 0; bx < bricksPerCube; ++bx) {
+            bool occupied{false};
+            if (cube.atlasSlot != -1) {
+                const auto & indices = cube.brickIndices[bz * bricksPerCube * bricksPerCube + by * bricksPerCube + bx];
+                occupied = std::any_of(std::begin(indices), std::end(indices), [this, &cube](const std::uint16_t paletteIndex){
+                    return volumeSlotTable.selected(cube.slots[paletteIndex]);
+                });
+            }
+            const auto brick = cubeBrick + Coordinate{bx, by, bz};
+            auto & texel = level0[brick.z * edge0 * edge0 + brick.y * edge0 + brick.x];
+            const std::uint8_t value = occupied ? 255 : 0;
+            if (texel != value) {
+                texel = value;
+                lo = {std::min(lo.x, brick.x), std::min(lo.y, brick.y), std::min(lo.z, brick.z)};
+                hi = {std::max(hi.x, brick.x + 1), std::max(hi.y, brick.y + 1), std::max(hi.z, brick.z + 1)};
+            }
+        }
+    }
+    if (lo.x >= hi.x) {// nothing changed
+        return;
+    }
+    glBindTexture(GL_TEXTURE_3D, volumeOccupancyTexId);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (std::size_t level = 0; level < volumeOccupancy.size(); ++level) {
+        const int edge = volumeOccupancyEdge >> level;
+        if (level > 0) {// a cell is occupied if any of its 8 children is
+            lo = lo / 2;
+            hi = (hi + 1) / 2;
+            const auto & finer = volumeOccupancy[level - 1];
+            const int finerEdge = edge * 2;
+            for (int z = lo.z; z < hi.z; ++z)
+            for (int y = lo.y; y < hi.y; ++y)
+            for (int x = lo.x; x < hi.x; ++x) {
+                std::uint8_t value{0};
+                for (int child = 0; child < 8; ++child) {
+                    const Coordinate pos{2 * x + (child & 1), 2 * y + ((child >> 1) & 1), 2 * z + ((child >> 2) & 1)};
+                    value = std::max(value, finer[pos.z * finerEdge * finerEdge + pos.y * finerEdge + pos.x]);
                 }
+                volumeOccupancy[level][z * edge * edge + y * edge + x] = value;
             }
         }
+        const auto size = hi - lo;
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, edge);
+        glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, edge);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, lo.x);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, lo.y);
+        glPixelStorei(GL_UNPACK_SKIP_IMAGES, lo.z);
+        glTexSubImage3D(GL_TEXTURE_3D, level, lo.x, lo.y, lo.z, size.x, size.y, size.z, GL_RED, GL_UNSIGNED_BYTE, volumeOccupancy[level].data());
     }
-    occlusion_profiler.end(); // ----------------------------------------------------------- profiling
-
-    tex_transfer_profiler.start(); // ----------------------------------------------------------- profiling
-    glBindTexture(GL_TEXTURE_3D, seg.volume_tex_id);
-    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA, texLen, texLen, texLen, 0, GL_RGBA, GL_UNSIGNED_BYTE, colcube);
-    delete[] colcube;
-    tex_transfer_profiler.end(); // ----------------------------------------------------------- profiling
-
-    tex_gen_profiler.end(); // ----------------------------------------------------------- profiling
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_IMAGES, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_3D, 0);
+}
 
-    // --------------------- display some profiling information ------------------------
-    // qDebug() << "tex gen avg time: " << tex_gen_profiler.average_time()*1000 << "ms";
-    // qDebug() << "    dc fetch    : " << dcfetch_profiler.average_time()*1000 << "ms";
-    // qDebug() << "    color fetch : " << colorfetch_profiler.average_time()*1000 << "ms";
-    // qDebug() << "    occlusion   : " << occlusion_profiler.average_time()*1000 << "ms";
-    // qDebug() << "    tex transfer: " << tex_transfer_profiler.average_time()*1000 << "ms";
-    // qDebug() << "---------------------------------------------";
+// selection and merge changes only touch the slot colors, the bricks and the set of uploaded cubes follow them
+void Viewport3D::updateVolumeOccupancy() {
+    const auto changed = volumeSlotTable.updateColors() || volumeColorsChanged;
+    volumeColorsChanged = false;
+    if (!changed || volumeCubes.empty()) {
+        return;
+    }
+    std::vector<int> all(volumeCubes.size());
+    std::iota(std::begin(all), std::end(all), 0);
+    std::vector<int> reload;
+    bool lookupChanged{false};
+    for (const auto index : all) {
+        auto & cube = volumeCubes[index];
+        const auto selected = selectedInside(cube);
+        if (selected && cube.atlasSlot == -1 && !cube.slots.empty()) {// indices are only kept on the gpu
+            reload.emplace_back(index);
+        } else if (!selected && cube.atlasSlot != -1) {
+            volumeFreeAtlasSlots.emplace_back(cube.atlasSlot);
+            cube.atlasSlot = -1;
+            lookupChanged = true;
+        }
+    }
+    updateVolumeBricks(all);
+    if (lookupChanged) {
+        updateVolumeLookup();
+    }
+    loadVolumeCubes(reload);
 }
 
 void Viewport3D::showHideButtons(bool isShow) {
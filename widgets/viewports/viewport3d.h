@@ -23,11 +23,16 @@
 #ifndef VIEWPORT3D_H
 #define VIEWPORT3D_H
 
+#include "slicer/gpucuber.h"
 #include "viewportbase.h"
 
 #include <QMatrix4x4>
 #include <QTimer>
 
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
 class Viewport3D : public ViewportBase {
     Q_OBJECT
     QPushButton wiggleButton{"w"}, xyButton{"xy"}, xzButton{"xz"}, zyButton{"zy"}, r90Button{"r90"}, r180Button{"r180"}, resetButton{"reset"};
@@ -36,11 +41,48 @@ class Viewport3D : public ViewportBase {
     void resetWiggle();
     virtual void zoom(const float zoomStep) override;
     virtual float zoomStep() const override;
+    virtual void initializeGL() override;
     virtual void paintGL() override;
     bool wiggleDirection{true};
     int wiggle{0};
     QTimer wiggletimer;
     void renderVolumeVP();
+    void updateVolumeOccupancy();
+    // ray marched segmentation volume: the palette compressed id cubes of the supercube live in an integer
+    // atlas texture, a page table maps each supercube cube to its atlas position and palette.
+    // Palettes hold global slots of volumeSlotTable, colors are resolved in the shader.
+    // Only cubes containing a selected subobject are uploaded, everything else is skipped as empty.
+    struct VolumeCube {
+        std::vector<std::uint32_t> slots;// global slot per palette index, referenced in volumeSlotTable
+        std::vector<std::vector<std::uint16_t>> brickIndices;// palette indices present in each brick
+        int atlasSlot{-1};// -1 if the indices aren't uploaded
+    };
+    gpu_slot_table volumeSlotTable;
+    std::vector<VolumeCube> volumeCubes;// z·M² + y·M + x within the supercube
+    boost::optional<CoordOfCube> volumeCenter;
+    int volumeM{0};
+    int volumeCubeEdge{0};
+    int volumeAtlasCubes{0};// per axis
+    int volumeAtlasCapacity{0};
+    std::vector<int> volumeFreeAtlasSlots;
+    bool volumeAtlasFullWarned{false};
+    bool volumeColorsChanged{false};// consumed by a load, the bricks of the other cubes still need to follow
+    uint volumeAtlasTexId{0};
+    uint volumePageTexId{0};
+    uint volumePaletteTexId{0};
+    static constexpr std::size_t volumeAtlasBudget = 256 * 1024 * 1024;// bytes of index data on the gpu
+    static constexpr int volumePaletteWidth = 4096;
+    // empty space skipping: mip pyramid over the bricks, 255 if a selected subobject is inside
+    static constexpr int volumeBrickSize = 8;
+    std::vector<std::vector<std::uint8_t>> volumeOccupancy;// per level
+    int volumeOccupancyEdge{0};// bricks per axis of level 0
+    uint volumeOccupancyTexId{0};
+    bool selectedInside(const VolumeCube & cube) const;
+    void resetVolume(const int M, const int cubeEdge);
+    void loadVolumeCubes(const std::vector<int> & cubes);
+    void updateVolumeLookup();
+    void updateVolumeBricks(const std::vector<int> & cubes);
+    QOpenGLShaderProgram volumeShader;
     void renderSkeletonVP(const RenderOptions & options = RenderOptions());
     virtual void renderViewport(const RenderOptions &options = RenderOptions()) override;
     void renderArbitrarySlicePane(ViewportOrtho & vp, const RenderOptions & options);
@@ -23,12 +23,9 @@
 #include "viewportarb.h"
 
 #include "dataset.h"
-#include "segmentation/cubeloader.h"
 #include "stateInfo.h"
 #include "viewer.h"
 
-#include <QOpenGLPixelTransferOptions>
-
 ViewportArb::ViewportArb(QWidget *parent, ViewportType viewportType) : ViewportOrtho(parent, viewportType) {
     menuButton.menu()->addAction(&resetAction);
     connect(&resetAction, &QAction::triggered, []() {
@@ -49,44 +46,6 @@ void ViewportArb::hideVP() {
 void ViewportArb::paintGL() {
     if (state->gpuSlicer && state->viewer->gpuRendering) {
         state->viewer->arbCubes(*this);
-    } else if (Segmentation::singleton().enabled && state->viewerState->showOnlyRawData == false) {
-        updateOverlayTexture();
     }
     ViewportOrtho::paintGL();
 }
-
-void ViewportArb::updateOverlayTexture() {
-    if (!Segmentation::singleton().enabled || !resliceNecessary[Segmentation::singleton().layerId]) {
-        return;
-    }
-    resliceNecessary[Segmentation::singleton().layerId] = false;
-    const int width = (state->M - 1) * Dataset::current().cubeEdgeLength / std::sqrt(2);
-    const int height = width;
-    const auto begin = leftUpperPxInAbsPx_float;
-    std::vector<char> texData(4 * std::pow(state->viewerState->texEdgeLength, 2));
-    boost::multi_array_ref<uint8_t, 3> viewportView(reinterpret_cast<uint8_t *>(texData.data()), boost::extents[width][height][4]);
-    // cache
-    auto subobjectIdCache = Segmentation::singleton().getBackgroundId();
-    auto colorCache = Segmentation::singleton().colorObjectFromSubobjectId(subobjectIdCache);
-    for (int y = 0; y < height; ++y)
-    for (int x = 0; x < width; ++x) {
-        const auto dataPos = static_cast<Coordinate>(begin + v1 * Dataset::current().magnification * x - v2 * Dataset::current().magnification * y);
-        if (dataPos.x < 0 || dataPos.y < 0 || dataPos.z < 0) {
-            viewportView[y][x][0] = viewportView[y][x][1] = viewportView[y][x][2] = viewportView[y][x][3] = 0;
-        } else {
-            const auto soid = readVoxel(dataPos);
-            const auto color = (subobjectIdCache == soid) ? colorCache : Segmentation::singleton().colorObjectFromSubobjectId(soid);
-            subobjectIdCache = soid;
-            colorCache = color;
-            viewportView[y][x][0] = std::get<0>(color);
-            viewportView[y][x][1] = std::get<1>(color);
-            viewportView[y][x][2] = std::get<2>(color);
-            viewportView[y][x][3] = std::get<3>(color);
-        }
-    }
-    texture.texHandle[Segmentation::singleton().layerId].bind();
-    QOpenGLPixelTransferOptions options;
-    options.setRowLength(width);
-    texture.texHandle[Segmentation::singleton().layerId].setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, texData.data(), &options);
-    texture.texHandle[Segmentation::singleton().layerId].release();
-}
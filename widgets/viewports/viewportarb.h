@@ -28,7 +28,6 @@
 class ViewportArb : public ViewportOrtho {
     Q_OBJECT
     QAction resetAction{"Reset rotation", &menuButton};
-    void updateOverlayTexture();
 
 protected:
     virtual void paintGL() override;
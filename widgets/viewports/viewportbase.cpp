@@ -163,8 +163,9 @@ ViewportBase::ViewportBase(QWidget *parent, ViewportType viewportType) :
 }
 
 ViewportBase::~ViewportBase() {
+    makeCurrent();
+    destroyPickingFbo();
     if (oglDebug && oglLogger.isLogging()) {
-        makeCurrent();
         oglLogger.stopLogging();
     }
 }
@@ -278,7 +279,14 @@ void ViewportBase::initializeGL() {
     enabled = enabled && meshIdShader.addShaderFromSourceFile(QOpenGLShader::Fragment, ":/resources/shaders/mesh/meshidshader.frag");
     state->viewerState->MeshPickingEnabled = enabled && meshIdShader.link();
 
-    for (auto * shader : {&meshShader, &meshTreeColorShader, &meshIdShader}) {
+    if (context()->format().version() >= qMakePair(3, 0)) {// integer name buffer, pickNodes falls back to RGBA passes otherwise
+        nodeIdShader.addShaderFromSourceFile(QOpenGLShader::Vertex, ":/resources/shaders/nodeidshader.vert");
+        nodeIdShader.addShaderFromSourceFile(QOpenGLShader::Fragment, ":/resources/shaders/nodeidshader.frag");
+        nodeIdShader.bindAttributeLocation("idHigh", 1);// keep it off location 0, which may alias gl_Vertex
+        nodeIdShader.link();
+    }
+
+    for (auto * shader : {&meshShader, &meshTreeColorShader, &meshIdShader, &nodeIdShader}) {
         if (!shader->log().isEmpty()) {
             qDebug() << shader->log();
         }
@@ -159,10 +159,19 @@ private:
 
     void renderMeshBuffer(Mesh & buf);
 
+    // persistent node picking target: RG32UI name texture and depth buffer of the viewport size
+    GLuint pickingFbo{0};
+    GLuint pickingNameTexture{0};
+    GLuint pickingDepthBuffer{0};
+    QSize pickingFboSize;
+    void preparePickingFbo();
+    void destroyPickingFbo();
+
 protected:
     QOpenGLShaderProgram meshShader;
     QOpenGLShaderProgram meshTreeColorShader;
     QOpenGLShaderProgram meshIdShader;
+    QOpenGLShaderProgram nodeIdShader;
     boost::optional<BufferSelection> pickMesh(const QPoint pos);
     void pickMeshIdAtPosition();
     virtual void renderMeshBufferIds(Mesh & buf);
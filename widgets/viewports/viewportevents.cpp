@@ -29,6 +29,7 @@
 #include "functions.h"
 #include "gui_wrapper.h"
 #include "scriptengine/scripting.h"
+#include "segmentation/brushstroke.h"
 #include "segmentation/cubeloader.h"
 #include "segmentation/segmentation.h"
 #include "segmentation/segmentationsplit.h"
@@ -36,6 +37,7 @@
 #include "skeleton/skeletonizer.h"
 #include "skeleton/tree.h"
 #include "stateInfo.h"
+#include "undojournal.h"
 #include "viewer.h"
 #include "widgets/preferences/navigationtab.h"
 #include "widgets/mainwindow.h"
@@ -103,7 +105,7 @@ void segmentation_brush_work(const QMouseEvent *event, ViewportOrtho & vp) {
         }
         if (seg.selectedObjectsCount() > 0) {
             uint64_t soid = seg.subobjectIdOfFirstSelectedObject(coord);
-            writeVoxels(coord, soid, seg.brush.value());
+            BrushStroke::singleton().moveTo(coord, soid, seg.brush.value());
         }
     }
 }
@@ -161,6 +163,9 @@ void ViewportBase::handleMouseButtonMiddle(const QMouseEvent *event) {
 void ViewportOrtho::handleMouseButtonMiddle(const QMouseEvent *event) {
     if (event->modifiers().testFlag(Qt::NoModifier) && Session::singleton().annotationMode.testFlag(AnnotationMode::NodeEditing)) {
         if (auto clickedNode = pickNode(event->x(), event->y(), 10)) {
+            if (draggedNode == nullptr) {
+                UndoJournal::singleton().beginGroup();
+            }
             draggedNode = &clickedNode.get();
         }
     }
@@ -170,6 +175,10 @@ void ViewportOrtho::handleMouseButtonMiddle(const QMouseEvent *event) {
 void ViewportOrtho::handleMouseButtonRight(const QMouseEvent *event) {
     const auto & annotationMode = Session::singleton().annotationMode;
     if (annotationMode.testFlag(AnnotationMode::Brush)) {
+        if (!brushStroke) {
+            brushStroke = true;
+            UndoJournal::singleton().beginGroup();
+        }
         Segmentation::singleton().brush.setInverse(event->modifiers().testFlag(Qt::ShiftModifier));
         segmentation_brush_work(event, *this);
         return;
@@ -327,6 +336,10 @@ void Viewport3D::handleMouseMotionRightHold(const QMouseEvent *event) {
 
 void ViewportOrtho::handleMouseMotionRightHold(const QMouseEvent *event) {
     if (Session::singleton().annotationMode.testFlag(AnnotationMode::Brush)) {
+        if (!brushStroke) {// the stroke was cut by endUndoGroups, the rest is another step
+            brushStroke = true;
+            UndoJournal::singleton().beginGroup();
+        }
         const bool notOrigin = event->pos() != mouseDown;//don’t do redundant work
         if (notOrigin) {
             segmentation_brush_work(event, *this);
@@ -420,9 +433,27 @@ void ViewportOrtho::handleMouseReleaseRight(const QMouseEvent *event) {
             segmentation_brush_work(event, *this);
         }
     }
+    if (brushStroke) {
+        brushStroke = false;
+        BrushStroke::singleton().end();
+        UndoJournal::singleton().endGroup();
+    }
     ViewportBase::handleMouseReleaseRight(event);
 }
 
+void ViewportOrtho::endUndoGroups() {// the release event may never arrive, e.g. when a dialog takes the focus
+    if (brushStroke) {
+        brushStroke = false;
+        BrushStroke::singleton().end();
+        UndoJournal::singleton().endGroup();
+    }
+    if (draggedNode != nullptr) {
+        arbNodeDragCache = {};
+        draggedNode = nullptr;
+        UndoJournal::singleton().endGroup();
+    }
+}
+
 void ViewportOrtho::handleMouseReleaseMiddle(const QMouseEvent *event) {
     Coordinate clickedCoordinate = getCoordinateFromOrthogonalClick(event->pos(), *this);
     if (!Session::singleton().outsideMovementArea(clickedCoordinate)) {
@@ -445,6 +476,9 @@ void ViewportOrtho::handleMouseReleaseMiddle(const QMouseEvent *event) {
         }
     }
     //finish node drag
+    if (draggedNode != nullptr) {
+        UndoJournal::singleton().endGroup();
+    }
     arbNodeDragCache = {};
     draggedNode = nullptr;
 
@@ -673,6 +707,16 @@ void Viewport3D::focusOutEvent(QFocusEvent * event) {
     QWidget::focusOutEvent(event);
 }
 
+void ViewportOrtho::leaveEvent(QEvent * event) {
+    endUndoGroups();
+    ViewportBase::leaveEvent(event);
+}
+
+void ViewportOrtho::focusOutEvent(QFocusEvent * event) {
+    endUndoGroups();
+    ViewportBase::focusOutEvent(event);
+}
+
 Coordinate getCoordinateFromOrthogonalClick(const QPointF pos, ViewportOrtho & vp) {
     const auto leftUpper = floatCoordinate{state->viewerState->currentPosition} - (vp.v1 * vp.edgeLength / vp.screenPxXPerDataPx - vp.v2 * vp.edgeLength / vp.screenPxYPerDataPx) * 0.5;
     return leftUpper + vp.v1 * (pos.x() / vp.screenPxXPerDataPx - 0.5) - vp.v2 * (pos.y() / vp.screenPxYPerDataPx - 0.5);
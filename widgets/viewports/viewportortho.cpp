@@ -74,11 +74,11 @@ void ViewportOrtho::initializeGL() {
         if (viewportType == ViewportType::VIEWPORT_XY) {
 //            state->viewer->gpucubeedge = 128;
             state->viewer->layers.emplace_back(*context());
-            state->viewer->layers.back().createBogusCube(Dataset::current().cubeEdgeLength, state->viewer->gpucubeedge);
+            state->viewer->layers.back().createBogusCube(state->viewer->gpucubeedge);
             state->viewer->layers.emplace_back(*context());
 //            state->viewer->layers.back().enabled = false;
             state->viewer->layers.back().isOverlayData = true;
-            state->viewer->layers.back().createBogusCube(Dataset::current().cubeEdgeLength, state->viewer->gpucubeedge);
+            state->viewer->layers.back().createBogusCube(state->viewer->gpucubeedge);
         }
 
         glEnable(GL_TEXTURE_3D);
@@ -51,9 +51,13 @@ class ViewportOrtho : public ViewportBase {
 
     floatCoordinate arbNodeDragCache = {};
     class nodeListElement *draggedNode = nullptr;
+    bool brushStroke{false};// a stroke is one undo step, and so is a node drag
+    void endUndoGroups();
 
     virtual void mousePressEvent(QMouseEvent *event) override;
     virtual void mouseMoveEvent(QMouseEvent *event) override;
+    virtual void leaveEvent(QEvent * event) override;
+    virtual void focusOutEvent(QFocusEvent * event) override;
 
     virtual void handleKeyPress(const QKeyEvent *event) override;
     virtual void handleMouseHover(const QMouseEvent *event) override;